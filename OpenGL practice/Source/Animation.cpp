@@ -0,0 +1,523 @@
+#include "Animation.h"
+#include "JobSystem.h"
+#include "Timing.h"
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <iostream>
+#include <algorithm>
+#include <random>
+#include <chrono>
+#include <cmath>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define ANIMATION_SSE
+#include <xmmintrin.h>
+#endif
+
+void VertexBoneData::addInfluence(int bone, float weight) {
+	//weights are kept sorted from largest to smallest, a new one replaces the smallest if it's larger
+	unsigned int slot = MAX_INFLUENCES;
+	while (slot > 0 && weights[slot - 1] < weight)
+		--slot;
+	if (slot == MAX_INFLUENCES)
+		return;
+	for (unsigned int i = MAX_INFLUENCES - 1; i > slot; --i) {
+		boneIds[i] = boneIds[i - 1];
+		weights[i] = weights[i - 1];
+	}
+	boneIds[slot] = bone;
+	weights[slot] = weight;
+}
+
+void VertexBoneData::normalize() {
+	float sum = 0.0f;
+	for (unsigned int i = 0; i < MAX_INFLUENCES; ++i)
+		sum += weights[i];
+	if (sum <= 0.0f)
+		return;
+	for (unsigned int i = 0; i < MAX_INFLUENCES; ++i)
+		weights[i] /= sum;
+}
+
+
+//the bind transform is split into translation, rotation and scale, assuming it has no shear
+unsigned int Skeleton::addJoint(int parent, const glm::mat4& bindTransform, const std::string& name) {
+	glm::vec3 scale(glm::length(glm::vec3(bindTransform[0])), glm::length(glm::vec3(bindTransform[1])), glm::length(glm::vec3(bindTransform[2])));
+	glm::mat4 rotation(1.0f);
+	for (unsigned int i = 0; i < 3; ++i)
+		rotation[i] = scale[i] > 0.0f ? bindTransform[i] * (1.0f / scale[i]) : glm::vec4(0.0f);
+	rotation[0].w = rotation[1].w = rotation[2].w = 0.0f;
+
+	parents.push_back(parent);
+	bindTranslations.push_back(glm::vec3(bindTransform[3]));
+	bindRotations.push_back(glm::normalize(glm::quat_cast(rotation)));
+	bindScales.push_back(scale);
+	jointNames.push_back(name);
+	return parents.size() - 1;
+}
+
+unsigned int Skeleton::addBone(const std::string& name, const glm::mat4& offsetMatrix) {
+	for (unsigned int i = 0; i < boneNames.size(); ++i) {
+		if (boneNames[i] == name)
+			return i;
+	}
+	boneNames.push_back(name);
+	boneOffsets.push_back(offsetMatrix);
+	boneJoints.push_back(0);
+	return boneNames.size() - 1;
+}
+
+bool Skeleton::resolveBones() {
+	bool resolved = true;
+	for (unsigned int i = 0; i < boneNames.size(); ++i) {
+		int joint = findJoint(boneNames[i]);
+		if (joint < 0) {
+			std::cout << "ERROR::SKELETON:: No joint for bone " << boneNames[i] << std::endl;
+			resolved = false;
+			joint = 0;
+		}
+		boneJoints[i] = joint;
+	}
+	return resolved;
+}
+
+int Skeleton::findJoint(const std::string& name) const {
+	for (unsigned int i = 0; i < jointNames.size(); ++i) {
+		if (jointNames[i] == name)
+			return i;
+	}
+	return -1;
+}
+
+void Skeleton::clear() {
+	parents.clear();
+	bindTranslations.clear();
+	bindRotations.clear();
+	bindScales.clear();
+	jointNames.clear();
+	boneNames.clear();
+	boneOffsets.clear();
+	boneJoints.clear();
+}
+
+std::size_t Skeleton::getNumJoints() const {
+	return parents.size();
+}
+
+unsigned int Skeleton::getNumBones() const {
+	return boneNames.size();
+}
+
+int Skeleton::getParent(unsigned int joint) const {
+	return parents[joint];
+}
+
+const glm::vec3& Skeleton::getBindTranslation(unsigned int joint) const {
+	return bindTranslations[joint];
+}
+
+const glm::quat& Skeleton::getBindRotation(unsigned int joint) const {
+	return bindRotations[joint];
+}
+
+const glm::vec3& Skeleton::getBindScale(unsigned int joint) const {
+	return bindScales[joint];
+}
+
+unsigned int Skeleton::getBoneJoint(unsigned int bone) const {
+	return boneJoints[bone];
+}
+
+const glm::mat4& Skeleton::getBoneOffset(unsigned int bone) const {
+	return boneOffsets[bone];
+}
+
+
+//index of the last key at or before time, 0 before the first key
+static unsigned int findKey(const std::vector<float>& times, float time) {
+	std::vector<float>::const_iterator next = std::upper_bound(times.begin(), times.end(), time);
+	return next == times.begin() ? 0 : (unsigned int)(next - times.begin()) - 1;
+}
+
+//position of time between key and the next key, 0 when key is the last one
+static float keyFactor(const std::vector<float>& times, unsigned int key, float time) {
+	if (key + 1 >= times.size())
+		return 0.0f;
+	float span = times[key + 1] - times[key];
+	return span > 0.0f ? std::min(std::max((time - times[key]) / span, 0.0f), 1.0f) : 0.0f;
+}
+
+static glm::vec3 sampleKeys(const std::vector<float>& times, const std::vector<glm::vec3>& values, float time, const glm::vec3& bindValue) {
+	if (values.empty())
+		return bindValue;
+	unsigned int key = findKey(times, time);
+	if (key + 1 >= values.size())
+		return values[key];
+	return glm::mix(values[key], values[key + 1], keyFactor(times, key, time));
+}
+
+static glm::quat sampleKeys(const std::vector<float>& times, const std::vector<glm::quat>& values, float time, const glm::quat& bindValue) {
+	if (values.empty())
+		return bindValue;
+	unsigned int key = findKey(times, time);
+	if (key + 1 >= values.size())
+		return values[key];
+	return glm::normalize(glm::slerp(values[key], values[key + 1], keyFactor(times, key, time)));
+}
+
+AnimationSampler::AnimationSampler(const Skeleton& skeletonVal, const std::vector<AnimationClip>& clipsVal) : skeleton(skeletonVal),
+	clips(clipsVal) {
+	const std::size_t numJoints = skeleton.getNumJoints();
+	jointChannels.assign(clips.size() * numJoints, -1);
+	for (unsigned int clip = 0; clip < clips.size(); ++clip) {
+		for (unsigned int channel = 0; channel < clips[clip].channels.size(); ++channel) {
+			unsigned int joint = clips[clip].channels[channel].joint;
+			if (joint < numJoints)
+				jointChannels[clip * numJoints + joint] = channel;
+		}
+	}
+}
+
+unsigned int AnimationSampler::addInstance(unsigned int clip, float time, const glm::mat4& transform) {
+	const std::size_t numJoints = skeleton.getNumJoints();
+	instanceClips.push_back(clip);
+	instanceTimes.push_back(time);
+	instanceTransforms.push_back(transform);
+	poseTranslations.resize(poseTranslations.size() + numJoints);
+	poseRotations.resize(poseRotations.size() + numJoints);
+	poseScales.resize(poseScales.size() + numJoints);
+	jointMatrices.resize(jointMatrices.size() + numJoints);
+	boneMatrices.resize(boneMatrices.size() + skeleton.getNumBones(), glm::mat4(1.0f));
+	return instanceClips.size() - 1;
+}
+
+void AnimationSampler::setInstanceTransform(unsigned int instance, const glm::mat4& transform) {
+	instanceTransforms[instance] = transform;
+}
+
+void AnimationSampler::update(float deltaTime) {
+	updateInstances(deltaTime, 0, instanceClips.size());
+}
+
+void AnimationSampler::update(float deltaTime, JobSystem& jobSystem, unsigned int grainSize) {
+	JobCounter done;
+	jobSystem.parallelFor(instanceClips.size(), grainSize, [this, deltaTime](unsigned int begin, unsigned int end) {
+		updateInstances(deltaTime, begin, end);
+	}, &done);
+	jobSystem.wait(done);
+}
+
+const std::vector<glm::mat4>& AnimationSampler::getBoneMatrices() const {
+	return boneMatrices;
+}
+
+const glm::mat4* AnimationSampler::getBoneMatrices(unsigned int instance) const {
+	return boneMatrices.data() + (std::size_t)instance * skeleton.getNumBones();
+}
+
+std::size_t AnimationSampler::getNumInstances() const {
+	return instanceClips.size();
+}
+
+unsigned int AnimationSampler::getNumBones() const {
+	return skeleton.getNumBones();
+}
+
+//three passes per instance: sample every joint's local pose into the pose arrays, compose the model-space joint
+//matrices parent before child, then apply the bone offsets and the instance transform
+void AnimationSampler::updateInstances(float deltaTime, unsigned int begin, unsigned int end) {
+	const std::size_t numJoints = skeleton.getNumJoints();
+	const unsigned int numBones = skeleton.getNumBones();
+	for (unsigned int instance = begin; instance < end; ++instance) {
+		const unsigned int clip = instanceClips[instance];
+		const AnimationClip* animation = clip < clips.size() ? &clips[clip] : NULL;
+		float time = instanceTimes[instance] + deltaTime;
+		if (animation && animation->duration > 0.0f)
+			time = std::fmod(time, animation->duration);
+		instanceTimes[instance] = time;
+
+		const std::size_t base = instance * numJoints;
+		for (unsigned int joint = 0; joint < numJoints; ++joint) {
+			int channel = animation ? jointChannels[clip * numJoints + joint] : -1;
+			if (channel < 0) {
+				poseTranslations[base + joint] = skeleton.getBindTranslation(joint);
+				poseRotations[base + joint] = skeleton.getBindRotation(joint);
+				poseScales[base + joint] = skeleton.getBindScale(joint);
+				continue;
+			}
+			const AnimationChannel& keys = animation->channels[channel];
+			poseTranslations[base + joint] = sampleKeys(keys.positionTimes, keys.positions, time, skeleton.getBindTranslation(joint));
+			poseRotations[base + joint] = sampleKeys(keys.rotationTimes, keys.rotations, time, skeleton.getBindRotation(joint));
+			poseScales[base + joint] = sampleKeys(keys.scaleTimes, keys.scales, time, skeleton.getBindScale(joint));
+		}
+
+		for (unsigned int joint = 0; joint < numJoints; ++joint) {
+			glm::mat4 local = glm::mat4_cast(poseRotations[base + joint]);
+			const glm::vec3& scale = poseScales[base + joint];
+			local[0] = local[0] * scale.x;
+			local[1] = local[1] * scale.y;
+			local[2] = local[2] * scale.z;
+			local[3] = glm::vec4(poseTranslations[base + joint], 1.0f);
+			int parent = skeleton.getParent(joint);
+			jointMatrices[base + joint] = parent == Skeleton::NO_PARENT ? local : jointMatrices[base + parent] * local;
+		}
+
+		glm::mat4* bones = boneMatrices.data() + (std::size_t)instance * numBones;
+		for (unsigned int bone = 0; bone < numBones; ++bone)
+			bones[bone] = instanceTransforms[instance] * jointMatrices[base + skeleton.getBoneJoint(bone)] * skeleton.getBoneOffset(bone);
+	}
+}
+
+
+void skinVertices(const SkinnedMeshData& mesh, const glm::mat4* boneMatrices, glm::vec3* positions, glm::vec3* normals) {
+	for (unsigned int v = 0; v < mesh.positions.size(); ++v) {
+		const VertexBoneData& influences = mesh.bones[v];
+		glm::mat4 skin = boneMatrices[influences.boneIds[0]] * influences.weights[0];
+		for (unsigned int i = 1; i < VertexBoneData::MAX_INFLUENCES && influences.weights[i] > 0.0f; ++i)
+			skin = skin + boneMatrices[influences.boneIds[i]] * influences.weights[i];
+		positions[v] = glm::vec3(skin * glm::vec4(mesh.positions[v], 1.0f));
+		normals[v] = glm::normalize(glm::vec3(skin * glm::vec4(mesh.normals[v], 0.0f)));
+	}
+}
+
+#ifdef ANIMATION_SSE
+//every column of the blended matrix is one register: the blend is a multiply-add of whole columns, and a transform is
+//the columns scaled by the broadcast coordinates and summed
+void skinVerticesSIMD(const SkinnedMeshData& mesh, const glm::mat4* boneMatrices, glm::vec3* positions, glm::vec3* normals) {
+	for (unsigned int v = 0; v < mesh.positions.size(); ++v) {
+		const VertexBoneData& influences = mesh.bones[v];
+		__m128 column0 = _mm_setzero_ps(), column1 = _mm_setzero_ps(), column2 = _mm_setzero_ps(), column3 = _mm_setzero_ps();
+		for (unsigned int i = 0; i < VertexBoneData::MAX_INFLUENCES; ++i) {
+			//weights are sorted, the first zero ends the influences
+			if (influences.weights[i] <= 0.0f)
+				break;
+			const float* bone = glm::value_ptr(boneMatrices[influences.boneIds[i]]);
+			const __m128 weight = _mm_set1_ps(influences.weights[i]);
+			column0 = _mm_add_ps(column0, _mm_mul_ps(_mm_loadu_ps(bone), weight));
+			column1 = _mm_add_ps(column1, _mm_mul_ps(_mm_loadu_ps(bone + 4), weight));
+			column2 = _mm_add_ps(column2, _mm_mul_ps(_mm_loadu_ps(bone + 8), weight));
+			column3 = _mm_add_ps(column3, _mm_mul_ps(_mm_loadu_ps(bone + 12), weight));
+		}
+
+		const glm::vec3& position = mesh.positions[v];
+		const glm::vec3& normal = mesh.normals[v];
+		__m128 skinnedPosition = _mm_add_ps(_mm_add_ps(_mm_mul_ps(column0, _mm_set1_ps(position.x)), _mm_mul_ps(column1, _mm_set1_ps(position.y))),
+			_mm_add_ps(_mm_mul_ps(column2, _mm_set1_ps(position.z)), column3));
+		__m128 skinnedNormal = _mm_add_ps(_mm_add_ps(_mm_mul_ps(column0, _mm_set1_ps(normal.x)), _mm_mul_ps(column1, _mm_set1_ps(normal.y))),
+			_mm_mul_ps(column2, _mm_set1_ps(normal.z)));
+
+		//normalize with a full square root, the reciprocal estimate is too coarse for lighting
+		__m128 squared = _mm_mul_ps(skinnedNormal, skinnedNormal);
+		float lengthSquared = _mm_cvtss_f32(squared) + _mm_cvtss_f32(_mm_shuffle_ps(squared, squared, _MM_SHUFFLE(1, 1, 1, 1)))
+			+ _mm_cvtss_f32(_mm_shuffle_ps(squared, squared, _MM_SHUFFLE(2, 2, 2, 2)));
+		skinnedNormal = _mm_div_ps(skinnedNormal, _mm_sqrt_ps(_mm_set1_ps(lengthSquared)));
+
+		float result[4];
+		_mm_storeu_ps(result, skinnedPosition);
+		positions[v] = glm::vec3(result[0], result[1], result[2]);
+		_mm_storeu_ps(result, skinnedNormal);
+		normals[v] = glm::vec3(result[0], result[1], result[2]);
+	}
+}
+#else
+void skinVerticesSIMD(const SkinnedMeshData& mesh, const glm::mat4* boneMatrices, glm::vec3* positions, glm::vec3* normals) {
+	skinVertices(mesh, boneMatrices, positions, normals);
+}
+#endif
+
+
+BoneMatrixBuffer::BoneMatrixBuffer() : capacity(0) {
+}
+
+void BoneMatrixBuffer::upload(const std::vector<glm::mat4>& matrices) {
+	std::size_t size = matrices.size() * sizeof(glm::mat4);
+	if (size == 0)
+		return;
+	if (!buffer)
+		buffer = GLBuffer::create();
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer.get());
+	capacity = std::max(size, capacity);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, capacity, NULL, GL_STREAM_DRAW);
+	glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, size, matrices.data());
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void BoneMatrixBuffer::bind() const {
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, BINDING, buffer.get());
+}
+
+void BoneMatrixBuffer::release() {
+	buffer.reset();
+	capacity = 0;
+}
+
+
+void createProceduralCharacter(Skeleton& skeleton, std::vector<AnimationClip>& clips, SkinnedMeshData& mesh,
+	std::vector<unsigned int>& indices, unsigned int numSegments, unsigned int ringsPerSegment, unsigned int ringVertices) {
+	numSegments = std::max(numSegments, 1u);
+	ringsPerSegment = std::max(ringsPerSegment, 1u);
+	ringVertices = std::max(ringVertices, 3u);
+	const float height = 2.0f, radius = 0.15f;
+	const float segmentLength = height / numSegments;
+
+	//a chain of joints, each one segment above its parent, and one bone per joint
+	skeleton.clear();
+	for (unsigned int i = 0; i < numSegments; ++i) {
+		std::string name = "segment" + std::to_string(i);
+		skeleton.addJoint(i == 0 ? Skeleton::NO_PARENT : (int)i - 1, glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, i == 0 ? 0.0f : segmentLength, 0.0f)), name);
+		skeleton.addBone(name, glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, -(float)i * segmentLength, 0.0f)));
+	}
+	skeleton.resolveBones();
+
+	//rings of vertices up the tube. Every vertex follows the joint of its segment, and blends towards the neighbouring
+	//joint over the half of the segment closest to it, so the tube bends smoothly at the joints
+	const unsigned int numRings = numSegments * ringsPerSegment + 1;
+	mesh.positions.clear();
+	mesh.normals.clear();
+	mesh.bones.clear();
+	for (unsigned int ring = 0; ring < numRings; ++ring) {
+		float y = height * ring / (numRings - 1);
+		float ringRadius = radius * (1.0f - 0.4f * y / height);
+		float segmentPosition = y / segmentLength;
+		unsigned int segment = std::min((unsigned int)segmentPosition, numSegments - 1);
+		float t = segmentPosition - segment;
+
+		VertexBoneData influences;
+		if (t < 0.5f && segment > 0) {
+			influences.addInfluence(segment, 0.5f + t);
+			influences.addInfluence(segment - 1, 0.5f - t);
+		}
+		else if (t >= 0.5f && segment + 1 < numSegments) {
+			influences.addInfluence(segment, 1.5f - t);
+			influences.addInfluence(segment + 1, t - 0.5f);
+		}
+		else {
+			influences.addInfluence(segment, 1.0f);
+		}
+		influences.normalize();
+
+		for (unsigned int i = 0; i < ringVertices; ++i) {
+			float angle = glm::radians(360.0f) * i / ringVertices;
+			glm::vec3 direction(std::cos(angle), 0.0f, std::sin(angle));
+			mesh.positions.push_back(glm::vec3(direction.x * ringRadius, y, direction.z * ringRadius));
+			mesh.normals.push_back(direction);
+			mesh.bones.push_back(influences);
+		}
+	}
+
+	indices.clear();
+	for (unsigned int ring = 0; ring + 1 < numRings; ++ring) {
+		for (unsigned int i = 0; i < ringVertices; ++i) {
+			unsigned int a = ring * ringVertices + i, b = (ring + 1) * ringVertices + i;
+			unsigned int c = (ring + 1) * ringVertices + (i + 1) % ringVertices, d = ring * ringVertices + (i + 1) % ringVertices;
+			indices.push_back(a);
+			indices.push_back(b);
+			indices.push_back(c);
+			indices.push_back(a);
+			indices.push_back(c);
+			indices.push_back(d);
+		}
+	}
+
+	//a two second sway: every joint swings around z and x, each a little later than the one below it
+	AnimationClip sway;
+	sway.name = "sway";
+	sway.duration = 2.0f;
+	const unsigned int numKeys = 17;
+	for (unsigned int joint = 0; joint < numSegments; ++joint) {
+		AnimationChannel channel;
+		channel.joint = joint;
+		for (unsigned int key = 0; key < numKeys; ++key) {
+			float time = sway.duration * key / (numKeys - 1);
+			float phase = glm::radians(360.0f) * time / sway.duration - 0.5f * joint;
+			glm::quat swing = glm::angleAxis(glm::radians(12.0f) * std::sin(phase), glm::vec3(0.0f, 0.0f, 1.0f));
+			glm::quat twist = glm::angleAxis(glm::radians(6.0f) * std::cos(phase), glm::vec3(1.0f, 0.0f, 0.0f));
+			channel.rotationTimes.push_back(time);
+			channel.rotations.push_back(glm::normalize(swing * twist));
+		}
+		sway.channels.push_back(channel);
+	}
+	clips.clear();
+	clips.push_back(sway);
+}
+
+
+void benchmarkSkinning(unsigned int numInstances, unsigned int numFrames) {
+	if (numInstances == 0 || numFrames == 0)
+		return;
+
+	Skeleton skeleton;
+	std::vector<AnimationClip> clips;
+	SkinnedMeshData mesh;
+	std::vector<unsigned int> indices;
+	createProceduralCharacter(skeleton, clips, mesh, indices);
+
+	//instances on a grid, each starting at a random point of the clip
+	std::mt19937 generator(42);
+	std::uniform_real_distribution<float> randomTime(0.0f, clips[0].duration);
+	AnimationSampler sampler(skeleton, clips);
+	unsigned int gridSize = (unsigned int)std::ceil(std::sqrt((float)numInstances));
+	for (unsigned int i = 0; i < numInstances; ++i)
+		sampler.addInstance(0, randomTime(generator), glm::translate(glm::mat4(1.0f), glm::vec3(1.5f * (i % gridSize), 0.0f, 1.5f * (i / gridSize))));
+
+	const std::size_t numVertices = mesh.positions.size();
+	std::vector<glm::vec3> scalarPositions(numInstances * numVertices), scalarNormals(numInstances * numVertices);
+	std::vector<glm::vec3> simdPositions(numInstances * numVertices), simdNormals(numInstances * numVertices);
+	JobSystem jobSystem;
+	const float frameTime = 1.0f / 60.0f;
+
+	std::cout << "Skinning benchmark: " << numInstances << " instances, " << skeleton.getNumBones() << " bones, " << numVertices
+		<< " vertices, " << numFrames << " frames, " << jobSystem.getNumThreads() << " threads" << std::endl;
+#ifndef ANIMATION_SSE
+	std::cout << "    (SSE not available in this build, the SIMD path uses the scalar path)" << std::endl;
+#endif
+
+	//every stage runs numFrames times, the sampler keeps advancing so no two frames sample the same times
+	double samplingTime = 0.0, parallelSamplingTime = 0.0, scalarTime = 0.0, simdTime = 0.0, parallelSimdTime = 0.0; //milliseconds
+	for (unsigned int frame = 0; frame < numFrames; ++frame) {
+		auto start = std::chrono::high_resolution_clock::now();
+		sampler.update(frameTime);
+		samplingTime += elapsedMilliseconds(start);
+
+		start = std::chrono::high_resolution_clock::now();
+		sampler.update(frameTime, jobSystem);
+		parallelSamplingTime += elapsedMilliseconds(start);
+
+		start = std::chrono::high_resolution_clock::now();
+		for (unsigned int i = 0; i < numInstances; ++i)
+			skinVertices(mesh, sampler.getBoneMatrices(i), &scalarPositions[i * numVertices], &scalarNormals[i * numVertices]);
+		scalarTime += elapsedMilliseconds(start);
+
+		start = std::chrono::high_resolution_clock::now();
+		for (unsigned int i = 0; i < numInstances; ++i)
+			skinVerticesSIMD(mesh, sampler.getBoneMatrices(i), &simdPositions[i * numVertices], &simdNormals[i * numVertices]);
+		simdTime += elapsedMilliseconds(start);
+
+		start = std::chrono::high_resolution_clock::now();
+		JobCounter skinningDone;
+		jobSystem.parallelFor(numInstances, 8, [&](unsigned int begin, unsigned int end) {
+			for (unsigned int i = begin; i < end; ++i)
+				skinVerticesSIMD(mesh, sampler.getBoneMatrices(i), &simdPositions[i * numVertices], &simdNormals[i * numVertices]);
+		}, &skinningDone);
+		jobSystem.wait(skinningDone);
+		parallelSimdTime += elapsedMilliseconds(start);
+	}
+
+	std::cout << "    sampling, 1 thread: " << samplingTime / numFrames << " ms/frame" << std::endl;
+	std::cout << "    sampling, " << jobSystem.getNumThreads() << " threads: " << parallelSamplingTime / numFrames << " ms/frame" << std::endl;
+	std::cout << "    CPU skinning scalar, 1 thread: " << scalarTime / numFrames << " ms/frame" << std::endl;
+	std::cout << "    CPU skinning SIMD, 1 thread: " << simdTime / numFrames << " ms/frame" << std::endl;
+	std::cout << "    CPU skinning SIMD, " << jobSystem.getNumThreads() << " threads: " << parallelSimdTime / numFrames << " ms/frame" << std::endl;
+	std::cout << "    CPU skinning path: " << (parallelSamplingTime + parallelSimdTime) / numFrames << " ms/frame, uploads "
+		<< numInstances * numVertices * 2 * sizeof(glm::vec3) / 1024 << " KB of vertices" << std::endl;
+	std::cout << "    GPU skinning path: " << parallelSamplingTime / numFrames << " ms/frame, uploads "
+		<< sampler.getBoneMatrices().size() * sizeof(glm::mat4) / 1024 << " KB of bone matrices" << std::endl;
+
+	//sanity check: both CPU paths must skin the last frame the same way
+	float maxDifference = 0.0f;
+	for (std::size_t i = 0; i < scalarPositions.size(); ++i) {
+		maxDifference = std::max(maxDifference, glm::length(scalarPositions[i] - simdPositions[i]));
+		maxDifference = std::max(maxDifference, glm::length(scalarNormals[i] - simdNormals[i]));
+	}
+	std::cout << "    max difference between scalar and SIMD skinning: " << maxDifference << std::endl;
+}
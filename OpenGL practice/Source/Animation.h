@@ -0,0 +1,164 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <vector>
+#include <string>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include "GLResource.h"
+
+class JobSystem;
+
+//bone influences of one vertex. They live in their own vertex stream (attributes 7 and 8) next to the mesh's vertex
+//buffer, so the vertex layout of meshes without bones doesn't change
+struct VertexBoneData {
+	static const unsigned int MAX_INFLUENCES = 4;
+
+	int boneIds[MAX_INFLUENCES];
+	float weights[MAX_INFLUENCES];
+
+	VertexBoneData() {
+		for (unsigned int i = 0; i < MAX_INFLUENCES; ++i) {
+			boneIds[i] = 0;
+			weights[i] = 0.0f;
+		}
+	}
+	void addInfluence(int bone, float weight); //keeps the MAX_INFLUENCES largest weights
+	void normalize(); //scales the kept weights to sum to one
+};
+
+//keyframes of one joint, times in seconds
+struct AnimationChannel {
+	unsigned int joint;
+	std::vector<float> positionTimes, rotationTimes, scaleTimes;
+	std::vector<glm::vec3> positions;
+	std::vector<glm::quat> rotations;
+	std::vector<glm::vec3> scales;
+};
+
+//joints without a channel keep their bind pose. Clips loop
+struct AnimationClip {
+	std::string name;
+	float duration; //seconds
+	std::vector<AnimationChannel> channels;
+
+	AnimationClip() : duration(0.0f) {}
+};
+
+//Joint hierarchy in parent-before-child order, with the bind pose of every joint split into translation, rotation and
+//scale so that sampling can blend keyframes component by component. Bones are the joints meshes are skinned to: a
+//bone's offset matrix takes a vertex from mesh space into the space of its joint in the bind pose. Bones may be added
+//by name before the joints exist and are linked to them by resolveBones().
+class Skeleton
+{
+public:
+	static const int NO_PARENT = -1;
+
+	unsigned int addJoint(int parent, const glm::mat4& bindTransform, const std::string& name = "");
+	unsigned int addBone(const std::string& name, const glm::mat4& offsetMatrix); //returns the existing bone of a known name
+	bool resolveBones(); //false if a bone has no joint of the same name
+	int findJoint(const std::string& name) const;
+	void clear();
+
+	std::size_t getNumJoints() const;
+	unsigned int getNumBones() const;
+	int getParent(unsigned int joint) const;
+	const glm::vec3& getBindTranslation(unsigned int joint) const;
+	const glm::quat& getBindRotation(unsigned int joint) const;
+	const glm::vec3& getBindScale(unsigned int joint) const;
+	unsigned int getBoneJoint(unsigned int bone) const;
+	const glm::mat4& getBoneOffset(unsigned int bone) const;
+
+private:
+	//per joint
+	std::vector<int> parents;
+	std::vector<glm::vec3> bindTranslations;
+	std::vector<glm::quat> bindRotations;
+	std::vector<glm::vec3> bindScales;
+	std::vector<std::string> jointNames;
+	//per bone
+	std::vector<std::string> boneNames;
+	std::vector<glm::mat4> boneOffsets;
+	std::vector<unsigned int> boneJoints;
+};
+
+//Plays a clip on every instance of a character and produces the skinning matrices of all instances in one array, ready
+//to be uploaded for GPU skinning or read by CPU skinning. The local poses are kept as a structure of arrays (all
+//translations, all rotations, all scales) so sampling writes each component stream linearly, and every instance is
+//independent, so the job system overload samples ranges of instances on the worker threads. The skeleton and clips are
+//referenced, not copied, and must outlive the sampler.
+class AnimationSampler
+{
+public:
+	AnimationSampler(const Skeleton& skeleton, const std::vector<AnimationClip>& clips);
+	unsigned int addInstance(unsigned int clip, float time = 0.0f, const glm::mat4& transform = glm::mat4(1.0f));
+	void setInstanceTransform(unsigned int instance, const glm::mat4& transform);
+	void update(float deltaTime); //advances and samples every instance on the calling thread
+	void update(float deltaTime, JobSystem& jobSystem, unsigned int grainSize = 16);
+
+	//getNumBones() matrices per instance, instance after instance. Each one already includes the instance transform
+	const std::vector<glm::mat4>& getBoneMatrices() const;
+	const glm::mat4* getBoneMatrices(unsigned int instance) const;
+	std::size_t getNumInstances() const;
+	unsigned int getNumBones() const;
+
+private:
+	const Skeleton& skeleton;
+	const std::vector<AnimationClip>& clips;
+	std::vector<int> jointChannels; //channel of every joint in every clip, clip after clip, -1 when the joint has none
+
+	//per instance
+	std::vector<unsigned int> instanceClips;
+	std::vector<float> instanceTimes;
+	std::vector<glm::mat4> instanceTransforms;
+
+	//getNumJoints() entries per instance
+	std::vector<glm::vec3> poseTranslations;
+	std::vector<glm::quat> poseRotations;
+	std::vector<glm::vec3> poseScales;
+	std::vector<glm::mat4> jointMatrices; //model-space joint transforms
+
+	std::vector<glm::mat4> boneMatrices;
+
+	void updateInstances(float deltaTime, unsigned int begin, unsigned int end);
+};
+
+//bind pose positions and normals of a skinned mesh with their bone influences, the input of CPU skinning
+struct SkinnedMeshData {
+	std::vector<glm::vec3> positions;
+	std::vector<glm::vec3> normals;
+	std::vector<VertexBoneData> bones;
+};
+
+//CPU skinning: blends the influencing bone matrices of every vertex and transforms its position and normal. Normals
+//use the blended matrix directly, which assumes the bones don't scale non-uniformly
+void skinVertices(const SkinnedMeshData& mesh, const glm::mat4* boneMatrices, glm::vec3* positions, glm::vec3* normals);
+//same result with the matrix blend and the transforms done four floats at a time in SSE registers
+void skinVerticesSIMD(const SkinnedMeshData& mesh, const glm::mat4* boneMatrices, glm::vec3* positions, glm::vec3* normals);
+
+//shader storage buffer with the bone matrices of every instance for GPU skinning. The vertex shader reads the matrices
+//of its vertex at gl_InstanceID * numBones + boneId
+class BoneMatrixBuffer
+{
+public:
+	static const unsigned int BINDING = 3; //shader storage block binding of BoneMatrices
+
+	BoneMatrixBuffer();
+	void upload(const std::vector<glm::mat4>& matrices); //orphans the storage, so last frame's draws don't stall it
+	void bind() const;
+	void release(); //the context must still be current
+
+private:
+	GLBuffer buffer;
+	std::size_t capacity;
+};
+
+//a tube standing on the origin, segmented along +y and skinned to a chain of one joint per segment, with a looping
+//clip that sways the chain. Stands in for an animated asset where none is available
+void createProceduralCharacter(Skeleton& skeleton, std::vector<AnimationClip>& clips, SkinnedMeshData& mesh,
+	std::vector<unsigned int>& indices, unsigned int numSegments = 8, unsigned int ringsPerSegment = 4, unsigned int ringVertices = 16);
+
+//samples numInstances procedural characters and skins them on the CPU (scalar and SIMD, 1 and N threads), and prints
+//the CPU cost of each path with the bytes a frame uploads: skinned vertices for CPU skinning, bone matrices for GPU
+//skinning. The GPU side of GPU skinning is timed in the animated crowd scene
+void benchmarkSkinning(unsigned int numInstances = 1000, unsigned int numFrames = 50);
@@ -0,0 +1,279 @@
+#include "AssetLoader.h"
+#include "ProcessMemory.h"
+#include "GLTFLoader.h"
+#include "OBJLoader.h"
+#include "Timing.h"
+#include <GLFW/glfw3.h>
+#include <chrono>
+#include <algorithm>
+
+//set on the upload thread of every AssetLoader, whose steps fence their uploads before moving on to the render thread
+static thread_local bool onUploadThread = false;
+
+AssetLoader::AssetLoader(unsigned int numThreads) : running(true), numPendingLoads(0), uploadWindow(NULL), uploadThreadEnabled(false) {
+	for (unsigned int i = 0; i < std::max(numThreads, 1u); ++i)
+		threads.push_back(std::thread(&AssetLoader::threadLoop, this));
+}
+
+AssetLoader::~AssetLoader() {
+	shutdown();
+}
+
+//loads spend as much time waiting on file reads as decoding, so there are more loader threads than the job system
+//leaves free cores, but at least two so a large file doesn't hold up every other load
+unsigned int AssetLoader::getDefaultNumThreads() {
+	return std::max(2u, std::thread::hardware_concurrency() / 2);
+}
+
+AssetLoader::ThreadSwitch AssetLoader::resumeOnLoaderThread() {
+	ThreadSwitch threadSwitch = { this, ASSET_LOADER_THREAD };
+	return threadSwitch;
+}
+
+AssetLoader::ThreadSwitch AssetLoader::resumeOnRenderThread() {
+	ThreadSwitch threadSwitch = { this, ASSET_RENDER_THREAD };
+	return threadSwitch;
+}
+
+AssetLoader::ThreadSwitch AssetLoader::resumeOnUploadThread() {
+	ThreadSwitch threadSwitch = { this, isUploadThreadEnabled() ? ASSET_UPLOAD_THREAD : ASSET_RENDER_THREAD };
+	return threadSwitch;
+}
+
+bool AssetLoader::startUploadThread(GLFWwindow* window) {
+	if (uploadWindow)
+		return true;
+	//the context hints given for window are still set, so the upload context gets the same version and profile
+	glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+	uploadWindow = glfwCreateWindow(1, 1, "Upload context", NULL, window);
+	glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+	if (!uploadWindow) {
+		std::cout << "ERROR::ASSET_LOADER:: Cannot create the shared upload context" << std::endl;
+		return false;
+	}
+	uploadThread = std::thread(&AssetLoader::uploadThreadLoop, this);
+	uploadThreadEnabled = true;
+	return true;
+}
+
+void AssetLoader::setUploadThreadEnabled(bool enabled) {
+	uploadThreadEnabled = enabled && uploadWindow;
+}
+
+bool AssetLoader::isUploadThreadEnabled() const {
+	return uploadThreadEnabled.load();
+}
+
+void AssetLoader::schedule(std::coroutine_handle<> handle, AssetThread thread) {
+	//leaving the upload context: the fence follows every upload the load made there, and the flush makes sure the GPU
+	//gets to it without this context issuing anything else
+	GLsync fence = NULL;
+	if (thread == ASSET_RENDER_THREAD && onUploadThread) {
+		fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		glFlush();
+	}
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (fence) {
+			FencedStep step = { fence, handle };
+			fencedSteps.push_back(step);
+		}
+		else if (thread == ASSET_LOADER_THREAD)
+			loaderQueue.push_back(handle);
+		else if (thread == ASSET_UPLOAD_THREAD)
+			uploadQueue.push_back(handle);
+		else
+			renderQueue.push_back(handle);
+	}
+	if (thread == ASSET_LOADER_THREAD)
+		wakeCondition.notify_one();
+	else if (thread == ASSET_UPLOAD_THREAD)
+		uploadCondition.notify_one();
+}
+
+void AssetLoader::threadLoop() {
+	while (true) {
+		std::coroutine_handle<> handle;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wakeCondition.wait(lock, [this]() { return !running || !loaderQueue.empty(); });
+			if (!running)
+				return;
+			handle = loaderQueue.front();
+			loaderQueue.pop_front();
+		}
+		handle.resume();
+	}
+}
+
+void AssetLoader::uploadThreadLoop() {
+	onUploadThread = true;
+	glfwMakeContextCurrent(uploadWindow);
+	while (true) {
+		std::coroutine_handle<> handle;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			uploadCondition.wait(lock, [this]() { return !running || !uploadQueue.empty(); });
+			if (!running)
+				break;
+			handle = uploadQueue.front();
+			uploadQueue.pop_front();
+		}
+		handle.resume();
+	}
+	glfwMakeContextCurrent(NULL);
+}
+
+unsigned int AssetLoader::update(double budgetMs) {
+	auto start = std::chrono::high_resolution_clock::now();
+	unsigned int numSteps = 0;
+
+	//steps whose uploads have completed join the render queue. Polling with a zero timeout never blocks the frame
+	std::vector<FencedStep> steps;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		steps.swap(fencedSteps);
+	}
+	for (unsigned int i = 0; i < steps.size(); ++i) {
+		GLenum status = glClientWaitSync(steps[i].fence, 0, 0);
+		bool signaled = status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED;
+		if (signaled)
+			glDeleteSync(steps[i].fence);
+		std::lock_guard<std::mutex> lock(mutex);
+		if (signaled)
+			renderQueue.push_back(steps[i].handle);
+		else
+			fencedSteps.push_back(steps[i]);
+	}
+
+	while (true) {
+		std::coroutine_handle<> handle;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (!running || renderQueue.empty())
+				break;
+			handle = renderQueue.front();
+			renderQueue.pop_front();
+		}
+		handle.resume();
+		++numSteps;
+		if (elapsedMilliseconds(start) >= budgetMs)
+			break;
+	}
+	return numSteps;
+}
+
+void AssetLoader::shutdown() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (!running)
+			return;
+		running = false;
+	}
+	wakeCondition.notify_all();
+	uploadCondition.notify_all();
+	for (unsigned int i = 0; i < threads.size(); ++i)
+		threads[i].join();
+	threads.clear();
+	if (uploadThread.joinable())
+		uploadThread.join();
+	if (uploadWindow)
+		glfwDestroyWindow(uploadWindow);
+	uploadWindow = NULL;
+	uploadThreadEnabled = false;
+	for (unsigned int i = 0; i < fencedSteps.size(); ++i)
+		glDeleteSync(fencedSteps[i].fence);
+	fencedSteps.clear();
+	loaderQueue.clear();
+	renderQueue.clear();
+	uploadQueue.clear();
+}
+
+unsigned int AssetLoader::getNumPendingLoads() const {
+	return numPendingLoads.load(std::memory_order_relaxed);
+}
+
+Task<TextureImage> AssetLoader::decode(std::string path) {
+	co_await resumeOnLoaderThread();
+	co_return decodeTexture(path.c_str());
+}
+
+Task<TextureImage> AssetLoader::decode(const unsigned char* data, std::size_t size) {
+	co_await resumeOnLoaderThread();
+	co_return decodeTexture(data, size);
+}
+
+Task<unsigned int> AssetLoader::loadTexture(std::string path, bool gammaCorrection) {
+	numPendingLoads.fetch_add(1, std::memory_order_relaxed);
+	TextureImage image = co_await decode(path);
+	co_await resumeOnUploadThread();
+	unsigned int texture = uploadTexture(image, gammaCorrection);
+	co_await resumeOnRenderThread();
+	numPendingLoads.fetch_sub(1, std::memory_order_relaxed);
+	co_return texture;
+}
+
+Task<Model> AssetLoader::loadModel(std::string path, bool gammaCorrection, unsigned int residency) {
+	numPendingLoads.fetch_add(1, std::memory_order_relaxed);
+	Model model(gammaCorrection, residency);
+	ThreadSwitch resumeOnUploadContext = resumeOnUploadThread();
+	co_await resumeOnLoaderThread();
+	GLTFFile gltf; //embedded images are decoded from its mapping, so it outlives the images
+	OBJFile obj;
+	bool nativeGLTF = isGLTFFile(path) && model.importGLTF(gltf, path);
+	bool nativeOBJ = !nativeGLTF && isOBJFile(path) && model.importOBJ(obj, path);
+	Assimp::Importer importer;
+	const aiScene* scene = nativeGLTF || nativeOBJ ? NULL : model.importScene(importer, path);
+	if (!nativeGLTF && !nativeOBJ && !scene) {
+		numPendingLoads.fetch_sub(1, std::memory_order_relaxed);
+		co_return std::move(model);
+	}
+
+	//every texture starts decoding on its own loader thread now, alongside the conversion
+	std::vector<Task<TextureImage>> images;
+	images.reserve(model.loadedTextures.size());
+	for (unsigned int i = 0; i < model.loadedTextures.size(); ++i) {
+		const GLTFImage* image = nativeGLTF ? findGLTFEmbeddedImage(gltf, model.loadedTextures[i].localPath) : NULL;
+		if (image)
+			images.push_back(decode(image->data, image->size));
+		else
+			images.push_back(decode(model.directory + '/' + model.loadedTextures[i].localPath));
+	}
+
+	//the buffers are mapped by a GL context and written here: the mapped pointers are plain memory to this thread
+	co_await resumeOnUploadContext;
+	Vertex* vertices = NULL;
+	unsigned int* indices = NULL;
+	bool mapped = model.mapBuffers(vertices, indices);
+	co_await resumeOnLoaderThread();
+	std::vector<VertexBoneData> bones;
+	if (mapped && nativeGLTF)
+		model.convertGLTF(gltf, vertices, indices);
+	else if (mapped && nativeOBJ)
+		model.convertOBJ(obj, vertices, indices);
+	else if (mapped)
+		model.convertScene(scene, vertices, indices, bones);
+	importer.FreeScene(); //only the texture paths, already copied, were still needed
+	obj.close();
+	co_await resumeOnUploadContext;
+	if (mapped)
+		model.finishBuffers(bones);
+
+	//one texture upload per step, so update() can stop between them. The images arrive on whichever thread decoded them
+	for (unsigned int i = 0; i < images.size(); ++i) {
+		TextureImage image = co_await images[i];
+		co_await resumeOnUploadContext;
+		auto start = std::chrono::high_resolution_clock::now();
+		if (mapped)
+			model.setTexture(i, uploadTexture(image, gammaCorrection));
+		model.loadStats.textureTime += elapsedMilliseconds(start);
+	}
+
+	//vertex arrays aren't shared between contexts, so the model's is made on the render thread, after the uploads
+	co_await resumeOnRenderThread();
+	if (mapped)
+		model.createVertexArray();
+	model.loadStats.peakResidentBytes = getPeakResidentBytes();
+	numPendingLoads.fetch_sub(1, std::memory_order_relaxed);
+	co_return std::move(model);
+}
@@ -0,0 +1,211 @@
+#pragma once
+
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <atomic>
+#include <deque>
+#include <vector>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <utility>
+
+#include "Model.h"
+
+struct GLFWwindow;
+
+//where an AssetLoader resumes a load
+enum AssetThread {
+	ASSET_LOADER_THREAD, //file reading, decoding, conversion
+	ASSET_RENDER_THREAD, //GL calls on the render context, under the frame budget
+	ASSET_UPLOAD_THREAD //GL calls on the upload context, or on the render context when there is none
+};
+
+//Result of an asynchronous load, as a C++20 coroutine. The coroutine starts running as soon as it is called and a task
+//is either co_awaited by another coroutine, which then resumes where the task finished, or polled with isReady() by code
+//that can't suspend, such as a scene's render function. A task must be ready, or its AssetLoader shut down, before it
+//is destroyed: destroying it while its coroutine runs on another thread would free the frame under it.
+template<class T>
+class Task
+{
+public:
+	struct promise_type {
+		std::optional<T> value;
+		std::exception_ptr exception;
+		//NULL while running unawaited, the awaiting coroutine's address once awaited, this promise once finished
+		std::atomic<void*> continuation;
+
+		promise_type() : continuation(NULL) {}
+		Task get_return_object() {
+			return Task(std::coroutine_handle<promise_type>::from_promise(*this));
+		}
+		std::suspend_never initial_suspend() noexcept {
+			return {};
+		}
+		//suspends for good and resumes whoever awaits the task, on the thread that finished it
+		struct FinalAwaiter {
+			bool await_ready() noexcept {
+				return false;
+			}
+			std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> handle) noexcept {
+				promise_type& promise = handle.promise();
+				void* awaiting = promise.continuation.exchange(&promise, std::memory_order_acq_rel);
+				return awaiting ? std::coroutine_handle<>::from_address(awaiting) : std::noop_coroutine();
+			}
+			void await_resume() noexcept {}
+		};
+		FinalAwaiter final_suspend() noexcept {
+			return {};
+		}
+		void return_value(T result) {
+			value.emplace(std::move(result));
+		}
+		void unhandled_exception() {
+			exception = std::current_exception();
+		}
+	};
+
+	Task(Task&& other) noexcept : handle(other.handle) {
+		other.handle = NULL;
+	}
+	Task& operator=(Task&& other) noexcept {
+		if (this != &other) {
+			if (handle)
+				handle.destroy();
+			handle = other.handle;
+			other.handle = NULL;
+		}
+		return *this;
+	}
+	Task(const Task&) = delete;
+	Task& operator=(const Task&) = delete;
+	~Task() {
+		if (handle)
+			handle.destroy();
+	}
+
+	bool isReady() const {
+		return handle.promise().continuation.load(std::memory_order_acquire) == &handle.promise();
+	}
+	//the result of a ready task. Rethrows what the coroutine threw
+	T& get() {
+		if (handle.promise().exception)
+			std::rethrow_exception(handle.promise().exception);
+		return *handle.promise().value;
+	}
+
+	//co_await: takes the result out of the task, which is left ready but empty
+	struct Awaiter {
+		std::coroutine_handle<promise_type> handle;
+
+		bool await_ready() const {
+			return handle.promise().continuation.load(std::memory_order_acquire) == &handle.promise();
+		}
+		bool await_suspend(std::coroutine_handle<> awaiting) {
+			void* expected = NULL;
+			//fails when the task finished since await_ready, in which case the awaiting coroutine goes on right away
+			return handle.promise().continuation.compare_exchange_strong(expected, awaiting.address(), std::memory_order_acq_rel);
+		}
+		T await_resume() {
+			if (handle.promise().exception)
+				std::rethrow_exception(handle.promise().exception);
+			return std::move(*handle.promise().value);
+		}
+	};
+	Awaiter operator co_await() {
+		Awaiter awaiter = { handle };
+		return awaiter;
+	}
+
+private:
+	std::coroutine_handle<promise_type> handle;
+
+	explicit Task(std::coroutine_handle<promise_type> handleVal) : handle(handleVal) {}
+};
+
+//Loads models and textures in the background. File reading, decoding and mesh conversion run on a pool of loader
+//threads; the steps that make GL calls (creating and mapping buffers, unmapping them, uploading a texture) are resumed
+//on the render thread by update(), which stops resuming them once the frame's upload budget is spent. A load moves
+//between the two with co_await resumeOnLoaderThread() and co_await resumeOnRenderThread(), so each load reads as the
+//straight sequence of its steps. The loader must outlive the loads it started.
+//Optionally an upload thread owns a second context that shares its objects with the render context. Buffer and texture
+//uploads then go there instead of taking render thread time, and a load that moves on to the render thread afterwards
+//is only resumed once a fence placed after its uploads has signaled, so the render thread never uses an object whose
+//upload the GPU hasn't finished.
+class AssetLoader
+{
+public:
+	//awaiting it suspends the coroutine and resumes it on a loader thread or, through update(), on the render thread
+	struct ThreadSwitch {
+		AssetLoader* loader;
+		AssetThread thread;
+
+		bool await_ready() const noexcept {
+			return false;
+		}
+		void await_suspend(std::coroutine_handle<> handle) const {
+			loader->schedule(handle, thread);
+		}
+		void await_resume() const noexcept {}
+	};
+
+	explicit AssetLoader(unsigned int numThreads = getDefaultNumThreads());
+	~AssetLoader();
+	AssetLoader(const AssetLoader&) = delete;
+	AssetLoader& operator=(const AssetLoader&) = delete;
+
+	//the model's texture files are decoded on the loader threads while its meshes are converted straight into the mapped
+	//buffers. The model is ready once every texture is uploaded; one that failed to import is empty and draws nothing
+	Task<Model> loadModel(std::string path, bool gammaCorrection = false, unsigned int residency = RESIDENCY_SKINNING);
+	Task<unsigned int> loadTexture(std::string path, bool gammaCorrection = false);
+
+	ThreadSwitch resumeOnLoaderThread();
+	ThreadSwitch resumeOnRenderThread();
+	//the upload thread while it's enabled, the render thread otherwise. Decided when called, so a load that keeps the
+	//switch uploads everything to the same place
+	ThreadSwitch resumeOnUploadThread();
+
+	//creates a hidden window whose context shares the objects of window's context and starts the upload thread on it.
+	//Must be called on the main thread with window's context current. Returns false when the context can't be created
+	bool startUploadThread(GLFWwindow* window);
+	void setUploadThreadEnabled(bool enabled); //loads started afterwards upload on the render thread when disabled
+	bool isUploadThreadEnabled() const;
+
+	//resumes the loads waiting for the render thread until budgetMs is spent, at least one so every load progresses.
+	//Call once a frame on the GL thread. Returns the number of steps resumed
+	unsigned int update(double budgetMs);
+	//stops the loader threads after the steps they are running; the loads that didn't finish never will. Call on the
+	//main thread before destroying the tasks of unfinished loads and before the GL context goes away
+	void shutdown();
+	unsigned int getNumPendingLoads() const; //loads started and not yet ready
+	static unsigned int getDefaultNumThreads();
+
+private:
+	//a step for the render thread that waits on the uploads before it
+	struct FencedStep {
+		GLsync fence;
+		std::coroutine_handle<> handle;
+	};
+
+	std::vector<std::thread> threads;
+	std::deque<std::coroutine_handle<>> loaderQueue;
+	std::deque<std::coroutine_handle<>> renderQueue;
+	std::deque<std::coroutine_handle<>> uploadQueue;
+	std::vector<FencedStep> fencedSteps;
+	std::mutex mutex; //guards the queues and the fenced steps
+	std::condition_variable wakeCondition;
+	std::condition_variable uploadCondition;
+	bool running;
+	std::atomic<unsigned int> numPendingLoads;
+	GLFWwindow* uploadWindow; //NULL without an upload thread
+	std::thread uploadThread;
+	std::atomic<bool> uploadThreadEnabled;
+
+	void schedule(std::coroutine_handle<> handle, AssetThread thread);
+	void threadLoop();
+	void uploadThreadLoop();
+	Task<TextureImage> decode(std::string path);
+	Task<TextureImage> decode(const unsigned char* data, std::size_t size); //the data must outlive the task
+};
@@ -0,0 +1,505 @@
+#include "BVH.h"
+#include "JobSystem.h"
+#include "Timing.h"
+#include <glm/gtc/matrix_transform.hpp>
+#include <iostream>
+#include <random>
+#include <chrono>
+
+static const unsigned int NUM_BINS = 16; //SAH candidate split planes per axis: NUM_BINS - 1
+static const unsigned int MAX_LEAF_SIZE = 4; //larger nodes are always split
+static const unsigned int MAX_DEPTH = 60; //keeps the fixed-size traversal stacks below safe
+static const unsigned int STACK_SIZE = MAX_DEPTH + 4;
+static const float TRAVERSAL_COST = 1.0f; //cost of visiting a node relative to testing one object
+
+BVH::BVH() : buildCost(0.0f), currentCost(0.0f) {
+}
+
+void BVH::build(const std::vector<AABB>& objectBounds) {
+	bounds = objectBounds;
+	nodes.clear();
+	objectIndices.resize(bounds.size());
+	centroids.resize(bounds.size());
+	if (bounds.empty()) {
+		buildCost = currentCost = 0.0f;
+		return;
+	}
+
+	for (unsigned int i = 0; i < bounds.size(); ++i) {
+		objectIndices[i] = i;
+		centroids[i] = bounds[i].center();
+	}
+
+	//a binary tree with at least one object per leaf has at most 2n - 1 nodes, reserving them keeps node references valid
+	nodes.reserve(2 * bounds.size() - 1);
+	Node root;
+	root.leftOrFirst = 0;
+	root.count = bounds.size();
+	for (unsigned int i = 0; i < bounds.size(); ++i)
+		root.bounds.expand(bounds[i]);
+	nodes.push_back(root);
+
+	//explicit stack of (node, depth) so a degenerate input can't overflow the call stack
+	std::vector<std::pair<unsigned int, unsigned int>> buildStack;
+	buildStack.push_back(std::make_pair(0u, 0u));
+	while (!buildStack.empty()) {
+		std::pair<unsigned int, unsigned int> entry = buildStack.back();
+		buildStack.pop_back();
+		if (entry.second >= MAX_DEPTH)
+			continue;
+		subdivide(entry.first);
+		if (nodes[entry.first].count == 0) {
+			buildStack.push_back(std::make_pair(nodes[entry.first].leftOrFirst + 1, entry.second + 1));
+			buildStack.push_back(std::make_pair(nodes[entry.first].leftOrFirst, entry.second + 1));
+		}
+	}
+
+	std::vector<glm::vec3>().swap(centroids);
+	buildCost = currentCost = computeCost();
+}
+
+//splits a leaf in two with the binned SAH, or leaves it alone if splitting wouldn't lower the expected cost
+void BVH::subdivide(unsigned int nodeIndex) {
+	Node& node = nodes[nodeIndex];
+	const unsigned int first = node.leftOrFirst;
+	const unsigned int count = node.count;
+	if (count <= 1)
+		return;
+
+	AABB centroidBounds;
+	for (unsigned int i = first; i < first + count; ++i)
+		centroidBounds.expand(centroids[objectIndices[i]]);
+
+	//bin the centroids along each axis and sweep the bins from both sides to evaluate every split plane
+	int bestAxis = -1;
+	float bestPosition = 0.0f;
+	float bestCost = FLT_MAX;
+	for (unsigned int axis = 0; axis < 3; ++axis) {
+		const float axisMin = centroidBounds.min[axis];
+		const float axisExtent = centroidBounds.max[axis] - axisMin;
+		if (axisExtent <= 0.0f)
+			continue;
+
+		AABB binBounds[NUM_BINS];
+		unsigned int binCounts[NUM_BINS] = { 0 };
+		const float scale = NUM_BINS / axisExtent;
+		for (unsigned int i = first; i < first + count; ++i) {
+			unsigned int object = objectIndices[i];
+			unsigned int bin = std::min(NUM_BINS - 1, (unsigned int)((centroids[object][axis] - axisMin) * scale));
+			binCounts[bin]++;
+			binBounds[bin].expand(bounds[object]);
+		}
+
+		float leftAreas[NUM_BINS - 1], rightAreas[NUM_BINS - 1];
+		unsigned int leftCounts[NUM_BINS - 1], rightCounts[NUM_BINS - 1];
+		AABB leftBox, rightBox;
+		unsigned int leftSum = 0, rightSum = 0;
+		for (unsigned int i = 0; i < NUM_BINS - 1; ++i) {
+			leftSum += binCounts[i];
+			leftBox.expand(binBounds[i]);
+			leftCounts[i] = leftSum;
+			leftAreas[i] = leftBox.surfaceArea();
+
+			rightSum += binCounts[NUM_BINS - 1 - i];
+			rightBox.expand(binBounds[NUM_BINS - 1 - i]);
+			rightCounts[NUM_BINS - 2 - i] = rightSum;
+			rightAreas[NUM_BINS - 2 - i] = rightBox.surfaceArea();
+		}
+
+		for (unsigned int i = 0; i < NUM_BINS - 1; ++i) {
+			float cost = leftCounts[i] * leftAreas[i] + rightCounts[i] * rightAreas[i];
+			if (cost < bestCost) {
+				bestCost = cost;
+				bestAxis = axis;
+				bestPosition = axisMin + (i + 1) / scale;
+			}
+		}
+	}
+
+	unsigned int leftCount = 0;
+	if (bestAxis >= 0) {
+		const float leafCost = count * node.bounds.surfaceArea();
+		const float splitCost = TRAVERSAL_COST * node.bounds.surfaceArea() + bestCost;
+		if (count <= MAX_LEAF_SIZE && splitCost >= leafCost)
+			return;
+
+		//partition the object range around the split plane
+		int i = first;
+		int j = first + count - 1;
+		while (i <= j) {
+			if (centroids[objectIndices[i]][bestAxis] < bestPosition)
+				++i;
+			else
+				std::swap(objectIndices[i], objectIndices[j--]);
+		}
+		leftCount = i - first;
+	}
+	else if (count <= MAX_LEAF_SIZE) {
+		return; //all centroids coincide and the leaf is small enough
+	}
+
+	//coincident centroids or a split that rounding put on one side: fall back to an object median split
+	if (leftCount == 0 || leftCount == count)
+		leftCount = count / 2;
+
+	unsigned int leftIndex = nodes.size();
+	Node children[2];
+	children[0].leftOrFirst = first;
+	children[0].count = leftCount;
+	children[1].leftOrFirst = first + leftCount;
+	children[1].count = count - leftCount;
+	for (unsigned int c = 0; c < 2; ++c) {
+		for (unsigned int i = children[c].leftOrFirst; i < children[c].leftOrFirst + children[c].count; ++i)
+			children[c].bounds.expand(bounds[objectIndices[i]]);
+		nodes.push_back(children[c]);
+	}
+
+	node.leftOrFirst = leftIndex;
+	node.count = 0;
+}
+
+//recomputes every node's bounds from the new object bounds without changing the tree's topology.
+//Children are always stored after their parent, so walking the array backwards visits children first
+void BVH::refit(const std::vector<AABB>& objectBounds) {
+	if (objectBounds.size() != bounds.size()) {
+		std::cout << "ERROR::BVH:: Refit with " << objectBounds.size() << " objects, the tree was built with "
+			<< bounds.size() << ", rebuilding instead" << std::endl;
+		build(objectBounds);
+		return;
+	}
+
+	bounds = objectBounds;
+	for (unsigned int i = nodes.size(); i-- > 0;) {
+		Node& node = nodes[i];
+		node.bounds = AABB();
+		if (node.count > 0) {
+			for (unsigned int j = node.leftOrFirst; j < node.leftOrFirst + node.count; ++j)
+				node.bounds.expand(bounds[objectIndices[j]]);
+		}
+		else {
+			node.bounds.expand(nodes[node.leftOrFirst].bounds);
+			node.bounds.expand(nodes[node.leftOrFirst + 1].bounds);
+		}
+	}
+	currentCost = computeCost();
+}
+
+//objects that moved apart make refitted nodes overlap, which shows up as a growing SAH cost
+bool BVH::shouldRebuild(float costThreshold) const {
+	return currentCost > costThreshold * buildCost;
+}
+
+//SAH cost of the whole tree relative to the root's surface area
+float BVH::computeCost() const {
+	if (nodes.empty())
+		return 0.0f;
+
+	float cost = 0.0f;
+	for (unsigned int i = 0; i < nodes.size(); ++i) {
+		float area = nodes[i].bounds.surfaceArea();
+		cost += nodes[i].count > 0 ? area * nodes[i].count : area * TRAVERSAL_COST;
+	}
+	float rootArea = nodes[0].bounds.surfaceArea();
+	return rootArea > 0.0f ? cost / rootArea : cost;
+}
+
+void BVH::queryFrustum(const Frustum& frustum, std::vector<unsigned int>& results) const {
+	queryFrustums(&frustum, 1, &results);
+}
+
+//the top of the tree is expanded breadth first, dropping the subtrees outside the frustum, until there are a few
+//subtrees per thread; those are traversed as separate jobs and their results concatenated in order, so the objects come
+//out in the same order on any number of threads
+void BVH::queryFrustum(const Frustum& frustum, std::vector<unsigned int>& results, JobSystem& jobSystem) const {
+	results.clear();
+	if (nodes.empty())
+		return;
+
+	const unsigned int targetSubtrees = 4 * jobSystem.getNumThreads();
+	std::vector<unsigned int> subtrees(1, 0), nextSubtrees;
+	bool expanded = true;
+	while (expanded && subtrees.size() < targetSubtrees) {
+		expanded = false;
+		nextSubtrees.clear();
+		for (unsigned int i = 0; i < subtrees.size(); ++i) {
+			const Node& node = nodes[subtrees[i]];
+			if (node.count > 0) {
+				nextSubtrees.push_back(subtrees[i]);
+			}
+			else if (frustum.intersects(node.bounds)) {
+				nextSubtrees.push_back(node.leftOrFirst);
+				nextSubtrees.push_back(node.leftOrFirst + 1);
+				expanded = true;
+			}
+		}
+		subtrees.swap(nextSubtrees);
+	}
+
+	std::vector<std::vector<unsigned int>> subtreeResults(subtrees.size());
+	JobCounter queryDone;
+	jobSystem.parallelFor(subtrees.size(), 1, [&](unsigned int begin, unsigned int end) {
+		for (unsigned int i = begin; i < end; ++i)
+			traverseFrustums(subtrees[i], &frustum, 1, &subtreeResults[i]);
+	}, &queryDone);
+	jobSystem.wait(queryDone);
+
+	for (unsigned int i = 0; i < subtreeResults.size(); ++i)
+		results.insert(results.end(), subtreeResults[i].begin(), subtreeResults[i].end());
+}
+
+//tests several frustums (e.g. the camera and the shadow cascades) in a single traversal. Every stack entry carries a
+//bit mask of the frustums that still partially overlap the node and one of the frustums that fully contain it;
+//subtrees fully inside a frustum are accepted for it without further plane tests
+void BVH::queryFrustums(const Frustum* frustums, unsigned int numFrustums, std::vector<unsigned int>* results) const {
+	numFrustums = std::min(numFrustums, MAX_BATCHED_FRUSTUMS);
+	for (unsigned int f = 0; f < numFrustums; ++f)
+		results[f].clear();
+	if (nodes.empty() || numFrustums == 0)
+		return;
+	traverseFrustums(0, frustums, numFrustums, results);
+}
+
+//appends the objects of the subtree under root that pass each frustum to its results
+void BVH::traverseFrustums(unsigned int root, const Frustum* frustums, unsigned int numFrustums, std::vector<unsigned int>* results) const {
+	struct StackEntry {
+		unsigned int node;
+		unsigned int testMask;
+		unsigned int insideMask;
+	};
+	StackEntry stack[STACK_SIZE];
+	unsigned int stackSize = 0;
+	stack[stackSize++] = { root, numFrustums == 32 ? 0xFFFFFFFFu : (1u << numFrustums) - 1, 0 };
+
+	while (stackSize > 0) {
+		StackEntry entry = stack[--stackSize];
+		const Node& node = nodes[entry.node];
+
+		for (unsigned int f = 0; f < numFrustums; ++f) {
+			if (!(entry.testMask & (1u << f)))
+				continue;
+			Frustum::Classification classification = frustums[f].classify(node.bounds);
+			if (classification == Frustum::OUTSIDE) {
+				entry.testMask &= ~(1u << f);
+			}
+			else if (classification == Frustum::INSIDE) {
+				entry.testMask &= ~(1u << f);
+				entry.insideMask |= 1u << f;
+			}
+		}
+		if ((entry.testMask | entry.insideMask) == 0)
+			continue;
+
+		if (node.count > 0) {
+			for (unsigned int i = node.leftOrFirst; i < node.leftOrFirst + node.count; ++i) {
+				unsigned int object = objectIndices[i];
+				for (unsigned int f = 0; f < numFrustums; ++f) {
+					if ((entry.insideMask & (1u << f)) || ((entry.testMask & (1u << f)) && frustums[f].intersects(bounds[object])))
+						results[f].push_back(object);
+				}
+			}
+		}
+		else {
+			stack[stackSize++] = { node.leftOrFirst + 1, entry.testMask, entry.insideMask };
+			stack[stackSize++] = { node.leftOrFirst, entry.testMask, entry.insideMask };
+		}
+	}
+}
+
+//closest hit against the object bounds. Children are visited nearest first and any subtree whose entry point lies
+//beyond the closest hit found so far is skipped
+int BVH::raycast(const Ray& ray, float maxDistance, float& hitDistance) const {
+	int hitObject = -1;
+	float closest = maxDistance;
+	float entryDistance;
+	if (nodes.empty() || !ray.intersects(nodes[0].bounds, closest, entryDistance))
+		return -1;
+
+	std::pair<unsigned int, float> stack[STACK_SIZE];
+	unsigned int stackSize = 0;
+	stack[stackSize++] = std::make_pair(0u, entryDistance);
+
+	while (stackSize > 0) {
+		std::pair<unsigned int, float> entry = stack[--stackSize];
+		if (entry.second > closest)
+			continue;
+
+		const Node& node = nodes[entry.first];
+		if (node.count > 0) {
+			for (unsigned int i = node.leftOrFirst; i < node.leftOrFirst + node.count; ++i) {
+				unsigned int object = objectIndices[i];
+				if (ray.intersects(bounds[object], closest, entryDistance) && entryDistance < closest) {
+					closest = entryDistance;
+					hitObject = object;
+				}
+			}
+			continue;
+		}
+
+		float leftDistance, rightDistance;
+		bool hitLeft = ray.intersects(nodes[node.leftOrFirst].bounds, closest, leftDistance);
+		bool hitRight = ray.intersects(nodes[node.leftOrFirst + 1].bounds, closest, rightDistance);
+		if (hitLeft && hitRight) {
+			bool leftFirst = leftDistance <= rightDistance;
+			stack[stackSize++] = leftFirst ? std::make_pair(node.leftOrFirst + 1, rightDistance) : std::make_pair(node.leftOrFirst, leftDistance);
+			stack[stackSize++] = leftFirst ? std::make_pair(node.leftOrFirst, leftDistance) : std::make_pair(node.leftOrFirst + 1, rightDistance);
+		}
+		else if (hitLeft) {
+			stack[stackSize++] = std::make_pair(node.leftOrFirst, leftDistance);
+		}
+		else if (hitRight) {
+			stack[stackSize++] = std::make_pair(node.leftOrFirst + 1, rightDistance);
+		}
+	}
+
+	if (hitObject >= 0)
+		hitDistance = closest;
+	return hitObject;
+}
+
+//objects whose bounds overlap the sphere, e.g. the objects inside a point light's radius of influence
+void BVH::querySphere(const glm::vec3& center, float radius, std::vector<unsigned int>& results) const {
+	results.clear();
+	if (nodes.empty())
+		return;
+
+	unsigned int stack[STACK_SIZE];
+	unsigned int stackSize = 0;
+	stack[stackSize++] = 0;
+
+	while (stackSize > 0) {
+		const Node& node = nodes[stack[--stackSize]];
+		if (!sphereIntersectsAABB(center, radius, node.bounds))
+			continue;
+
+		if (node.count > 0) {
+			for (unsigned int i = node.leftOrFirst; i < node.leftOrFirst + node.count; ++i) {
+				if (sphereIntersectsAABB(center, radius, bounds[objectIndices[i]]))
+					results.push_back(objectIndices[i]);
+			}
+		}
+		else {
+			stack[stackSize++] = node.leftOrFirst + 1;
+			stack[stackSize++] = node.leftOrFirst;
+		}
+	}
+}
+
+std::size_t BVH::getNumNodes() const {
+	return nodes.size();
+}
+
+std::size_t BVH::getNumObjects() const {
+	return bounds.size();
+}
+
+const AABB& BVH::getObjectBounds(unsigned int object) const {
+	return bounds[object];
+}
+
+
+void benchmarkBVH() {
+	const unsigned int objectCounts[] = { 10000, 100000, 1000000 };
+	const unsigned int NUM_FRUSTUM_QUERIES = 100;
+	const unsigned int NUM_BATCHED_FRUSTUMS = 4;
+	const unsigned int NUM_RAYS = 10000;
+	const unsigned int NUM_SPHERES = 10000;
+
+	for (unsigned int objectCount : objectCounts) {
+		//random boxes at constant density so the number of objects per query stays comparable across sizes
+		std::mt19937 generator(42);
+		const float worldSize = 4.0f * std::cbrt((float)objectCount);
+		std::uniform_real_distribution<float> randomPosition(-0.5f * worldSize, 0.5f * worldSize);
+		std::uniform_real_distribution<float> randomHalfSize(0.25f, 1.0f);
+		std::uniform_real_distribution<float> randomOffset(-0.5f, 0.5f);
+
+		std::vector<AABB> objectBounds(objectCount);
+		for (unsigned int i = 0; i < objectCount; ++i) {
+			glm::vec3 center(randomPosition(generator), randomPosition(generator), randomPosition(generator));
+			glm::vec3 halfSize(randomHalfSize(generator), randomHalfSize(generator), randomHalfSize(generator));
+			objectBounds[i] = AABB(center - halfSize, center + halfSize);
+		}
+
+		std::cout << "BVH benchmark: " << objectCount << " objects" << std::endl;
+
+		BVH bvh;
+		auto start = std::chrono::high_resolution_clock::now();
+		bvh.build(objectBounds);
+		std::cout << "    build: " << elapsedMilliseconds(start) << " ms, " << bvh.getNumNodes() << " nodes" << std::endl;
+
+		//move every object a little and refit
+		std::vector<AABB> movedBounds(objectCount);
+		for (unsigned int i = 0; i < objectCount; ++i) {
+			glm::vec3 offset(randomOffset(generator), randomOffset(generator), randomOffset(generator));
+			movedBounds[i] = AABB(objectBounds[i].min + offset, objectBounds[i].max + offset);
+		}
+		start = std::chrono::high_resolution_clock::now();
+		bvh.refit(movedBounds);
+		std::cout << "    refit: " << elapsedMilliseconds(start) << " ms, rebuild recommended: "
+			<< (bvh.shouldRebuild() ? "yes" : "no") << std::endl;
+
+		//camera frustums looking into the box from one side, rotated about the y axis for the batched query
+		glm::mat4 projection = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, worldSize);
+		Frustum frustums[NUM_BATCHED_FRUSTUMS];
+		for (unsigned int f = 0; f < NUM_BATCHED_FRUSTUMS; ++f) {
+			float angle = glm::radians(90.0f * f);
+			glm::vec3 eye(std::sin(angle) * worldSize, 0.0f, std::cos(angle) * worldSize);
+			frustums[f] = Frustum(projection * glm::lookAt(eye, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f)));
+		}
+
+		std::vector<unsigned int> visible;
+		start = std::chrono::high_resolution_clock::now();
+		for (unsigned int q = 0; q < NUM_FRUSTUM_QUERIES; ++q)
+			bvh.queryFrustum(frustums[0], visible);
+		double bvhTime = elapsedMilliseconds(start) / NUM_FRUSTUM_QUERIES;
+
+		unsigned int bruteForceVisible = 0;
+		start = std::chrono::high_resolution_clock::now();
+		for (unsigned int i = 0; i < objectCount; ++i)
+			bruteForceVisible += frustums[0].intersects(movedBounds[i]) ? 1 : 0;
+		double bruteForceTime = elapsedMilliseconds(start);
+		std::cout << "    frustum query: " << bvhTime << " ms (" << visible.size() << " visible), brute force: "
+			<< bruteForceTime << " ms (" << bruteForceVisible << " visible)" << std::endl;
+
+		std::vector<unsigned int> batchedResults[NUM_BATCHED_FRUSTUMS];
+		start = std::chrono::high_resolution_clock::now();
+		for (unsigned int q = 0; q < NUM_FRUSTUM_QUERIES; ++q)
+			bvh.queryFrustums(frustums, NUM_BATCHED_FRUSTUMS, batchedResults);
+		double batchedTime = elapsedMilliseconds(start) / NUM_FRUSTUM_QUERIES;
+		start = std::chrono::high_resolution_clock::now();
+		for (unsigned int q = 0; q < NUM_FRUSTUM_QUERIES; ++q) {
+			for (unsigned int f = 0; f < NUM_BATCHED_FRUSTUMS; ++f)
+				bvh.queryFrustum(frustums[f], batchedResults[f]);
+		}
+		double separateTime = elapsedMilliseconds(start) / NUM_FRUSTUM_QUERIES;
+		std::cout << "    " << NUM_BATCHED_FRUSTUMS << " frustums batched: " << batchedTime << " ms, separately: "
+			<< separateTime << " ms" << std::endl;
+
+		//random rays through the volume
+		std::vector<Ray> rays;
+		rays.reserve(NUM_RAYS);
+		std::uniform_real_distribution<float> randomDirection(-1.0f, 1.0f);
+		for (unsigned int i = 0; i < NUM_RAYS; ++i) {
+			glm::vec3 origin(randomPosition(generator), randomPosition(generator), randomPosition(generator));
+			glm::vec3 direction(randomDirection(generator), randomDirection(generator), randomDirection(generator));
+			rays.push_back(Ray(origin, glm::normalize(direction)));
+		}
+		unsigned int numHits = 0;
+		float hitDistance;
+		start = std::chrono::high_resolution_clock::now();
+		for (unsigned int i = 0; i < NUM_RAYS; ++i)
+			numHits += bvh.raycast(rays[i], worldSize, hitDistance) >= 0 ? 1 : 0;
+		std::cout << "    " << NUM_RAYS << " ray casts: " << elapsedMilliseconds(start) << " ms, " << numHits << " hits" << std::endl;
+
+		//sphere queries the size of a typical point light radius
+		std::vector<unsigned int> overlapping;
+		unsigned long long totalOverlapping = 0;
+		start = std::chrono::high_resolution_clock::now();
+		for (unsigned int i = 0; i < NUM_SPHERES; ++i) {
+			glm::vec3 center(randomPosition(generator), randomPosition(generator), randomPosition(generator));
+			bvh.querySphere(center, 5.0f, overlapping);
+			totalOverlapping += overlapping.size();
+		}
+		std::cout << "    " << NUM_SPHERES << " sphere queries: " << elapsedMilliseconds(start) << " ms, "
+			<< totalOverlapping / NUM_SPHERES << " objects per sphere" << std::endl;
+	}
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <vector>
+#include "Bounds.h"
+
+class JobSystem;
+
+//Bounding volume hierarchy over object bounds, built top-down with the binned surface area heuristic.
+//Nodes are stored in a flat array and children are always allocated as a pair after their parent, so a refit is a
+//single reverse pass over the array. Moving objects are handled by refitting; once the refitted tree's SAH cost has
+//grown too far past the cost it had when it was built, shouldRebuild() asks for a fresh build.
+class BVH
+{
+public:
+	static const unsigned int MAX_BATCHED_FRUSTUMS = 32;
+
+	BVH();
+	void build(const std::vector<AABB>& objectBounds);
+	void refit(const std::vector<AABB>& objectBounds); //object count and order must match the last build
+	bool shouldRebuild(float costThreshold = 1.5f) const;
+
+	void queryFrustum(const Frustum& frustum, std::vector<unsigned int>& results) const;
+	void queryFrustum(const Frustum& frustum, std::vector<unsigned int>& results, JobSystem& jobSystem) const;
+	void queryFrustums(const Frustum* frustums, unsigned int numFrustums, std::vector<unsigned int>* results) const;
+	int raycast(const Ray& ray, float maxDistance, float& hitDistance) const; //closest object index or -1
+	void querySphere(const glm::vec3& center, float radius, std::vector<unsigned int>& results) const;
+
+	std::size_t getNumNodes() const;
+	std::size_t getNumObjects() const;
+	const AABB& getObjectBounds(unsigned int object) const;
+
+private:
+	struct Node {
+		AABB bounds;
+		unsigned int leftOrFirst; //index of the left child (right child follows it) or of the first object of a leaf
+		unsigned int count; //number of objects in a leaf, 0 for an internal node
+	};
+
+	std::vector<Node> nodes;
+	std::vector<unsigned int> objectIndices; //objects ordered so that every leaf references a contiguous range
+	std::vector<AABB> bounds;
+	std::vector<glm::vec3> centroids; //only used while building
+	float buildCost; //SAH cost of the tree right after the last build
+	float currentCost; //SAH cost after the last refit
+
+	void subdivide(unsigned int nodeIndex);
+	void traverseFrustums(unsigned int root, const Frustum* frustums, unsigned int numFrustums, std::vector<unsigned int>* results) const;
+	float computeCost() const;
+};
+
+//builds, refits and queries BVHs over 10k, 100k and 1M random boxes and prints the timings
+void benchmarkBVH();
@@ -0,0 +1,151 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <cfloat>
+#include <cmath>
+#include <algorithm>
+#include <utility>
+
+//axis-aligned bounding box. A default constructed box is empty (min > max) so that expanding it by the first point
+//or box yields exactly that point or box
+struct AABB {
+	glm::vec3 min;
+	glm::vec3 max;
+
+	AABB() : min(FLT_MAX), max(-FLT_MAX) {}
+	AABB(const glm::vec3& minVal, const glm::vec3& maxVal) : min(minVal), max(maxVal) {}
+
+	bool isEmpty() const {
+		return min.x > max.x || min.y > max.y || min.z > max.z;
+	}
+
+	void expand(const glm::vec3& point) {
+		min = glm::min(min, point);
+		max = glm::max(max, point);
+	}
+
+	void expand(const AABB& box) {
+		min = glm::min(min, box.min);
+		max = glm::max(max, box.max);
+	}
+
+	glm::vec3 center() const {
+		return 0.5f * (min + max);
+	}
+
+	glm::vec3 extent() const {
+		return max - min;
+	}
+
+	float surfaceArea() const {
+		if (isEmpty())
+			return 0.0f;
+		glm::vec3 e = extent();
+		return 2.0f * (e.x * e.y + e.y * e.z + e.z * e.x);
+	}
+
+	//bounds of the box after an affine transform (Arvo's method: every column of the matrix scales the
+	//extent of the box independently, so only the min/max of each product is needed)
+	AABB transformed(const glm::mat4& transform) const {
+		if (isEmpty())
+			return AABB();
+		glm::vec3 newMin(transform[3]), newMax(transform[3]);
+		for (unsigned int column = 0; column < 3; ++column) {
+			glm::vec3 a = glm::vec3(transform[column]) * min[column];
+			glm::vec3 b = glm::vec3(transform[column]) * max[column];
+			newMin += glm::min(a, b);
+			newMax += glm::max(a, b);
+		}
+		return AABB(newMin, newMax);
+	}
+};
+
+struct Ray {
+	glm::vec3 origin;
+	glm::vec3 direction;
+	glm::vec3 inverseDirection; //precomputed for the slab test
+
+	Ray(const glm::vec3& originVal, const glm::vec3& directionVal) : origin(originVal), direction(directionVal),
+		inverseDirection(1.0f / directionVal.x, 1.0f / directionVal.y, 1.0f / directionVal.z) {}
+
+	//slab test: returns true if the ray enters the box within [0, maxDistance] and writes the entry distance
+	//A ray running along a slab's plane, with its origin on it, computes 0 * inf = NaN for that plane. The planes are
+	//ordered by the direction's sign rather than by comparing the distances, and the comparisons that narrow the
+	//interval are false for NaN, so such a plane bounds nothing and the ray counts as inside the slab
+	bool intersects(const AABB& box, float maxDistance, float& entryDistance) const {
+		float tNear = 0.0f, tFar = maxDistance;
+		for (int axis = 0; axis < 3; ++axis) {
+			float t0 = (box.min[axis] - origin[axis]) * inverseDirection[axis];
+			float t1 = (box.max[axis] - origin[axis]) * inverseDirection[axis];
+			if (inverseDirection[axis] < 0.0f)
+				std::swap(t0, t1);
+			if (t0 > tNear)
+				tNear = t0;
+			if (t1 < tFar)
+				tFar = t1;
+		}
+		entryDistance = tNear;
+		return tNear <= tFar;
+	}
+};
+
+inline bool sphereIntersectsAABB(const glm::vec3& center, float radius, const AABB& box) {
+	glm::vec3 closestPoint = glm::clamp(center, box.min, box.max);
+	glm::vec3 offset = center - closestPoint;
+	return glm::dot(offset, offset) <= radius * radius;
+}
+
+//view frustum as six inward-facing planes (ax + by + cz + d >= 0 inside) extracted from a view-projection matrix
+struct Frustum {
+	enum Classification { OUTSIDE, INTERSECTING, INSIDE };
+
+	glm::vec4 planes[6];
+
+	Frustum() {}
+
+	//Gribb-Hartmann plane extraction: every plane is the sum or difference of the fourth row and one other row
+	explicit Frustum(const glm::mat4& viewProjection) {
+		glm::vec4 row0(viewProjection[0][0], viewProjection[1][0], viewProjection[2][0], viewProjection[3][0]);
+		glm::vec4 row1(viewProjection[0][1], viewProjection[1][1], viewProjection[2][1], viewProjection[3][1]);
+		glm::vec4 row2(viewProjection[0][2], viewProjection[1][2], viewProjection[2][2], viewProjection[3][2]);
+		glm::vec4 row3(viewProjection[0][3], viewProjection[1][3], viewProjection[2][3], viewProjection[3][3]);
+		planes[0] = row3 + row0; //left
+		planes[1] = row3 - row0; //right
+		planes[2] = row3 + row1; //bottom
+		planes[3] = row3 - row1; //top
+		planes[4] = row3 + row2; //near
+		planes[5] = row3 - row2; //far
+		for (unsigned int i = 0; i < 6; ++i)
+			planes[i] /= glm::length(glm::vec3(planes[i]));
+	}
+
+	//tests the box corner furthest along each plane's normal (p-vertex) and the one furthest against it (n-vertex)
+	Classification classify(const AABB& box) const {
+		Classification result = INSIDE;
+		for (unsigned int i = 0; i < 6; ++i) {
+			glm::vec3 normal(planes[i]);
+			glm::vec3 pVertex(normal.x >= 0.0f ? box.max.x : box.min.x, normal.y >= 0.0f ? box.max.y : box.min.y,
+				normal.z >= 0.0f ? box.max.z : box.min.z);
+			if (glm::dot(normal, pVertex) + planes[i].w < 0.0f)
+				return OUTSIDE;
+			glm::vec3 nVertex(normal.x >= 0.0f ? box.min.x : box.max.x, normal.y >= 0.0f ? box.min.y : box.max.y,
+				normal.z >= 0.0f ? box.min.z : box.max.z);
+			if (glm::dot(normal, nVertex) + planes[i].w < 0.0f)
+				result = INTERSECTING;
+		}
+		return result;
+	}
+
+	bool intersects(const AABB& box) const {
+		return classify(box) != OUTSIDE;
+	}
+
+	//plane tests only: a sphere just outside a corner of the frustum can pass, a sphere that touches it never fails
+	bool intersectsSphere(const glm::vec3& center, float radius) const {
+		for (unsigned int i = 0; i < 6; ++i) {
+			if (glm::dot(glm::vec3(planes[i]), center) + planes[i].w < -radius)
+				return false;
+		}
+		return true;
+	}
+};
@@ -0,0 +1,410 @@
+#include "CellStreamer.h"
+#include <fstream>
+#include <random>
+#include <cstring>
+#include <algorithm>
+
+static_assert(sizeof(StreamingPackHeader) == 36, "the pack header is read straight from the file");
+static_assert(sizeof(StreamingPackCell) == 40, "the pack's cell table is read straight from the file");
+
+static std::size_t alignPackOffset(std::size_t offset) {
+	return (offset + STREAMING_PACK_ALIGNMENT - 1) / STREAMING_PACK_ALIGNMENT * STREAMING_PACK_ALIGNMENT;
+}
+
+//distance from the segment to the box, measured from the point of the segment closest to the box's center: exact for
+//a point, close enough for the short look-ahead segments next to cell sized boxes
+static float distanceToSegment(const AABB& box, const glm::vec3& start, const glm::vec3& end) {
+	glm::vec3 segment = end - start;
+	float lengthSquared = glm::dot(segment, segment);
+	float t = lengthSquared > 0.0f ? std::min(std::max(glm::dot(box.center() - start, segment) / lengthSquared, 0.0f), 1.0f) : 0.0f;
+	glm::vec3 point = start + t * segment;
+	return glm::length(point - glm::clamp(point, box.min, box.max));
+}
+
+CellStreamer::CellStreamer(AssetLoader& loaderVal) : loader(loaderVal), memoryBudget(1024u << 20), gpuBudget(512u << 20),
+	drawDistance(150.0f), prefetchDistance(300.0f), lookAhead(2.0f), maxLoadsInFlight(8), frame(0) {
+	std::memset(&header, 0, sizeof(header));
+}
+
+bool CellStreamer::open(const char* path) {
+	cells.clear();
+	memoryCells.clear();
+	gpuCells.clear();
+	loadingCells.clear();
+	stats = StreamingStats();
+	if (!pack.open(path))
+		return false;
+
+	const unsigned char* data = pack.getData();
+	if (pack.getSize() < sizeof(header)) {
+		std::cout << "ERROR::CELL_STREAMER:: " << path << " is not a streaming pack" << std::endl;
+		pack.close();
+		return false;
+	}
+	std::memcpy(&header, data, sizeof(header));
+	std::size_t numCells = (std::size_t)header.cellsX * header.cellsZ;
+	if (std::memcmp(header.magic, "CELL", 4) != 0 || header.version != STREAMING_PACK_VERSION || header.vertexSize != sizeof(Vertex)
+		|| pack.getSize() < sizeof(header) + numCells * sizeof(StreamingPackCell)) {
+		std::cout << "ERROR::CELL_STREAMER:: " << path << " is not a streaming pack of this version and vertex layout" << std::endl;
+		pack.close();
+		return false;
+	}
+
+	cells.resize(numCells);
+	for (std::size_t i = 0; i < numCells; ++i) {
+		StreamingPackCell entry;
+		std::memcpy(&entry, data + sizeof(header) + i * sizeof(entry), sizeof(entry));
+		Cell& cell = cells[i];
+		cell.bounds = AABB(glm::vec3(entry.boundsMin[0], entry.boundsMin[1], entry.boundsMin[2]),
+			glm::vec3(entry.boundsMax[0], entry.boundsMax[1], entry.boundsMax[2]));
+		cell.offset = (std::size_t)entry.offset;
+		cell.vertexBytes = (std::size_t)entry.numVertices * sizeof(Vertex);
+		cell.indexBytes = (std::size_t)entry.numIndices * sizeof(unsigned int);
+		cell.numIndices = entry.numIndices;
+		if (cell.offset + cell.getSize() > pack.getSize()) {
+			std::cout << "ERROR::CELL_STREAMER:: " << path << " is truncated" << std::endl;
+			cells.clear();
+			pack.close();
+			return false;
+		}
+	}
+	return true;
+}
+
+void CellStreamer::setBudget(std::size_t memoryBytes, std::size_t gpuBytes) {
+	memoryBudget = memoryBytes;
+	gpuBudget = gpuBytes;
+}
+
+void CellStreamer::setDistances(float drawDistanceVal, float prefetchDistanceVal, float lookAheadVal) {
+	drawDistance = drawDistanceVal;
+	prefetchDistance = std::max(prefetchDistanceVal, drawDistanceVal);
+	lookAhead = lookAheadVal;
+}
+
+void CellStreamer::setMaxLoadsInFlight(unsigned int maxLoads) {
+	maxLoadsInFlight = std::max(maxLoads, 1u);
+}
+
+void CellStreamer::update(const glm::vec3& position, const glm::vec3& velocity) {
+	++frame;
+	if (cells.empty())
+		return;
+
+	//the loads update their cell themselves when they finish, on the render thread; only their tasks are left to drop
+	for (unsigned int i = 0; i < loadingCells.size();) {
+		Cell& cell = cells[loadingCells[i]];
+		if (cell.load->isReady()) {
+			cell.load.reset();
+			loadingCells[i] = loadingCells.back();
+			loadingCells.pop_back();
+		}
+		else
+			++i;
+	}
+
+	//cells near the path the camera takes within the look-ahead time, nearest to the camera first. Only the cells of the
+	//grid the path's bounds reach are tested
+	glm::vec3 predicted = position + velocity * lookAhead;
+	AABB reach;
+	reach.expand(position);
+	reach.expand(predicted);
+	glm::vec3 origin(header.origin[0], header.origin[1], header.origin[2]);
+	int minX = std::max((int)std::floor((reach.min.x - prefetchDistance - origin.x) / header.cellSize), 0);
+	int maxX = std::min((int)std::floor((reach.max.x + prefetchDistance - origin.x) / header.cellSize), (int)header.cellsX - 1);
+	int minZ = std::max((int)std::floor((reach.min.z - prefetchDistance - origin.z) / header.cellSize), 0);
+	int maxZ = std::min((int)std::floor((reach.max.z + prefetchDistance - origin.z) / header.cellSize), (int)header.cellsZ - 1);
+
+	wantedCells.clear();
+	stats.numMissingCells = 0;
+	for (int z = minZ; z <= maxZ; ++z) {
+		for (int x = minX; x <= maxX; ++x) {
+			unsigned int index = z * header.cellsX + x;
+			Cell& cell = cells[index];
+			float pathDistance = distanceToSegment(cell.bounds, position, predicted);
+			if (pathDistance > prefetchDistance)
+				continue;
+			float distance = distanceToSegment(cell.bounds, position, position);
+			cell.lastWanted = frame;
+			if (pathDistance <= drawDistance)
+				cell.lastWantedOnGPU = frame;
+			if (distance <= drawDistance && cell.gpu != CELL_RESIDENT)
+				++stats.numMissingCells;
+			WantedCell wanted = { index, distance };
+			wantedCells.push_back(wanted);
+		}
+	}
+	std::sort(wantedCells.begin(), wantedCells.end(), [](const WantedCell& a, const WantedCell& b) { return a.distance < b.distance; });
+
+	//a cell is paged in before it's uploaded, and a cell already on the GPU isn't paged in again only to be prefetched.
+	//Once a cell doesn't fit in memory the farther ones are only uploaded, if already paged in
+	bool memoryFull = false;
+	for (unsigned int i = 0; i < wantedCells.size() && loadingCells.size() < maxLoadsInFlight; ++i) {
+		unsigned int index = wantedCells[i].cell;
+		Cell& cell = cells[index];
+		if (cell.load || cell.gpu != CELL_ABSENT)
+			continue;
+		if (cell.memory == CELL_ABSENT) {
+			if (memoryFull || !makeRoomInMemory(cell.getSize())) {
+				memoryFull = true;
+				continue;
+			}
+			cell.memory = CELL_LOADING;
+			stats.memoryBytes += cell.getSize();
+			memoryCells.push_back(index);
+			loadingCells.push_back(index);
+			cell.load.emplace(pageIn(index));
+		}
+		else if (cell.memory == CELL_RESIDENT && cell.lastWantedOnGPU == frame) {
+			if (!makeRoomOnGPU(cell.getSize()))
+				continue;
+			cell.gpu = CELL_LOADING;
+			stats.gpuBytes += cell.getSize();
+			gpuCells.push_back(index);
+			loadingCells.push_back(index);
+			cell.load.emplace(upload(index));
+		}
+	}
+
+	stats.numCellsInMemory = memoryCells.size();
+	stats.numCellsOnGPU = gpuCells.size();
+	stats.numLoadsInFlight = loadingCells.size();
+}
+
+//evicts the least recently wanted cells in memory until size fits the budget. Cells wanted this frame and cells being
+//uploaded, whose pages the upload reads, are kept
+bool CellStreamer::makeRoomInMemory(std::size_t size) {
+	while (stats.memoryBytes + size > memoryBudget) {
+		int victim = -1;
+		for (unsigned int i = 0; i < memoryCells.size(); ++i) {
+			const Cell& cell = cells[memoryCells[i]];
+			if (cell.memory != CELL_RESIDENT || cell.gpu == CELL_LOADING || cell.lastWanted == frame)
+				continue;
+			if (victim < 0 || cell.lastWanted < cells[memoryCells[victim]].lastWanted)
+				victim = i;
+		}
+		if (victim < 0)
+			return false;
+		Cell& cell = cells[memoryCells[victim]];
+		pack.discard(cell.offset, cell.getSize());
+		cell.memory = CELL_ABSENT;
+		stats.memoryBytes -= cell.getSize();
+		++stats.numMemoryEvictions;
+		memoryCells[victim] = memoryCells.back();
+		memoryCells.pop_back();
+	}
+	return true;
+}
+
+bool CellStreamer::makeRoomOnGPU(std::size_t size) {
+	while (stats.gpuBytes + size > gpuBudget) {
+		int victim = -1;
+		for (unsigned int i = 0; i < gpuCells.size(); ++i) {
+			const Cell& cell = cells[gpuCells[i]];
+			if (cell.gpu != CELL_RESIDENT || cell.lastWantedOnGPU == frame)
+				continue;
+			if (victim < 0 || cell.lastWantedOnGPU < cells[gpuCells[victim]].lastWantedOnGPU)
+				victim = i;
+		}
+		if (victim < 0)
+			return false;
+		Cell& cell = cells[gpuCells[victim]];
+		cell.VAO.reset();
+		cell.VBO.reset();
+		cell.EBO.reset();
+		cell.gpu = CELL_ABSENT;
+		stats.gpuBytes -= cell.getSize();
+		++stats.numGPUEvictions;
+		gpuCells[victim] = gpuCells.back();
+		gpuCells.pop_back();
+	}
+	return true;
+}
+
+//reads the cell's pages on a loader thread: touching a byte of every page makes the OS read them there, instead of
+//when the upload first reads them on a GL thread
+Task<bool> CellStreamer::pageIn(unsigned int index) {
+	co_await loader.resumeOnLoaderThread();
+	const Cell& cell = cells[index];
+	pack.prefetch(cell.offset, cell.getSize());
+	const volatile unsigned char* data = pack.getData() + cell.offset; //volatile, so the reads aren't optimized away
+	const std::size_t pageSize = MappedFile::getPageSize();
+	for (std::size_t i = 0; i < cell.getSize(); i += pageSize)
+		(void)data[i];
+	co_await loader.resumeOnRenderThread();
+	cells[index].memory = CELL_RESIDENT;
+	++stats.numPageIns;
+	co_return true;
+}
+
+//the buffers are filled straight from the mapping. The vertex array, which contexts don't share, is made on the render
+//thread afterwards
+Task<bool> CellStreamer::upload(unsigned int index) {
+	co_await loader.resumeOnUploadThread();
+	const unsigned char* data = pack.getData() + cells[index].offset;
+	GLBuffer vertexBuffer = GLBuffer::create();
+	GLBuffer indexBuffer = GLBuffer::create();
+	glBindBuffer(GL_COPY_WRITE_BUFFER, vertexBuffer.get());
+	glBufferData(GL_COPY_WRITE_BUFFER, cells[index].vertexBytes, data, GL_STATIC_DRAW);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, indexBuffer.get());
+	glBufferData(GL_COPY_WRITE_BUFFER, cells[index].indexBytes, data + cells[index].vertexBytes, GL_STATIC_DRAW);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	co_await loader.resumeOnRenderThread();
+
+	Cell& cell = cells[index];
+	cell.VBO = std::move(vertexBuffer);
+	cell.EBO = std::move(indexBuffer);
+	cell.VAO = GLVertexArray::create();
+	glBindVertexArray(cell.VAO.get());
+	glBindBuffer(GL_ARRAY_BUFFER, cell.VBO.get());
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, cell.EBO.get());
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, normal));
+	glEnableVertexAttribArray(2);
+	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, texCoords));
+	glEnableVertexAttribArray(3);
+	glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, tangent));
+	glEnableVertexAttribArray(4);
+	glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, bitangent));
+	glBindVertexArray(0);
+	cell.gpu = CELL_RESIDENT;
+	++stats.numUploads;
+	co_return true;
+}
+
+unsigned int CellStreamer::draw(const Frustum& frustum) const {
+	unsigned int numDrawn = 0;
+	for (unsigned int i = 0; i < gpuCells.size(); ++i) {
+		const Cell& cell = cells[gpuCells[i]];
+		if (cell.gpu != CELL_RESIDENT || !frustum.intersects(cell.bounds))
+			continue;
+		glBindVertexArray(cell.VAO.get());
+		glDrawElements(GL_TRIANGLES, cell.numIndices, GL_UNSIGNED_INT, 0);
+		++numDrawn;
+	}
+	glBindVertexArray(0);
+	return numDrawn;
+}
+
+const StreamingStats& CellStreamer::getStats() const {
+	return stats;
+}
+
+unsigned int CellStreamer::getNumCells() const {
+	return cells.size();
+}
+
+AABB CellStreamer::getBounds() const {
+	AABB bounds;
+	for (unsigned int i = 0; i < cells.size(); ++i)
+		bounds.expand(cells[i].bounds);
+	return bounds;
+}
+
+std::size_t CellStreamer::getPackSize() const {
+	return pack.getSize();
+}
+
+//appends a box of 24 vertices, so every face has its own normal, and its 36 indices
+static void addBox(const glm::vec3& min, const glm::vec3& max, std::vector<Vertex>& vertices, std::vector<unsigned int>& indices) {
+	static const glm::vec3 normals[6] = { glm::vec3(1, 0, 0), glm::vec3(-1, 0, 0), glm::vec3(0, 1, 0), glm::vec3(0, -1, 0),
+		glm::vec3(0, 0, 1), glm::vec3(0, 0, -1) };
+	glm::vec3 center = 0.5f * (min + max);
+	glm::vec3 halfExtent = 0.5f * (max - min);
+	for (unsigned int face = 0; face < 6; ++face) {
+		glm::vec3 normal = normals[face];
+		glm::vec3 tangent = face < 2 ? glm::vec3(0, 0, -normal.x) : face < 4 ? glm::vec3(1, 0, 0) : glm::vec3(normal.z, 0, 0);
+		glm::vec3 bitangent = glm::cross(normal, tangent);
+		unsigned int first = vertices.size();
+		for (unsigned int corner = 0; corner < 4; ++corner) {
+			glm::vec2 texCoords((corner == 1 || corner == 2) ? 1.0f : 0.0f, corner >= 2 ? 1.0f : 0.0f);
+			glm::vec3 offset = normal + (2.0f * texCoords.x - 1.0f) * tangent + (2.0f * texCoords.y - 1.0f) * bitangent;
+			vertices.push_back(Vertex(center + offset * halfExtent, normal, texCoords, tangent, bitangent));
+		}
+		unsigned int faceIndices[6] = { first, first + 1, first + 2, first, first + 2, first + 3 };
+		indices.insert(indices.end(), faceIndices, faceIndices + 6);
+	}
+}
+
+bool generateStreamingPack(const char* path, unsigned int cellsPerSide, float cellSize, std::size_t bytesPerCell, unsigned int seed) {
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	if (!file) {
+		std::cout << "ERROR::CELL_STREAMER:: Cannot create " << path << std::endl;
+		return false;
+	}
+
+	StreamingPackHeader header;
+	std::memcpy(header.magic, "CELL", 4);
+	header.version = STREAMING_PACK_VERSION;
+	header.vertexSize = sizeof(Vertex);
+	header.cellsX = header.cellsZ = cellsPerSide;
+	header.origin[0] = header.origin[2] = -0.5f * cellsPerSide * cellSize;
+	header.origin[1] = -0.5f;
+	header.cellSize = cellSize;
+
+	const std::size_t bytesPerBox = 24 * sizeof(Vertex) + 36 * sizeof(unsigned int);
+	const unsigned int numBoxes = (unsigned int)std::max<std::size_t>(bytesPerCell / bytesPerBox, 1);
+	const std::size_t cellBytes = numBoxes * bytesPerBox;
+	std::vector<StreamingPackCell> table(cellsPerSide * cellsPerSide);
+	std::size_t offset = alignPackOffset(sizeof(header) + table.size() * sizeof(StreamingPackCell));
+	for (unsigned int i = 0; i < table.size(); ++i) {
+		table[i].offset = offset;
+		table[i].numVertices = 24 * numBoxes;
+		table[i].numIndices = 36 * numBoxes;
+		offset = alignPackOffset(offset + cellBytes);
+	}
+	std::cout << "Generating a streaming pack of " << table.size() << " cells, " << offset / (1024.0 * 1024.0 * 1024.0) << " GB: " << path
+		<< std::endl;
+
+	std::vector<Vertex> vertices;
+	std::vector<unsigned int> indices;
+	vertices.reserve(24 * numBoxes);
+	indices.reserve(36 * numBoxes);
+	std::vector<char> padding(STREAMING_PACK_ALIGNMENT, 0);
+	file.seekp(table[0].offset);
+	for (unsigned int z = 0; z < cellsPerSide; ++z) {
+		for (unsigned int x = 0; x < cellsPerSide; ++x) {
+			unsigned int index = z * cellsPerSide + x;
+			std::mt19937 generator(seed * 7919u + index);
+			std::uniform_real_distribution<float> random(0.0f, 1.0f);
+			glm::vec3 cellMin(header.origin[0] + x * cellSize, header.origin[1], header.origin[2] + z * cellSize);
+
+			//a ground slab, then boxes scattered over it, mostly low with a few towers
+			vertices.clear();
+			indices.clear();
+			addBox(cellMin - glm::vec3(0.0f, 0.2f, 0.0f), cellMin + glm::vec3(cellSize, 0.0f, cellSize), vertices, indices);
+			for (unsigned int i = 1; i < numBoxes; ++i) {
+				glm::vec3 size(0.5f + 3.5f * random(generator), 0.0f, 0.5f + 3.5f * random(generator));
+				float r = random(generator);
+				size.y = 0.5f + 4.0f * r + (r > 0.97f ? 40.0f * random(generator) : 0.0f);
+				glm::vec3 min = cellMin + glm::vec3(random(generator) * (cellSize - size.x), 0.0f, random(generator) * (cellSize - size.z));
+				addBox(min, min + size, vertices, indices);
+			}
+
+			AABB bounds;
+			for (unsigned int i = 0; i < vertices.size(); ++i)
+				bounds.expand(vertices[i].position);
+			for (unsigned int axis = 0; axis < 3; ++axis) {
+				table[index].boundsMin[axis] = bounds.min[axis];
+				table[index].boundsMax[axis] = bounds.max[axis];
+			}
+			file.write(reinterpret_cast<const char*>(vertices.data()), vertices.size() * sizeof(Vertex));
+			file.write(reinterpret_cast<const char*>(indices.data()), indices.size() * sizeof(unsigned int));
+			std::size_t end = table[index].offset + cellBytes;
+			file.write(padding.data(), alignPackOffset(end) - end);
+		}
+		std::cout << "    row " << z + 1 << " / " << cellsPerSide << std::endl;
+	}
+
+	//the table goes in last, once the bounds of every cell are known
+	file.seekp(0);
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	file.write(reinterpret_cast<const char*>(table.data()), table.size() * sizeof(StreamingPackCell));
+	if (!file) {
+		std::cout << "ERROR::CELL_STREAMER:: Cannot write " << path << std::endl;
+		return false;
+	}
+	return true;
+}
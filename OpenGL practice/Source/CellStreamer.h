@@ -0,0 +1,127 @@
+#pragma once
+
+#include <vector>
+#include <optional>
+#include <cstdint>
+#include <glm/glm.hpp>
+
+#include "Bounds.h"
+#include "MappedFile.h"
+#include "GLResource.h"
+#include "AssetLoader.h"
+
+//layout of a streaming pack: this header, the table of cells, then the data of every cell starting on a
+//STREAMING_PACK_ALIGNMENT boundary: its vertices, as in a Model's vertex buffer, followed by its indices
+struct StreamingPackHeader {
+	char magic[4]; //"CELL"
+	std::uint32_t version;
+	std::uint32_t vertexSize; //sizeof(Vertex) of the writer, the pack is only read back with the same layout
+	std::uint32_t cellsX, cellsZ; //cells of the grid, one row of cellsX cells after the other along z
+	float origin[3]; //min corner of the grid
+	float cellSize;
+};
+
+struct StreamingPackCell {
+	float boundsMin[3], boundsMax[3];
+	std::uint64_t offset; //from the start of the file
+	std::uint32_t numVertices, numIndices;
+};
+
+const std::uint32_t STREAMING_PACK_VERSION = 1;
+const std::size_t STREAMING_PACK_ALIGNMENT = 65536; //cells never share a page, so evicting one keeps its neighbours' pages
+
+//where a cell is in one of the two tiers a CellStreamer keeps cells in
+enum CellResidency {
+	CELL_ABSENT,
+	CELL_LOADING, //counts against the budget already
+	CELL_RESIDENT
+};
+
+struct StreamingStats {
+	unsigned int numCellsInMemory, numCellsOnGPU; //resident or loading
+	std::size_t memoryBytes, gpuBytes;
+	unsigned int numLoadsInFlight;
+	unsigned int numMissingCells; //cells within the draw distance of the camera that weren't on the GPU at the last update
+	//since the pack was opened
+	unsigned int numPageIns, numUploads, numMemoryEvictions, numGPUEvictions;
+
+	StreamingStats() : numCellsInMemory(0), numCellsOnGPU(0), memoryBytes(0), gpuBytes(0), numLoadsInFlight(0), numMissingCells(0),
+		numPageIns(0), numUploads(0), numMemoryEvictions(0), numGPUEvictions(0) {}
+};
+
+//Streams the cells of a scene too large for memory out of a memory-mapped pack file. A cell is paged in (its pages of
+//the mapping read from disk on a loader thread) once the camera, or where its velocity takes it within the look-ahead
+//time, comes within the prefetch distance, and uploaded into its own vertex and index buffers once within the draw
+//distance. Either tier evicts its least recently wanted cells when a new one doesn't fit its budget; a cell wanted this
+//frame is never evicted, so a budget too small for the wanted cells leaves the farthest of them out instead of thrashing.
+//The loads go through the AssetLoader, so their GL uploads happen on its upload thread when it has one and under its
+//frame budget otherwise. Like a Task, the streamer must not be destroyed while its loads run: shut the loader down first.
+class CellStreamer
+{
+public:
+	explicit CellStreamer(AssetLoader& loader);
+	CellStreamer(const CellStreamer&) = delete;
+	CellStreamer& operator=(const CellStreamer&) = delete;
+
+	bool open(const char* path); //prints the error and returns false for a missing or malformed pack
+	void setBudget(std::size_t memoryBytes, std::size_t gpuBytes);
+	void setDistances(float drawDistance, float prefetchDistance, float lookAhead); //lookAhead in seconds of velocity
+	void setMaxLoadsInFlight(unsigned int maxLoads); //fewer loads queued at once keep the priorities current
+
+	//finds the wanted cells, evicts and starts loads. Call once a frame on the render thread, velocity in units per second
+	void update(const glm::vec3& position, const glm::vec3& velocity);
+	//draws the cells on the GPU inside the frustum with the bound shader, returns how many
+	unsigned int draw(const Frustum& frustum) const;
+
+	const StreamingStats& getStats() const;
+	unsigned int getNumCells() const;
+	AABB getBounds() const; //of the whole pack
+	std::size_t getPackSize() const;
+
+private:
+	struct Cell {
+		AABB bounds;
+		std::size_t offset, vertexBytes, indexBytes;
+		unsigned int numIndices;
+		CellResidency memory, gpu;
+		unsigned int lastWanted, lastWantedOnGPU; //frames, what the LRU of each tier goes by
+		GLVertexArray VAO;
+		GLBuffer VBO, EBO;
+		std::optional<Task<bool>> load; //page-in or upload in flight, at most one at a time
+
+		Cell() : offset(0), vertexBytes(0), indexBytes(0), numIndices(0), memory(CELL_ABSENT), gpu(CELL_ABSENT), lastWanted(0),
+			lastWantedOnGPU(0) {}
+		std::size_t getSize() const {
+			return vertexBytes + indexBytes;
+		}
+	};
+
+	struct WantedCell {
+		unsigned int cell;
+		float distance; //from the camera
+	};
+
+	AssetLoader& loader;
+	MappedFile pack;
+	StreamingPackHeader header;
+	std::vector<Cell> cells; //never resized while loads run, they refer to their cell by index
+	std::vector<unsigned int> memoryCells, gpuCells; //cells resident or loading in each tier
+	std::vector<unsigned int> loadingCells;
+	std::vector<WantedCell> wantedCells; //kept to reuse its storage
+	std::size_t memoryBudget, gpuBudget;
+	float drawDistance, prefetchDistance, lookAhead;
+	unsigned int maxLoadsInFlight;
+	unsigned int frame;
+	StreamingStats stats;
+
+	bool makeRoomInMemory(std::size_t size);
+	bool makeRoomOnGPU(std::size_t size);
+	Task<bool> pageIn(unsigned int cell);
+	Task<bool> upload(unsigned int cell);
+};
+
+//writes a synthetic city to a streaming pack without ever holding more than one cell in memory: a grid of
+//cellsPerSide x cellsPerSide cells, each a ground slab and as many random boxes as fit in bytesPerCell. The defaults
+//make a pack of about 4 GB. Every cell is generated from seed and its index alone
+bool generateStreamingPack(const char* path, unsigned int cellsPerSide = 32, float cellSize = 64.0f, std::size_t bytesPerCell = 4 << 20,
+	unsigned int seed = 1);
@@ -0,0 +1,277 @@
+#include "CommandBuffer.h"
+#include "JobSystem.h"
+#include "Bounds.h"
+#include "Timing.h"
+#include <glm/gtc/matrix_transform.hpp>
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+#include <random>
+#include <chrono>
+
+static unsigned int alignUniformOffset(std::size_t offset) {
+	return (offset + CommandBuffer::UNIFORM_ALIGNMENT - 1) / CommandBuffer::UNIFORM_ALIGNMENT * CommandBuffer::UNIFORM_ALIGNMENT;
+}
+
+CommandBuffer::CommandBuffer() : viewUniformOffset(0), viewUniformSize(0) {
+}
+
+void CommandBuffer::reset() {
+	packets.clear();
+	uniformData.clear();
+	viewUniformOffset = viewUniformSize = 0;
+}
+
+unsigned int CommandBuffer::pushUniforms(const void* data, unsigned int size) {
+	unsigned int offset = alignUniformOffset(uniformData.size());
+	uniformData.resize(offset + size);
+	std::memcpy(uniformData.data() + offset, data, size);
+	return offset;
+}
+
+void CommandBuffer::setViewUniforms(const void* data, unsigned int size) {
+	viewUniformOffset = pushUniforms(data, size);
+	viewUniformSize = size;
+}
+
+void CommandBuffer::draw(const DrawPacket& packet) {
+	packets.push_back(packet);
+}
+
+void CommandBuffer::sortPackets() {
+	std::stable_sort(packets.begin(), packets.end(), [](const DrawPacket& a, const DrawPacket& b) {
+		return a.sortKey < b.sortKey;
+	});
+}
+
+const std::vector<DrawPacket>& CommandBuffer::getPackets() const {
+	return packets;
+}
+
+const std::vector<unsigned char>& CommandBuffer::getUniformData() const {
+	return uniformData;
+}
+
+unsigned int CommandBuffer::getViewUniformOffset() const {
+	return viewUniformOffset;
+}
+
+unsigned int CommandBuffer::getViewUniformSize() const {
+	return viewUniformSize;
+}
+
+unsigned long long CommandBuffer::makeSortKey(unsigned int program, unsigned int texture, unsigned int vertexArray) {
+	return ((unsigned long long)(program & 0xFFFF) << 40) | ((unsigned long long)(texture & 0xFFFFF) << 20) | (vertexArray & 0xFFFFF);
+}
+
+
+CommandBufferExecutor::CommandBufferExecutor() : capacity(0), numDraws(0), numStateChanges(0) {
+}
+
+//the buffer object is orphaned on every upload, so the driver hands out fresh storage instead of waiting for the
+//draws of the previous frame that still read the old contents
+void CommandBufferExecutor::upload(const std::vector<const CommandBuffer*>& buffers) {
+	uploadedBuffers = buffers;
+	baseOffsets.resize(buffers.size());
+	std::size_t size = 0;
+	for (unsigned int i = 0; i < buffers.size(); ++i) {
+		baseOffsets[i] = size;
+		size = alignUniformOffset(size + buffers[i]->getUniformData().size());
+	}
+	numDraws = numStateChanges = 0;
+	if (size == 0)
+		return;
+
+	if (!uniformBuffer)
+		uniformBuffer = GLBuffer::create();
+	glBindBuffer(GL_UNIFORM_BUFFER, uniformBuffer.get());
+	if (size > capacity) {
+		capacity = std::max(size, capacity * 2);
+		glBufferData(GL_UNIFORM_BUFFER, capacity, NULL, GL_STREAM_DRAW);
+	}
+	unsigned char* mapped = (unsigned char*)glMapBufferRange(GL_UNIFORM_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+	if (mapped) {
+		for (unsigned int i = 0; i < buffers.size(); ++i) {
+			const std::vector<unsigned char>& data = buffers[i]->getUniformData();
+			if (!data.empty())
+				std::memcpy(mapped + baseOffsets[i], data.data(), data.size());
+		}
+		glUnmapBuffer(GL_UNIFORM_BUFFER);
+	}
+	else {
+		std::cout << "ERROR::COMMAND_BUFFER:: Failed to map the uniform buffer of " << size << " bytes" << std::endl;
+	}
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void CommandBufferExecutor::execute(const CommandBuffer& buffer) {
+	std::vector<const CommandBuffer*>::const_iterator found = std::find(uploadedBuffers.begin(), uploadedBuffers.end(), &buffer);
+	if (found == uploadedBuffers.end()) {
+		std::cout << "ERROR::COMMAND_BUFFER:: Executed a command buffer that wasn't uploaded this frame" << std::endl;
+		return;
+	}
+	std::size_t baseOffset = baseOffsets[found - uploadedBuffers.begin()];
+
+	static const GLenum textureTargets[] = { GL_TEXTURE_2D, GL_TEXTURE_CUBE_MAP, GL_TEXTURE_2D_ARRAY, GL_TEXTURE_CUBE_MAP_ARRAY };
+	static const GLenum primitives[] = { GL_TRIANGLES, GL_LINES, GL_POINTS };
+
+	//the caller may have changed any state since the last execute, so nothing is assumed about the current bindings
+	if (buffer.getViewUniformSize() > 0)
+		glBindBufferRange(GL_UNIFORM_BUFFER, VIEW_UNIFORM_BINDING, uniformBuffer.get(), baseOffset + buffer.getViewUniformOffset(), buffer.getViewUniformSize());
+	unsigned int program = 0, vertexArray = 0;
+	unsigned int textures[DrawPacket::MAX_TEXTURES] = { 0 };
+	bool first = true;
+
+	const std::vector<DrawPacket>& packets = buffer.getPackets();
+	for (unsigned int i = 0; i < packets.size(); ++i) {
+		const DrawPacket& packet = packets[i];
+		if (first || packet.program != program) {
+			glUseProgram(packet.program);
+			program = packet.program;
+			++numStateChanges;
+		}
+		if (first || packet.vertexArray != vertexArray) {
+			glBindVertexArray(packet.vertexArray);
+			vertexArray = packet.vertexArray;
+			++numStateChanges;
+		}
+		for (unsigned int unit = 0; unit < DrawPacket::MAX_TEXTURES; ++unit) {
+			if (packet.textures[unit] == 0 || packet.textures[unit] == textures[unit])
+				continue;
+			glActiveTexture(GL_TEXTURE0 + unit);
+			glBindTexture(textureTargets[packet.textureTypes[unit]], packet.textures[unit]);
+			textures[unit] = packet.textures[unit];
+			++numStateChanges;
+		}
+		first = false;
+
+		if (packet.uniformSize > 0)
+			glBindBufferRange(GL_UNIFORM_BUFFER, DRAW_UNIFORM_BINDING, uniformBuffer.get(), baseOffset + packet.uniformOffset, packet.uniformSize);
+		if (packet.instanceCount > 1)
+			glDrawArraysInstanced(primitives[packet.primitive], packet.first, packet.count, packet.instanceCount);
+		else
+			glDrawArrays(primitives[packet.primitive], packet.first, packet.count);
+		++numDraws;
+	}
+
+	glBindVertexArray(0);
+	glActiveTexture(GL_TEXTURE0);
+}
+
+void CommandBufferExecutor::release() {
+	uniformBuffer.reset();
+	capacity = 0;
+	uploadedBuffers.clear();
+}
+
+unsigned int CommandBufferExecutor::getNumDraws() const {
+	return numDraws;
+}
+
+unsigned int CommandBufferExecutor::getNumStateChanges() const {
+	return numStateChanges;
+}
+
+
+void benchmarkCommandRecording(unsigned int numObjects, unsigned int numFrames) {
+	if (numObjects == 0 || numFrames == 0)
+		return;
+
+	//unit cubes with random position, rotation and scale around a point light, and a camera looking at the light
+	std::mt19937 generator(42);
+	const float worldSize = 2.0f * std::cbrt((float)numObjects);
+	std::uniform_real_distribution<float> randomPosition(-0.5f * worldSize, 0.5f * worldSize);
+	std::uniform_real_distribution<float> randomScale(0.25f, 1.0f);
+	std::uniform_real_distribution<float> randomAngle(-180.0f, 180.0f);
+	std::vector<glm::mat4> models(numObjects);
+	std::vector<glm::vec3> centers(numObjects);
+	std::vector<float> radii(numObjects);
+	for (unsigned int i = 0; i < numObjects; ++i) {
+		glm::vec3 position(randomPosition(generator), randomPosition(generator), randomPosition(generator));
+		float scale = randomScale(generator);
+		models[i] = glm::scale(glm::rotate(glm::translate(glm::mat4(1.0f), position), glm::radians(randomAngle(generator)),
+			glm::vec3(0.0f, 1.0f, 0.0f)), glm::vec3(scale));
+		centers[i] = position;
+		radii[i] = 0.87f * scale;
+	}
+
+	//view 0 is the camera, views 1 to 6 the faces of the light's shadow cube
+	const unsigned int NUM_VIEWS = 7;
+	const glm::vec3 directions[6] = { glm::vec3(1.0, 0.0, 0.0), glm::vec3(-1.0, 0.0, 0.0), glm::vec3(0.0, 1.0, 0.0),
+		glm::vec3(0.0, -1.0, 0.0), glm::vec3(0.0, 0.0, 1.0), glm::vec3(0.0, 0.0, -1.0) };
+	const glm::vec3 ups[6] = { glm::vec3(0.0, -1.0, 0.0), glm::vec3(0.0, -1.0, 0.0), glm::vec3(0.0, 0.0, 1.0),
+		glm::vec3(0.0, 0.0, -1.0), glm::vec3(0.0, -1.0, 0.0), glm::vec3(0.0, -1.0, 0.0) };
+	const float lightRange = 0.25f * worldSize;
+	Frustum frustums[NUM_VIEWS];
+	frustums[0] = Frustum(glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, worldSize)
+		* glm::lookAt(glm::vec3(0.0f, 0.0f, 0.5f * worldSize), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f)));
+	for (unsigned int face = 0; face < 6; ++face)
+		frustums[1 + face] = Frustum(glm::perspective(glm::radians(90.0f), 1.0f, 0.1f, lightRange) * glm::lookAt(glm::vec3(0.0f), directions[face], ups[face]));
+
+	struct ObjectUniforms {
+		glm::mat4 model;
+		glm::mat4 normalMatrix;
+	};
+
+	const unsigned int maxThreads = std::max(1u, std::thread::hardware_concurrency());
+	std::cout << "Command recording benchmark: " << numObjects << " objects, " << NUM_VIEWS << " views, " << numFrames
+		<< " frames, 1 to " << maxThreads << " threads" << std::endl;
+
+	double baseTime = 0.0;
+	for (unsigned int threads = 1; threads <= maxThreads; ++threads) {
+		//every view is split into one bucket per thread, so the main view doesn't become the critical path
+		JobSystem jobSystem(threads - 1);
+		const unsigned int numBuckets = threads;
+		std::vector<CommandBuffer> buffers(NUM_VIEWS * numBuckets);
+		double recordTime = 0.0; //milliseconds
+		std::size_t numPackets = 0, uniformBytes = 0;
+
+		for (unsigned int frame = 0; frame < numFrames; ++frame) {
+			auto start = std::chrono::high_resolution_clock::now();
+			JobCounter recordingDone;
+			for (unsigned int view = 0; view < NUM_VIEWS; ++view) {
+				for (unsigned int bucket = 0; bucket < numBuckets; ++bucket) {
+					jobSystem.run([&, view, bucket]() {
+						CommandBuffer& buffer = buffers[view * numBuckets + bucket];
+						buffer.reset();
+						unsigned int begin = (unsigned long long)numObjects * bucket / numBuckets;
+						unsigned int end = (unsigned long long)numObjects * (bucket + 1) / numBuckets;
+						for (unsigned int i = begin; i < end; ++i) {
+							if (!frustums[view].intersectsSphere(centers[i], radii[i]))
+								continue;
+							DrawPacket packet;
+							packet.program = view == 0 ? 1 : 2;
+							packet.vertexArray = 1;
+							packet.count = 36;
+							if (view == 0) {
+								ObjectUniforms uniforms = { models[i], glm::transpose(glm::inverse(models[i])) };
+								packet.uniformOffset = buffer.pushUniforms(uniforms);
+								packet.uniformSize = sizeof(ObjectUniforms);
+								packet.textures[0] = 1 + i % 2;
+							}
+							else {
+								packet.uniformOffset = buffer.pushUniforms(models[i]);
+								packet.uniformSize = sizeof(glm::mat4);
+							}
+							packet.sortKey = CommandBuffer::makeSortKey(packet.program, packet.textures[0], packet.vertexArray);
+							buffer.draw(packet);
+						}
+						buffer.sortPackets();
+					}, &recordingDone);
+				}
+			}
+			jobSystem.wait(recordingDone);
+			recordTime += elapsedMilliseconds(start);
+		}
+
+		for (unsigned int i = 0; i < buffers.size(); ++i) {
+			numPackets += buffers[i].getPackets().size();
+			uniformBytes += buffers[i].getUniformData().size();
+		}
+		recordTime /= numFrames;
+		if (threads == 1)
+			baseTime = recordTime;
+		std::cout << "    " << threads << " thread(s): " << recordTime << " ms/frame (x" << baseTime / recordTime << "), "
+			<< numPackets << " packets, " << uniformBytes / 1024 << " KB of uniforms" << std::endl;
+	}
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <vector>
+#include "GLResource.h"
+
+//one draw as plain values: the GL objects are referred to by name, but nothing here makes a GL call, so packets can be
+//recorded on any thread. Uniform data that changes per draw lives in the command buffer and is referenced by offset
+struct DrawPacket {
+	static const unsigned int MAX_TEXTURES = 4;
+	enum TextureType { TEXTURE_2D, TEXTURE_CUBE_MAP, TEXTURE_2D_ARRAY, TEXTURE_CUBE_MAP_ARRAY };
+	enum PrimitiveType { TRIANGLES, LINES, POINTS };
+
+	unsigned int program;
+	unsigned int vertexArray;
+	unsigned int textures[MAX_TEXTURES]; //bound to texture units 0.., 0 leaves the unit as it is
+	TextureType textureTypes[MAX_TEXTURES];
+	unsigned int uniformOffset; //of the draw's uniform block data in the command buffer
+	unsigned int uniformSize; //0 when the draw has no uniform block data
+	PrimitiveType primitive;
+	unsigned int first; //first vertex
+	unsigned int count; //number of vertices
+	unsigned int instanceCount;
+	unsigned long long sortKey;
+
+	DrawPacket() : program(0), vertexArray(0), uniformOffset(0), uniformSize(0), primitive(TRIANGLES), first(0), count(0),
+		instanceCount(1), sortKey(0) {
+		for (unsigned int i = 0; i < MAX_TEXTURES; ++i) {
+			textures[i] = 0;
+			textureTypes[i] = TEXTURE_2D;
+		}
+	}
+};
+
+//Draw packets of one view or bucket and the uniform block data they reference. A command buffer is recorded by one
+//thread at a time; separate views are recorded into separate buffers in parallel and merged on the GL thread by a
+//CommandBufferExecutor. Every block of uniform data starts at a multiple of UNIFORM_ALIGNMENT, so the offsets stay
+//valid for glBindBufferRange wherever the executor places the buffer.
+class CommandBuffer
+{
+public:
+	static const unsigned int UNIFORM_ALIGNMENT = 256; //largest GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT of current hardware
+
+	CommandBuffer();
+	void reset(); //keeps the allocations for the next frame
+
+	unsigned int pushUniforms(const void* data, unsigned int size); //copies a uniform block, returns its offset
+	template<typename T> unsigned int pushUniforms(const T& data) {
+		return pushUniforms(&data, sizeof(T));
+	}
+	void setViewUniforms(const void* data, unsigned int size); //block bound once before the packets are replayed
+	template<typename T> void setViewUniforms(const T& data) {
+		setViewUniforms(&data, sizeof(T));
+	}
+
+	void draw(const DrawPacket& packet);
+	void sortPackets(); //by sort key, packets with the same key keep their order
+
+	const std::vector<DrawPacket>& getPackets() const;
+	const std::vector<unsigned char>& getUniformData() const;
+	unsigned int getViewUniformOffset() const;
+	unsigned int getViewUniformSize() const;
+
+	//program in the top bits, then the first texture and the vertex array, so sorting groups the expensive state changes
+	static unsigned long long makeSortKey(unsigned int program, unsigned int texture, unsigned int vertexArray);
+
+private:
+	std::vector<DrawPacket> packets;
+	std::vector<unsigned char> uniformData;
+	unsigned int viewUniformOffset, viewUniformSize;
+};
+
+//Replays command buffers on the GL thread. upload() merges the uniform data of every buffer of the frame into one
+//buffer object with a single mapped write; execute() then replays one of them, binding its view block and each
+//packet's draw block with glBindBufferRange and skipping program, vertex array and texture binds that wouldn't change
+//anything. Render target and other pass state is left to the caller, which sets it up between the execute() calls.
+class CommandBufferExecutor
+{
+public:
+	static const unsigned int VIEW_UNIFORM_BINDING = 1; //uniform block binding of the view block
+	static const unsigned int DRAW_UNIFORM_BINDING = 2; //uniform block binding of the per-draw block
+
+	CommandBufferExecutor();
+	void upload(const std::vector<const CommandBuffer*>& buffers);
+	void execute(const CommandBuffer& buffer); //the buffer must be part of the last upload
+	void release(); //deletes the buffer object, the context must still be current
+
+	unsigned int getNumDraws() const; //since the last upload
+	unsigned int getNumStateChanges() const; //program, vertex array and texture binds since the last upload
+
+private:
+	GLBuffer uniformBuffer;
+	std::size_t capacity;
+	std::vector<const CommandBuffer*> uploadedBuffers;
+	std::vector<std::size_t> baseOffsets; //of every uploaded buffer's data in uniformBuffer
+	unsigned int numDraws, numStateChanges;
+};
+
+//records numObjects random objects into the six faces of a point light's shadow cube and a camera view (culling every
+//object against each view and packing its uniforms) with 1 to N threads and prints the recording time and speedup.
+//Only the recording is timed, nothing is replayed, so this runs without a GL context
+void benchmarkCommandRecording(unsigned int numObjects = 50000, unsigned int numFrames = 100);
@@ -0,0 +1,72 @@
+#include "DynamicResolution.h"
+#include <algorithm>
+#include <cmath>
+
+const float DynamicResolution::SCALE_STEP = 0.05f;
+const float DynamicResolution::SMOOTHING = 0.1f;
+const float DynamicResolution::HEADROOM = 0.85f;
+
+DynamicResolution::DynamicResolution(float budgetVal, float minScaleVal, float maxScaleVal) : budget(budgetVal), minScale(minScaleVal),
+	maxScale(maxScaleVal), scale(maxScaleVal), smoothedFrameTime(0.0f), framesSinceChange(0), width(0), height(0) {
+}
+
+bool DynamicResolution::update(float gpuFrameTime, unsigned int windowWidth, unsigned int windowHeight) {
+	unsigned int previousWidth = width, previousHeight = height;
+	if (gpuFrameTime > 0.0f) {
+		smoothedFrameTime = smoothedFrameTime == 0.0f ? gpuFrameTime : smoothedFrameTime + SMOOTHING * (gpuFrameTime - smoothedFrameTime);
+		++framesSinceChange;
+	}
+
+	if (framesSinceChange >= COOLDOWN_FRAMES && (smoothedFrameTime > budget || smoothedFrameTime < HEADROOM * budget)) {
+		float wanted = scale * std::sqrt(budget / smoothedFrameTime);
+		//round towards the current scale so a frame time just past the threshold still moves by one step
+		float steps = (wanted - scale) / SCALE_STEP;
+		steps = steps > 0.0f ? std::max(std::floor(steps), 1.0f) : std::min(std::ceil(steps), -1.0f);
+		float newScale = std::min(std::max(scale + steps * SCALE_STEP, minScale), maxScale);
+		if (newScale != scale) {
+			scale = newScale;
+			framesSinceChange = 0;
+		}
+	}
+
+	resize(windowWidth, windowHeight);
+	return width != previousWidth || height != previousHeight;
+}
+
+void DynamicResolution::reset(unsigned int windowWidth, unsigned int windowHeight) {
+	scale = maxScale;
+	smoothedFrameTime = 0.0f;
+	framesSinceChange = 0;
+	resize(windowWidth, windowHeight);
+}
+
+//a minimized window has a size of 0, the targets never go below 1x1
+void DynamicResolution::resize(unsigned int windowWidth, unsigned int windowHeight) {
+	width = std::max((unsigned int)(windowWidth * scale + 0.5f), 1u);
+	height = std::max((unsigned int)(windowHeight * scale + 0.5f), 1u);
+}
+
+unsigned int DynamicResolution::getWidth() const {
+	return width;
+}
+
+unsigned int DynamicResolution::getHeight() const {
+	return height;
+}
+
+float DynamicResolution::getScale() const {
+	return scale;
+}
+
+float DynamicResolution::getSmoothedFrameTime() const {
+	return smoothedFrameTime;
+}
+
+float DynamicResolution::getBudget() const {
+	return budget;
+}
+
+void DynamicResolution::setBudget(float budgetVal) {
+	budget = budgetVal;
+	framesSinceChange = 0;
+}
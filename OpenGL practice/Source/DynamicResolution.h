@@ -0,0 +1,38 @@
+#pragma once
+
+//Picks the internal render resolution from the measured GPU frame time. The frame time is smoothed, and the
+//resolution scale (applied to both axes) is lowered as soon as the smoothed time goes over the budget, and raised when
+//it leaves enough headroom. The GPU cost is taken to be proportional to the number of pixels, so the scale a frame
+//time asks for is scale * sqrt(budget / frameTime); it is quantized to steps and held for a few frames after every
+//change, which keeps the targets from being reallocated every frame while the timer results catch up.
+class DynamicResolution
+{
+public:
+	DynamicResolution(float budgetVal = 1000.0f / 60.0f, float minScaleVal = 0.5f, float maxScaleVal = 1.0f);
+
+	//feeds the GPU time of a finished frame in milliseconds, returns true when the internal resolution changed
+	bool update(float gpuFrameTime, unsigned int windowWidth, unsigned int windowHeight);
+	void reset(unsigned int windowWidth, unsigned int windowHeight); //back to the maximum scale, forgets the measurements
+
+	unsigned int getWidth() const;
+	unsigned int getHeight() const;
+	float getScale() const;
+	float getSmoothedFrameTime() const;
+	float getBudget() const;
+	void setBudget(float budgetVal);
+
+private:
+	static const unsigned int COOLDOWN_FRAMES = 30; //measurements still include frames rendered before the last change
+	static const float SCALE_STEP;
+	static const float SMOOTHING; //weight of a new measurement in the moving average
+	static const float HEADROOM; //the scale is only raised when the frame time is below this fraction of the budget
+
+	float budget;
+	float minScale, maxScale;
+	float scale;
+	float smoothedFrameTime;
+	unsigned int framesSinceChange;
+	unsigned int width, height;
+
+	void resize(unsigned int windowWidth, unsigned int windowHeight);
+};
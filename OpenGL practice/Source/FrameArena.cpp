@@ -0,0 +1,253 @@
+#include "FrameArena.h"
+#include "Timing.h"
+#include <glm/glm.hpp>
+#include <iostream>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <algorithm>
+
+//allocation-counting hook: the replaceable global allocation functions, counting every call before going to malloc
+static std::atomic<std::size_t> heapAllocations(0);
+
+void* operator new(std::size_t size) {
+	heapAllocations.fetch_add(1, std::memory_order_relaxed);
+	void* pointer = std::malloc(size > 0 ? size : 1);
+	if (!pointer)
+		throw std::bad_alloc();
+	return pointer;
+}
+
+void* operator new[](std::size_t size) {
+	return operator new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+	heapAllocations.fetch_add(1, std::memory_order_relaxed);
+	return std::malloc(size > 0 ? size : 1);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t& tag) noexcept {
+	return operator new(size, tag);
+}
+
+void operator delete(void* pointer) noexcept {
+	std::free(pointer);
+}
+
+void operator delete[](void* pointer) noexcept {
+	std::free(pointer);
+}
+
+void operator delete(void* pointer, std::size_t) noexcept {
+	std::free(pointer);
+}
+
+void operator delete[](void* pointer, std::size_t) noexcept {
+	std::free(pointer);
+}
+
+void operator delete(void* pointer, const std::nothrow_t&) noexcept {
+	std::free(pointer);
+}
+
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept {
+	std::free(pointer);
+}
+
+std::size_t getHeapAllocationCount() {
+	return heapAllocations.load(std::memory_order_relaxed);
+}
+
+
+FrameArena::FrameArena(std::size_t initialCapacity) : offset(0), bytesUsed(0) {
+	Block block = { static_cast<char*>(::operator new(initialCapacity)), initialCapacity };
+	blocks.reserve(8);
+	blocks.push_back(block);
+}
+
+FrameArena::~FrameArena() {
+	for (unsigned int i = 0; i < blocks.size(); ++i)
+		::operator delete(blocks[i].data);
+}
+
+void* FrameArena::allocate(std::size_t size, std::size_t alignment) {
+	Block* block = &blocks.back();
+	std::uintptr_t address = reinterpret_cast<std::uintptr_t>(block->data) + offset;
+	std::size_t padding = (alignment - address % alignment) % alignment;
+
+	//out of space: chain on a block at least twice the size of the last one
+	if (offset + padding + size > block->size) {
+		Block newBlock;
+		newBlock.size = std::max(2 * block->size, size + alignment);
+		newBlock.data = static_cast<char*>(::operator new(newBlock.size));
+		blocks.push_back(newBlock);
+		block = &blocks.back();
+		offset = 0;
+		address = reinterpret_cast<std::uintptr_t>(block->data);
+		padding = (alignment - address % alignment) % alignment;
+	}
+
+	void* pointer = block->data + offset + padding;
+	offset += padding + size;
+	bytesUsed += padding + size;
+	return pointer;
+}
+
+void FrameArena::reset() {
+	//the frame overflowed the first block: merge the chain into one block that holds a whole frame
+	if (blocks.size() > 1) {
+		std::size_t capacity = getCapacity();
+		for (unsigned int i = 0; i < blocks.size(); ++i)
+			::operator delete(blocks[i].data);
+		blocks.clear();
+		Block block = { static_cast<char*>(::operator new(capacity)), capacity };
+		blocks.push_back(block);
+	}
+	offset = 0;
+	bytesUsed = 0;
+}
+
+std::size_t FrameArena::getBytesUsed() const {
+	return bytesUsed;
+}
+
+std::size_t FrameArena::getCapacity() const {
+	std::size_t capacity = 0;
+	for (unsigned int i = 0; i < blocks.size(); ++i)
+		capacity += blocks[i].size;
+	return capacity;
+}
+
+
+//slot of the calling thread in every FrameArenas, handed out in the order threads first ask for an arena
+static std::atomic<unsigned int> nextThreadSlot(0);
+static thread_local unsigned int threadSlot = nextThreadSlot.fetch_add(1);
+
+FrameArenas::FrameArenas(std::size_t arenaCapacity) : frame(0), enabled(true), arenaCapacity(arenaCapacity) {
+	for (unsigned int i = 0; i < 2; ++i) {
+		for (unsigned int j = 0; j < MAX_THREADS; ++j)
+			arenas[i][j] = NULL;
+	}
+}
+
+FrameArenas::~FrameArenas() {
+	for (unsigned int i = 0; i < 2; ++i) {
+		for (unsigned int j = 0; j < MAX_THREADS; ++j)
+			delete arenas[i][j];
+	}
+}
+
+FrameArena* FrameArenas::get() {
+	if (!enabled || threadSlot >= MAX_THREADS)
+		return NULL;
+	FrameArena*& arena = arenas[frame.load(std::memory_order_relaxed) % 2][threadSlot];
+	if (!arena)
+		arena = new FrameArena(arenaCapacity);
+	return arena;
+}
+
+//the arenas now being switched to were last used the frame before the one that just ended
+void FrameArenas::endFrame() {
+	unsigned int next = (frame.load(std::memory_order_relaxed) + 1) % 2;
+	for (unsigned int i = 0; i < MAX_THREADS; ++i) {
+		if (arenas[next][i])
+			arenas[next][i]->reset();
+	}
+	frame.store(next, std::memory_order_relaxed);
+}
+
+void FrameArenas::setEnabled(bool enabledVal) {
+	enabled = enabledVal;
+}
+
+bool FrameArenas::isEnabled() const {
+	return enabled;
+}
+
+std::size_t FrameArenas::getBytesUsed() const {
+	std::size_t bytes = 0;
+	unsigned int current = frame.load(std::memory_order_relaxed) % 2;
+	for (unsigned int i = 0; i < MAX_THREADS; ++i) {
+		if (arenas[current][i])
+			bytes += arenas[current][i]->getBytesUsed();
+	}
+	return bytes;
+}
+
+
+//the transient data of one frame, built with whatever allocator the containers are given
+template<class String, class Allocator>
+static float buildFrameData(const Allocator& allocator, unsigned int frame) {
+	struct FaceUpdate {
+		unsigned int light;
+		unsigned int face;
+		float priority;
+	};
+	float checksum = 0.0f;
+
+	//six shadow cube face matrices
+	typename std::allocator_traits<Allocator>::template rebind_alloc<glm::mat4> matrixAllocator(allocator);
+	std::vector<glm::mat4, decltype(matrixAllocator)> shadowTransforms(matrixAllocator);
+	for (unsigned int face = 0; face < 6; ++face)
+		shadowTransforms.push_back(glm::mat4((float)(frame + face)));
+	checksum += shadowTransforms[5][0][0];
+
+	//point shadow face candidates of 24 lights
+	typename std::allocator_traits<Allocator>::template rebind_alloc<FaceUpdate> candidateAllocator(allocator);
+	std::vector<FaceUpdate, decltype(candidateAllocator)> candidates(candidateAllocator);
+	for (unsigned int light = 0; light < 24; ++light) {
+		for (unsigned int face = 0; face < 6; ++face) {
+			FaceUpdate update = { light, face, (float)((frame * 7 + light * 6 + face) % 13) };
+			candidates.push_back(update);
+		}
+	}
+	checksum += candidates.back().priority;
+
+	//uniform names of the lights and a timer label
+	typename std::allocator_traits<Allocator>::template rebind_alloc<char> charAllocator(allocator);
+	for (unsigned int light = 0; light < 24; ++light) {
+		String name("pointLights[", charAllocator);
+		name.append(std::to_string(light).c_str()).append("].position");
+		checksum += (float)name.size();
+	}
+	String label("Point shadow updates (", charAllocator);
+	label.append(std::to_string(24).c_str()).append(" lights, budget ").append(std::to_string(12).c_str()).append(" faces)");
+	checksum += (float)label.size();
+	return checksum;
+}
+
+void benchmarkFrameArena(unsigned int numFrames) {
+	if (numFrames == 0)
+		return;
+	std::cout << "Frame arena benchmark: " << numFrames << " frames of shadow matrices, 144 face candidates, 24 uniform names and a label"
+		<< std::endl;
+
+	//heap: the containers as the render loop used to build them
+	float heapChecksum = 0.0f, arenaChecksum = 0.0f;
+	std::size_t allocations = getHeapAllocationCount();
+	auto start = std::chrono::high_resolution_clock::now();
+	for (unsigned int frame = 0; frame < numFrames; ++frame)
+		heapChecksum += buildFrameData<std::string>(std::allocator<char>(), frame);
+	double heapTime = elapsedMilliseconds(start);
+	std::size_t heapAllocationCount = getHeapAllocationCount() - allocations;
+
+	//frame arenas, reset at the end of every frame
+	FrameArenas frameArenas;
+	frameArenas.get(); //creates the calling thread's first arena outside of the timing
+	allocations = getHeapAllocationCount();
+	start = std::chrono::high_resolution_clock::now();
+	for (unsigned int frame = 0; frame < numFrames; ++frame) {
+		arenaChecksum += buildFrameData<ArenaString>(ArenaAllocator<char>(frameArenas.get()), frame);
+		frameArenas.endFrame();
+	}
+	double arenaTime = elapsedMilliseconds(start);
+	std::size_t arenaAllocationCount = getHeapAllocationCount() - allocations;
+
+	std::cout << "    heap: " << (double)heapAllocationCount / numFrames << " allocations/frame, " << 1000.0 * heapTime / numFrames
+		<< " us/frame" << std::endl;
+	std::cout << "    frame arenas: " << (double)arenaAllocationCount / numFrames << " allocations/frame, " << 1000.0 * arenaTime / numFrames
+		<< " us/frame" << std::endl;
+	if (heapChecksum != arenaChecksum)
+		std::cout << "ERROR::FRAME_ARENA:: Heap and arena frames differ" << std::endl;
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <cstddef>
+#include <atomic>
+#include <vector>
+#include <string>
+#include <new>
+
+//Linear (bump) allocator for data that only lives for a frame or two. Allocating moves an offset through the current
+//block and there is no per-allocation free: reset() releases everything at once. When a frame needs more than the block
+//holds, more blocks are chained on, and the next reset() replaces them with a single block large enough for the whole
+//frame, so after the first few frames the arena no longer touches the heap.
+class FrameArena
+{
+public:
+	explicit FrameArena(std::size_t initialCapacity = 64 * 1024);
+	~FrameArena();
+	FrameArena(const FrameArena&) = delete;
+	FrameArena& operator=(const FrameArena&) = delete;
+
+	void* allocate(std::size_t size, std::size_t alignment = alignof(std::max_align_t));
+	void reset(); //everything allocated since the last reset becomes invalid
+	std::size_t getBytesUsed() const; //since the last reset, alignment padding included
+	std::size_t getCapacity() const;
+
+private:
+	struct Block {
+		char* data;
+		std::size_t size;
+	};
+	std::vector<Block> blocks; //allocations come from the last one
+	std::size_t offset; //into the last block
+	std::size_t bytesUsed;
+};
+
+//One arena per thread, double buffered across frames: get() returns the calling thread's arena of the current frame and
+//endFrame() switches to the other set of arenas and resets it. What a frame allocates therefore stays valid through the
+//next frame as well, for data that is consumed a frame late. get() only touches the calling thread's arena and needs no
+//locking; endFrame() and getBytesUsed() must be called while no other thread allocates, e.g. after waiting on the jobs.
+class FrameArenas
+{
+public:
+	static const unsigned int MAX_THREADS = 64; //threads beyond this get no arena and allocate from the heap
+
+	explicit FrameArenas(std::size_t arenaCapacity = 64 * 1024);
+	~FrameArenas();
+	FrameArenas(const FrameArenas&) = delete;
+	FrameArenas& operator=(const FrameArenas&) = delete;
+
+	FrameArena* get(); //NULL when disabled, which makes ArenaAllocators fall back to the heap
+	void endFrame();
+	void setEnabled(bool enabled);
+	bool isEnabled() const;
+	std::size_t getBytesUsed() const; //by the current frame, over all threads
+
+private:
+	FrameArena* arenas[2][MAX_THREADS]; //created by their thread on first use
+	std::atomic<unsigned int> frame;
+	bool enabled;
+	std::size_t arenaCapacity;
+};
+
+//STL allocator that takes its memory from a FrameArena, or from the heap when it has none. Deallocating from an arena
+//does nothing, so a container using one must not be used after the arena's next reset. Copies keep the arena, so a
+//container's memory always comes from the same place it was created with.
+template<class T>
+class ArenaAllocator
+{
+public:
+	typedef T value_type;
+
+	ArenaAllocator(FrameArena* arenaVal = NULL) noexcept : arena(arenaVal) {}
+	template<class U> ArenaAllocator(const ArenaAllocator<U>& other) noexcept : arena(other.getArena()) {}
+
+	T* allocate(std::size_t n) {
+		if (arena)
+			return static_cast<T*>(arena->allocate(n * sizeof(T), alignof(T)));
+		return static_cast<T*>(::operator new(n * sizeof(T)));
+	}
+	void deallocate(T* pointer, std::size_t) noexcept {
+		if (!arena)
+			::operator delete(pointer);
+	}
+	FrameArena* getArena() const noexcept {
+		return arena;
+	}
+
+private:
+	FrameArena* arena;
+};
+
+template<class T, class U>
+bool operator==(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) noexcept {
+	return a.getArena() == b.getArena();
+}
+
+template<class T, class U>
+bool operator!=(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) noexcept {
+	return a.getArena() != b.getArena();
+}
+
+template<class T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+typedef std::basic_string<char, std::char_traits<char>, ArenaAllocator<char>> ArenaString;
+
+//number of global operator new calls since the program started, counted by the replacement operators in FrameArena.cpp
+std::size_t getHeapAllocationCount();
+
+//builds and throws away the transient data of a typical frame (shadow matrices, point shadow face candidates, timer
+//labels) on the heap and on frame arenas, and prints the heap allocations and time per frame of each
+void benchmarkFrameArena(unsigned int numFrames = 10000);
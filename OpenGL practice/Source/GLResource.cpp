@@ -0,0 +1,196 @@
+#include "GLResource.h"
+#include <iostream>
+
+static std::atomic<std::size_t> numAlive[NUM_GL_RESOURCE_TYPES];
+static std::atomic<bool> contextAlive(true);
+
+const char* getGLResourceTypeName(GLResourceType type) {
+	static const char* names[NUM_GL_RESOURCE_TYPES] = { "buffer", "vertex array", "texture", "framebuffer", "program" };
+	return names[type];
+}
+
+unsigned int createGLResource(GLResourceType type) {
+	unsigned int id = 0;
+	switch (type) {
+	case GL_RESOURCE_BUFFER:
+		glGenBuffers(1, &id);
+		break;
+	case GL_RESOURCE_VERTEX_ARRAY:
+		glGenVertexArrays(1, &id);
+		break;
+	case GL_RESOURCE_TEXTURE:
+		glGenTextures(1, &id);
+		break;
+	case GL_RESOURCE_FRAMEBUFFER:
+		glGenFramebuffers(1, &id);
+		break;
+	case GL_RESOURCE_PROGRAM:
+		id = glCreateProgram();
+		break;
+	default:
+		break;
+	}
+	if (id != 0)
+		numAlive[type].fetch_add(1, std::memory_order_relaxed);
+	return id;
+}
+
+void destroyGLResource(GLResourceType type, unsigned int id) {
+	if (id == 0)
+		return;
+	numAlive[type].fetch_sub(1, std::memory_order_relaxed);
+	if (!contextAlive.load(std::memory_order_relaxed))
+		return;
+	switch (type) {
+	case GL_RESOURCE_BUFFER:
+		glDeleteBuffers(1, &id);
+		break;
+	case GL_RESOURCE_VERTEX_ARRAY:
+		glDeleteVertexArrays(1, &id);
+		break;
+	case GL_RESOURCE_TEXTURE:
+		glDeleteTextures(1, &id);
+		break;
+	case GL_RESOURCE_FRAMEBUFFER:
+		glDeleteFramebuffers(1, &id);
+		break;
+	case GL_RESOURCE_PROGRAM:
+		glDeleteProgram(id);
+		break;
+	default:
+		break;
+	}
+}
+
+std::size_t getNumAliveGLResources(GLResourceType type) {
+	return numAlive[type].load(std::memory_order_relaxed);
+}
+
+template<GLResourceType Type>
+GLObject<Type>::GLObject(unsigned int idVal) : id(idVal) {
+	if (id != 0)
+		numAlive[Type].fetch_add(1, std::memory_order_relaxed);
+}
+
+template<GLResourceType Type>
+unsigned int GLObject<Type>::release() {
+	if (id != 0)
+		numAlive[Type].fetch_sub(1, std::memory_order_relaxed);
+	unsigned int released = id;
+	id = 0;
+	return released;
+}
+
+template class GLObject<GL_RESOURCE_BUFFER>;
+template class GLObject<GL_RESOURCE_VERTEX_ARRAY>;
+template class GLObject<GL_RESOURCE_TEXTURE>;
+template class GLObject<GL_RESOURCE_FRAMEBUFFER>;
+template class GLObject<GL_RESOURCE_PROGRAM>;
+
+
+GLResourceRegistry::~GLResourceRegistry() {
+	clear(false);
+}
+
+//the registry's objects count as alive like those of GLObjects
+unsigned int GLResourceRegistry::add(GLResourceType type, unsigned int id, const std::string& name, unsigned int& generation) {
+	if (id == 0) {
+		generation = 0;
+		return 0;
+	}
+	numAlive[type].fetch_add(1, std::memory_order_relaxed);
+	Pool& pool = pools[type];
+	unsigned int slotIndex;
+	if (!pool.freeSlots.empty()) {
+		slotIndex = pool.freeSlots.back();
+		pool.freeSlots.pop_back();
+	}
+	else {
+		slotIndex = pool.slots.size();
+		Slot slot = { 0, 0 };
+		pool.slots.push_back(slot);
+	}
+	Slot& slot = pool.slots[slotIndex];
+	slot.denseIndex = pool.ids.size();
+	++slot.generation; //odd: in use
+	pool.ids.push_back(id);
+	pool.slotIndices.push_back(slotIndex);
+	pool.names.push_back(name);
+	generation = slot.generation;
+	return slotIndex;
+}
+
+unsigned int GLResourceRegistry::get(GLResourceType type, unsigned int index, unsigned int generation) const {
+	const Pool& pool = pools[type];
+	if (generation == 0 || index >= pool.slots.size() || pool.slots[index].generation != generation)
+		return 0;
+	return pool.ids[pool.slots[index].denseIndex];
+}
+
+void GLResourceRegistry::remove(GLResourceType type, unsigned int index, unsigned int generation) {
+	if (get(type, index, generation) == 0)
+		return;
+	Pool& pool = pools[type];
+	Slot& slot = pool.slots[index];
+	destroyGLResource(type, pool.ids[slot.denseIndex]);
+
+	//the last entry fills the hole
+	unsigned int last = pool.ids.size() - 1;
+	pool.ids[slot.denseIndex] = pool.ids[last];
+	pool.names[slot.denseIndex].swap(pool.names[last]);
+	pool.slotIndices[slot.denseIndex] = pool.slotIndices[last];
+	pool.slots[pool.slotIndices[last]].denseIndex = slot.denseIndex;
+	pool.ids.pop_back();
+	pool.names.pop_back();
+	pool.slotIndices.pop_back();
+
+	++slot.generation; //even: free, and every handle to the old resource is now stale
+	pool.freeSlots.push_back(index);
+}
+
+std::size_t GLResourceRegistry::size(GLResourceType type) const {
+	return pools[type].ids.size();
+}
+
+void GLResourceRegistry::clear(bool reportRemaining) {
+	for (unsigned int type = 0; type < NUM_GL_RESOURCE_TYPES; ++type) {
+		Pool& pool = pools[type];
+		for (unsigned int i = 0; i < pool.ids.size(); ++i) {
+			if (reportRemaining) {
+				std::cout << "GLResourceRegistry: " << getGLResourceTypeName((GLResourceType)type) << " " << pool.ids[i]
+					<< (pool.names[i].empty() ? "" : " (" + pool.names[i] + ")") << " was never removed" << std::endl;
+			}
+			destroyGLResource((GLResourceType)type, pool.ids[i]);
+		}
+		//every slot gets a new generation, so handles from before the clear stay stale after it
+		for (unsigned int i = 0; i < pool.slots.size(); ++i) {
+			if (pool.slots[i].generation % 2 == 1) {
+				++pool.slots[i].generation;
+				pool.freeSlots.push_back(i);
+			}
+		}
+		pool.ids.clear();
+		pool.slotIndices.clear();
+		pool.names.clear();
+	}
+}
+
+
+//whatever is still alive here is owned by something that outlives the context, and is never deleted
+void shutdownGLResources() {
+	std::size_t numLeaked = 0;
+	for (unsigned int type = 0; type < NUM_GL_RESOURCE_TYPES; ++type)
+		numLeaked += getNumAliveGLResources((GLResourceType)type);
+	if (numLeaked == 0) {
+		std::cout << "GL resources: no leaks at shutdown" << std::endl;
+	}
+	else {
+		std::cout << "GL resources: leaked at shutdown";
+		for (unsigned int type = 0; type < NUM_GL_RESOURCE_TYPES; ++type) {
+			if (getNumAliveGLResources((GLResourceType)type) > 0)
+				std::cout << " " << getNumAliveGLResources((GLResourceType)type) << " " << getGLResourceTypeName((GLResourceType)type) << "(s)";
+		}
+		std::cout << std::endl;
+	}
+	contextAlive.store(false, std::memory_order_relaxed);
+}
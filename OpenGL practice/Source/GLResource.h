@@ -0,0 +1,142 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <vector>
+#include <string>
+#include <atomic>
+#include <cstddef>
+
+enum GLResourceType { GL_RESOURCE_BUFFER, GL_RESOURCE_VERTEX_ARRAY, GL_RESOURCE_TEXTURE, GL_RESOURCE_FRAMEBUFFER, GL_RESOURCE_PROGRAM,
+	NUM_GL_RESOURCE_TYPES };
+
+const char* getGLResourceTypeName(GLResourceType type);
+unsigned int createGLResource(GLResourceType type); //glGen*/glCreateProgram, counted as alive
+void destroyGLResource(GLResourceType type, unsigned int id); //glDelete*, no-op for 0 or once the context is gone
+std::size_t getNumAliveGLResources(GLResourceType type); //created or adopted and not yet destroyed
+
+//Move-only owner of one GL object, deleted with it. It holds nothing but the object's name, so using it costs the same
+//as the raw name; copies are impossible, so there is exactly one owner. The context must be current when an owner is
+//destroyed, unless shutdownGLResources() already ran.
+template<GLResourceType Type>
+class GLObject
+{
+public:
+	GLObject() : id(0) {}
+	explicit GLObject(unsigned int idVal); //takes ownership of an object created elsewhere, e.g. by textureFromFile
+	~GLObject() {
+		reset();
+	}
+	GLObject(const GLObject&) = delete;
+	GLObject& operator=(const GLObject&) = delete;
+	GLObject(GLObject&& other) noexcept : id(other.id) {
+		other.id = 0;
+	}
+	GLObject& operator=(GLObject&& other) noexcept {
+		if (this != &other) {
+			reset();
+			id = other.id;
+			other.id = 0;
+		}
+		return *this;
+	}
+
+	static GLObject create() {
+		return GLObject(createGLResource(Type), true);
+	}
+	unsigned int get() const {
+		return id;
+	}
+	explicit operator bool() const {
+		return id != 0;
+	}
+	void reset() { //deletes the object
+		destroyGLResource(Type, id);
+		id = 0;
+	}
+	unsigned int release(); //gives up ownership without deleting
+
+private:
+	unsigned int id;
+
+	GLObject(unsigned int idVal, bool) : id(idVal) {} //already counted by createGLResource
+};
+
+typedef GLObject<GL_RESOURCE_BUFFER> GLBuffer;
+typedef GLObject<GL_RESOURCE_VERTEX_ARRAY> GLVertexArray;
+typedef GLObject<GL_RESOURCE_TEXTURE> GLTexture;
+typedef GLObject<GL_RESOURCE_FRAMEBUFFER> GLFramebuffer;
+typedef GLObject<GL_RESOURCE_PROGRAM> GLProgram;
+
+//handle to a resource of a GLResourceRegistry: a slot index and the generation of the slot when the resource was added.
+//Removing a resource bumps its slot's generation, so stale handles are detected instead of reaching whatever reuses
+//the slot. The type is part of the handle's type, so a texture handle can't be passed where a buffer is expected
+template<GLResourceType Type>
+struct GLHandle {
+	unsigned int index;
+	unsigned int generation; //0 for the null handle, slots start at generation 1
+
+	GLHandle() : index(0), generation(0) {}
+	GLHandle(unsigned int indexVal, unsigned int generationVal) : index(indexVal), generation(generationVal) {}
+	bool isNull() const {
+		return generation == 0;
+	}
+};
+
+//Owns GL objects by handle. Every type has a dense pool of names, so walking all resources of a type touches one
+//contiguous array, and a sparse array of slots mapping handles to pool entries; removing swaps the last entry into the
+//hole. Looking a handle up is two array reads and a generation compare. clear() reports everything still registered,
+//with the name it was added under.
+class GLResourceRegistry
+{
+public:
+	GLResourceRegistry() {}
+	~GLResourceRegistry();
+	GLResourceRegistry(const GLResourceRegistry&) = delete;
+	GLResourceRegistry& operator=(const GLResourceRegistry&) = delete;
+
+	template<GLResourceType Type>
+	GLHandle<Type> add(GLObject<Type>&& object, const std::string& name = "") {
+		unsigned int generation;
+		unsigned int index = add(Type, object.release(), name, generation);
+		return GLHandle<Type>(index, generation);
+	}
+	template<GLResourceType Type>
+	unsigned int get(GLHandle<Type> handle) const { //0 for null and stale handles
+		return get(Type, handle.index, handle.generation);
+	}
+	template<GLResourceType Type>
+	bool isValid(GLHandle<Type> handle) const {
+		return get(Type, handle.index, handle.generation) != 0;
+	}
+	template<GLResourceType Type>
+	void remove(GLHandle<Type>& handle) { //deletes the object and nulls the handle
+		remove(Type, handle.index, handle.generation);
+		handle = GLHandle<Type>();
+	}
+
+	std::size_t size(GLResourceType type) const;
+	void clear(bool reportRemaining = true); //deletes every resource, the context must still be current
+
+private:
+	struct Slot {
+		unsigned int denseIndex;
+		unsigned int generation; //odd while the slot is in use
+	};
+	struct Pool {
+		std::vector<unsigned int> ids; //dense
+		std::vector<unsigned int> slotIndices; //slot of every dense entry
+		std::vector<std::string> names; //dense, for the leak report
+		std::vector<Slot> slots;
+		std::vector<unsigned int> freeSlots;
+	};
+	Pool pools[NUM_GL_RESOURCE_TYPES];
+
+	unsigned int add(GLResourceType type, unsigned int id, const std::string& name, unsigned int& generation);
+	unsigned int get(GLResourceType type, unsigned int index, unsigned int generation) const;
+	void remove(GLResourceType type, unsigned int index, unsigned int generation);
+};
+
+//leak report: prints how many GL objects of each type are still alive, i.e. owned by something that outlives the context,
+//and marks the context as gone, so owners destroyed afterwards (statics at exit) only forget their objects. Call right
+//before destroying the context
+void shutdownGLResources();
@@ -0,0 +1,855 @@
+#include "GLTFLoader.h"
+#include <glm/gtc/type_ptr.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <iostream>
+#include <cstring>
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <limits>
+#include <algorithm>
+
+//JSON document of a glTF file: a tree of values, with the keys of an object parallel to its values
+struct JSONValue {
+	enum Type { JSON_NULL, JSON_BOOL, JSON_NUMBER, JSON_STRING, JSON_ARRAY, JSON_OBJECT };
+
+	Type type;
+	double number; //also 0 or 1 for booleans
+	std::string string;
+	std::vector<JSONValue> elements; //of an array, or the values of an object
+	std::vector<std::string> keys; //of an object
+
+	JSONValue() : type(JSON_NULL), number(0.0) {}
+
+	const JSONValue* find(const char* key) const {
+		for (unsigned int i = 0; i < keys.size(); ++i) {
+			if (keys[i] == key)
+				return &elements[i];
+		}
+		return NULL;
+	}
+	double getNumber(const char* key, double defaultValue) const {
+		const JSONValue* value = find(key);
+		return value && (value->type == JSON_NUMBER || value->type == JSON_BOOL) ? value->number : defaultValue;
+	}
+	std::size_t getSize(const char* key) const { //0 when absent, also for values that can't be a size
+		double value = getNumber(key, 0.0);
+		return value >= 0.0 && value < 9007199254740992.0 ? (std::size_t)value : 0;
+	}
+	int getIndex(const char* key) const { //-1 when absent, also for values that can't be an index
+		double value = getNumber(key, -1.0);
+		return value >= 0.0 && value < (double)std::numeric_limits<int>::max() && value == std::floor(value) ? (int)value : -1;
+	}
+	std::string getString(const char* key) const {
+		const JSONValue* value = find(key);
+		return value && value->type == JSON_STRING ? value->string : std::string();
+	}
+	const std::vector<JSONValue>& getArray(const char* key) const { //empty when absent
+		static const std::vector<JSONValue> empty;
+		const JSONValue* value = find(key);
+		return value && value->type == JSON_ARRAY ? value->elements : empty;
+	}
+};
+
+//recursive descent JSON parser. Nesting is limited so a hostile file can't exhaust the stack
+class JSONParser
+{
+public:
+	JSONParser(const char* text, std::size_t length) : current(text), end(text + length) {}
+
+	bool parse(JSONValue& value) {
+		if (!parseValue(value, 0))
+			return false;
+		skipWhitespace();
+		return current == end;
+	}
+
+private:
+	static const unsigned int MAX_DEPTH = 64;
+	const char* current;
+	const char* end;
+
+	void skipWhitespace() {
+		while (current < end && (*current == ' ' || *current == '\t' || *current == '\n' || *current == '\r'))
+			++current;
+	}
+	bool match(const char* literal) {
+		std::size_t length = std::strlen(literal);
+		if ((std::size_t)(end - current) < length || std::strncmp(current, literal, length) != 0)
+			return false;
+		current += length;
+		return true;
+	}
+
+	bool parseValue(JSONValue& value, unsigned int depth) {
+		skipWhitespace();
+		if (current == end || depth > MAX_DEPTH)
+			return false;
+		switch (*current) {
+		case '{':
+			return parseObject(value, depth);
+		case '[':
+			return parseArray(value, depth);
+		case '"':
+			value.type = JSONValue::JSON_STRING;
+			return parseString(value.string);
+		case 't':
+			value.type = JSONValue::JSON_BOOL;
+			value.number = 1.0;
+			return match("true");
+		case 'f':
+			value.type = JSONValue::JSON_BOOL;
+			value.number = 0.0;
+			return match("false");
+		case 'n':
+			value.type = JSONValue::JSON_NULL;
+			return match("null");
+		default:
+			return parseNumber(value);
+		}
+	}
+
+	bool parseObject(JSONValue& value, unsigned int depth) {
+		value.type = JSONValue::JSON_OBJECT;
+		++current;
+		skipWhitespace();
+		if (current < end && *current == '}') {
+			++current;
+			return true;
+		}
+		while (true) {
+			skipWhitespace();
+			value.keys.push_back(std::string());
+			if (current == end || *current != '"' || !parseString(value.keys.back()))
+				return false;
+			skipWhitespace();
+			if (current == end || *current++ != ':')
+				return false;
+			value.elements.push_back(JSONValue());
+			if (!parseValue(value.elements.back(), depth + 1))
+				return false;
+			skipWhitespace();
+			if (current == end)
+				return false;
+			char next = *current++;
+			if (next == '}')
+				return true;
+			if (next != ',')
+				return false;
+		}
+	}
+
+	bool parseArray(JSONValue& value, unsigned int depth) {
+		value.type = JSONValue::JSON_ARRAY;
+		++current;
+		skipWhitespace();
+		if (current < end && *current == ']') {
+			++current;
+			return true;
+		}
+		while (true) {
+			value.elements.push_back(JSONValue());
+			if (!parseValue(value.elements.back(), depth + 1))
+				return false;
+			skipWhitespace();
+			if (current == end)
+				return false;
+			char next = *current++;
+			if (next == ']')
+				return true;
+			if (next != ',')
+				return false;
+		}
+	}
+
+	static int hexDigit(char c) {
+		if (c >= '0' && c <= '9')
+			return c - '0';
+		if (c >= 'a' && c <= 'f')
+			return c - 'a' + 10;
+		if (c >= 'A' && c <= 'F')
+			return c - 'A' + 10;
+		return -1;
+	}
+
+	bool parseString(std::string& string) {
+		++current;
+		while (current < end && *current != '"') {
+			char c = *current++;
+			if (c != '\\') {
+				string += c;
+				continue;
+			}
+			if (current == end)
+				return false;
+			c = *current++;
+			switch (c) {
+			case 'b': string += '\b'; break;
+			case 'f': string += '\f'; break;
+			case 'n': string += '\n'; break;
+			case 'r': string += '\r'; break;
+			case 't': string += '\t'; break;
+			case 'u': {
+				//code points outside the basic plane come as surrogate pairs, which are kept as two 3-byte sequences:
+				//names and URIs are only compared and opened, never displayed
+				if (end - current < 4)
+					return false;
+				unsigned int codePoint = 0;
+				for (unsigned int i = 0; i < 4; ++i) {
+					int digit = hexDigit(*current++);
+					if (digit < 0)
+						return false;
+					codePoint = codePoint * 16 + digit;
+				}
+				if (codePoint < 0x80)
+					string += (char)codePoint;
+				else if (codePoint < 0x800) {
+					string += (char)(0xC0 | (codePoint >> 6));
+					string += (char)(0x80 | (codePoint & 0x3F));
+				}
+				else {
+					string += (char)(0xE0 | (codePoint >> 12));
+					string += (char)(0x80 | ((codePoint >> 6) & 0x3F));
+					string += (char)(0x80 | (codePoint & 0x3F));
+				}
+				break;
+			}
+			default: string += c; break; //quote, backslash and slash
+			}
+		}
+		if (current == end)
+			return false;
+		++current;
+		return true;
+	}
+
+	bool parseNumber(JSONValue& value) {
+		//strtod wants a terminated string and the document isn't one, so the number is copied out first
+		char buffer[64];
+		std::size_t length = 0;
+		while (current + length < end && length < sizeof(buffer) - 1 && current[length] != '\0'
+			&& std::strchr("+-0123456789.eE", current[length]))
+			++length;
+		if (length == 0)
+			return false;
+		std::memcpy(buffer, current, length);
+		buffer[length] = '\0';
+		char* numberEnd;
+		value.type = JSONValue::JSON_NUMBER;
+		value.number = std::strtod(buffer, &numberEnd);
+		if (numberEnd != buffer + length)
+			return false;
+		current += length;
+		return true;
+	}
+};
+
+static bool decodeBase64(const char* text, std::size_t length, std::vector<unsigned char>& data) {
+	data.clear();
+	data.reserve(length / 4 * 3);
+	unsigned int bits = 0, numBits = 0;
+	for (std::size_t i = 0; i < length && text[i] != '='; ++i) {
+		char c = text[i];
+		int value = c >= 'A' && c <= 'Z' ? c - 'A' : c >= 'a' && c <= 'z' ? c - 'a' + 26 : c >= '0' && c <= '9' ? c - '0' + 52
+			: c == '+' ? 62 : c == '/' ? 63 : -1;
+		if (value < 0)
+			return false;
+		bits = (bits << 6) | value;
+		numBits += 6;
+		if (numBits >= 8) {
+			numBits -= 8;
+			data.push_back((unsigned char)(bits >> numBits));
+		}
+	}
+	return true;
+}
+
+//decodes the %XX escapes of a relative URI into a file path
+static std::string decodeURI(const std::string& uri) {
+	std::string path;
+	for (std::size_t i = 0; i < uri.size(); ++i) {
+		if (uri[i] == '%' && i + 2 < uri.size() && std::isxdigit((unsigned char)uri[i + 1]) && std::isxdigit((unsigned char)uri[i + 2])) {
+			path += (char)std::strtol(uri.substr(i + 1, 2).c_str(), NULL, 16);
+			i += 2;
+		}
+		else
+			path += uri[i];
+	}
+	return path;
+}
+
+//the data of a "data:[<type>][;base64],<data>" URI, false for other URIs and malformed ones
+static bool decodeDataURI(const std::string& uri, std::vector<unsigned char>& data) {
+	if (uri.compare(0, 5, "data:") != 0)
+		return false;
+	std::size_t comma = uri.find(',');
+	if (comma == std::string::npos || comma < 7 || uri.compare(comma - 7, 7, ";base64") != 0)
+		return false;
+	return decodeBase64(uri.c_str() + comma + 1, uri.size() - comma - 1, data);
+}
+
+static unsigned int getComponentSize(unsigned int componentType) {
+	switch (componentType) {
+	case GL_BYTE: case GL_UNSIGNED_BYTE: return 1;
+	case GL_SHORT: case GL_UNSIGNED_SHORT: return 2;
+	case GL_UNSIGNED_INT: case GL_FLOAT: return 4;
+	default: return 0;
+	}
+}
+
+static unsigned int getNumComponents(const std::string& type) {
+	if (type == "SCALAR") return 1;
+	if (type == "VEC2") return 2;
+	if (type == "VEC3") return 3;
+	if (type == "VEC4") return 4;
+	if (type == "MAT2") return 4;
+	if (type == "MAT3") return 9;
+	if (type == "MAT4") return 16;
+	return 0;
+}
+
+typedef glm::vec4 (*ElementReader)(const unsigned char* element);
+
+template<class T>
+static float normalizeComponent(T value) {
+	if (std::numeric_limits<T>::is_signed)
+		return std::max((float)value / std::numeric_limits<T>::max(), -1.0f);
+	return (float)value / std::numeric_limits<T>::max();
+}
+
+template<class T, unsigned int N, bool Normalized>
+static glm::vec4 readElement(const unsigned char* element) {
+	T components[N];
+	std::memcpy(components, element, sizeof(components)); //elements of interleaved views needn't be aligned
+	glm::vec4 result(0.0f);
+	for (unsigned int i = 0; i < N; ++i)
+		result[i] = Normalized ? normalizeComponent(components[i]) : (float)components[i];
+	return result;
+}
+
+static glm::vec4 readNothing(const unsigned char*) {
+	return glm::vec4(0.0f);
+}
+
+template<class T, bool Normalized>
+static ElementReader selectReader(unsigned int numComponents) {
+	switch (numComponents) {
+	case 1: return &readElement<T, 1, Normalized>;
+	case 2: return &readElement<T, 2, Normalized>;
+	case 3: return &readElement<T, 3, Normalized>;
+	case 4: return &readElement<T, 4, Normalized>;
+	default: return &readNothing;
+	}
+}
+
+static ElementReader selectReader(const GLTFAccessor& accessor) {
+	if (accessor.bufferView < 0)
+		return &readNothing;
+	bool normalized = accessor.normalized;
+	switch (accessor.componentType) {
+	case GL_BYTE: return normalized ? selectReader<std::int8_t, true>(accessor.numComponents) : selectReader<std::int8_t, false>(accessor.numComponents);
+	case GL_UNSIGNED_BYTE: return normalized ? selectReader<std::uint8_t, true>(accessor.numComponents) : selectReader<std::uint8_t, false>(accessor.numComponents);
+	case GL_SHORT: return normalized ? selectReader<std::int16_t, true>(accessor.numComponents) : selectReader<std::int16_t, false>(accessor.numComponents);
+	case GL_UNSIGNED_SHORT: return normalized ? selectReader<std::uint16_t, true>(accessor.numComponents) : selectReader<std::uint16_t, false>(accessor.numComponents);
+	case GL_UNSIGNED_INT: return selectReader<std::uint32_t, false>(accessor.numComponents);
+	case GL_FLOAT: return selectReader<float, false>(accessor.numComponents);
+	default: return &readNothing;
+	}
+}
+
+GLTFAccessorReader::GLTFAccessorReader() : data(NULL), stride(0), count(0), read(&readNothing) {}
+
+GLTFAccessorReader::GLTFAccessorReader(const GLTFFile& file, int accessor) : GLTFAccessorReader() {
+	if (accessor < 0 || accessor >= (int)file.accessors.size())
+		return;
+	const GLTFAccessor& description = file.accessors[accessor];
+	count = description.count;
+	read = selectReader(description);
+	if (description.bufferView < 0)
+		return;
+	const GLTFBufferView& view = file.bufferViews[description.bufferView];
+	data = file.getBufferViewData(description.bufferView) + description.byteOffset;
+	stride = view.byteStride ? view.byteStride : getComponentSize(description.componentType) * description.numComponents;
+}
+
+GLTFFile::GLTFFile() : hasSkinsOrAnimations(false) {}
+
+bool GLTFFile::open(const std::string& path) {
+	if (!file.open(path.c_str()))
+		return false;
+	std::string directory = path.substr(0, path.find_last_of('/') + 1);
+	const unsigned char* data = file.getData();
+	std::size_t size = file.getSize();
+
+	//a .glb is a 12 byte header and chunks of a length, a type and the data: the JSON, then optionally the binary buffer
+	std::uint32_t header[3];
+	if (size >= sizeof(header))
+		std::memcpy(header, data, sizeof(header));
+	if (size < sizeof(header) || header[0] != 0x46546C67) //"glTF"
+		return parse(reinterpret_cast<const char*>(data), size, directory, NULL, 0);
+	if (header[1] != 2) {
+		std::cout << "ERROR::GLTF:: " << path << " is a binary glTF of version " << header[1] << ", not 2" << std::endl;
+		return false;
+	}
+	const unsigned char* chunks[2] = { NULL, NULL };
+	std::size_t chunkSizes[2] = { 0, 0 };
+	std::size_t offset = sizeof(header);
+	size = std::min<std::size_t>(size, header[2]);
+	while (offset + 8 <= size) {
+		std::uint32_t chunk[2];
+		std::memcpy(chunk, data + offset, sizeof(chunk));
+		offset += 8;
+		if (chunk[0] > size - offset)
+			break;
+		if (chunk[1] == 0x4E4F534A && !chunks[0]) { //"JSON"
+			chunks[0] = data + offset;
+			chunkSizes[0] = chunk[0];
+		}
+		else if (chunk[1] == 0x004E4942 && !chunks[1]) { //"BIN"
+			chunks[1] = data + offset;
+			chunkSizes[1] = chunk[0];
+		}
+		offset += chunk[0];
+	}
+	if (!chunks[0]) {
+		std::cout << "ERROR::GLTF:: " << path << " has no JSON chunk" << std::endl;
+		return false;
+	}
+	return parse(reinterpret_cast<const char*>(chunks[0]), chunkSizes[0], directory, chunks[1], chunkSizes[1]);
+}
+
+const unsigned char* GLTFFile::getBufferViewData(unsigned int bufferView) const {
+	const GLTFBufferView& view = bufferViews[bufferView];
+	return buffers[view.buffer] + view.byteOffset;
+}
+
+//reads the default scene of the document. Everything an accessor reader or the conversion will index is checked here,
+//once, so a malformed file fails to open instead of reading out of bounds later
+bool GLTFFile::parse(const char* json, std::size_t length, const std::string& directory, const unsigned char* binaryChunk,
+	std::size_t binaryChunkSize) {
+	JSONValue document;
+	if (!JSONParser(json, length).parse(document) || document.type != JSONValue::JSON_OBJECT) {
+		std::cout << "ERROR::GLTF:: Malformed JSON in " << directory << std::endl;
+		return false;
+	}
+	const JSONValue* asset = document.find("asset");
+	if (!asset || asset->getString("version").compare(0, 1, "2") != 0) {
+		std::cout << "ERROR::GLTF:: Only glTF 2.0 is supported (" << directory << ")" << std::endl;
+		return false;
+	}
+	const std::vector<JSONValue>& required = document.getArray("extensionsRequired");
+	for (unsigned int i = 0; i < required.size(); ++i) {
+		if (required[i].string != "KHR_mesh_quantization") {
+			std::cout << "ERROR::GLTF:: Unsupported required extension " << required[i].string << std::endl;
+			return false;
+		}
+	}
+	hasSkinsOrAnimations = !document.getArray("skins").empty() || !document.getArray("animations").empty();
+
+	//buffers: the .glb's binary chunk, external files mapped in turn, or data URIs
+	const std::vector<JSONValue>& bufferValues = document.getArray("buffers");
+	for (unsigned int i = 0; i < bufferValues.size(); ++i) {
+		std::string uri = bufferValues[i].getString("uri");
+		std::size_t byteLength = bufferValues[i].getSize("byteLength");
+		const unsigned char* data = NULL;
+		std::size_t size = 0;
+		if (uri.empty() && i == 0 && binaryChunk) {
+			data = binaryChunk;
+			size = binaryChunkSize;
+		}
+		else if (uri.compare(0, 5, "data:") == 0) {
+			decodedBuffers.push_back(std::vector<unsigned char>());
+			if (decodeDataURI(uri, decodedBuffers.back())) {
+				data = decodedBuffers.back().data();
+				size = decodedBuffers.back().size();
+			}
+		}
+		else if (!uri.empty()) {
+			bufferFiles.push_back(MappedFile());
+			if (bufferFiles.back().open((directory + decodeURI(uri)).c_str())) {
+				data = bufferFiles.back().getData();
+				size = bufferFiles.back().getSize();
+			}
+		}
+		if (!data || size < byteLength) {
+			std::cout << "ERROR::GLTF:: Cannot read buffer " << i << " of " << directory << std::endl;
+			return false;
+		}
+		buffers.push_back(data);
+		bufferSizes.push_back(byteLength);
+	}
+
+	const std::vector<JSONValue>& viewValues = document.getArray("bufferViews");
+	for (unsigned int i = 0; i < viewValues.size(); ++i) {
+		GLTFBufferView view;
+		int buffer = viewValues[i].getIndex("buffer");
+		view.byteOffset = viewValues[i].getSize("byteOffset");
+		view.byteLength = viewValues[i].getSize("byteLength");
+		view.byteStride = viewValues[i].getSize("byteStride");
+		if (buffer < 0 || buffer >= (int)buffers.size() || view.byteOffset > bufferSizes[buffer] || view.byteLength > bufferSizes[buffer] - view.byteOffset) {
+			std::cout << "ERROR::GLTF:: Buffer view " << i << " is out of its buffer" << std::endl;
+			return false;
+		}
+		view.buffer = buffer;
+		bufferViews.push_back(view);
+	}
+
+	const std::vector<JSONValue>& accessorValues = document.getArray("accessors");
+	for (unsigned int i = 0; i < accessorValues.size(); ++i) {
+		const JSONValue& value = accessorValues[i];
+		GLTFAccessor accessor;
+		accessor.bufferView = value.getIndex("bufferView");
+		accessor.byteOffset = value.getSize("byteOffset");
+		accessor.componentType = (unsigned int)value.getSize("componentType");
+		accessor.numComponents = getNumComponents(value.getString("type"));
+		accessor.normalized = value.getNumber("normalized", 0.0) != 0.0;
+		accessor.count = value.getSize("count");
+		std::size_t elementSize = getComponentSize(accessor.componentType) * accessor.numComponents;
+		if (elementSize == 0 || accessor.bufferView >= (int)bufferViews.size() || accessor.count > std::numeric_limits<unsigned int>::max() / 3) {
+			std::cout << "ERROR::GLTF:: Accessor " << i << " is malformed" << std::endl;
+			return false;
+		}
+		if (value.find("sparse")) {
+			std::cout << "ERROR::GLTF:: Sparse accessors are not supported" << std::endl;
+			return false;
+		}
+		if (accessor.bufferView >= 0 && accessor.count > 0) {
+			const GLTFBufferView& view = bufferViews[accessor.bufferView];
+			std::size_t stride = view.byteStride ? view.byteStride : elementSize;
+			if (accessor.byteOffset > view.byteLength || elementSize > view.byteLength - accessor.byteOffset
+				|| (accessor.count - 1) > (view.byteLength - accessor.byteOffset - elementSize) / stride) {
+				std::cout << "ERROR::GLTF:: Accessor " << i << " is out of its buffer view" << std::endl;
+				return false;
+			}
+		}
+		accessors.push_back(accessor);
+	}
+
+	//an attribute is used only with the number of components the conversion reads; vertex attributes must all have a
+	//value for every vertex and indices must name one of them
+	auto checkAccessor = [this](int accessor, unsigned int numComponents, std::size_t minCount) {
+		return accessor < 0 || (accessor < (int)accessors.size() && accessors[accessor].numComponents == numComponents
+			&& accessors[accessor].count >= minCount);
+	};
+	const std::vector<JSONValue>& meshValues = document.getArray("meshes");
+	for (unsigned int i = 0; i < meshValues.size(); ++i) {
+		GLTFMesh mesh;
+		mesh.name = meshValues[i].getString("name");
+		const std::vector<JSONValue>& primitiveValues = meshValues[i].getArray("primitives");
+		for (unsigned int j = 0; j < primitiveValues.size(); ++j) {
+			const JSONValue& value = primitiveValues[j];
+			GLTFPrimitive primitive;
+			primitive.mode = value.find("mode") ? (unsigned int)value.getSize("mode") : (unsigned int)GL_TRIANGLES;
+			if (primitive.mode != GL_TRIANGLES && primitive.mode != GL_TRIANGLE_STRIP && primitive.mode != GL_TRIANGLE_FAN)
+				continue;
+			const JSONValue* attributes = value.find("attributes");
+			primitive.position = attributes ? attributes->getIndex("POSITION") : -1;
+			primitive.normal = attributes ? attributes->getIndex("NORMAL") : -1;
+			primitive.texCoord = attributes ? attributes->getIndex("TEXCOORD_0") : -1;
+			primitive.tangent = attributes ? attributes->getIndex("TANGENT") : -1;
+			primitive.indices = value.getIndex("indices");
+			primitive.material = value.getIndex("material");
+			if (primitive.position < 0 || !checkAccessor(primitive.position, 3, 0)) {
+				std::cout << "ERROR::GLTF:: Primitive " << j << " of mesh " << i << " has no usable positions" << std::endl;
+				return false;
+			}
+			std::size_t numVertices = accessors[primitive.position].count;
+			if (!checkAccessor(primitive.normal, 3, numVertices) || !checkAccessor(primitive.texCoord, 2, numVertices)
+				|| !checkAccessor(primitive.tangent, 4, numVertices) || !checkAccessor(primitive.indices, 1, 0)
+				|| (primitive.indices >= 0 && accessors[primitive.indices].componentType != GL_UNSIGNED_BYTE
+					&& accessors[primitive.indices].componentType != GL_UNSIGNED_SHORT && accessors[primitive.indices].componentType != GL_UNSIGNED_INT)
+				|| primitive.material >= (int)document.getArray("materials").size()) {
+				std::cout << "ERROR::GLTF:: Primitive " << j << " of mesh " << i << " is malformed" << std::endl;
+				return false;
+			}
+			mesh.primitives.push_back(primitive);
+		}
+		meshes.push_back(mesh);
+	}
+
+	//a node has a matrix or a translation, rotation (x, y, z, w quaternion) and scale
+	const std::vector<JSONValue>& nodeValues = document.getArray("nodes");
+	std::vector<unsigned int> numParents(nodeValues.size(), 0);
+	for (unsigned int i = 0; i < nodeValues.size(); ++i) {
+		const JSONValue& value = nodeValues[i];
+		GLTFNode node;
+		node.name = value.getString("name");
+		node.mesh = value.getIndex("mesh");
+		if (node.mesh >= (int)meshes.size()) {
+			std::cout << "ERROR::GLTF:: Node " << i << " has no mesh " << node.mesh << std::endl;
+			return false;
+		}
+		const std::vector<JSONValue>& matrix = value.getArray("matrix");
+		const std::vector<JSONValue>& translation = value.getArray("translation");
+		const std::vector<JSONValue>& rotation = value.getArray("rotation");
+		const std::vector<JSONValue>& scale = value.getArray("scale");
+		node.localTransform = glm::mat4(1.0f);
+		if (matrix.size() == 16) {
+			float elements[16];
+			for (unsigned int j = 0; j < 16; ++j)
+				elements[j] = (float)matrix[j].number;
+			node.localTransform = glm::make_mat4(elements); //column-major like glm
+		}
+		else {
+			if (translation.size() == 3)
+				node.localTransform = glm::translate(node.localTransform, glm::vec3(translation[0].number, translation[1].number, translation[2].number));
+			if (rotation.size() == 4)
+				node.localTransform *= glm::mat4_cast(glm::quat((float)rotation[3].number, (float)rotation[0].number, (float)rotation[1].number,
+					(float)rotation[2].number));
+			if (scale.size() == 3)
+				node.localTransform = glm::scale(node.localTransform, glm::vec3(scale[0].number, scale[1].number, scale[2].number));
+		}
+		const std::vector<JSONValue>& children = value.getArray("children");
+		for (unsigned int j = 0; j < children.size(); ++j) {
+			double child = children[j].number;
+			if (children[j].type != JSONValue::JSON_NUMBER || child < 0.0 || child >= nodeValues.size() || ++numParents[(unsigned int)child] > 1) {
+				std::cout << "ERROR::GLTF:: Node " << i << " has an invalid child" << std::endl;
+				return false;
+			}
+			node.children.push_back((unsigned int)child);
+		}
+		nodes.push_back(node);
+	}
+
+	//the default scene's roots, every node without a parent when the file has no scenes. Roots must have no parent and
+	//every other node at most one, so walking down from the roots never loops
+	const std::vector<JSONValue>& scenes = document.getArray("scenes");
+	int scene = std::max(document.getIndex("scene"), 0);
+	if (scene < (int)scenes.size()) {
+		const std::vector<JSONValue>& roots = scenes[scene].getArray("nodes");
+		for (unsigned int i = 0; i < roots.size(); ++i) {
+			double root = roots[i].number;
+			if (roots[i].type != JSONValue::JSON_NUMBER || root < 0.0 || root >= nodes.size() || numParents[(unsigned int)root] != 0) {
+				std::cout << "ERROR::GLTF:: The scene has an invalid root node" << std::endl;
+				return false;
+			}
+			sceneNodes.push_back((unsigned int)root);
+		}
+	}
+	else {
+		for (unsigned int i = 0; i < nodes.size(); ++i) {
+			if (numParents[i] == 0)
+				sceneNodes.push_back(i);
+		}
+	}
+
+	//images are named by URI or, when embedded in a buffer view or a data URI, read from memory
+	const std::vector<JSONValue>& imageValues = document.getArray("images");
+	for (unsigned int i = 0; i < imageValues.size(); ++i) {
+		GLTFImage image;
+		image.data = NULL;
+		image.size = 0;
+		std::string uri = imageValues[i].getString("uri");
+		int bufferView = imageValues[i].getIndex("bufferView");
+		if (bufferView >= 0 && bufferView < (int)bufferViews.size()) {
+			image.data = getBufferViewData(bufferView);
+			image.size = bufferViews[bufferView].byteLength;
+		}
+		else if (uri.compare(0, 5, "data:") == 0) {
+			decodedBuffers.push_back(std::vector<unsigned char>());
+			if (decodeDataURI(uri, decodedBuffers.back())) {
+				image.data = decodedBuffers.back().data();
+				image.size = decodedBuffers.back().size();
+			}
+		}
+		else
+			image.uri = decodeURI(uri);
+		images.push_back(image);
+	}
+
+	const std::vector<JSONValue>& textures = document.getArray("textures");
+	auto textureImage = [&](const JSONValue* textureInfo) {
+		int texture = textureInfo ? textureInfo->getIndex("index") : -1;
+		int image = texture >= 0 && texture < (int)textures.size() ? textures[texture].getIndex("source") : -1;
+		return image < (int)images.size() ? image : -1;
+	};
+	const std::vector<JSONValue>& materialValues = document.getArray("materials");
+	for (unsigned int i = 0; i < materialValues.size(); ++i) {
+		GLTFMaterial material;
+		const JSONValue* pbr = materialValues[i].find("pbrMetallicRoughness");
+		material.baseColorImage = textureImage(pbr ? pbr->find("baseColorTexture") : NULL);
+		material.normalImage = textureImage(materialValues[i].find("normalTexture"));
+		materials.push_back(material);
+	}
+	return true;
+}
+
+bool isGLTFFile(const std::string& path) {
+	std::size_t dot = path.find_last_of('.');
+	if (dot == std::string::npos)
+		return false;
+	std::string extension = path.substr(dot + 1);
+	std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+	return extension == "gltf" || extension == "glb";
+}
+
+unsigned int countGLTFVertices(const GLTFFile& file, const GLTFPrimitive& primitive) {
+	return file.accessors[primitive.position].count;
+}
+
+unsigned int countGLTFIndices(const GLTFFile& file, const GLTFPrimitive& primitive) {
+	std::size_t count = primitive.indices >= 0 ? file.accessors[primitive.indices].count : file.accessors[primitive.position].count;
+	if (primitive.mode == GL_TRIANGLES)
+		return count - count % 3;
+	return count >= 3 ? 3 * (count - 2) : 0;
+}
+
+//writes the triangle list of the primitive's indices, or of its vertices in order when it has none. Strips alternate
+//the winding back, fans keep their first vertex. Indices past the vertices become 0 instead of reading past the buffer
+template<class T>
+static void writeIndices(const unsigned char* data, std::size_t stride, std::size_t count, unsigned int mode, unsigned int numVertices,
+	unsigned int* indices) {
+	auto index = [&](std::size_t i) {
+		T value;
+		if (data)
+			std::memcpy(&value, data + i * stride, sizeof(T));
+		else
+			value = (T)i;
+		return (unsigned int)value < numVertices ? (unsigned int)value : 0u;
+	};
+	if (mode == GL_TRIANGLES) {
+		for (std::size_t i = 0; i < count - count % 3; ++i)
+			*indices++ = index(i);
+		return;
+	}
+	for (std::size_t i = 0; i + 2 < count; ++i) {
+		if (mode == GL_TRIANGLE_FAN) {
+			*indices++ = index(0);
+			*indices++ = index(i + 1);
+			*indices++ = index(i + 2);
+		}
+		else {
+			*indices++ = index(i + (i % 2));
+			*indices++ = index(i + 1 - (i % 2));
+			*indices++ = index(i + 2);
+		}
+	}
+}
+
+static void writeGLTFIndices(const GLTFFile& file, const GLTFPrimitive& primitive, unsigned int* indices) {
+	unsigned int numVertices = countGLTFVertices(file, primitive);
+	if (primitive.indices < 0) {
+		writeIndices<unsigned int>(NULL, 0, numVertices, primitive.mode, numVertices, indices);
+		return;
+	}
+	const GLTFAccessor& accessor = file.accessors[primitive.indices];
+	const unsigned char* data = accessor.bufferView >= 0 ? file.getBufferViewData(accessor.bufferView) + accessor.byteOffset : NULL;
+	std::size_t stride = accessor.bufferView >= 0 && file.bufferViews[accessor.bufferView].byteStride
+		? file.bufferViews[accessor.bufferView].byteStride : getComponentSize(accessor.componentType);
+	if (!data) { //every index 0
+		std::fill(indices, indices + countGLTFIndices(file, primitive), 0u);
+		return;
+	}
+	switch (accessor.componentType) {
+	case GL_UNSIGNED_BYTE:
+		writeIndices<std::uint8_t>(data, stride, accessor.count, primitive.mode, numVertices, indices);
+		break;
+	case GL_UNSIGNED_SHORT:
+		writeIndices<std::uint16_t>(data, stride, accessor.count, primitive.mode, numVertices, indices);
+		break;
+	default:
+		writeIndices<std::uint32_t>(data, stride, accessor.count, primitive.mode, numVertices, indices);
+		break;
+	}
+}
+
+std::vector<unsigned int> readGLTFIndices(const GLTFFile& file, const GLTFPrimitive& primitive) {
+	std::vector<unsigned int> indices(countGLTFIndices(file, primitive));
+	writeGLTFIndices(file, primitive, indices.data());
+	return indices;
+}
+
+std::string getGLTFImagePath(const GLTFFile& file, unsigned int image) {
+	return file.images[image].uri.empty() ? '*' + std::to_string(image) : file.images[image].uri;
+}
+
+const GLTFImage* findGLTFEmbeddedImage(const GLTFFile& file, const std::string& localPath) {
+	if (localPath.empty() || localPath[0] != '*')
+		return NULL;
+	char* end;
+	unsigned long image = std::strtoul(localPath.c_str() + 1, &end, 10);
+	return *end == '\0' && end != localPath.c_str() + 1 && image < file.images.size() ? &file.images[image] : NULL;
+}
+
+AABB convertGLTFPrimitive(const GLTFFile& file, const GLTFPrimitive& primitive, Vertex* vertices, unsigned int* indices) {
+	GLTFAccessorReader positions(file, primitive.position);
+	GLTFAccessorReader normals(file, primitive.normal);
+	GLTFAccessorReader texCoords(file, primitive.texCoord);
+	GLTFAccessorReader tangents(file, primitive.tangent);
+	const unsigned int numVertices = positions.size();
+
+	//what the file leaves out is generated as aiProcess_GenSmoothNormals and aiProcess_CalcTangentSpace would: normals
+	//from the area weighted normals of the triangles around each vertex, tangents (only with texture coordinates) from
+	//the texture coordinate gradients of those triangles, made orthogonal to the normal. Both need the triangles, which
+	//are read from the file again since the indices written to the mapped buffer can't be read back
+	std::vector<glm::vec3> generatedNormals, generatedTangents, generatedBitangents;
+	if (!normals.isValid() || (!tangents.isValid() && texCoords.isValid())) {
+		std::vector<unsigned int> triangles = readGLTFIndices(file, primitive);
+		if (!normals.isValid())
+			generatedNormals.assign(numVertices, glm::vec3(0.0f));
+		if (!tangents.isValid() && texCoords.isValid()) {
+			generatedTangents.assign(numVertices, glm::vec3(0.0f));
+			generatedBitangents.assign(numVertices, glm::vec3(0.0f));
+		}
+		for (unsigned int i = 0; i + 2 < triangles.size(); i += 3) {
+			unsigned int corners[3] = { triangles[i], triangles[i + 1], triangles[i + 2] };
+			glm::vec3 p0(positions[corners[0]]), p1(positions[corners[1]]), p2(positions[corners[2]]);
+			glm::vec3 edge1 = p1 - p0, edge2 = p2 - p0;
+			if (!generatedNormals.empty()) {
+				glm::vec3 faceNormal = glm::cross(edge1, edge2); //its length is twice the area
+				for (unsigned int j = 0; j < 3; ++j)
+					generatedNormals[corners[j]] += faceNormal;
+			}
+			if (!generatedTangents.empty()) {
+				glm::vec2 uv0(texCoords[corners[0]]), uv1(texCoords[corners[1]]), uv2(texCoords[corners[2]]);
+				glm::vec2 deltaUV1 = uv1 - uv0, deltaUV2 = uv2 - uv0;
+				float determinant = deltaUV1.x * deltaUV2.y - deltaUV2.x * deltaUV1.y;
+				if (std::abs(determinant) < 1e-12f)
+					continue;
+				float f = 1.0f / determinant;
+				glm::vec3 tangent = f * (deltaUV2.y * edge1 - deltaUV1.y * edge2);
+				glm::vec3 bitangent = f * (deltaUV1.x * edge2 - deltaUV2.x * edge1);
+				for (unsigned int j = 0; j < 3; ++j) {
+					generatedTangents[corners[j]] += tangent;
+					generatedBitangents[corners[j]] += bitangent;
+				}
+			}
+		}
+	}
+
+	AABB bounds;
+	for (unsigned int i = 0; i < numVertices; ++i) {
+		glm::vec3 position(positions[i]);
+		glm::vec3 normal = normals.isValid() ? glm::vec3(normals[i]) : generatedNormals[i];
+		if (!normals.isValid() && glm::dot(normal, normal) > 0.0f)
+			normal = glm::normalize(normal);
+		glm::vec2 texCoords0(0.0f);
+		glm::vec3 tangent(0.0f);
+		glm::vec3 bitangent(0.0f);
+		if (texCoords.isValid()) {
+			glm::vec2 texCoord(texCoords[i]);
+			texCoords0 = glm::vec2(texCoord.x, 1.0f - texCoord.y);
+			if (tangents.isValid()) {
+				//the fourth component is the handedness of the tangent space
+				glm::vec4 fileTangent = tangents[i];
+				tangent = glm::vec3(fileTangent);
+				bitangent = glm::cross(normal, tangent) * (fileTangent.w < 0.0f ? -1.0f : 1.0f);
+			}
+			else {
+				tangent = generatedTangents[i] - normal * glm::dot(normal, generatedTangents[i]);
+				bitangent = generatedBitangents[i] - normal * glm::dot(normal, generatedBitangents[i]);
+				if (glm::dot(tangent, tangent) > 0.0f)
+					tangent = glm::normalize(tangent);
+				if (glm::dot(bitangent, bitangent) > 0.0f)
+					bitangent = glm::normalize(bitangent);
+			}
+		}
+		new (&vertices[i]) Vertex(position, normal, texCoords0, tangent, bitangent);
+		bounds.expand(position);
+	}
+
+	writeGLTFIndices(file, primitive, indices);
+	return bounds;
+}
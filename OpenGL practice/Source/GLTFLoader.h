@@ -0,0 +1,124 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cstddef>
+#include <glm/glm.hpp>
+
+#include "Mesh.h"
+#include "Bounds.h"
+#include "MappedFile.h"
+
+class GLTFFile;
+
+//the parts of a glTF 2.0 file the native loader reads, indices into the file's arrays and -1 for what is absent
+struct GLTFBufferView {
+	unsigned int buffer;
+	std::size_t byteOffset, byteLength;
+	std::size_t byteStride; //0 for tightly packed
+};
+
+struct GLTFAccessor {
+	int bufferView; //-1: every element is zero
+	std::size_t byteOffset;
+	unsigned int componentType; //GL_BYTE ... GL_FLOAT, the values glTF uses
+	unsigned int numComponents;
+	bool normalized;
+	std::size_t count;
+};
+
+struct GLTFPrimitive {
+	int position, normal, texCoord, tangent, indices; //accessors
+	int material;
+	unsigned int mode; //GL_TRIANGLES, GL_TRIANGLE_STRIP or GL_TRIANGLE_FAN, primitives of points and lines are dropped
+};
+
+struct GLTFMesh {
+	std::string name;
+	std::vector<GLTFPrimitive> primitives;
+};
+
+struct GLTFNode {
+	std::string name;
+	glm::mat4 localTransform;
+	int mesh;
+	std::vector<unsigned int> children;
+};
+
+struct GLTFMaterial {
+	int baseColorImage, normalImage; //images, through the material's textures
+};
+
+struct GLTFImage {
+	std::string uri; //relative to the file, empty for embedded images
+	const unsigned char* data; //encoded image of an embedded image (buffer view or data URI), NULL otherwise
+	std::size_t size;
+};
+
+//Reads the elements of an accessor as floats. Integer components are converted as KHR_mesh_quantization allows:
+//normalized ones to [0, 1] or [-1, 1], the others as they are. The element type is resolved once, so reading an
+//element is one indirect call straight on the file's memory
+class GLTFAccessorReader
+{
+public:
+	GLTFAccessorReader(); //reads nothing
+	GLTFAccessorReader(const GLTFFile& file, int accessor);
+
+	bool isValid() const {
+		return count > 0;
+	}
+	std::size_t size() const {
+		return count;
+	}
+	glm::vec4 operator[](std::size_t element) const { //components the accessor doesn't have are 0
+		return read(data + element * stride);
+	}
+
+private:
+	const unsigned char* data;
+	std::size_t stride, count;
+	glm::vec4 (*read)(const unsigned char* element);
+};
+
+//A parsed .gltf or .glb file with its buffers memory-mapped: a .glb's binary chunk and external .bin files are read
+//from the mapping, never copied. Only buffers given as base64 data URIs are decoded into memory. Accessors, buffer views
+//and images are validated against the buffers when the file is opened, so reading them afterwards can't overrun
+class GLTFFile
+{
+public:
+	std::vector<GLTFBufferView> bufferViews;
+	std::vector<GLTFAccessor> accessors;
+	std::vector<GLTFMesh> meshes;
+	std::vector<GLTFNode> nodes;
+	std::vector<GLTFMaterial> materials;
+	std::vector<GLTFImage> images;
+	std::vector<unsigned int> sceneNodes; //roots of the default scene
+	bool hasSkinsOrAnimations;
+
+	GLTFFile();
+	//prints the error and returns false for files that can't be read, aren't valid glTF 2.0 or require an extension
+	//other than KHR_mesh_quantization
+	bool open(const std::string& path);
+	const unsigned char* getBufferViewData(unsigned int bufferView) const;
+
+private:
+	MappedFile file; //the .gltf or .glb
+	std::vector<MappedFile> bufferFiles;
+	std::vector<std::vector<unsigned char>> decodedBuffers; //data URIs
+	std::vector<const unsigned char*> buffers;
+	std::vector<std::size_t> bufferSizes;
+
+	bool parse(const char* json, std::size_t length, const std::string& directory, const unsigned char* binaryChunk, std::size_t binaryChunkSize);
+};
+
+bool isGLTFFile(const std::string& path); //by extension
+unsigned int countGLTFVertices(const GLTFFile& file, const GLTFPrimitive& primitive);
+unsigned int countGLTFIndices(const GLTFFile& file, const GLTFPrimitive& primitive); //after turning strips and fans into triangles
+//writes the primitive's vertices and triangle list indices to the given arrays in order, every element once and nothing
+//read back, like the assimp conversion, with the texture coordinates flipped as aiProcess_FlipUVs does. Missing normals
+//and tangents are generated. Returns the bounds of the positions
+AABB convertGLTFPrimitive(const GLTFFile& file, const GLTFPrimitive& primitive, Vertex* vertices, unsigned int* indices);
+std::vector<unsigned int> readGLTFIndices(const GLTFFile& file, const GLTFPrimitive& primitive); //as triangle lists
+//the path a Model records for an image: its URI, or "*" and its index for an embedded image, as assimp names those
+std::string getGLTFImagePath(const GLTFFile& file, unsigned int image);
+const GLTFImage* findGLTFEmbeddedImage(const GLTFFile& file, const std::string& localPath); //NULL for paths of files
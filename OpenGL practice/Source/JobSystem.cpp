@@ -0,0 +1,292 @@
+#include "JobSystem.h"
+#include "SceneGraph.h"
+#include "BVH.h"
+#include "Timing.h"
+#include <glm/gtc/matrix_transform.hpp>
+#include <iostream>
+#include <algorithm>
+#include <random>
+#include <chrono>
+
+//the job system and queue the current thread belongs to. Threads that aren't workers of any job system use queue 0
+static thread_local const JobSystem* currentJobSystem = nullptr;
+static thread_local unsigned int currentQueue = 0;
+
+JobSystem::JobSystem(unsigned int numWorkers) : running(true), numQueuedJobs(0) {
+	for (unsigned int i = 0; i <= numWorkers; ++i)
+		queues.push_back(std::unique_ptr<JobQueue>(new JobQueue()));
+	for (unsigned int i = 1; i <= numWorkers; ++i)
+		workers.push_back(std::thread(&JobSystem::workerLoop, this, i));
+}
+
+//jobs still queued are dropped, wait on their counters first
+JobSystem::~JobSystem() {
+	running = false;
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+	}
+	wakeCondition.notify_all();
+	for (unsigned int i = 0; i < workers.size(); ++i)
+		workers[i].join();
+}
+
+void JobSystem::run(const std::function<void()>& function, JobCounter* counter, JobCounter* dependency) {
+	Job job = { function, counter };
+	if (counter)
+		counter->count.fetch_add(1, std::memory_order_relaxed);
+
+	if (dependency) {
+		//the last job of the dependency scans the parked list and decrements under the same lock, so a job is either
+		//parked before that scan or sees the dependency already done
+		std::lock_guard<std::mutex> lock(parkedMutex);
+		if (!dependency->isDone()) {
+			parkedJobs.push_back(std::make_pair(dependency, job));
+			return;
+		}
+	}
+	push(job);
+}
+
+void JobSystem::parallelFor(unsigned int count, unsigned int grainSize, const std::function<void(unsigned int, unsigned int)>& function,
+	JobCounter* counter, JobCounter* dependency) {
+	if (count == 0)
+		return;
+	grainSize = std::max(grainSize, 1u);
+	std::shared_ptr<const RangeFunction> sharedFunction = std::make_shared<RangeFunction>(function);
+	run([this, sharedFunction, count, grainSize, counter]() {
+		runRange(sharedFunction, 0, count, grainSize, counter);
+	}, counter, dependency);
+}
+
+void JobSystem::runRange(const std::shared_ptr<const RangeFunction>& function, unsigned int begin, unsigned int end, unsigned int grainSize,
+	JobCounter* counter) {
+	while (end - begin > grainSize) {
+		unsigned int middle = begin + (end - begin) / 2;
+		std::shared_ptr<const RangeFunction> sharedFunction = function;
+		run([this, sharedFunction, middle, end, grainSize, counter]() {
+			runRange(sharedFunction, middle, end, grainSize, counter);
+		}, counter);
+		end = middle;
+	}
+	(*function)(begin, end);
+}
+
+void JobSystem::wait(JobCounter& counter) {
+	unsigned int queueIndex = getQueueIndex();
+	while (!counter.isDone()) {
+		if (!runNextJob(queueIndex))
+			std::this_thread::yield();
+	}
+}
+
+unsigned int JobSystem::getNumThreads() const {
+	return workers.size() + 1;
+}
+
+unsigned int JobSystem::getDefaultNumWorkers() {
+	return std::max(1u, std::thread::hardware_concurrency()) - 1;
+}
+
+void JobSystem::workerLoop(unsigned int queueIndex) {
+	currentJobSystem = this;
+	currentQueue = queueIndex;
+	while (running) {
+		if (runNextJob(queueIndex))
+			continue;
+		std::unique_lock<std::mutex> lock(sleepMutex);
+		wakeCondition.wait(lock, [this]() { return !running || numQueuedJobs.load() > 0; });
+	}
+}
+
+unsigned int JobSystem::getQueueIndex() const {
+	return currentJobSystem == this ? currentQueue : 0;
+}
+
+void JobSystem::push(Job job) {
+	JobQueue& queue = *queues[getQueueIndex()];
+	{
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		queue.jobs.push_back(std::move(job));
+	}
+	numQueuedJobs.fetch_add(1);
+
+	//a worker that just found nothing to do checks numQueuedJobs under the sleep mutex before it sleeps, taking the
+	//mutex here makes sure it either sees the new job or is already waiting for the notification
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+	}
+	wakeCondition.notify_one();
+}
+
+//pops the newest job of the thread's own queue, otherwise steals the oldest job of another queue
+bool JobSystem::runNextJob(unsigned int queueIndex) {
+	Job job;
+	bool found = false;
+	for (unsigned int i = 0; i < queues.size() && !found; ++i) {
+		JobQueue& queue = *queues[(queueIndex + i) % queues.size()];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (queue.jobs.empty())
+			continue;
+		if (i == 0) {
+			job = std::move(queue.jobs.back());
+			queue.jobs.pop_back();
+		}
+		else {
+			job = std::move(queue.jobs.front());
+			queue.jobs.pop_front();
+		}
+		found = true;
+	}
+	if (!found)
+		return false;
+
+	numQueuedJobs.fetch_sub(1);
+	job.function();
+	finish(job.counter);
+	return true;
+}
+
+void JobSystem::finish(JobCounter* counter) {
+	if (!counter)
+		return;
+	int count = counter->count.load(std::memory_order_relaxed);
+	while (count > 1) {
+		if (counter->count.compare_exchange_weak(count, count - 1, std::memory_order_acq_rel))
+			return;
+	}
+
+	//the last job of the counter: its dependents are released before the count reaches zero, as a wait may return and
+	//the counter's address be reused (by the next frame's counter on the stack) the moment it does. The decrement happens
+	//under the lock, so run() either parks a job before the scan or sees the counter done
+	std::vector<Job> released;
+	{
+		std::lock_guard<std::mutex> lock(parkedMutex);
+		for (unsigned int i = 0; i < parkedJobs.size();) {
+			if (parkedJobs[i].first == counter) {
+				released.push_back(parkedJobs[i].second);
+				parkedJobs.erase(parkedJobs.begin() + i);
+			}
+			else {
+				++i;
+			}
+		}
+		counter->count.fetch_sub(1, std::memory_order_acq_rel);
+	}
+	for (unsigned int i = 0; i < released.size(); ++i)
+		push(released[i]);
+}
+
+
+void benchmarkJobSystem(unsigned int numNodes, unsigned int numLights, unsigned int numFrames) {
+	if (numNodes == 0 || numFrames == 0)
+		return;
+
+	//a forest of shallow random hierarchies spread through a volume, every node is an object with unit cube bounds
+	std::mt19937 generator(1234);
+	const float worldSize = 4.0f * std::cbrt((float)numNodes);
+	std::uniform_real_distribution<float> randomPosition(-0.5f * worldSize, 0.5f * worldSize);
+	std::uniform_real_distribution<float> randomOffset(-2.0f, 2.0f);
+	std::uniform_real_distribution<float> randomAngle(-180.0f, 180.0f);
+	const unsigned int numRoots = std::max(1u, numNodes / 100);
+	SceneGraph sceneGraph;
+	sceneGraph.reserve(numNodes);
+	for (unsigned int i = 0; i < numNodes; ++i) {
+		if (i < numRoots) {
+			glm::vec3 position(randomPosition(generator), randomPosition(generator), randomPosition(generator));
+			sceneGraph.addNode(SceneGraph::NO_PARENT, glm::translate(glm::mat4(1.0f), position));
+		}
+		else {
+			glm::mat4 local = glm::translate(glm::mat4(1.0f), glm::vec3(randomOffset(generator), randomOffset(generator), randomOffset(generator)));
+			sceneGraph.addNode(generator() % i, glm::rotate(local, glm::radians(randomAngle(generator)), glm::vec3(0.0f, 1.0f, 0.0f)));
+		}
+	}
+	sceneGraph.updateWorldTransforms();
+
+	const AABB localBounds(glm::vec3(-0.5f), glm::vec3(0.5f));
+	std::vector<AABB> objectBounds(numNodes);
+	for (unsigned int i = 0; i < numNodes; ++i)
+		objectBounds[i] = localBounds.transformed(sceneGraph.getWorldTransform(i));
+	BVH bvh;
+	bvh.build(objectBounds);
+
+	//point lights with random colors and attenuation, binned against the camera frustum
+	std::uniform_real_distribution<float> randomUnit(0.0f, 1.0f);
+	std::vector<glm::vec3> lightPositions(numLights), lightColors(numLights);
+	std::vector<float> lightLinear(numLights), lightQuadratic(numLights);
+	for (unsigned int i = 0; i < numLights; ++i) {
+		lightPositions[i] = glm::vec3(randomPosition(generator), randomPosition(generator), randomPosition(generator));
+		lightColors[i] = glm::vec3(randomUnit(generator), randomUnit(generator), randomUnit(generator));
+		lightLinear[i] = 0.1f + 0.6f * randomUnit(generator);
+		lightQuadratic[i] = 0.02f + 1.8f * randomUnit(generator);
+	}
+
+	glm::mat4 projection = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, worldSize);
+	glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 0.0f, 0.5f * worldSize), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	Frustum frustum(projection * view);
+
+	const unsigned int numChanged = numNodes / 10;
+	const unsigned int maxThreads = std::max(1u, std::thread::hardware_concurrency());
+	std::cout << "Job system benchmark: " << numNodes << " nodes/objects, " << numChanged << " transforms changed per frame, "
+		<< numLights << " lights, " << numFrames << " frames, 1 to " << maxThreads << " threads" << std::endl;
+
+	double baseTimes[3] = { 0.0, 0.0, 0.0 };
+	for (unsigned int threads = 1; threads <= maxThreads; ++threads) {
+		JobSystem jobSystem(threads - 1);
+		SceneGraph frameGraph = sceneGraph; //every run applies the same changes to the same hierarchy
+		BVH frameBVH = bvh;
+		std::mt19937 frameGenerator(5678);
+		std::vector<unsigned int> visibleObjects;
+		std::vector<unsigned char> lightVisible(numLights);
+		std::vector<unsigned int> binnedLights;
+
+		double times[3] = { 0.0, 0.0, 0.0 }; //milliseconds: transforms + bounds, culling, light binning
+		for (unsigned int frame = 0; frame < numFrames; ++frame) {
+			for (unsigned int i = 0; i < numChanged; ++i) {
+				unsigned int node = frameGenerator() % numNodes;
+				frameGraph.setLocalTransform(node, glm::rotate(frameGraph.getLocalTransform(node), 0.01f, glm::vec3(0.0f, 1.0f, 0.0f)));
+			}
+
+			auto start = std::chrono::high_resolution_clock::now();
+			frameGraph.updateWorldTransforms(jobSystem);
+			JobCounter boundsDone;
+			jobSystem.parallelFor(numNodes, 1024, [&](unsigned int begin, unsigned int end) {
+				for (unsigned int i = begin; i < end; ++i)
+					objectBounds[i] = localBounds.transformed(frameGraph.getWorldTransform(i));
+			}, &boundsDone);
+			jobSystem.wait(boundsDone);
+			times[0] += elapsedMilliseconds(start);
+
+			frameBVH.refit(objectBounds);
+			start = std::chrono::high_resolution_clock::now();
+			frameBVH.queryFrustum(frustum, visibleObjects, jobSystem);
+			times[1] += elapsedMilliseconds(start);
+
+			start = std::chrono::high_resolution_clock::now();
+			JobCounter lightsDone;
+			jobSystem.parallelFor(numLights, 1024, [&](unsigned int begin, unsigned int end) {
+				for (unsigned int i = begin; i < end; ++i) {
+					float lightMax = std::max(std::max(lightColors[i].x, lightColors[i].y), lightColors[i].z);
+					float radius = (-lightLinear[i] + std::sqrt(lightLinear[i] * lightLinear[i] - 4.0f * lightQuadratic[i] * (1.0f - (256.0f / 5.0f) * lightMax)))
+						/ (2.0f * lightQuadratic[i]);
+					lightVisible[i] = frustum.intersectsSphere(lightPositions[i], radius) ? 1 : 0;
+				}
+			}, &lightsDone);
+			jobSystem.wait(lightsDone);
+			binnedLights.clear();
+			for (unsigned int i = 0; i < numLights; ++i) {
+				if (lightVisible[i])
+					binnedLights.push_back(i);
+			}
+			times[2] += elapsedMilliseconds(start);
+		}
+
+		for (unsigned int stage = 0; stage < 3; ++stage) {
+			times[stage] /= numFrames;
+			if (threads == 1)
+				baseTimes[stage] = times[stage];
+		}
+		std::cout << "    " << threads << " thread(s): transforms " << times[0] << " ms (x" << baseTimes[0] / times[0] << "), culling "
+			<< times[1] << " ms (x" << baseTimes[1] / times[1] << ", " << visibleObjects.size() << " visible), light binning "
+			<< times[2] << " ms (x" << baseTimes[2] / times[2] << ", " << binnedLights.size() << " in view)" << std::endl;
+	}
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <functional>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <utility>
+
+class JobCounter;
+
+struct Job {
+	std::function<void()> function;
+	JobCounter* counter; //decremented once the function returned, may be null
+};
+
+//number of unfinished jobs in a group. Every job run with the counter increments it when it is queued and decrements
+//it when it finishes, so a counter can be waited on or used as the dependency of later jobs. The last job releases the
+//jobs depending on the counter before its decrement, and the decrement is the last thing a job does with its counter,
+//so the counter may go out of scope (and its address be reused) as soon as a wait on it returns
+class JobCounter
+{
+public:
+	JobCounter() : count(0) {}
+	JobCounter(const JobCounter&) = delete;
+	JobCounter& operator=(const JobCounter&) = delete;
+
+	bool isDone() const {
+		return count.load(std::memory_order_acquire) == 0;
+	}
+
+private:
+	friend class JobSystem;
+
+	std::atomic<int> count;
+};
+
+//Work-stealing job system. Every worker thread owns a deque: it pushes and pops its own jobs at the back, so the most
+//recently split (and still cache-warm) work runs first, and idle workers steal from the front of the other deques,
+//which holds the oldest and therefore largest pieces of work. Threads that aren't workers (the GL thread) share one
+//extra deque and help run jobs while they wait on a counter, so a job system without workers still runs everything.
+class JobSystem
+{
+public:
+	explicit JobSystem(unsigned int numWorkers = getDefaultNumWorkers());
+	~JobSystem();
+	JobSystem(const JobSystem&) = delete;
+	JobSystem& operator=(const JobSystem&) = delete;
+
+	//queues the function, or parks it until dependency reaches zero. counter is incremented right away. A counter used
+	//as a dependency must not be given new jobs before the ones depending on it were released
+	void run(const std::function<void()>& function, JobCounter* counter = nullptr, JobCounter* dependency = nullptr);
+	//calls function(begin, end) over [0, count) in ranges of at most grainSize. The range is split in halves on the
+	//worker that runs it, so idle workers steal big halves instead of the caller queuing count / grainSize jobs
+	void parallelFor(unsigned int count, unsigned int grainSize, const std::function<void(unsigned int, unsigned int)>& function,
+		JobCounter* counter, JobCounter* dependency = nullptr);
+	void wait(JobCounter& counter); //runs queued jobs until the counter reaches zero
+
+	unsigned int getNumThreads() const; //workers plus the thread that waits
+	static unsigned int getDefaultNumWorkers(); //one per hardware thread besides the calling one
+
+private:
+	typedef std::function<void(unsigned int, unsigned int)> RangeFunction;
+
+	struct JobQueue {
+		std::mutex mutex;
+		std::deque<Job> jobs;
+	};
+
+	std::vector<std::unique_ptr<JobQueue>> queues; //queue 0 is shared by the threads that aren't workers
+	std::vector<std::thread> workers;
+	std::atomic<bool> running;
+	std::atomic<int> numQueuedJobs;
+	std::mutex sleepMutex;
+	std::condition_variable wakeCondition;
+	std::vector<std::pair<JobCounter*, Job>> parkedJobs; //jobs waiting for their dependency to reach zero
+	std::mutex parkedMutex;
+
+	void workerLoop(unsigned int queueIndex);
+	unsigned int getQueueIndex() const;
+	void push(Job job);
+	bool runNextJob(unsigned int queueIndex);
+	void finish(JobCounter* counter);
+	void runRange(const std::shared_ptr<const RangeFunction>& function, unsigned int begin, unsigned int end, unsigned int grainSize,
+		JobCounter* counter);
+};
+
+//times the per-frame CPU stages (dirty transform update, BVH frustum culling and light binning) of a large synthetic
+//scene with 1 to N threads and prints the time and speedup of each stage against the single-threaded run
+void benchmarkJobSystem(unsigned int numNodes = 100000, unsigned int numLights = 100000, unsigned int numFrames = 50);
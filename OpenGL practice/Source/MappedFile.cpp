@@ -0,0 +1,157 @@
+#include "MappedFile.h"
+#include <iostream>
+#include <algorithm>
+#include <utility>
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+MappedFile::MappedFile() : data(NULL), size(0), file(INVALID_HANDLE_VALUE), mapping(NULL) {}
+#else
+MappedFile::MappedFile() : data(NULL), size(0), file(-1) {}
+#endif
+
+MappedFile::MappedFile(const char* path) : MappedFile() {
+	open(path);
+}
+
+MappedFile::~MappedFile() {
+	close();
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept : MappedFile() {
+	*this = std::move(other);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+	if (this != &other) {
+		close();
+		std::swap(data, other.data);
+		std::swap(size, other.size);
+		std::swap(file, other.file);
+#ifdef _WIN32
+		std::swap(mapping, other.mapping);
+#endif
+	}
+	return *this;
+}
+
+bool MappedFile::open(const char* path) {
+	close();
+#ifdef _WIN32
+	file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	LARGE_INTEGER fileSize;
+	if (file == INVALID_HANDLE_VALUE || !GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+		std::cout << "ERROR::MAPPED_FILE:: Cannot open " << path << std::endl;
+		close();
+		return false;
+	}
+	size = (std::size_t)fileSize.QuadPart;
+	mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (mapping)
+		data = static_cast<const unsigned char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+#else
+	file = ::open(path, O_RDONLY);
+	struct stat status;
+	if (file < 0 || fstat(file, &status) != 0 || status.st_size == 0) {
+		std::cout << "ERROR::MAPPED_FILE:: Cannot open " << path << std::endl;
+		close();
+		return false;
+	}
+	size = (std::size_t)status.st_size;
+	void* view = mmap(NULL, size, PROT_READ, MAP_SHARED, file, 0);
+	if (view != MAP_FAILED)
+		data = static_cast<const unsigned char*>(view);
+#endif
+	if (!data) {
+		std::cout << "ERROR::MAPPED_FILE:: Cannot map " << path << std::endl;
+		close();
+		return false;
+	}
+	return true;
+}
+
+void MappedFile::close() {
+#ifdef _WIN32
+	if (data)
+		UnmapViewOfFile(data);
+	if (mapping)
+		CloseHandle(mapping);
+	if (file != INVALID_HANDLE_VALUE)
+		CloseHandle(file);
+	mapping = NULL;
+	file = INVALID_HANDLE_VALUE;
+#else
+	if (data)
+		munmap(const_cast<unsigned char*>(data), size);
+	if (file >= 0)
+		::close(file);
+	file = -1;
+#endif
+	data = NULL;
+	size = 0;
+}
+
+bool MappedFile::isOpen() const {
+	return data != NULL;
+}
+
+const unsigned char* MappedFile::getData() const {
+	return data;
+}
+
+std::size_t MappedFile::getSize() const {
+	return size;
+}
+
+std::size_t MappedFile::getPageSize() {
+#ifdef _WIN32
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return info.dwPageSize;
+#else
+	return (std::size_t)sysconf(_SC_PAGESIZE);
+#endif
+}
+
+void MappedFile::pageRange(std::size_t& offset, std::size_t& rangeSize) const {
+	static const std::size_t pageSize = getPageSize();
+	std::size_t end = std::min(offset + rangeSize, size);
+	offset -= offset % pageSize;
+	rangeSize = end > offset ? end - offset : 0;
+}
+
+void MappedFile::prefetch(std::size_t offset, std::size_t rangeSize) const {
+	if (!data)
+		return;
+	pageRange(offset, rangeSize);
+	if (rangeSize == 0)
+		return;
+#ifdef _WIN32
+	WIN32_MEMORY_RANGE_ENTRY range = { const_cast<unsigned char*>(data + offset), rangeSize };
+	PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+#else
+	madvise(const_cast<unsigned char*>(data + offset), rangeSize, MADV_WILLNEED);
+#endif
+}
+
+void MappedFile::discard(std::size_t offset, std::size_t rangeSize) const {
+	if (!data)
+		return;
+	pageRange(offset, rangeSize);
+	if (rangeSize == 0)
+		return;
+#ifdef _WIN32
+	//unlocking pages that aren't locked fails, but takes them out of the working set all the same
+	VirtualUnlock(const_cast<unsigned char*>(data + offset), rangeSize);
+#else
+	madvise(const_cast<unsigned char*>(data + offset), rangeSize, MADV_DONTNEED);
+#endif
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+
+//Read-only memory mapping of a whole file. Pages are read from disk the first time they are touched, so opening even a
+//file larger than memory is cheap, and the OS can drop clean pages again whenever it needs the memory. The mapping is
+//plain memory to every thread. Move-only: the mapping is released with its owner.
+class MappedFile
+{
+public:
+	MappedFile();
+	explicit MappedFile(const char* path);
+	~MappedFile();
+	MappedFile(MappedFile&& other) noexcept;
+	MappedFile& operator=(MappedFile&& other) noexcept;
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	bool open(const char* path); //closes the file mapped before. Prints the error and returns false when it can't be mapped
+	void close();
+	bool isOpen() const;
+	const unsigned char* getData() const; //NULL when not open
+	std::size_t getSize() const;
+
+	//hints for a range of the file, no-ops where the OS has no such hint. prefetch starts reading the range in the
+	//background, discard drops its pages from the process's working set; they are read again if touched afterwards
+	void prefetch(std::size_t offset, std::size_t size) const;
+	void discard(std::size_t offset, std::size_t size) const;
+	static std::size_t getPageSize();
+
+private:
+	const unsigned char* data;
+	std::size_t size;
+#ifdef _WIN32
+	void* file; //HANDLE
+	void* mapping; //HANDLE
+#else
+	int file;
+#endif
+
+	void pageRange(std::size_t& offset, std::size_t& size) const; //widens the range to whole pages inside the file
+};
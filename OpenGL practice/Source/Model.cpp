@@ -1,78 +1,246 @@
 #include "Model.h"
+#include "FrameArena.h"
+#include "ProcessMemory.h"
+#include "RenderTargetPool.h"
+#include "GLTFLoader.h"
+#include "OBJLoader.h"
+#include "Timing.h"
+#include <glm/gtc/type_ptr.hpp>
+#include <cstddef>
+#include <cstring>
+#include <cmath>
+#include <chrono>
+#include <new>
+#include <algorithm>
+#include <limits>
+#include <functional>
+#include <utility>
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 
-Model::Model(const char* path, const std::vector<glm::mat4>* modelMatrices, const bool gamma) : numModelMatrices(1),
-gammaCorrection(gamma) {
+static const unsigned int IMPORT_FLAGS = aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_CalcTangentSpace |
+	aiProcess_FlipUVs | aiProcess_LimitBoneWeights;
+
+Model::Model(const char* path, const std::vector<glm::mat4>* modelMatrices, const bool gamma, unsigned int residencyVal) :
+residency(residencyVal), gammaCorrection(gamma), numModelMatrices(1) {
 	loadModel(path);
 	if (modelMatrices) initInstancedModelMatrix(modelMatrices);//change this if you want to use this!
 }
 
+Model::Model(const bool gamma, unsigned int residencyVal) : residency(residencyVal), gammaCorrection(gamma), numModelMatrices(1) {
+}
+
 void Model::draw(const Shader& shader) const{
-	for (unsigned int i = 0; i < meshes.size(); ++i)
-		meshes[i].draw(shader, numModelMatrices); //draw given number( of this mesh using instanced model matrix
+	for (unsigned int i = 0; i < nodeMeshes.size(); ++i)
+		drawMesh(meshes[nodeMeshes[i]], shader, numModelMatrices); //draw given number( of this mesh using instanced model matrix
 }
 
-//loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector
-void Model::loadModel(const std::string& path) {
-	//read file via ASSIMP
-	Assimp::Importer importer;
-	const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals |
-		aiProcess_CalcTangentSpace| aiProcess_FlipUVs);
+//draws every mesh with its node's world transform from the file's hierarchy applied on top of the given model matrix.
+//Call getNodeHierarchy().updateWorldTransforms() after changing node transforms so the world matrices are current
+void Model::draw(const Shader& shader, const glm::mat4& model) const {
+	for (unsigned int i = 0; i < nodeMeshes.size(); ++i) {
+		shader.setUniformMatrix4("model", model * nodeHierarchy.getWorldTransform(meshNodes[i]));
+		drawMesh(meshes[nodeMeshes[i]], shader, numModelMatrices);
+	}
+}
 
-	//checks whether the scene or the root node of the scene is null. 
-	//It also checks if the returned data is incomplete, that is, if the AI_SCENE_FLAGS_INCOMPLETE flag is set.
-	if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
-		std::cout << "ERROR::ASSIMP::" << importer.GetErrorString() << std::endl;
-		return;
+SceneGraph& Model::getNodeHierarchy() {
+	return nodeHierarchy;
+}
+
+const ModelLoadStats& Model::getLoadStats() const {
+	return loadStats;
+}
+
+unsigned int Model::getResidency() const {
+	return residency;
+}
+
+ModelMemoryUsage Model::getMemoryUsage() const {
+	ModelMemoryUsage usage;
+	usage.meshBytes = meshes.capacity() * sizeof(MeshRange) + meshBounds.capacity() * sizeof(AABB) + meshSkins.capacity() * sizeof(int)
+		+ (nodeMeshes.capacity() + meshNodes.capacity()) * sizeof(unsigned int) + loadedTextures.capacity() * sizeof(Texture);
+	for (unsigned int i = 0; i < meshes.size(); ++i)
+		usage.meshBytes += meshes[i].textures.capacity() * sizeof(Texture);
+	usage.positionBytes = positions.capacity() * sizeof(glm::vec3) + positionIndices.capacity() * sizeof(unsigned int);
+	usage.skinningBytes = skinnedMeshes.capacity() * sizeof(SkinnedMeshData);
+	for (unsigned int i = 0; i < skinnedMeshes.size(); ++i) {
+		usage.skinningBytes += (skinnedMeshes[i].positions.capacity() + skinnedMeshes[i].normals.capacity()) * sizeof(glm::vec3)
+			+ skinnedMeshes[i].bones.capacity() * sizeof(VertexBoneData);
+	}
+	usage.animationBytes = skeleton.getNumJoints() * (sizeof(int) + 2 * sizeof(glm::vec3) + sizeof(glm::quat))
+		+ skeleton.getNumBones() * (sizeof(glm::mat4) + sizeof(unsigned int)) + animations.capacity() * sizeof(AnimationClip);
+	for (unsigned int i = 0; i < animations.size(); ++i) {
+		usage.animationBytes += animations[i].channels.capacity() * sizeof(AnimationChannel);
+		for (unsigned int j = 0; j < animations[i].channels.size(); ++j) {
+			const AnimationChannel& channel = animations[i].channels[j];
+			usage.animationBytes += (channel.positionTimes.capacity() + channel.rotationTimes.capacity() + channel.scaleTimes.capacity())
+				* sizeof(float) + (channel.positions.capacity() + channel.scales.capacity()) * sizeof(glm::vec3)
+				+ channel.rotations.capacity() * sizeof(glm::quat);
+		}
 	}
-	directory = path.substr(0, path.find_last_of('/'));
 
-	processNode(scene->mRootNode, scene);
+	usage.vertexBufferBytes = loadStats.numVertices * sizeof(Vertex);
+	usage.indexBufferBytes = loadStats.numIndices * sizeof(unsigned int);
+	usage.boneBufferBytes = boneBuffer ? loadStats.numVertices * sizeof(VertexBoneData) : 0;
+	usage.instanceBufferBytes = instanceBuffer ? numModelMatrices * sizeof(glm::mat4) : 0;
+	for (unsigned int i = 0; i < loadedTextures.size(); ++i) {
+		GLint width = 0, height = 0, internalFormat = 0;
+		glBindTexture(GL_TEXTURE_2D, loadedTextures[i].id);
+		glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
+		glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height);
+		glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_INTERNAL_FORMAT, &internalFormat);
+		//a full mipmap chain adds a third to the base level
+		usage.textureBytes += (std::size_t)width * height * RenderTargetPool::getBytesPerPixel(internalFormat) * 4 / 3;
+	}
+	glBindTexture(GL_TEXTURE_2D, 0);
+	return usage;
 }
 
-//process a node in recursive fashion. Processes each individual mesh 
-//locaed at then node and repeats this process on its children nodes (if anyP
-void Model::processNode(const aiNode* node, const aiScene* scene) {
-	//process all the node's meshes (if any)
-	for (unsigned int i = 0; i < node->mNumMeshes; ++i) {
-		aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-		meshes.push_back(processMesh(mesh, scene));
+bool Model::raycast(const Ray& ray, float maxDistance, float& hitDistance) const {
+	bool hit = false;
+	float closest = maxDistance;
+	for (unsigned int i = 0; i < nodeMeshes.size(); ++i) {
+		//into the node's space: the direction isn't renormalized, so distances along the ray stay those of the model
+		glm::mat4 toNode = glm::inverse(nodeHierarchy.getWorldTransform(meshNodes[i]));
+		Ray nodeRay(glm::vec3(toNode * glm::vec4(ray.origin, 1.0f)), glm::vec3(toNode * glm::vec4(ray.direction, 0.0f)));
+		float entryDistance;
+		if (!nodeRay.intersects(meshBounds[nodeMeshes[i]], closest, entryDistance))
+			continue;
+		if (positions.empty()) {
+			closest = entryDistance;
+			hit = true;
+			continue;
+		}
+
+		//Moller-Trumbore against every triangle of the mesh
+		const MeshRange& mesh = meshes[nodeMeshes[i]];
+		const glm::vec3* meshPositions = positions.data() + mesh.baseVertex;
+		for (unsigned int j = mesh.firstIndex; j + 2 < mesh.firstIndex + mesh.numIndices; j += 3) {
+			const glm::vec3& v0 = meshPositions[positionIndices[j]];
+			glm::vec3 edge1 = meshPositions[positionIndices[j + 1]] - v0;
+			glm::vec3 edge2 = meshPositions[positionIndices[j + 2]] - v0;
+			glm::vec3 p = glm::cross(nodeRay.direction, edge2);
+			float determinant = glm::dot(edge1, p);
+			if (std::abs(determinant) < 1e-12f)
+				continue;
+			float inverseDeterminant = 1.0f / determinant;
+			glm::vec3 t = nodeRay.origin - v0;
+			float u = glm::dot(t, p) * inverseDeterminant;
+			if (u < 0.0f || u > 1.0f)
+				continue;
+			glm::vec3 q = glm::cross(t, edge1);
+			float v = glm::dot(nodeRay.direction, q) * inverseDeterminant;
+			if (v < 0.0f || u + v > 1.0f)
+				continue;
+			float distance = glm::dot(edge2, q) * inverseDeterminant;
+			if (distance >= 0.0f && distance < closest) {
+				closest = distance;
+				hit = true;
+			}
+		}
 	}
+	if (hit)
+		hitDistance = closest;
+	return hit;
+}
 
-	//process node's children
-	for (unsigned int i = 0; i < node->mNumChildren; ++i) {
-		processNode(node->mChildren[i], scene);
+bool Model::hasSkeleton() const {
+	return skeleton.getNumBones() > 0;
+}
+
+const Skeleton& Model::getSkeleton() const {
+	return skeleton;
+}
+
+const std::vector<AnimationClip>& Model::getAnimations() const {
+	return animations;
+}
+
+const SkinnedMeshData* Model::getSkinnedMesh(unsigned int mesh) const {
+	return meshSkins[mesh] < 0 || skinnedMeshes.empty() ? NULL : &skinnedMeshes[meshSkins[mesh]];
+}
+
+void Model::drawSkinned(const Shader& shader, unsigned int numInstances) const {
+	shader.setUniformInt("numBones", skeleton.getNumBones());
+	for (unsigned int i = 0; i < nodeMeshes.size(); ++i) {
+		if (meshSkins[nodeMeshes[i]] >= 0)
+			drawMesh(meshes[nodeMeshes[i]], shader, numInstances);
 	}
 }
 
-Mesh Model::processMesh(aiMesh* mesh, const aiScene* scene) {
-	std::vector<Vertex> vertices;
-	std::vector<unsigned int> indices;
-	std::vector<Texture> textures;
+AABB Model::computeBounds() const {
+	AABB bounds;
+	for (unsigned int i = 0; i < nodeMeshes.size(); ++i)
+		bounds.expand(meshBounds[nodeMeshes[i]].transformed(nodeHierarchy.getWorldTransform(meshNodes[i])));
+	return bounds;
+}
 
-	//process vertex poistions, normals and texture coordinates
-	for (unsigned int i = 0; i < mesh->mNumVertices; ++i) {
-		glm::vec3 position(mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z);
-		glm::vec3 normal(0.0f);
-		glm::vec2 texCoords(0.0f);
-		glm::vec3 tangent(0.0f);
-		glm::vec3 bitangent(0.0f);
-
-		//checks if the mesh contains normals
-		if (mesh->HasNormals()) {
-			normal.x = mesh->mNormals[i].x;
-			normal.y = mesh->mNormals[i].y;
-			normal.z = mesh->mNormals[i].z;
+//binds the mesh's textures to the material's samplers and draws the given number of instances of its index range
+void Model::drawMesh(const MeshRange& mesh, const Shader& shader, unsigned int numInstances) const {
+	for (unsigned int texUnit = 0; texUnit < mesh.textures.size(); ++texUnit) {
+		glActiveTexture(GL_TEXTURE0 + texUnit); //activates the right texture unit
+		glBindTexture(GL_TEXTURE_2D, mesh.textures[texUnit].id);
+
+		const char* samplerName = "material.";
+		switch (mesh.textures[texUnit].type) {
+		case aiTextureType_DIFFUSE:
+			samplerName = "material.diffuseMap";
+			break;
+		case aiTextureType_SPECULAR:
+			samplerName = "material.specularMap";
+			break;
+		case aiTextureType_HEIGHT:
+			samplerName = "material.heightMap";
+			break;
+		default:
+			break;
 		}
 
-		//checks if the mesh contains texture coordinates
-		if (mesh->mTextureCoords[0]) {
-			// a vertex can contain up to 8 different texture coordinates. We thus make the assumption that we won't 
-			// use models where a vertex can have multiple texture coordinates so we always take the first set (0).
-			texCoords.x = mesh->mTextureCoords[0][i].x;
-			texCoords.y = mesh->mTextureCoords[0][i].y;
+		shader.setUniformInt(samplerName, texUnit);
+	}
+	glActiveTexture(GL_TEXTURE0); //reset back to default unit
+
+	glBindVertexArray(VAO.get());
+	glDrawElementsInstancedBaseVertex(GL_TRIANGLES, mesh.numIndices, GL_UNSIGNED_INT, (void*)(mesh.firstIndex * sizeof(unsigned int)),
+		numInstances, mesh.baseVertex);
+	glBindVertexArray(0); //unbinds vao
+}
 
+//the number of indices of a mesh. After aiProcess_Triangulate a mesh of triangles has three per face, but point and
+//line meshes keep their faces of one and two indices
+static unsigned int countIndices(const aiMesh* mesh) {
+	if (mesh->mPrimitiveTypes == aiPrimitiveType_TRIANGLE)
+		return 3 * mesh->mNumFaces;
+	unsigned int count = 0;
+	for (unsigned int i = 0; i < mesh->mNumFaces; ++i)
+		count += mesh->mFaces[i].mNumIndices;
+	return count;
+}
+
+//process vertex poistions, normals and texture coordinates
+static Vertex readVertex(const aiMesh* mesh, unsigned int i) {
+	glm::vec3 position(mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z);
+	glm::vec3 normal(0.0f);
+	glm::vec2 texCoords(0.0f);
+	glm::vec3 tangent(0.0f);
+	glm::vec3 bitangent(0.0f);
+
+	//checks if the mesh contains normals
+	if (mesh->HasNormals()) {
+		normal.x = mesh->mNormals[i].x;
+		normal.y = mesh->mNormals[i].y;
+		normal.z = mesh->mNormals[i].z;
+	}
+
+	//checks if the mesh contains texture coordinates
+	if (mesh->mTextureCoords[0]) {
+		// a vertex can contain up to 8 different texture coordinates. We thus make the assumption that we won't 
+		// use models where a vertex can have multiple texture coordinates so we always take the first set (0).
+		texCoords.x = mesh->mTextureCoords[0][i].x;
+		texCoords.y = mesh->mTextureCoords[0][i].y;
+
+		if (mesh->HasTangentsAndBitangents()) {
 			//tangent
 			tangent.x = mesh->mTangents[i].x;
 			tangent.y = mesh->mTangents[i].y;
@@ -83,61 +251,515 @@ Mesh Model::processMesh(aiMesh* mesh, const aiScene* scene) {
 			bitangent.y = mesh->mBitangents[i].y;
 			bitangent.z = mesh->mBitangents[i].z;
 		}
-
-		Vertex vertex(position, normal, texCoords, tangent, bitangent);
-		vertices.push_back(vertex);
 	}
+	return Vertex(position, normal, texCoords, tangent, bitangent);
+}
+
+//writes the vertices and indices of a mesh to the given arrays in order, every element once and nothing read back, which
+//suits write-combined mapped GPU memory. The indices stay relative to the mesh's first vertex
+static void convertMesh(const aiMesh* mesh, Vertex* vertices, unsigned int* indices) {
+	for (unsigned int i = 0; i < mesh->mNumVertices; ++i)
+		new (&vertices[i]) Vertex(readVertex(mesh, i));
 
-	//process indices
 	for (unsigned int i = 0; i < mesh->mNumFaces; ++i) {
-		aiFace face = mesh->mFaces[i];
+		const aiFace& face = mesh->mFaces[i]; //by reference: copying an aiFace allocates a copy of its indices
 		for (unsigned int j = 0; j < face.mNumIndices; ++j)
-			indices.push_back(face.mIndices[j]);
+			*indices++ = face.mIndices[j];
+	}
+}
+
+//loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
+//glTF and OBJ files are read natively when they can be
+void Model::loadModel(const std::string& path) {
+	GLTFFile gltf; //embedded images are read from its mapping, so it's kept until the textures are loaded
+	OBJFile obj;
+	bool nativeGLTF = isGLTFFile(path) && importGLTF(gltf, path);
+	bool nativeOBJ = !nativeGLTF && isOBJFile(path) && importOBJ(obj, path);
+	Assimp::Importer importer;
+	const aiScene* scene = nativeGLTF || nativeOBJ ? NULL : importScene(importer, path);
+	Vertex* vertices = NULL;
+	unsigned int* indices = NULL;
+	if ((!nativeGLTF && !nativeOBJ && !scene) || !mapBuffers(vertices, indices))
+		return;
+	std::vector<VertexBoneData> bones;
+	if (nativeGLTF)
+		convertGLTF(gltf, vertices, indices);
+	else if (nativeOBJ)
+		convertOBJ(obj, vertices, indices);
+	else
+		convertScene(scene, vertices, indices, bones);
+	obj.close();
+	finishBuffers(bones);
+	createVertexArray();
+
+	auto start = std::chrono::high_resolution_clock::now();
+	for (unsigned int i = 0; i < loadedTextures.size(); ++i) {
+		const GLTFImage* image = nativeGLTF ? findGLTFEmbeddedImage(gltf, loadedTextures[i].localPath) : NULL;
+		if (image)
+			setTexture(i, uploadTexture(decodeTexture(image->data, image->size), gammaCorrection));
+		else
+			setTexture(i, textureFromFile(loadedTextures[i].localPath.c_str(), directory, gammaCorrection));
+	}
+	loadStats.textureTime = elapsedMilliseconds(start);
+	loadStats.peakResidentBytes = getPeakResidentBytes();
+}
+
+//reads the file, lays the meshes out one after the other in the shared buffers and records the textures of their
+//materials, without loading them
+const aiScene* Model::importScene(Assimp::Importer& importer, const std::string& path) {
+	//read file via ASSIMP
+	auto start = std::chrono::high_resolution_clock::now();
+	const aiScene* scene = importer.ReadFile(path, IMPORT_FLAGS);
+
+	//checks whether the scene or the root node of the scene is null. 
+	//It also checks if the returned data is incomplete, that is, if the AI_SCENE_FLAGS_INCOMPLETE flag is set.
+	if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
+		std::cout << "ERROR::ASSIMP::" << importer.GetErrorString() << std::endl;
+		return NULL;
+	}
+	directory = path.substr(0, path.find_last_of('/'));
+	loadStats.importTime = elapsedMilliseconds(start);
+
+	//every mesh of the file is converted once, laid out one after the other in the shared buffers. Nodes referencing the
+	//same mesh draw the same range
+	meshes.resize(scene->mNumMeshes);
+	for (unsigned int i = 0; i < scene->mNumMeshes; ++i) {
+		const aiMesh* mesh = scene->mMeshes[i];
+		meshes[i].baseVertex = loadStats.numVertices;
+		meshes[i].firstIndex = loadStats.numIndices;
+		meshes[i].numIndices = countIndices(mesh);
+		loadStats.numVertices += mesh->mNumVertices;
+		loadStats.numIndices += meshes[i].numIndices;
+
+		//process material
+		if (mesh->mMaterialIndex >= 0) {
+			const aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
+
+			loadMaterialTextures(material, aiTextureType_DIFFUSE, meshes[i].textures);
+			loadMaterialTextures(material, aiTextureType_SPECULAR, meshes[i].textures);
+
+			//normal maps 
+			//The wavefront object format (.obj) exports normal maps slightly different from Assimp's conventions
+			//as aiTextureType_NORMAL doesn't load normal maps, while aiTextureType_HEIGHT does. So, we use this for now
+			loadMaterialTextures(material, aiTextureType_HEIGHT, meshes[i].textures);
+
+			//height maps
+			loadMaterialTextures(material, aiTextureType_AMBIENT, meshes[i].textures);
+		}
 	}
-	//process material
-	if (mesh->mMaterialIndex >= 0) {
-		aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
+	return scene;
+}
+
+//opens the file and lays its meshes out like importScene: each primitive of a glTF mesh becomes a mesh of the model,
+//as assimp splits them, with its material's base color texture as the diffuse map and its normal texture in the
+//height slot, where the shaders take normal maps from
+bool Model::importGLTF(GLTFFile& file, const std::string& path) {
+	auto start = std::chrono::high_resolution_clock::now();
+	if (!file.open(path) || file.hasSkinsOrAnimations)
+		return false;
+	directory = path.substr(0, path.find_last_of('/'));
+	loadStats.importTime = elapsedMilliseconds(start);
 
-		std::vector<Texture> diffuseMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE);
-		textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
+	for (unsigned int i = 0; i < file.meshes.size(); ++i) {
+		for (unsigned int j = 0; j < file.meshes[i].primitives.size(); ++j) {
+			const GLTFPrimitive& primitive = file.meshes[i].primitives[j];
+			MeshRange mesh;
+			mesh.baseVertex = loadStats.numVertices;
+			mesh.firstIndex = loadStats.numIndices;
+			mesh.numIndices = countGLTFIndices(file, primitive);
+			loadStats.numVertices += countGLTFVertices(file, primitive);
+			loadStats.numIndices += mesh.numIndices;
+			if (primitive.material >= 0) {
+				const GLTFMaterial& material = file.materials[primitive.material];
+				if (material.baseColorImage >= 0)
+					addTexture(aiTextureType_DIFFUSE, getGLTFImagePath(file, material.baseColorImage), mesh.textures);
+				if (material.normalImage >= 0)
+					addTexture(aiTextureType_HEIGHT, getGLTFImagePath(file, material.normalImage), mesh.textures);
+			}
+			meshes.push_back(mesh);
+		}
+	}
+	return true;
+}
+
+//parses the file and lays its meshes out like importScene, with the textures of each mesh's material in the same order
+bool Model::importOBJ(OBJFile& file, const std::string& path) {
+	auto start = std::chrono::high_resolution_clock::now();
+	if (!file.open(path))
+		return false;
+	directory = path.substr(0, path.find_last_of('/'));
+	loadStats.importTime = elapsedMilliseconds(start);
 
-		std::vector<Texture> specularMaps = loadMaterialTextures(material, aiTextureType_SPECULAR);
-		textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
+	const aiTextureType textureTypes[] = { aiTextureType_DIFFUSE, aiTextureType_SPECULAR, aiTextureType_HEIGHT, aiTextureType_AMBIENT };
+	meshes.resize(file.meshes.size());
+	for (unsigned int i = 0; i < file.meshes.size(); ++i) {
+		meshes[i].baseVertex = loadStats.numVertices;
+		meshes[i].firstIndex = loadStats.numIndices;
+		meshes[i].numIndices = file.meshes[i].numIndices;
+		loadStats.numVertices += file.meshes[i].numCorners;
+		loadStats.numIndices += meshes[i].numIndices;
+		if (file.meshes[i].material < 0)
+			continue;
+		const OBJMaterial& material = file.materials[file.meshes[i].material];
+		for (unsigned int j = 0; j < sizeof(textureTypes) / sizeof(textureTypes[0]); ++j) {
+			for (unsigned int k = 0; k < material.textures.size(); ++k) {
+				if (material.textures[k].first == textureTypes[j])
+					addTexture(textureTypes[j], material.textures[k].second, meshes[i].textures);
+			}
+		}
+	}
+	return true;
+}
 
-		//normal maps 
-		//The wavefront object format (.obj) exports normal maps slightly different from Assimp's conventions
-		//as aiTextureType_NORMAL doesn't load normal maps, while aiTextureType_HEIGHT does. So, we use this for now
-		std::vector<Texture> normalMaps = loadMaterialTextures(material, aiTextureType_HEIGHT);
-		textures.insert(textures.end(), normalMaps.begin(), normalMaps.end());
+//both buffers are allocated at their final size and mapped, so the meshes are written straight from assimp's arrays
+//into memory the driver can use without another copy. The pointers stay valid until finishBuffers, from any thread.
+//Without a vertex array bound the element array binding can't be used, so both go through GL_COPY_WRITE_BUFFER
+bool Model::mapBuffers(Vertex*& vertices, unsigned int*& indices) {
+	auto start = std::chrono::high_resolution_clock::now();
+	VBO = GLBuffer::create();
+	EBO = GLBuffer::create();
+	vertices = NULL;
+	indices = NULL;
+	glBindBuffer(GL_COPY_WRITE_BUFFER, VBO.get());
+	glBufferData(GL_COPY_WRITE_BUFFER, loadStats.numVertices * sizeof(Vertex), NULL, GL_STATIC_DRAW);
+	if (loadStats.numVertices > 0)
+		vertices = static_cast<Vertex*>(glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, loadStats.numVertices * sizeof(Vertex),
+			GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
+	glBindBuffer(GL_COPY_WRITE_BUFFER, EBO.get());
+	glBufferData(GL_COPY_WRITE_BUFFER, loadStats.numIndices * sizeof(unsigned int), NULL, GL_STATIC_DRAW);
+	if (loadStats.numIndices > 0)
+		indices = static_cast<unsigned int*>(glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, loadStats.numIndices * sizeof(unsigned int),
+			GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
 
-		//height maps
-		std::vector<Texture> heightMaps = loadMaterialTextures(material, aiTextureType_AMBIENT);
-		textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
+	if ((loadStats.numVertices > 0 && !vertices) || (loadStats.numIndices > 0 && !indices)) {
+		std::cout << "ERROR::MODEL:: Cannot map the vertex and index buffers of the model in " << directory << std::endl;
+		if (indices)
+			glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, VBO.get());
+		if (vertices)
+			glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+		meshes.clear();
+		return false;
 	}
-	return Mesh(vertices, indices, textures);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	loadStats.conversionTime += elapsedMilliseconds(start);
+	return true;
 }
 
+//writes every mesh into the mapped buffers and builds everything the model keeps on the CPU: bounds, the residency
+//data, the bone influences for finishBuffers to upload, the node hierarchy and the skeleton
+void Model::convertScene(const aiScene* scene, Vertex* vertices, unsigned int* indices, std::vector<VertexBoneData>& bones) {
+	auto start = std::chrono::high_resolution_clock::now();
+	//the mapped memory is write-only, so the copy kept on the CPU is read from assimp's arrays as well
+	if (residency & RESIDENCY_POSITIONS) {
+		positions.resize(loadStats.numVertices);
+		positionIndices.resize(loadStats.numIndices);
+	}
+	for (unsigned int i = 0; i < meshes.size(); ++i) {
+		const aiMesh* mesh = scene->mMeshes[i];
+		convertMesh(mesh, vertices + meshes[i].baseVertex, indices + meshes[i].firstIndex);
+
+		AABB bounds;
+		for (unsigned int j = 0; j < mesh->mNumVertices; ++j)
+			bounds.expand(glm::vec3(mesh->mVertices[j].x, mesh->mVertices[j].y, mesh->mVertices[j].z));
+		meshBounds.push_back(bounds);
+
+		if (residency & RESIDENCY_POSITIONS) {
+			for (unsigned int j = 0; j < mesh->mNumVertices; ++j)
+				positions[meshes[i].baseVertex + j] = glm::vec3(mesh->mVertices[j].x, mesh->mVertices[j].y, mesh->mVertices[j].z);
+			unsigned int* meshIndices = positionIndices.data() + meshes[i].firstIndex;
+			for (unsigned int j = 0; j < mesh->mNumFaces; ++j) {
+				const aiFace& face = mesh->mFaces[j];
+				for (unsigned int k = 0; k < face.mNumIndices; ++k)
+					*meshIndices++ = face.mIndices[k];
+			}
+		}
+	}
+
+	//bone influences go in a second vertex buffer parallel to the first, with no influences for the vertices of meshes
+	//without bones. The skinning data stays on the CPU only for RESIDENCY_SKINNING
+	meshSkins.assign(meshes.size(), -1);
+	for (unsigned int i = 0; i < meshes.size(); ++i) {
+		if (!scene->mMeshes[i]->HasBones())
+			continue;
+		if (bones.empty())
+			bones.resize(loadStats.numVertices);
+		skinnedMeshes.push_back(SkinnedMeshData());
+		loadBones(scene->mMeshes[i], skinnedMeshes.back());
+		std::copy(skinnedMeshes.back().bones.begin(), skinnedMeshes.back().bones.end(), bones.begin() + meshes[i].baseVertex);
+		meshSkins[i] = skinnedMeshes.size() - 1;
+	}
+	if (!(residency & RESIDENCY_SKINNING))
+		std::vector<SkinnedMeshData>().swap(skinnedMeshes);
+	loadStats.conversionTime += elapsedMilliseconds(start);
+
+	processNode(scene->mRootNode, SceneGraph::NO_PARENT);
+	nodeHierarchy.updateWorldTransforms();
+	if (skeleton.getNumBones() > 0 || scene->mNumAnimations > 0)
+		loadSkeleton(scene);
+}
+
+//writes every primitive straight from the file's mapped buffers into the mapped GPU buffers and builds what the model
+//keeps on the CPU, like convertScene. The file's scene roots are put under one root node, as assimp does
+void Model::convertGLTF(const GLTFFile& file, Vertex* vertices, unsigned int* indices) {
+	auto start = std::chrono::high_resolution_clock::now();
+	if (residency & RESIDENCY_POSITIONS) {
+		positions.resize(loadStats.numVertices);
+		positionIndices.resize(loadStats.numIndices);
+	}
+	std::vector<unsigned int> firstMeshes; //mesh of the model of each glTF mesh's first primitive
+	unsigned int meshIndex = 0;
+	for (unsigned int i = 0; i < file.meshes.size(); ++i) {
+		firstMeshes.push_back(meshIndex);
+		for (unsigned int j = 0; j < file.meshes[i].primitives.size(); ++j, ++meshIndex) {
+			const GLTFPrimitive& primitive = file.meshes[i].primitives[j];
+			const MeshRange& mesh = meshes[meshIndex];
+			meshBounds.push_back(convertGLTFPrimitive(file, primitive, vertices + mesh.baseVertex, indices + mesh.firstIndex));
+
+			//the mapped memory is write-only, so the copy kept on the CPU is read from the file as well
+			if (residency & RESIDENCY_POSITIONS) {
+				GLTFAccessorReader reader(file, primitive.position);
+				for (unsigned int k = 0; k < reader.size(); ++k)
+					positions[mesh.baseVertex + k] = glm::vec3(reader[k]);
+				std::vector<unsigned int> meshIndices = readGLTFIndices(file, primitive);
+				std::copy(meshIndices.begin(), meshIndices.end(), positionIndices.begin() + mesh.firstIndex);
+			}
+		}
+	}
+	meshSkins.assign(meshes.size(), -1);
+	loadStats.conversionTime += elapsedMilliseconds(start);
+
+	unsigned int root = nodeHierarchy.addNode(SceneGraph::NO_PARENT, glm::mat4(1.0f), "ROOT");
+	for (unsigned int i = 0; i < file.sceneNodes.size(); ++i)
+		addGLTFNode(file, file.sceneNodes[i], root, firstMeshes);
+	nodeHierarchy.updateWorldTransforms();
+}
+
+//writes every mesh from the parsed file into the mapped buffers and builds what the model keeps on the CPU, like
+//convertScene. Each object or group is a node under the root, as assimp makes them
+void Model::convertOBJ(const OBJFile& file, Vertex* vertices, unsigned int* indices) {
+	auto start = std::chrono::high_resolution_clock::now();
+	if (residency & RESIDENCY_POSITIONS) {
+		positions.resize(loadStats.numVertices);
+		positionIndices.resize(loadStats.numIndices);
+	}
+	for (unsigned int i = 0; i < meshes.size(); ++i) {
+		const OBJMesh& mesh = file.meshes[i];
+		meshBounds.push_back(convertOBJMesh(file, mesh, vertices + meshes[i].baseVertex, indices + meshes[i].firstIndex));
+
+		//the mapped memory is write-only, so the copy kept on the CPU is read from the file as well
+		if (residency & RESIDENCY_POSITIONS) {
+			for (std::size_t j = 0; j < mesh.numCorners; ++j)
+				positions[meshes[i].baseVertex + j] = file.positions[file.corners[mesh.firstCorner + j].position];
+			std::vector<unsigned int> meshIndices = readOBJIndices(file, mesh);
+			std::copy(meshIndices.begin(), meshIndices.end(), positionIndices.begin() + meshes[i].firstIndex);
+		}
+	}
+	meshSkins.assign(meshes.size(), -1);
+	loadStats.conversionTime += elapsedMilliseconds(start);
+
+	unsigned int root = nodeHierarchy.addNode(SceneGraph::NO_PARENT, glm::mat4(1.0f), "ROOT");
+	unsigned int node = root;
+	for (unsigned int i = 0; i < meshes.size(); ++i) {
+		if (node == root || file.meshes[i].name != file.meshes[i - 1].name)
+			node = nodeHierarchy.addNode(root, glm::mat4(1.0f), file.meshes[i].name);
+		nodeMeshes.push_back(i);
+		meshNodes.push_back(node);
+	}
+	nodeHierarchy.updateWorldTransforms();
+}
+
+//unmaps the buffers convertScene wrote and uploads the bone influences
+void Model::finishBuffers(const std::vector<VertexBoneData>& bones) {
+	auto start = std::chrono::high_resolution_clock::now();
+	//the contents of a mapped buffer can be lost (e.g. on a display mode change), which unmapping reports
+	glBindBuffer(GL_COPY_WRITE_BUFFER, VBO.get());
+	if (loadStats.numVertices > 0 && glUnmapBuffer(GL_COPY_WRITE_BUFFER) == GL_FALSE)
+		std::cout << "ERROR::MODEL:: Vertex buffer of the model in " << directory << " was corrupted while mapped" << std::endl;
+	glBindBuffer(GL_COPY_WRITE_BUFFER, EBO.get());
+	if (loadStats.numIndices > 0 && glUnmapBuffer(GL_COPY_WRITE_BUFFER) == GL_FALSE)
+		std::cout << "ERROR::MODEL:: Index buffer of the model in " << directory << " was corrupted while mapped" << std::endl;
+
+	if (!bones.empty()) {
+		boneBuffer = GLBuffer::create();
+		glBindBuffer(GL_COPY_WRITE_BUFFER, boneBuffer.get());
+		glBufferData(GL_COPY_WRITE_BUFFER, bones.size() * sizeof(VertexBoneData), bones.data(), GL_STATIC_DRAW);
+	}
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	loadStats.conversionTime += elapsedMilliseconds(start);
+}
+
+//links the vertex attributes of the shared buffers and the bone influences, if any, to one vertex array
+void Model::createVertexArray() {
+	if (!VBO)
+		return;
+	VAO = GLVertexArray::create();
+	glBindVertexArray(VAO.get());
+	glBindBuffer(GL_ARRAY_BUFFER, VBO.get());
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO.get());
+
+	//link position attribute in the vertex data to the shader
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
+
+	//link normal attribute in the vertex data to the shader
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, normal));
+
+	//link text coords attribute in the vertex data to the shader
+	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, texCoords));
+	glEnableVertexAttribArray(2);
+
+	//link tangent attribute in the vertex data to the shader
+	glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, tangent));
+	glEnableVertexAttribArray(3);
+
+	//link bitangent attribute in the vertex data to the shader
+	glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, bitangent));
+	glEnableVertexAttribArray(4);
+
+	//bone ids at attribute 7, weights at attribute 8
+	if (boneBuffer) {
+		glBindBuffer(GL_ARRAY_BUFFER, boneBuffer.get());
+		glEnableVertexAttribArray(7);
+		glVertexAttribIPointer(7, VertexBoneData::MAX_INFLUENCES, GL_INT, sizeof(VertexBoneData), (void*)offsetof(VertexBoneData, boneIds));
+		glEnableVertexAttribArray(8);
+		glVertexAttribPointer(8, VertexBoneData::MAX_INFLUENCES, GL_FLOAT, GL_FALSE, sizeof(VertexBoneData), (void*)offsetof(VertexBoneData, weights));
+	}
+	glBindVertexArray(0);
+}
 
-std::vector<Texture> Model::loadMaterialTextures(aiMaterial* material, aiTextureType type) {
-	std::vector<Texture> textures;
+void Model::setTexture(unsigned int texture, unsigned int id) {
+	Texture& loadedTexture = loadedTextures[texture];
+	loadedTexture.id = id;
+	textureObjects.push_back(GLTexture(id));
+	for (unsigned int i = 0; i < meshes.size(); ++i) {
+		for (unsigned int j = 0; j < meshes[i].textures.size(); ++j) {
+			if (meshes[i].textures[j].localPath == loadedTexture.localPath)
+				meshes[i].textures[j].id = id;
+		}
+	}
+}
+
+//process a node in recursive fashion. Records each individual mesh 
+//locaed at then node and repeats this process on its children nodes (if anyP
+//The node's transform is kept in the node hierarchy so that meshes are drawn where the file places them
+void Model::processNode(const aiNode* node, int parentNode) {
+	//aiMatrix4x4 is row-major while glm is column-major
+	glm::mat4 localTransform = glm::transpose(glm::make_mat4(&node->mTransformation.a1));
+	unsigned int nodeIndex = nodeHierarchy.addNode(parentNode, localTransform, node->mName.C_Str());
+
+	//the node's meshes (if any) were converted by loadModel
+	for (unsigned int i = 0; i < node->mNumMeshes; ++i) {
+		nodeMeshes.push_back(node->mMeshes[i]);
+		meshNodes.push_back(nodeIndex);
+	}
+
+	//process node's children
+	for (unsigned int i = 0; i < node->mNumChildren; ++i) {
+		processNode(node->mChildren[i], nodeIndex);
+	}
+}
+
+//processNode for a node of a glTF file. The file was checked to be a tree below its scene roots when it was opened
+void Model::addGLTFNode(const GLTFFile& file, unsigned int node, int parentNode, const std::vector<unsigned int>& firstMeshes) {
+	const GLTFNode& fileNode = file.nodes[node];
+	unsigned int nodeIndex = nodeHierarchy.addNode(parentNode, fileNode.localTransform, fileNode.name);
+	if (fileNode.mesh >= 0) {
+		for (unsigned int i = 0; i < file.meshes[fileNode.mesh].primitives.size(); ++i) {
+			nodeMeshes.push_back(firstMeshes[fileNode.mesh] + i);
+			meshNodes.push_back(nodeIndex);
+		}
+	}
+	for (unsigned int i = 0; i < fileNode.children.size(); ++i)
+		addGLTFNode(file, fileNode.children[i], nodeIndex, firstMeshes);
+}
+
+//appends the material's textures of the given type to textures, recording the ones no other mesh uses in loadedTextures.
+//Their texture objects are created later by setTexture
+void Model::loadMaterialTextures(const aiMaterial* material, aiTextureType type, std::vector<Texture>& textures) {
 	for (unsigned int i = 0; i < material->GetTextureCount(type);  ++i) {
 		aiString localPath;
 		material->GetTexture(type, i, &localPath);
-		bool skip = false;
-		for (unsigned int j = 0; j < loadedTextures.size(); ++j) {
-			if (std::strcmp(loadedTextures[j].localPath.c_str(), localPath.C_Str()) == 0) {
-				textures.push_back(loadedTextures[j]);
-				skip = true;
-				break;
-			}
+		addTexture(type, localPath.C_Str(), textures);
+	}
+}
+
+void Model::addTexture(aiTextureType type, const std::string& localPath, std::vector<Texture>& textures) {
+	for (unsigned int i = 0; i < loadedTextures.size(); ++i) {
+		if (loadedTextures[i].localPath == localPath) {
+			textures.push_back(loadedTextures[i]);
+			return;
 		}
-		if (!skip) {
-			Texture texture(textureFromFile(localPath.C_Str(), directory, gammaCorrection), type, localPath.C_Str());
-			textures.push_back(texture);
-			loadedTextures.push_back(texture);
+	}
+	Texture texture(0, type, localPath);
+	textures.push_back(texture);
+	loadedTextures.push_back(texture);
+}
+
+//reads the bone influences of every vertex and keeps the bind pose with the influences for CPU skinning
+void Model::loadBones(const aiMesh* mesh, SkinnedMeshData& skin) {
+	skin.bones.resize(mesh->mNumVertices);
+	for (unsigned int i = 0; i < mesh->mNumBones; ++i) {
+		const aiBone* bone = mesh->mBones[i];
+		//aiMatrix4x4 is row-major while glm is column-major
+		unsigned int boneIndex = skeleton.addBone(bone->mName.C_Str(), glm::transpose(glm::make_mat4(&bone->mOffsetMatrix.a1)));
+		for (unsigned int j = 0; j < bone->mNumWeights; ++j)
+			skin.bones[bone->mWeights[j].mVertexId].addInfluence(boneIndex, bone->mWeights[j].mWeight);
+	}
+
+	skin.positions.reserve(mesh->mNumVertices);
+	skin.normals.reserve(mesh->mNumVertices);
+	for (unsigned int i = 0; i < mesh->mNumVertices; ++i) {
+		skin.bones[i].normalize();
+		skin.positions.push_back(glm::vec3(mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z));
+		skin.normals.push_back(mesh->HasNormals() ? glm::vec3(mesh->mNormals[i].x, mesh->mNormals[i].y, mesh->mNormals[i].z) : glm::vec3(0.0f));
+	}
+}
+
+//the joints are the nodes of the hierarchy, so animation channels and bones find their joint by node name. Channel
+//times are converted from ticks to seconds
+void Model::loadSkeleton(const aiScene* scene) {
+	for (unsigned int i = 0; i < nodeHierarchy.size(); ++i)
+		skeleton.addJoint(nodeHierarchy.getParent(i), nodeHierarchy.getLocalTransform(i), nodeHierarchy.getName(i));
+	skeleton.resolveBones();
+
+	for (unsigned int i = 0; i < scene->mNumAnimations; ++i) {
+		const aiAnimation* animation = scene->mAnimations[i];
+		float ticksPerSecond = animation->mTicksPerSecond > 0.0 ? (float)animation->mTicksPerSecond : 25.0f;
+		AnimationClip clip;
+		clip.name = animation->mName.C_Str();
+		clip.duration = (float)animation->mDuration / ticksPerSecond;
+
+		for (unsigned int j = 0; j < animation->mNumChannels; ++j) {
+			const aiNodeAnim* nodeAnimation = animation->mChannels[j];
+			int joint = skeleton.findJoint(nodeAnimation->mNodeName.C_Str());
+			if (joint < 0) {
+				std::cout << "ERROR::ASSIMP:: No node for animation channel " << nodeAnimation->mNodeName.C_Str() << std::endl;
+				continue;
+			}
+			AnimationChannel channel;
+			channel.joint = joint;
+			for (unsigned int k = 0; k < nodeAnimation->mNumPositionKeys; ++k) {
+				const aiVectorKey& key = nodeAnimation->mPositionKeys[k];
+				channel.positionTimes.push_back((float)key.mTime / ticksPerSecond);
+				channel.positions.push_back(glm::vec3(key.mValue.x, key.mValue.y, key.mValue.z));
+			}
+			for (unsigned int k = 0; k < nodeAnimation->mNumRotationKeys; ++k) {
+				const aiQuatKey& key = nodeAnimation->mRotationKeys[k];
+				channel.rotationTimes.push_back((float)key.mTime / ticksPerSecond);
+				channel.rotations.push_back(glm::quat(key.mValue.w, key.mValue.x, key.mValue.y, key.mValue.z));
+			}
+			for (unsigned int k = 0; k < nodeAnimation->mNumScalingKeys; ++k) {
+				const aiVectorKey& key = nodeAnimation->mScalingKeys[k];
+				channel.scaleTimes.push_back((float)key.mTime / ticksPerSecond);
+				channel.scales.push_back(glm::vec3(key.mValue.x, key.mValue.y, key.mValue.z));
+			}
+			clip.channels.push_back(channel);
 		}
+		animations.push_back(clip);
 	}
-	return textures;
 }
 
 
@@ -147,24 +769,61 @@ unsigned textureFromFile(const char* localPath, const std::string &directory, bo
 }
 
 
-//This function generates a texture object, sets its texture parameters and loads the texture image for the object.
+TextureImage::~TextureImage() {
+	stbi_image_free(data);
+}
+
+TextureImage::TextureImage(TextureImage&& other) noexcept : data(other.data), width(other.width), height(other.height),
+numChannels(other.numChannels) {
+	other.data = NULL;
+}
+
+TextureImage& TextureImage::operator=(TextureImage&& other) noexcept {
+	if (this != &other) {
+		stbi_image_free(data);
+		data = other.data;
+		width = other.width;
+		height = other.height;
+		numChannels = other.numChannels;
+		other.data = NULL;
+	}
+	return *this;
+}
+
+//loads the image from file, flipped so that its first row is the bottom one as GL expects. The flip is set for the
+//calling thread only, so images can be decoded on several threads at once
+TextureImage decodeTexture(const char* textureFile) {
+	TextureImage image;
+	stbi_set_flip_vertically_on_load_thread(true);
+	image.data = stbi_load(textureFile, &image.width, &image.height, &image.numChannels, 0);
+	if (!image.data)
+		std::cout << "ERROR: Cannot load texture file: " << textureFile << std::endl;
+	return image;
+}
+
+TextureImage decodeTexture(const unsigned char* data, std::size_t size) {
+	TextureImage image;
+	stbi_set_flip_vertically_on_load_thread(true);
+	if (data && size <= (std::size_t)std::numeric_limits<int>::max())
+		image.data = stbi_load_from_memory(data, (int)size, &image.width, &image.height, &image.numChannels, 0);
+	if (!image.data)
+		std::cout << "ERROR: Cannot load embedded texture" << std::endl;
+	return image;
+}
+
+//This function generates a texture object, sets its texture parameters and uploads the decoded image to the object.
 //It returns the initalized texture object.
 //Note: it expects the image to be RGB or RGBA format
-unsigned int textureFromFile(const char* textureFile, bool gammaCorrection) {
+unsigned int uploadTexture(const TextureImage& image, bool gammaCorrection) {
 	unsigned int textureID;
 	glGenTextures(1, &textureID);
 	glBindTexture(GL_TEXTURE_2D, textureID); //binds texture to target, GL_TEXTURE_2D
 
-	//load image from file
-	int width, height, nrChannels;
-	stbi_set_flip_vertically_on_load(true);
-	unsigned char* data = stbi_load(textureFile, &width, &height, &nrChannels, 0);
-
 	//create texture image for the bound texture object and generate mipmaps from the now attached texture image
-	if (data) {
+	if (image.data) {
 		GLint internalFormat = GL_RGB;
 		GLenum dataFormat = GL_RGB;
-		switch (nrChannels) {
+		switch (image.numChannels) {
 		case 1:
 			internalFormat = dataFormat = GL_RED;
 			break;
@@ -178,8 +837,7 @@ unsigned int textureFromFile(const char* textureFile, bool gammaCorrection) {
 			break;
 		}
 
-		glBindTexture(GL_TEXTURE_2D, textureID); //binds texture to target, GL_TEXTURE_2D
-		glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, dataFormat, GL_UNSIGNED_BYTE, data);
+		glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, image.width, image.height, 0, dataFormat, GL_UNSIGNED_BYTE, image.data);
 		glGenerateMipmap(GL_TEXTURE_2D);
 
 		//sets texture wrapping and filtering options for the currently bound texture object
@@ -194,16 +852,15 @@ unsigned int textureFromFile(const char* textureFile, bool gammaCorrection) {
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 	}
-	else {
-		std::cout << "ERROR: Cannot load texture file: " << textureFile << std::endl;
-	}
 
-	//free texture data
-	stbi_image_free(data);
 	glBindTexture(GL_TEXTURE_2D, 0); //unbind texture
 	return textureID;
 }
 
+unsigned int textureFromFile(const char* textureFile, bool gammaCorrection) {
+	return uploadTexture(decodeTexture(textureFile), gammaCorrection);
+}
+
 //This function generates a texture object, sets its texture parameters and loads the texture image for the object.
 //It returns the initalized texture object.
 //Note: it expects the image to be RGB format of float type
@@ -301,28 +958,299 @@ unsigned int cubeMapFromFile(const std::vector<const char*>& faces, bool gammaCo
 
 void Model::initInstancedModelMatrix(const std::vector<glm::mat4>* modelMatrices) {
 	numModelMatrices = modelMatrices->size();
-	unsigned int buffer;
-	glGenBuffers(1, &buffer);
-	glBindBuffer(GL_ARRAY_BUFFER, buffer);
+	instanceBuffer = GLBuffer::create();
+	glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer.get());
 	glBufferData(GL_ARRAY_BUFFER, numModelMatrices * sizeof(glm::mat4), modelMatrices->data(), GL_STATIC_DRAW);
 
-	for (unsigned int i = 0; i < meshes.size(); ++i){
-		glBindVertexArray(meshes[i].VAO);
-		std::size_t vec4Size = sizeof(glm::vec4);
-		glEnableVertexAttribArray(3);
-		glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, 4 * vec4Size, (void*)0);
-		glEnableVertexAttribArray(4);
-		glVertexAttribPointer(4, 4, GL_FLOAT, GL_FALSE, 4 * vec4Size, (void*)(1 * vec4Size));
-		glEnableVertexAttribArray(5);
-		glVertexAttribPointer(5, 4, GL_FLOAT, GL_FALSE, 4 * vec4Size, (void*)(2 * vec4Size));
-		glEnableVertexAttribArray(6);
-		glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, 4 * vec4Size, (void*)(3 * vec4Size));
-
-		glVertexAttribDivisor(3, 1);
-		glVertexAttribDivisor(4, 1);
-		glVertexAttribDivisor(5, 1);
-		glVertexAttribDivisor(6, 1);
-
-		glBindVertexArray(0);
-	}
-}
\ No newline at end of file
+	//all meshes share the vertex array
+	glBindVertexArray(VAO.get());
+	std::size_t vec4Size = sizeof(glm::vec4);
+	glEnableVertexAttribArray(3);
+	glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, 4 * vec4Size, (void*)0);
+	glEnableVertexAttribArray(4);
+	glVertexAttribPointer(4, 4, GL_FLOAT, GL_FALSE, 4 * vec4Size, (void*)(1 * vec4Size));
+	glEnableVertexAttribArray(5);
+	glVertexAttribPointer(5, 4, GL_FLOAT, GL_FALSE, 4 * vec4Size, (void*)(2 * vec4Size));
+	glEnableVertexAttribArray(6);
+	glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, 4 * vec4Size, (void*)(3 * vec4Size));
+
+	glVertexAttribDivisor(3, 1);
+	glVertexAttribDivisor(4, 1);
+	glVertexAttribDivisor(5, 1);
+	glVertexAttribDivisor(6, 1);
+
+	glBindVertexArray(0);
+}
+
+//a mesh as processMesh used to build it: vectors grown one vertex and one index at a time, then copied into the Mesh,
+//whose constructor took the vertices by reference and the indices by value
+struct LegacyMesh {
+	std::vector<Vertex> vertices;
+	std::vector<unsigned int> indices;
+
+	LegacyMesh(const std::vector<Vertex>& verticesVal, const std::vector<unsigned int> indicesVal) : vertices(verticesVal),
+		indices(indicesVal) {}
+};
+
+static LegacyMesh convertMeshLegacy(const aiMesh* mesh) {
+	std::vector<Vertex> vertices;
+	std::vector<unsigned int> indices;
+	for (unsigned int i = 0; i < mesh->mNumVertices; ++i)
+		vertices.push_back(readVertex(mesh, i));
+	for (unsigned int i = 0; i < mesh->mNumFaces; ++i) {
+		aiFace face = mesh->mFaces[i];
+		for (unsigned int j = 0; j < face.mNumIndices; ++j)
+			indices.push_back(face.mIndices[j]);
+	}
+	return LegacyMesh(vertices, indices);
+}
+
+void benchmarkMeshConversion(const char* path, unsigned int numRuns) {
+	if (numRuns == 0)
+		return;
+	auto start = std::chrono::high_resolution_clock::now();
+	Assimp::Importer importer;
+	const aiScene* scene = importer.ReadFile(path, IMPORT_FLAGS);
+	if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
+		std::cout << "ERROR::ASSIMP::" << importer.GetErrorString() << std::endl;
+		return;
+	}
+	double importTime = elapsedMilliseconds(start);
+
+	std::size_t numVertices = 0, numIndices = 0;
+	for (unsigned int i = 0; i < scene->mNumMeshes; ++i) {
+		numVertices += scene->mMeshes[i]->mNumVertices;
+		numIndices += countIndices(scene->mMeshes[i]);
+	}
+	std::cout << "Mesh conversion benchmark: " << path << ", " << scene->mNumMeshes << " meshes, " << numVertices << " vertices, "
+		<< numIndices << " indices, imported in " << importTime << " ms" << std::endl;
+
+	//one allocation for all vertices and one for all indices, standing in for the mapped GL buffers loadModel writes to
+	ResidentMemoryMeter directMeter;
+	std::size_t allocations = getHeapAllocationCount();
+	start = std::chrono::high_resolution_clock::now();
+	for (unsigned int run = 0; run < numRuns; ++run) {
+		Vertex* vertices = static_cast<Vertex*>(::operator new(numVertices * sizeof(Vertex)));
+		unsigned int* indices = static_cast<unsigned int*>(::operator new(numIndices * sizeof(unsigned int)));
+		std::size_t baseVertex = 0, firstIndex = 0;
+		for (unsigned int i = 0; i < scene->mNumMeshes; ++i) {
+			convertMesh(scene->mMeshes[i], vertices + baseVertex, indices + firstIndex);
+			baseVertex += scene->mMeshes[i]->mNumVertices;
+			firstIndex += countIndices(scene->mMeshes[i]);
+		}
+		::operator delete(vertices);
+		::operator delete(indices);
+	}
+	double directTime = elapsedMilliseconds(start);
+	std::size_t directAllocations = getHeapAllocationCount() - allocations;
+	std::size_t directMemory = directMeter.stop();
+
+	//a vector per mesh, every mesh kept until the end of the run as the model kept them
+	ResidentMemoryMeter legacyMeter;
+	allocations = getHeapAllocationCount();
+	start = std::chrono::high_resolution_clock::now();
+	for (unsigned int run = 0; run < numRuns; ++run) {
+		std::vector<LegacyMesh> meshes;
+		for (unsigned int i = 0; i < scene->mNumMeshes; ++i)
+			meshes.push_back(convertMeshLegacy(scene->mMeshes[i]));
+	}
+	double legacyTime = elapsedMilliseconds(start);
+	std::size_t legacyAllocations = getHeapAllocationCount() - allocations;
+	std::size_t legacyMemory = legacyMeter.stop();
+
+	//both must produce the same vertices and indices
+	bool identical = true;
+	std::vector<Vertex> vertices(numVertices);
+	std::vector<unsigned int> indices(numIndices);
+	std::size_t baseVertex = 0, firstIndex = 0;
+	for (unsigned int i = 0; i < scene->mNumMeshes; ++i) {
+		convertMesh(scene->mMeshes[i], vertices.data() + baseVertex, indices.data() + firstIndex);
+		LegacyMesh mesh = convertMeshLegacy(scene->mMeshes[i]);
+		if (!mesh.vertices.empty() && std::memcmp(mesh.vertices.data(), vertices.data() + baseVertex, mesh.vertices.size() * sizeof(Vertex)) != 0)
+			identical = false;
+		if (!mesh.indices.empty() && std::memcmp(mesh.indices.data(), indices.data() + firstIndex, mesh.indices.size() * sizeof(unsigned int)) != 0)
+			identical = false;
+		baseVertex += mesh.vertices.size();
+		firstIndex += mesh.indices.size();
+	}
+
+	std::cout << "    preallocated buffer: " << directTime / numRuns << " ms/run, " << (double)directAllocations / numRuns
+		<< " heap allocations/run, resident memory rose by up to " << directMemory / (1024 * 1024) << " MB" << std::endl;
+	std::cout << "    vector per mesh: " << legacyTime / numRuns << " ms/run, " << (double)legacyAllocations / numRuns
+		<< " heap allocations/run, resident memory rose by up to " << legacyMemory / (1024 * 1024) << " MB" << std::endl;
+	if (!identical)
+		std::cout << "ERROR::MODEL:: The two conversions differ" << std::endl;
+}
+
+//the arrays a benchmarked loader converts a file into: one allocation for all vertices and one for all indices,
+//standing in for the mapped GL buffers loadModel writes to
+struct LoadBuffers {
+	Vertex* vertices;
+	unsigned int* indices;
+	std::size_t numVertices, numIndices;
+
+	LoadBuffers() : vertices(NULL), indices(NULL), numVertices(0), numIndices(0) {}
+	~LoadBuffers() {
+		::operator delete(vertices);
+		::operator delete(indices);
+	}
+	void allocate(std::size_t numVerticesVal, std::size_t numIndicesVal) {
+		numVertices = numVerticesVal;
+		numIndices = numIndicesVal;
+		vertices = static_cast<Vertex*>(::operator new(numVertices * sizeof(Vertex)));
+		indices = static_cast<unsigned int*>(::operator new(numIndices * sizeof(unsigned int)));
+	}
+};
+
+//reads the file and converts all of its meshes into the buffers it allocates. Prints the error and returns false when
+//the file can't be read
+typedef std::function<bool(LoadBuffers& buffers)> LoadFunction;
+
+static bool loadWithAssimp(const char* path, LoadBuffers& buffers) {
+	Assimp::Importer importer;
+	const aiScene* scene = importer.ReadFile(path, IMPORT_FLAGS);
+	if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
+		std::cout << "ERROR::ASSIMP::" << importer.GetErrorString() << std::endl;
+		return false;
+	}
+	std::size_t numVertices = 0, numIndices = 0;
+	for (unsigned int i = 0; i < scene->mNumMeshes; ++i) {
+		numVertices += scene->mMeshes[i]->mNumVertices;
+		numIndices += countIndices(scene->mMeshes[i]);
+	}
+	buffers.allocate(numVertices, numIndices);
+	std::size_t baseVertex = 0, firstIndex = 0;
+	for (unsigned int i = 0; i < scene->mNumMeshes; ++i) {
+		convertMesh(scene->mMeshes[i], buffers.vertices + baseVertex, buffers.indices + firstIndex);
+		baseVertex += scene->mMeshes[i]->mNumVertices;
+		firstIndex += countIndices(scene->mMeshes[i]);
+	}
+	return true;
+}
+
+//times numRuns loads of a file by each of the named loaders and by assimp, one after the other, and prints the time,
+//the throughput when the file's size is given, and how far resident memory rose during each. Then compares the
+//vertices of the first loader with assimp's
+static void benchmarkLoading(const char* path, std::size_t fileSize, std::vector<std::pair<const char*, LoadFunction>> loaders,
+	unsigned int numRuns) {
+	LoadFunction assimpLoader = [path](LoadBuffers& buffers) {
+		return loadWithAssimp(path, buffers);
+	};
+	loaders.push_back(std::make_pair("assimp", assimpLoader));
+	for (unsigned int i = 0; i < loaders.size(); ++i) {
+		ResidentMemoryMeter meter;
+		auto start = std::chrono::high_resolution_clock::now();
+		for (unsigned int run = 0; run < numRuns; ++run) {
+			LoadBuffers buffers;
+			if (!loaders[i].second(buffers))
+				return;
+		}
+		double time = elapsedMilliseconds(start) / numRuns;
+		std::size_t memory = meter.stop();
+		std::cout << "    " << loaders[i].first << ": " << time << " ms/run, ";
+		if (fileSize > 0)
+			std::cout << (double)fileSize / (1024 * 1024) / (time / 1000.0) << " MB/s, ";
+		std::cout << "resident memory rose by up to " << memory / (1024 * 1024) << " MB" << std::endl;
+	}
+
+	//once more outside the measurements, keeping both results
+	LoadBuffers native, assimp;
+	if (!loaders[0].second(native) || !assimpLoader(assimp))
+		return;
+	//assimp may order the meshes of a file differently, so differences only mean something when the counts match
+	if (assimp.numVertices != native.numVertices || assimp.numIndices != native.numIndices) {
+		std::cout << "    assimp read " << assimp.numVertices << " vertices and " << assimp.numIndices << " indices, the vertices aren't compared"
+			<< std::endl;
+		return;
+	}
+	float positionDifference = 0.0f, texCoordDifference = 0.0f;
+	for (std::size_t i = 0; i < native.numVertices; ++i) {
+		glm::vec3 position = glm::abs(native.vertices[i].position - assimp.vertices[i].position);
+		glm::vec2 texCoords = glm::abs(native.vertices[i].texCoords - assimp.vertices[i].texCoords);
+		positionDifference = std::max(positionDifference, std::max(position.x, std::max(position.y, position.z)));
+		texCoordDifference = std::max(texCoordDifference, std::max(texCoords.x, texCoords.y));
+	}
+	std::cout << "    largest difference: " << positionDifference << " in positions, " << texCoordDifference << " in texture coordinates"
+		<< std::endl;
+}
+
+void benchmarkGLTFLoading(const char* path, unsigned int numRuns) {
+	if (numRuns == 0 || !isGLTFFile(path))
+		return;
+	std::size_t numVertices = 0, numIndices = 0;
+	unsigned int numMeshes = 0;
+	{
+		GLTFFile file;
+		if (!file.open(path))
+			return;
+		for (unsigned int i = 0; i < file.meshes.size(); ++i) {
+			for (unsigned int j = 0; j < file.meshes[i].primitives.size(); ++j, ++numMeshes) {
+				numVertices += countGLTFVertices(file, file.meshes[i].primitives[j]);
+				numIndices += countGLTFIndices(file, file.meshes[i].primitives[j]);
+			}
+		}
+	}
+	std::cout << "glTF loading benchmark: " << path << ", " << numMeshes << " meshes, " << numVertices << " vertices, " << numIndices
+		<< " indices" << std::endl;
+
+	LoadFunction nativeLoader = [path, numVertices, numIndices](LoadBuffers& buffers) {
+		GLTFFile file;
+		if (!file.open(path))
+			return false;
+		buffers.allocate(numVertices, numIndices);
+		std::size_t baseVertex = 0, firstIndex = 0;
+		for (unsigned int i = 0; i < file.meshes.size(); ++i) {
+			for (unsigned int j = 0; j < file.meshes[i].primitives.size(); ++j) {
+				const GLTFPrimitive& primitive = file.meshes[i].primitives[j];
+				convertGLTFPrimitive(file, primitive, buffers.vertices + baseVertex, buffers.indices + firstIndex);
+				baseVertex += countGLTFVertices(file, primitive);
+				firstIndex += countGLTFIndices(file, primitive);
+			}
+		}
+		return true;
+	};
+	std::vector<std::pair<const char*, LoadFunction>> loaders;
+	loaders.push_back(std::make_pair("native", nativeLoader));
+	benchmarkLoading(path, 0, loaders, numRuns);
+}
+
+void benchmarkOBJParsing(const char* path, unsigned int numRuns) {
+	if (numRuns == 0 || !isOBJFile(path))
+		return;
+	std::size_t fileSize = 0, numVertices = 0, numIndices = 0;
+	unsigned int numMeshes = 0;
+	{
+		OBJFile file;
+		if (!file.open(path))
+			return;
+		for (unsigned int i = 0; i < file.meshes.size(); ++i) {
+			numVertices += file.meshes[i].numCorners;
+			numIndices += file.meshes[i].numIndices;
+		}
+		numMeshes = file.meshes.size();
+		fileSize = MappedFile(path).getSize();
+	}
+	std::cout << "OBJ parsing benchmark: " << path << ", " << (double)fileSize / (1024 * 1024) << " MB, " << numMeshes << " meshes, "
+		<< numVertices << " vertices, " << numIndices << " indices" << std::endl;
+
+	std::vector<std::pair<const char*, LoadFunction>> loaders;
+	const char* names[] = { "native, one thread", "native, every thread" };
+	unsigned int threadCounts[] = { 1, 0 };
+	for (unsigned int i = 0; i < 2; ++i) {
+		unsigned int numThreads = threadCounts[i];
+		loaders.push_back(std::make_pair(names[i], [path, numThreads, numVertices, numIndices](LoadBuffers& buffers) {
+			OBJFile file;
+			if (!file.open(path, numThreads))
+				return false;
+			buffers.allocate(numVertices, numIndices);
+			std::size_t baseVertex = 0, firstIndex = 0;
+			for (unsigned int j = 0; j < file.meshes.size(); ++j) {
+				convertOBJMesh(file, file.meshes[j], buffers.vertices + baseVertex, buffers.indices + firstIndex);
+				baseVertex += file.meshes[j].numCorners;
+				firstIndex += file.meshes[j].numIndices;
+			}
+			return true;
+		}));
+	}
+	benchmarkLoading(path, fileSize, loaders, numRuns);
+}
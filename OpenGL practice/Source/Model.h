@@ -0,0 +1,197 @@
+#pragma once
+
+#include <vector>
+#include <iostream>
+#include <assimp/Importer.hpp>
+#include <assimp/postprocess.h>
+
+#include "Shader.h"
+#include "Mesh.h"
+#include "SceneGraph.h"
+#include "Bounds.h"
+#include "Animation.h"
+#include "GLResource.h"
+
+class GLTFFile;
+class OBJFile;
+
+//an image decoded by stb_image, 8 bits per channel, freed with the image. Decoding makes no GL calls, so it can run on
+//any thread and only the upload has to happen on the one with the context
+struct TextureImage {
+	unsigned char* data; //NULL when the file couldn't be decoded
+	int width, height, numChannels;
+
+	TextureImage() : data(NULL), width(0), height(0), numChannels(0) {}
+	~TextureImage();
+	TextureImage(TextureImage&& other) noexcept;
+	TextureImage& operator=(TextureImage&& other) noexcept;
+	TextureImage(const TextureImage&) = delete;
+	TextureImage& operator=(const TextureImage&) = delete;
+};
+
+TextureImage decodeTexture(const char* textureFile);
+TextureImage decodeTexture(const unsigned char* data, std::size_t size); //an encoded image in memory, e.g. embedded in a model
+unsigned int uploadTexture(const TextureImage& image, bool gammaCorrection = false); //creates a texture even for a failed decode
+unsigned textureFromFile(const char* localPath, const std::string& directory, bool gammaCorrection = false);
+unsigned int textureFromFile(const char* textureFile, bool gammaCorrection = false);
+unsigned int textureFromFile_f(const char* textureFile, GLint internalFormat);
+unsigned int cubeMapFromFile(const std::vector<const char*>& faces, bool gammaCorrection = false);
+
+//a mesh of a model: its range of the model's shared vertex and index buffers and the textures of its material
+struct MeshRange {
+	unsigned int baseVertex;
+	unsigned int firstIndex;
+	unsigned int numIndices;
+	std::vector<Texture> textures;
+
+	MeshRange() : baseVertex(0), firstIndex(0), numIndices(0) {}
+};
+
+//where the time and memory of loading a model went
+struct ModelLoadStats {
+	double importTime; //ms, assimp reading and post-processing the file
+	double conversionTime; //ms, converting the meshes into the GPU buffers, textures excluded
+	double textureTime; //ms, loading and uploading the textures. Only the uploads when an AssetLoader decoded them
+	std::size_t numVertices, numIndices;
+	std::size_t peakResidentBytes; //of the process once the model is loaded
+
+	ModelLoadStats() : importTime(0.0), conversionTime(0.0), textureTime(0.0), numVertices(0), numIndices(0), peakResidentBytes(0) {}
+};
+
+//what a model keeps on the CPU once its meshes are on the GPU, as flags. Draw ranges and bounds are always kept
+enum MeshResidency {
+	RESIDENCY_GPU_ONLY = 0,
+	RESIDENCY_POSITIONS = 1, //a compact copy of the vertex positions and indices, for CPU-side culling and picking
+	RESIDENCY_SKINNING = 2 //bind pose and bone influences of the skinned meshes, for CPU skinning
+};
+
+//bytes a model holds on the CPU and on the GPU, by what they hold
+struct ModelMemoryUsage {
+	//CPU
+	std::size_t meshBytes; //draw ranges, bounds, texture records and the mesh references of the hierarchy
+	std::size_t positionBytes; //RESIDENCY_POSITIONS copy
+	std::size_t skinningBytes; //RESIDENCY_SKINNING data
+	std::size_t animationBytes; //skeleton and keyframes
+	//GPU
+	std::size_t vertexBufferBytes, indexBufferBytes, boneBufferBytes, instanceBufferBytes;
+	std::size_t textureBytes; //estimated from the size and internal format of every texture, mipmaps included
+
+	ModelMemoryUsage() : meshBytes(0), positionBytes(0), skinningBytes(0), animationBytes(0), vertexBufferBytes(0), indexBufferBytes(0),
+		boneBufferBytes(0), instanceBufferBytes(0), textureBytes(0) {}
+	std::size_t getCPUBytes() const {
+		return meshBytes + positionBytes + skinningBytes + animationBytes;
+	}
+	std::size_t getGPUBytes() const {
+		return vertexBufferBytes + indexBufferBytes + boneBufferBytes + instanceBufferBytes + textureBytes;
+	}
+};
+
+//All meshes of a model share one vertex array: their vertices are interleaved in one vertex buffer and their indices
+//in one index buffer, each mesh drawn from its range with its base vertex. Loading writes every mesh straight from
+//assimp's arrays into the mapped buffers, so the vertex data is never held in a vector on the way to the GPU. A model
+//owns its GL objects and can be moved but not copied. What stays on the CPU afterwards is set by the residency flags:
+//with RESIDENCY_GPU_ONLY only what drawing and culling by bounds need.
+//Loading runs in stages that either only touch the CPU (import, conversion into the mapped buffers) or only make GL
+//calls (mapping, unmapping, texture uploads), so the AssetLoader can run the former off the GL thread and the latter on
+//a context sharing the render context's objects. Only the vertex array, which contexts don't share, is made last on
+//the render context.
+class Model
+{
+public:
+	Model(const char* path, const std::vector<glm::mat4>* modelMatrices = NULL, const bool gamma = false,
+		unsigned int residency = RESIDENCY_SKINNING);
+	Model(const Model&) = delete;
+	Model& operator=(const Model&) = delete;
+	Model(Model&&) = default;
+	Model& operator=(Model&&) = default;
+
+	void draw(const Shader& shader) const;
+	void draw(const Shader& shader, const glm::mat4& model) const;
+	SceneGraph& getNodeHierarchy();
+	AABB computeBounds() const; //model-space bounds of all meshes with their node transforms applied
+	const ModelLoadStats& getLoadStats() const;
+	ModelMemoryUsage getMemoryUsage() const; //queries the texture sizes, so the context must be current
+	unsigned int getResidency() const;
+	//closest hit of a model-space ray against the triangles of every mesh, with the node transforms applied. Without
+	//RESIDENCY_POSITIONS only the mesh bounds can be hit
+	bool raycast(const Ray& ray, float maxDistance, float& hitDistance) const;
+
+	//skeletal animation. The skeleton's joints are the nodes of the hierarchy, in the same order
+	bool hasSkeleton() const;
+	const Skeleton& getSkeleton() const;
+	const std::vector<AnimationClip>& getAnimations() const;
+	//mesh of the file, NULL for meshes without bones and without RESIDENCY_SKINNING
+	const SkinnedMeshData* getSkinnedMesh(unsigned int mesh) const;
+	//draws numInstances instances of the skinned meshes, with the bone matrices of every instance read from the
+	//BoneMatrixBuffer bound by the caller
+	void drawSkinned(const Shader& shader, unsigned int numInstances) const;
+
+private:
+	friend class AssetLoader;
+
+	//model data
+	std::vector<Texture> loadedTextures;
+	std::vector<GLTexture> textureObjects; //own the textures of loadedTextures, the Textures only refer to them
+	std::vector<MeshRange> meshes; //one per mesh of the file, however many nodes reference it
+	std::vector<AABB> meshBounds; //bounds of each mesh's vertices in the space of its node
+	std::vector<int> meshSkins; //index into skinnedMeshes of each mesh, -1 when it has no bones. Kept without the data
+	std::vector<unsigned int> nodeMeshes; //mesh of every mesh reference in the hierarchy
+	std::vector<unsigned int> meshNodes; //node of the hierarchy each of those references is attached to
+	GLVertexArray VAO;
+	GLBuffer VBO, EBO;
+	GLBuffer boneBuffer; //bone influences of every vertex, none when no mesh has bones
+	GLBuffer instanceBuffer; //instanced model matrices, none when not instanced
+	unsigned int residency;
+	std::vector<glm::vec3> positions; //RESIDENCY_POSITIONS: every vertex position, laid out as in the vertex buffer
+	std::vector<unsigned int> positionIndices; //RESIDENCY_POSITIONS: laid out as in the index buffer
+	std::vector<SkinnedMeshData> skinnedMeshes;
+	Skeleton skeleton;
+	std::vector<AnimationClip> animations;
+	SceneGraph nodeHierarchy; //aiNode transforms, relative to the model's root
+	std::string directory;
+	bool gammaCorrection;
+	std::size_t numModelMatrices;
+	ModelLoadStats loadStats;
+
+	Model(const bool gamma, unsigned int residency); //empty, for the AssetLoader to run the stages on
+
+	void loadModel(const std::string& path);
+	//the native glTF path, used for .gltf and .glb files instead of importScene and convertScene. importGLTF opens the file
+	//and lays out one mesh per primitive; it returns false, with nothing recorded, for files assimp has to load instead:
+	//those it can't open and those with skins or animations, which only the assimp path reads
+	bool importGLTF(GLTFFile& file, const std::string& path);
+	void convertGLTF(const GLTFFile& file, Vertex* vertices, unsigned int* indices);
+	void addGLTFNode(const GLTFFile& file, unsigned int node, int parentNode, const std::vector<unsigned int>& firstMeshes);
+	//the native OBJ path, the same way. importOBJ returns false only for files that can't be parsed
+	bool importOBJ(OBJFile& file, const std::string& path);
+	void convertOBJ(const OBJFile& file, Vertex* vertices, unsigned int* indices);
+	//loading stages, in order: importScene and convertScene make no GL calls, mapBuffers, finishBuffers and setTexture
+	//need a context sharing objects with the render context and createVertexArray the render context itself.
+	//importScene returns NULL and mapBuffers false when loading can't go on
+	const aiScene* importScene(Assimp::Importer& importer, const std::string& path);
+	bool mapBuffers(Vertex*& vertices, unsigned int*& indices);
+	void convertScene(const aiScene* scene, Vertex* vertices, unsigned int* indices, std::vector<VertexBoneData>& bones);
+	void finishBuffers(const std::vector<VertexBoneData>& bones);
+	void setTexture(unsigned int texture, unsigned int id); //gives loadedTextures[texture] and the meshes using it their texture
+	void createVertexArray();
+	void processNode(const aiNode* node, int parentNode);
+	void loadMaterialTextures(const aiMaterial* material, aiTextureType type, std::vector<Texture>& textures);
+	void addTexture(aiTextureType type, const std::string& localPath, std::vector<Texture>& textures);
+	void loadBones(const aiMesh* mesh, SkinnedMeshData& skin);
+	void drawMesh(const MeshRange& mesh, const Shader& shader, unsigned int numInstances) const;
+	void loadSkeleton(const aiScene* scene);
+	void initInstancedModelMatrix(const std::vector<glm::mat4>* modelMatrices);
+};
+
+//imports a model once and converts its meshes numRuns times on the CPU, the old way (a vector per mesh grown vertex by
+//vertex, then copied into the Mesh) and straight into one preallocated buffer, and prints the time, heap allocations
+//and rise in resident memory of each. Needs no GL context
+void benchmarkMeshConversion(const char* path, unsigned int numRuns = 10);
+//reads a .gltf or .glb file numRuns times with the native loader and with assimp, converting its meshes into one
+//preallocated buffer each time, and prints the time and rise in resident memory of each and how far their vertices differ.
+//Textures aren't loaded. Needs no GL context
+void benchmarkGLTFLoading(const char* path, unsigned int numRuns = 10);
+//parses a .obj file numRuns times with the native parser on one thread and on every hardware thread and with assimp,
+//converting its meshes into one preallocated buffer each time, and prints the time, throughput and rise in resident
+//memory of each and how far their vertices differ. Textures aren't loaded. Needs no GL context
+void benchmarkOBJParsing(const char* path, unsigned int numRuns = 10);
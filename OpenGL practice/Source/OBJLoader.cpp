@@ -0,0 +1,577 @@
+#include "OBJLoader.h"
+#include <iostream>
+#include <thread>
+#include <cstring>
+#include <cstdint>
+#include <cctype>
+#include <cmath>
+#include <limits>
+#include <new>
+#include <algorithm>
+#include <bit>
+
+//SSE2 for the integer compares that classify digits
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define OBJ_LOADER_SSE
+#include <emmintrin.h>
+#endif
+
+//what a chunk of the file holds: counted by the first pass, then offset by the chunks before it
+struct OBJCounts {
+	std::size_t numPositions, numTexCoords, numNormals, numFaces, numCorners;
+
+	OBJCounts() : numPositions(0), numTexCoords(0), numNormals(0), numFaces(0), numCorners(0) {}
+};
+
+//a usemtl, o or g line, taking effect from the face after it
+struct OBJEvent {
+	std::size_t face, corner;
+	bool material; //usemtl, o or g otherwise
+	std::string name;
+};
+
+struct OBJFile::Chunk {
+	const char* begin;
+	const char* end;
+	OBJCounts counts;
+	OBJCounts base;
+	std::vector<OBJEvent> events;
+	std::vector<std::string> materialLibraries;
+	bool valid;
+};
+
+static bool isSpace(char c) {
+	return c == ' ' || c == '\t' || c == '\r';
+}
+
+static const char* skipSpaces(const char* p, const char* end) {
+	while (p < end && isSpace(*p))
+		++p;
+	return p;
+}
+
+static const char* findLineEnd(const char* p, const char* end) {
+	const void* newline = std::memchr(p, '\n', end - p);
+	return newline ? static_cast<const char*>(newline) : end;
+}
+
+//whether the line starts with the keyword and a space, leaving p after the keyword when it does. Lines of a keyword
+//alone have nothing to read and are ignored like comments
+static bool matchKeyword(const char*& p, const char* lineEnd, const char* keyword) {
+	std::size_t length = std::strlen(keyword);
+	if ((std::size_t)(lineEnd - p) <= length || std::memcmp(p, keyword, length) != 0 || !isSpace(p[length]))
+		return false;
+	p += length;
+	return true;
+}
+
+static std::string readName(const char* p, const char* lineEnd) { //the rest of the line, trimmed
+	p = skipSpaces(p, lineEnd);
+	while (lineEnd > p && isSpace(lineEnd[-1]))
+		--lineEnd;
+	return std::string(p, lineEnd);
+}
+
+//eight ASCII digits at once, in the bytes of a 64 bit word read in little-endian order as on every target the project
+//builds for: the check tests all eight bytes for '0' to '9' and the parse combines the digits pairwise in three
+//multiplications instead of eight dependent ones
+#ifndef OBJ_LOADER_SSE
+static bool isEightDigits(std::uint64_t chunk) {
+	return ((chunk & 0xF0F0F0F0F0F0F0F0ull) | (((chunk + 0x0606060606060606ull) & 0xF0F0F0F0F0F0F0F0ull) >> 4)) == 0x3333333333333333ull;
+}
+#endif
+
+static std::uint32_t parseEightDigits(std::uint64_t chunk) {
+	const std::uint64_t mask = 0x000000FF000000FFull;
+	const std::uint64_t mul1 = 0x000F424000000064ull; //100 + (1000000 << 32)
+	const std::uint64_t mul2 = 0x0000271000000001ull; //1 + (10000 << 32)
+	chunk -= 0x3030303030303030ull;
+	chunk = chunk * 10 + (chunk >> 8);
+	chunk = (((chunk & mask) * mul1) + (((chunk >> 16) & mask) * mul2)) >> 32;
+	return (std::uint32_t)chunk;
+}
+
+#ifdef OBJ_LOADER_SSE
+//the number of digits the 16 bytes at p start with, 16 when they are all digits. Bytes past 0x7F compare as negative
+static unsigned int countLeadingDigits(const char* p) {
+	__m128i bytes = _mm_loadu_si128((const __m128i*)p);
+	__m128i digits = _mm_and_si128(_mm_cmpgt_epi8(bytes, _mm_set1_epi8('0' - 1)), _mm_cmplt_epi8(bytes, _mm_set1_epi8('9' + 1)));
+	unsigned int notDigits = ~(unsigned int)_mm_movemask_epi8(digits) & 0xFFFF;
+	return std::countr_zero(notDigits | 0x10000);
+}
+#endif
+
+//digits into mantissa, up to the 19 significant digits it can hold; the ones past them only scale the value. Returns the
+//number of digits read. With SSE the length of the run of digits is found first and up to eight of them are parsed at
+//once, the short runs of a typical coordinate ("0.123456") shifted up to the top of the word with '0's below them;
+//without it only runs of eight at a time skip the digit by digit loop
+static std::size_t readDigits(const char*& p, const char* end, std::uint64_t& mantissa, int& numDigits, int& exponent, bool fraction) {
+	const char* start = p;
+#ifdef OBJ_LOADER_SSE
+	static const std::uint64_t scales[] = { 1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000 };
+	while (end - p >= 16) {
+		unsigned int count = std::min(countLeadingDigits(p), 8u);
+		if (count == 0 || numDigits + (int)count > 19)
+			break;
+		std::uint64_t chunk;
+		std::memcpy(&chunk, p, 8);
+		if (count < 8)
+			chunk = (chunk << (8 * (8 - count))) | (0x3030303030303030ull >> (8 * count));
+		mantissa = mantissa * scales[count] + parseEightDigits(chunk);
+		if (mantissa != 0)
+			numDigits += count;
+		if (fraction)
+			exponent -= count;
+		p += count;
+		if (count < 8)
+			return p - start;
+	}
+#else
+	while (end - p >= 8 && numDigits <= 11) {
+		std::uint64_t chunk;
+		std::memcpy(&chunk, p, 8);
+		if (!isEightDigits(chunk))
+			break;
+		mantissa = mantissa * 100000000 + parseEightDigits(chunk);
+		if (mantissa != 0)
+			numDigits += 8;
+		if (fraction)
+			exponent -= 8;
+		p += 8;
+	}
+#endif
+	for (; p < end && *p >= '0' && *p <= '9'; ++p) {
+		if (numDigits < 19) {
+			mantissa = mantissa * 10 + (*p - '0');
+			if (mantissa != 0)
+				++numDigits;
+			if (fraction)
+				--exponent;
+		}
+		else if (!fraction)
+			++exponent;
+	}
+	return p - start;
+}
+
+//parses a decimal number with an optional fraction and exponent. The mantissa is read as an integer and scaled by
+//one multiplication or division by an exact power of ten in double precision, far more than the float needs; only
+//exponents past 22 fall back to pow
+static const char* parseFloat(const char* p, const char* end, float& value) {
+	static const double powersOf10[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16,
+		1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+	p = skipSpaces(p, end);
+	bool negative = p < end && *p == '-';
+	if (p < end && (*p == '-' || *p == '+'))
+		++p;
+	std::uint64_t mantissa = 0;
+	int numDigits = 0, exponent = 0;
+	std::size_t numRead = readDigits(p, end, mantissa, numDigits, exponent, false);
+	if (p < end && *p == '.') {
+		++p;
+		numRead += readDigits(p, end, mantissa, numDigits, exponent, true);
+	}
+	if (numRead == 0)
+		return NULL;
+	if (p < end && (*p == 'e' || *p == 'E')) {
+		++p;
+		bool negativeExponent = p < end && *p == '-';
+		if (p < end && (*p == '-' || *p == '+'))
+			++p;
+		if (p == end || *p < '0' || *p > '9')
+			return NULL;
+		int fileExponent = 0;
+		for (; p < end && *p >= '0' && *p <= '9'; ++p)
+			fileExponent = std::min(fileExponent * 10 + (*p - '0'), 100000);
+		exponent += negativeExponent ? -fileExponent : fileExponent;
+	}
+	double result = (double)mantissa;
+	if (exponent < 0 && exponent >= -22)
+		result /= powersOf10[-exponent];
+	else if (exponent > 0 && exponent <= 22)
+		result *= powersOf10[exponent];
+	else if (exponent != 0)
+		result *= std::pow(10.0, exponent);
+	value = (float)(negative ? -result : result);
+	return p;
+}
+
+//an index of a face corner, 1-based from the start of the file or negative from the end of what was read so far,
+//converted to 0-based. -1 when it's empty (as the texture coordinate of "1//2"), false for 0 or one out of range
+static bool parseIndex(const char*& p, const char* end, std::size_t numRead, std::size_t numTotal, int& index) {
+	index = -1;
+	bool negative = p < end && *p == '-';
+	if (negative)
+		++p;
+	if (p == end || *p < '0' || *p > '9')
+		return !negative;
+	std::uint64_t value = 0;
+	for (; p < end && *p >= '0' && *p <= '9'; ++p)
+		value = std::min<std::uint64_t>(value * 10 + (*p - '0'), 0xFFFFFFFFull);
+	if (value == 0)
+		return false;
+	std::uint64_t resolved = negative ? numRead - value : value - 1; //wraps around past the start, which the check catches
+	if ((negative && value > numRead) || resolved >= numTotal)
+		return false;
+	index = (int)resolved;
+	return true;
+}
+
+//the first pass: what the chunk's lines add to the file, recognized as matchKeyword does. A face counts its corners as
+//the runs of other characters between spaces, which is what the second pass reads them as
+static void countChunk(const char* p, const char* end, OBJCounts& counts) {
+	while (p < end) {
+		const char* lineEnd = findLineEnd(p, end);
+		p = skipSpaces(p, lineEnd);
+		if (lineEnd - p >= 2 && p[0] == 'v') {
+			if (isSpace(p[1]))
+				++counts.numPositions;
+			else if (p[1] == 't' && lineEnd - p >= 3 && isSpace(p[2]))
+				++counts.numTexCoords;
+			else if (p[1] == 'n' && lineEnd - p >= 3 && isSpace(p[2]))
+				++counts.numNormals;
+		}
+		else if (lineEnd - p >= 2 && p[0] == 'f' && isSpace(p[1])) {
+			unsigned int numCorners = 0;
+			for (const char* c = p + 1; c < lineEnd; ++c) {
+				if (!isSpace(*c) && isSpace(c[-1]))
+					++numCorners;
+			}
+			if (numCorners >= 3) {
+				++counts.numFaces;
+				counts.numCorners += numCorners;
+			}
+		}
+		p = lineEnd + 1;
+	}
+}
+
+bool OBJFile::open(const std::string& path, unsigned int numThreads) {
+	close();
+	MappedFile file;
+	if (!file.open(path.c_str()))
+		return false;
+	const char* data = reinterpret_cast<const char*>(file.getData());
+	const char* dataEnd = data + file.getSize();
+
+	//chunks of at least 1 MB, starting after a newline
+	const std::size_t minChunkSize = 1 << 20;
+	if (numThreads == 0)
+		numThreads = std::max(std::thread::hardware_concurrency(), 1u);
+	numThreads = (unsigned int)std::max<std::size_t>(std::min<std::size_t>(numThreads, file.getSize() / minChunkSize), 1);
+	std::vector<Chunk> chunks(numThreads);
+	for (unsigned int i = 0; i < numThreads; ++i) {
+		chunks[i].begin = i == 0 ? data : chunks[i - 1].end;
+		chunks[i].end = i + 1 == numThreads ? dataEnd : std::max(chunks[i].begin, data + file.getSize() / numThreads * (i + 1));
+		if (chunks[i].end < dataEnd)
+			chunks[i].end = std::min(findLineEnd(chunks[i].end, dataEnd) + 1, dataEnd);
+		chunks[i].valid = true;
+	}
+	//runs the function on every chunk, the first on this thread
+	auto forEachChunk = [&](auto function) {
+		std::vector<std::thread> threads;
+		for (unsigned int i = 1; i < numThreads; ++i)
+			threads.push_back(std::thread(function, i));
+		function(0);
+		for (unsigned int i = 0; i < threads.size(); ++i)
+			threads[i].join();
+	};
+
+	forEachChunk([&](unsigned int i) {
+		countChunk(chunks[i].begin, chunks[i].end, chunks[i].counts);
+	});
+	OBJCounts total;
+	for (unsigned int i = 0; i < numThreads; ++i) {
+		chunks[i].base = total;
+		total.numPositions += chunks[i].counts.numPositions;
+		total.numTexCoords += chunks[i].counts.numTexCoords;
+		total.numNormals += chunks[i].counts.numNormals;
+		total.numFaces += chunks[i].counts.numFaces;
+		total.numCorners += chunks[i].counts.numCorners;
+	}
+	if (total.numCorners > (std::size_t)std::numeric_limits<int>::max() || total.numPositions > (std::size_t)std::numeric_limits<int>::max()) {
+		std::cout << "ERROR::OBJ:: " << path << " is too large" << std::endl;
+		return false;
+	}
+	positions.resize(total.numPositions);
+	texCoords.resize(total.numTexCoords);
+	normals.resize(total.numNormals);
+	corners.resize(total.numCorners);
+	faceSizes.resize(total.numFaces);
+
+	//the second pass writes every element to its place in the shared arrays, so the chunks need no merging
+	forEachChunk([&](unsigned int i) {
+		Chunk& chunk = chunks[i];
+		std::size_t position = chunk.base.numPositions, texCoord = chunk.base.numTexCoords, normal = chunk.base.numNormals;
+		std::size_t face = chunk.base.numFaces, corner = chunk.base.numCorners;
+		auto addEvent = [&](bool material, const char* name, const char* lineEnd) {
+			OBJEvent event;
+			event.face = face;
+			event.corner = corner;
+			event.material = material;
+			event.name = readName(name, lineEnd);
+			chunk.events.push_back(event);
+		};
+		const char* p = chunk.begin;
+		while (p < chunk.end && chunk.valid) {
+			const char* lineEnd = findLineEnd(p, chunk.end);
+			p = skipSpaces(p, lineEnd);
+			if (matchKeyword(p, lineEnd, "v")) {
+				glm::vec3& value = positions[position++];
+				chunk.valid = (p = parseFloat(p, lineEnd, value.x)) && (p = parseFloat(p, lineEnd, value.y)) && (p = parseFloat(p, lineEnd, value.z));
+			}
+			else if (matchKeyword(p, lineEnd, "vt")) {
+				glm::vec2& value = texCoords[texCoord++];
+				chunk.valid = (p = parseFloat(p, lineEnd, value.x)) != NULL;
+				if (chunk.valid && !parseFloat(p, lineEnd, value.y))
+					value.y = 0.0f; //1D texture coordinates
+			}
+			else if (matchKeyword(p, lineEnd, "vn")) {
+				glm::vec3& value = normals[normal++];
+				chunk.valid = (p = parseFloat(p, lineEnd, value.x)) && (p = parseFloat(p, lineEnd, value.y)) && (p = parseFloat(p, lineEnd, value.z));
+			}
+			else if (matchKeyword(p, lineEnd, "f")) {
+				//position[/[texCoord][/normal]] per corner. Faces of fewer than 3 corners weren't counted and are skipped
+				OBJCorner faceCorners[2];
+				unsigned int numCorners = 0;
+				while ((p = skipSpaces(p, lineEnd)) < lineEnd && chunk.valid) {
+					OBJCorner value;
+					chunk.valid = parseIndex(p, lineEnd, position, total.numPositions, value.position) && value.position >= 0;
+					value.texCoord = value.normal = -1;
+					if (chunk.valid && p < lineEnd && *p == '/') {
+						++p;
+						chunk.valid = parseIndex(p, lineEnd, texCoord, total.numTexCoords, value.texCoord);
+						if (chunk.valid && p < lineEnd && *p == '/') {
+							++p;
+							chunk.valid = parseIndex(p, lineEnd, normal, total.numNormals, value.normal);
+						}
+					}
+					chunk.valid = chunk.valid && (p == lineEnd || isSpace(*p));
+					if (numCorners < 2)
+						faceCorners[numCorners] = value;
+					else {
+						if (numCorners == 2) {
+							corners[corner++] = faceCorners[0];
+							corners[corner++] = faceCorners[1];
+						}
+						corners[corner++] = value;
+					}
+					++numCorners;
+				}
+				if (numCorners >= 3)
+					faceSizes[face++] = numCorners;
+			}
+			else if (matchKeyword(p, lineEnd, "usemtl"))
+				addEvent(true, p, lineEnd);
+			else if (matchKeyword(p, lineEnd, "o") || matchKeyword(p, lineEnd, "g"))
+				addEvent(false, p, lineEnd);
+			else if (matchKeyword(p, lineEnd, "mtllib"))
+				chunk.materialLibraries.push_back(readName(p, lineEnd));
+			p = lineEnd + 1;
+		}
+	});
+	for (unsigned int i = 0; i < numThreads; ++i) {
+		if (!chunks[i].valid) {
+			std::cout << "ERROR::OBJ:: Malformed line or index out of range in " << path << std::endl;
+			close();
+			return false;
+		}
+	}
+
+	std::string directory = path.substr(0, path.find_last_of('/') + 1);
+	for (unsigned int i = 0; i < numThreads; ++i) {
+		for (unsigned int j = 0; j < chunks[i].materialLibraries.size(); ++j)
+			parseMaterials(directory + chunks[i].materialLibraries[j]);
+	}
+
+	//a mesh per run of faces between the lines that change the object, group or material, in file order
+	OBJMesh mesh;
+	mesh.material = -1;
+	mesh.firstFace = mesh.numFaces = mesh.firstCorner = mesh.numCorners = 0;
+	mesh.numIndices = 0;
+	auto finishMesh = [&](std::size_t face, std::size_t corner) {
+		mesh.numFaces = face - mesh.firstFace;
+		mesh.numCorners = corner - mesh.firstCorner;
+		if (mesh.numFaces > 0) {
+			mesh.numIndices = 3 * (unsigned int)(mesh.numCorners - 2 * mesh.numFaces); //a fan of n - 2 triangles per face
+			meshes.push_back(mesh);
+		}
+		mesh.firstFace = face;
+		mesh.firstCorner = corner;
+	};
+	for (unsigned int i = 0; i < numThreads; ++i) {
+		for (unsigned int j = 0; j < chunks[i].events.size(); ++j) {
+			const OBJEvent& event = chunks[i].events[j];
+			finishMesh(event.face, event.corner);
+			if (!event.material) {
+				mesh.name = event.name;
+				continue;
+			}
+			mesh.material = -1;
+			for (unsigned int k = 0; k < materials.size(); ++k) {
+				if (materials[k].name == event.name) {
+					mesh.material = k;
+					break;
+				}
+			}
+		}
+	}
+	finishMesh(total.numFaces, total.numCorners);
+	return true;
+}
+
+void OBJFile::close() {
+	std::vector<glm::vec3>().swap(positions);
+	std::vector<glm::vec2>().swap(texCoords);
+	std::vector<glm::vec3>().swap(normals);
+	std::vector<OBJCorner>().swap(corners);
+	std::vector<unsigned int>().swap(faceSizes);
+	meshes.clear();
+	materials.clear();
+}
+
+//the texture maps of every newmtl. A map's file is the last word of its line, after any options
+void OBJFile::parseMaterials(const std::string& path) {
+	MappedFile file;
+	if (!file.open(path.c_str()))
+		return;
+	const char* p = reinterpret_cast<const char*>(file.getData());
+	const char* end = p + file.getSize();
+	while (p < end) {
+		const char* lineEnd = findLineEnd(p, end);
+		p = skipSpaces(p, lineEnd);
+		const char* textureTypes[] = { "map_Kd", "map_Ks", "map_Bump", "map_bump", "bump", "map_Ka" };
+		const aiTextureType types[] = { aiTextureType_DIFFUSE, aiTextureType_SPECULAR, aiTextureType_HEIGHT, aiTextureType_HEIGHT,
+			aiTextureType_HEIGHT, aiTextureType_AMBIENT };
+		if (matchKeyword(p, lineEnd, "newmtl")) {
+			materials.push_back(OBJMaterial());
+			materials.back().name = readName(p, lineEnd);
+		}
+		else if (!materials.empty()) {
+			for (unsigned int i = 0; i < sizeof(types) / sizeof(types[0]); ++i) {
+				if (!matchKeyword(p, lineEnd, textureTypes[i]))
+					continue;
+				std::string arguments = readName(p, lineEnd);
+				std::size_t space = arguments.find_last_of(" \t");
+				std::string texture = space == std::string::npos ? arguments : arguments.substr(space + 1);
+				if (!texture.empty())
+					materials.back().textures.push_back(std::make_pair(types[i], texture));
+				break;
+			}
+		}
+		p = lineEnd + 1;
+	}
+}
+
+bool isOBJFile(const std::string& path) {
+	std::size_t dot = path.find_last_of('.');
+	if (dot == std::string::npos)
+		return false;
+	std::string extension = path.substr(dot + 1);
+	std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+	return extension == "obj";
+}
+
+std::vector<unsigned int> readOBJIndices(const OBJFile& file, const OBJMesh& mesh) {
+	std::vector<unsigned int> indices;
+	indices.reserve(mesh.numIndices);
+	unsigned int corner = 0;
+	for (std::size_t i = 0; i < mesh.numFaces; ++i) {
+		unsigned int faceSize = file.faceSizes[mesh.firstFace + i];
+		for (unsigned int j = 1; j + 1 < faceSize; ++j) {
+			indices.push_back(corner);
+			indices.push_back(corner + j);
+			indices.push_back(corner + j + 1);
+		}
+		corner += faceSize;
+	}
+	return indices;
+}
+
+AABB convertOBJMesh(const OBJFile& file, const OBJMesh& mesh, Vertex* vertices, unsigned int* indices) {
+	const OBJCorner* corners = file.corners.data() + mesh.firstCorner;
+	bool hasNormals = true, hasTexCoords = true;
+	int minPosition = std::numeric_limits<int>::max(), maxPosition = 0;
+	for (std::size_t i = 0; i < mesh.numCorners; ++i) {
+		hasNormals = hasNormals && corners[i].normal >= 0;
+		hasTexCoords = hasTexCoords && corners[i].texCoord >= 0;
+		minPosition = std::min(minPosition, corners[i].position);
+		maxPosition = std::max(maxPosition, corners[i].position);
+	}
+
+	//without normals, as aiProcess_GenSmoothNormals: the unit normals of the triangles around every position, averaged
+	//over every corner at that position
+	std::vector<glm::vec3> smoothNormals;
+	if (!hasNormals) {
+		smoothNormals.assign(maxPosition - minPosition + 1, glm::vec3(0.0f));
+		std::size_t corner = 0;
+		for (std::size_t i = 0; i < mesh.numFaces; ++i) {
+			unsigned int faceSize = file.faceSizes[mesh.firstFace + i];
+			glm::vec3 p0 = file.positions[corners[corner].position];
+			for (unsigned int j = 1; j + 1 < faceSize; ++j) {
+				glm::vec3 faceNormal = glm::cross(file.positions[corners[corner + j].position] - p0, file.positions[corners[corner + j + 1].position] - p0);
+				if (glm::dot(faceNormal, faceNormal) == 0.0f)
+					continue;
+				faceNormal = glm::normalize(faceNormal);
+				smoothNormals[corners[corner].position - minPosition] += faceNormal;
+				smoothNormals[corners[corner + j].position - minPosition] += faceNormal;
+				smoothNormals[corners[corner + j + 1].position - minPosition] += faceNormal;
+			}
+			corner += faceSize;
+		}
+	}
+
+	AABB bounds;
+	std::size_t corner = 0;
+	for (std::size_t i = 0; i < mesh.numFaces; ++i) {
+		unsigned int faceSize = file.faceSizes[mesh.firstFace + i];
+		const OBJCorner* face = corners + corner;
+
+		//every corner is a vertex of its own, so the tangent space of the face's triangles is that of its corners
+		glm::vec3 faceTangent(0.0f), faceBitangent(0.0f);
+		if (hasTexCoords) {
+			glm::vec3 p0 = file.positions[face[0].position];
+			glm::vec2 uv0 = file.texCoords[face[0].texCoord];
+			for (unsigned int j = 1; j + 1 < faceSize; ++j) {
+				glm::vec3 edge1 = file.positions[face[j].position] - p0, edge2 = file.positions[face[j + 1].position] - p0;
+				glm::vec2 deltaUV1 = file.texCoords[face[j].texCoord] - uv0, deltaUV2 = file.texCoords[face[j + 1].texCoord] - uv0;
+				float determinant = deltaUV1.x * deltaUV2.y - deltaUV2.x * deltaUV1.y;
+				if (std::abs(determinant) < 1e-12f)
+					continue;
+				float f = 1.0f / determinant;
+				faceTangent += f * (deltaUV2.y * edge1 - deltaUV1.y * edge2);
+				faceBitangent += f * (deltaUV1.x * edge2 - deltaUV2.x * edge1);
+			}
+		}
+
+		for (unsigned int j = 0; j < faceSize; ++j) {
+			const OBJCorner& faceCorner = face[j];
+			glm::vec3 position = file.positions[faceCorner.position];
+			glm::vec3 normal(0.0f);
+			if (hasNormals)
+				normal = file.normals[faceCorner.normal];
+			else if (glm::dot(smoothNormals[faceCorner.position - minPosition], smoothNormals[faceCorner.position - minPosition]) > 0.0f)
+				normal = glm::normalize(smoothNormals[faceCorner.position - minPosition]);
+			glm::vec2 texCoords(0.0f);
+			glm::vec3 tangent(0.0f), bitangent(0.0f);
+			if (hasTexCoords) {
+				texCoords = glm::vec2(file.texCoords[faceCorner.texCoord].x, 1.0f - file.texCoords[faceCorner.texCoord].y);
+				tangent = faceTangent - normal * glm::dot(normal, faceTangent);
+				bitangent = faceBitangent - normal * glm::dot(normal, faceBitangent);
+				if (glm::dot(tangent, tangent) > 0.0f)
+					tangent = glm::normalize(tangent);
+				if (glm::dot(bitangent, bitangent) > 0.0f)
+					bitangent = glm::normalize(bitangent);
+			}
+			new (&vertices[corner + j]) Vertex(position, normal, texCoords, tangent, bitangent);
+			bounds.expand(position);
+		}
+		for (unsigned int j = 1; j + 1 < faceSize; ++j) {
+			*indices++ = corner;
+			*indices++ = corner + j;
+			*indices++ = corner + j + 1;
+		}
+		corner += faceSize;
+	}
+	return bounds;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cstddef>
+#include <glm/glm.hpp>
+#include <assimp/material.h>
+
+#include "Mesh.h"
+#include "Bounds.h"
+#include "MappedFile.h"
+
+//a corner of a face: indices into the file's positions, texture coordinates and normals, -1 for what is absent
+struct OBJCorner {
+	int position, texCoord, normal;
+};
+
+//a run of faces with the same object or group and material, what assimp makes a mesh of
+struct OBJMesh {
+	std::string name; //of the object or group
+	int material; //-1 for none or an unknown name
+	std::size_t firstFace, numFaces;
+	std::size_t firstCorner, numCorners; //the corners of those faces, in order
+	unsigned int numIndices; //after splitting the faces into triangle fans
+};
+
+struct OBJMaterial {
+	std::string name;
+	std::vector<std::pair<aiTextureType, std::string>> textures; //map_Kd, map_Ks, map_Bump and map_Ka, in the file's order
+};
+
+//A parsed .obj file and the .mtl files it references. The .obj is memory-mapped and parsed by several threads at once,
+//each from a newline to a newline: a first pass counts the positions, texture coordinates, normals, faces and corners
+//of every chunk, so the second writes them straight to their place in the shared arrays, in file order whatever the
+//number of threads, and resolves relative (negative) indices on the spot. Points, lines, curves and smoothing groups
+//are ignored
+class OBJFile
+{
+public:
+	std::vector<glm::vec3> positions;
+	std::vector<glm::vec2> texCoords; //as in the file, not flipped
+	std::vector<glm::vec3> normals;
+	std::vector<OBJCorner> corners;
+	std::vector<unsigned int> faceSizes; //corners of every face, at least 3
+	std::vector<OBJMesh> meshes; //in the order of their first face in the file, none without faces
+	std::vector<OBJMaterial> materials;
+
+	//prints the error and returns false for a file that can't be read or has an index out of range. 0 threads: one
+	//per hardware thread, fewer for small files
+	bool open(const std::string& path, unsigned int numThreads = 0);
+	void close(); //frees everything parsed
+
+private:
+	struct Chunk;
+
+	void parseMaterials(const std::string& path);
+};
+
+bool isOBJFile(const std::string& path); //by extension
+//writes the mesh's vertices, one per corner as assimp makes them, and the triangle fan indices of its faces to the given
+//arrays in order, every element once and nothing read back, with the texture coordinates flipped as aiProcess_FlipUVs
+//does. Normals of meshes without them are generated smooth across corners at the same position, tangents from each
+//face's texture coordinates. Returns the bounds of the positions
+AABB convertOBJMesh(const OBJFile& file, const OBJMesh& mesh, Vertex* vertices, unsigned int* indices);
+std::vector<unsigned int> readOBJIndices(const OBJFile& file, const OBJMesh& mesh); //relative to the mesh's first corner
@@ -0,0 +1,367 @@
+#include "OcclusionCuller.h"
+#include "JobSystem.h"
+#include <glm/gtc/matrix_transform.hpp>
+#include <iostream>
+#include <thread>
+#include <random>
+#include <chrono>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define OCCLUSION_CULLER_SSE
+#include <xmmintrin.h>
+#endif
+
+static const float NEAR_W = 1e-4f; //clip-space w below which a vertex counts as behind the camera
+
+//unit cube corners and its 12 triangles
+static const glm::vec3 BOX_CORNERS[8] = {
+	glm::vec3(-0.5f, -0.5f, -0.5f), glm::vec3(0.5f, -0.5f, -0.5f), glm::vec3(0.5f, 0.5f, -0.5f), glm::vec3(-0.5f, 0.5f, -0.5f),
+	glm::vec3(-0.5f, -0.5f, 0.5f), glm::vec3(0.5f, -0.5f, 0.5f), glm::vec3(0.5f, 0.5f, 0.5f), glm::vec3(-0.5f, 0.5f, 0.5f)
+};
+static const unsigned int BOX_INDICES[36] = {
+	0, 2, 1, 0, 3, 2, //back
+	4, 5, 6, 4, 6, 7, //front
+	0, 7, 3, 0, 4, 7, //left
+	1, 2, 6, 1, 6, 5, //right
+	0, 1, 5, 0, 5, 4, //bottom
+	3, 7, 6, 3, 6, 2  //top
+};
+
+OcclusionCuller::OcclusionCuller(unsigned int widthVal, unsigned int heightVal, unsigned int numThreadsVal) :
+	width((std::max(widthVal, 4u) + 3) & ~3u), height(std::max(heightVal, 1u)), numThreads(numThreadsVal),
+	viewProjection(1.0f), rasterBuffer(width * height, 1.0f), depthBuffer(width * height, 1.0f) {
+	if (numThreads == 0)
+		numThreads = std::max(1u, std::thread::hardware_concurrency());
+}
+
+void OcclusionCuller::beginFrame(const glm::mat4& viewProjectionVal) {
+	viewProjection = viewProjectionVal;
+	triangles.clear();
+	std::fill(rasterBuffer.begin(), rasterBuffer.end(), 1.0f);
+}
+
+//transforms the occluder to screen space. Triangles with a vertex behind the camera are dropped: rasterizing less
+//occluder area only makes the culling less aggressive, never wrong
+void OcclusionCuller::addOccluder(const std::vector<glm::vec3>& positions, const std::vector<unsigned int>& indices, const glm::mat4& model) {
+	glm::mat4 modelViewProjection = viewProjection * model;
+	std::vector<glm::vec4> clipPositions(positions.size());
+	for (unsigned int i = 0; i < positions.size(); ++i)
+		clipPositions[i] = modelViewProjection * glm::vec4(positions[i], 1.0f);
+
+	for (unsigned int i = 0; i + 2 < indices.size(); i += 3) {
+		ScreenTriangle triangle;
+		bool behindCamera = false;
+		for (unsigned int v = 0; v < 3; ++v) {
+			const glm::vec4& clip = clipPositions[indices[i + v]];
+			if (clip.w < NEAR_W) {
+				behindCamera = true;
+				break;
+			}
+			glm::vec3 ndc = glm::vec3(clip) / clip.w;
+			triangle.vertices[v] = glm::vec3((ndc.x * 0.5f + 0.5f) * width, (ndc.y * 0.5f + 0.5f) * height, ndc.z * 0.5f + 0.5f);
+		}
+		if (!behindCamera)
+			triangles.push_back(triangle);
+	}
+}
+
+void OcclusionCuller::addOccluderBox(const glm::mat4& model) {
+	static const std::vector<glm::vec3> positions(BOX_CORNERS, BOX_CORNERS + 8);
+	static const std::vector<unsigned int> indices(BOX_INDICES, BOX_INDICES + 36);
+	addOccluder(positions, indices, model);
+}
+
+//every thread owns a horizontal band of the depth buffer and walks the full triangle list, so no two threads ever
+//write the same pixel. The erosion needs the neighbouring bands, so it runs as a second phase after all threads joined
+void OcclusionCuller::rasterizeOccluders() {
+	runInBands(&OcclusionCuller::rasterizeRows);
+	runInBands(&OcclusionCuller::erodeRows);
+}
+
+void OcclusionCuller::runInBands(void (OcclusionCuller::*function)(unsigned int, unsigned int)) {
+	unsigned int numBands = std::min(numThreads, height);
+	unsigned int rowsPerBand = (height + numBands - 1) / numBands;
+
+	std::vector<std::thread> workers;
+	for (unsigned int band = 1; band < numBands; ++band) {
+		unsigned int rowBegin = band * rowsPerBand;
+		unsigned int rowEnd = std::min(height, rowBegin + rowsPerBand);
+		if (rowBegin < rowEnd)
+			workers.push_back(std::thread(function, this, rowBegin, rowEnd));
+	}
+	(this->*function)(0, std::min(height, rowsPerBand));
+
+	for (unsigned int i = 0; i < workers.size(); ++i)
+		workers[i].join();
+}
+
+void OcclusionCuller::rasterizeOccluders(JobSystem& jobSystem) {
+	runInBands(&OcclusionCuller::rasterizeRows, jobSystem);
+	runInBands(&OcclusionCuller::erodeRows, jobSystem);
+}
+
+void OcclusionCuller::runInBands(void (OcclusionCuller::*function)(unsigned int, unsigned int), JobSystem& jobSystem) {
+	unsigned int numBands = std::min(jobSystem.getNumThreads(), height);
+	unsigned int rowsPerBand = (height + numBands - 1) / numBands;
+
+	JobCounter bandsDone;
+	jobSystem.parallelFor(height, rowsPerBand, [this, function](unsigned int rowBegin, unsigned int rowEnd) {
+		(this->*function)(rowBegin, rowEnd);
+	}, &bandsDone);
+	jobSystem.wait(bandsDone);
+}
+
+//rasterizes every occluder triangle whose pixel-center coverage falls into the given rows, keeping the nearest depth.
+//The value written for a triangle is the farthest depth its plane reaches inside the pixel, not the depth at the
+//center. Four horizontally adjacent pixels are processed at once
+void OcclusionCuller::rasterizeRows(unsigned int rowBegin, unsigned int rowEnd) {
+	for (unsigned int t = 0; t < triangles.size(); ++t) {
+		glm::vec3 v0 = triangles[t].vertices[0];
+		glm::vec3 v1 = triangles[t].vertices[1];
+		glm::vec3 v2 = triangles[t].vertices[2];
+
+		//occluders are rasterized regardless of their winding, so orient every triangle counter-clockwise
+		float area = (v1.x - v0.x) * (v2.y - v0.y) - (v1.y - v0.y) * (v2.x - v0.x);
+		if (std::abs(area) < 1e-6f)
+			continue;
+		if (area < 0.0f) {
+			std::swap(v1, v2);
+			area = -area;
+		}
+
+		int minX = std::max(0, (int)std::floor(std::min(v0.x, std::min(v1.x, v2.x))));
+		int maxX = std::min((int)width - 1, (int)std::ceil(std::max(v0.x, std::max(v1.x, v2.x))));
+		int minY = std::max((int)rowBegin, (int)std::floor(std::min(v0.y, std::min(v1.y, v2.y))));
+		int maxY = std::min((int)rowEnd - 1, (int)std::ceil(std::max(v0.y, std::max(v1.y, v2.y))));
+		if (minX > maxX || minY > maxY)
+			continue;
+
+		//edge functions E(p) = A * p.x + B * p.y + C, positive inside; edge i is opposite vertex i
+		const glm::vec3* edgeStart[3] = { &v1, &v2, &v0 };
+		const glm::vec3* edgeEnd[3] = { &v2, &v0, &v1 };
+		float A[3], B[3], C[3];
+		for (unsigned int i = 0; i < 3; ++i) {
+			A[i] = edgeStart[i]->y - edgeEnd[i]->y;
+			B[i] = edgeEnd[i]->x - edgeStart[i]->x;
+			C[i] = -(A[i] * edgeStart[i]->x + B[i] * edgeStart[i]->y);
+		}
+
+		//depth plane from the barycentric weights E_i / area
+		float dzdx = (A[0] * v0.z + A[1] * v1.z + A[2] * v2.z) / area;
+		float dzdy = (B[0] * v0.z + B[1] * v1.z + B[2] * v2.z) / area;
+		float z0 = (C[0] * v0.z + C[1] * v1.z + C[2] * v2.z) / area + 0.5f * (std::abs(dzdx) + std::abs(dzdy));
+
+		for (int y = minY; y <= maxY; ++y) {
+			float* row = &rasterBuffer[y * width];
+			float py = y + 0.5f;
+			int xStart = minX & ~3;
+
+#ifdef OCCLUSION_CULLER_SSE
+			__m128 rowE[3], vA[3];
+			for (unsigned int i = 0; i < 3; ++i) {
+				rowE[i] = _mm_set1_ps(B[i] * py + C[i]);
+				vA[i] = _mm_set1_ps(A[i]);
+			}
+			const __m128 zero = _mm_setzero_ps();
+			const __m128 rowZ = _mm_set1_ps(dzdy * py + z0);
+			const __m128 vdzdx = _mm_set1_ps(dzdx);
+			const __m128 laneOffsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+
+			for (int x = xStart; x <= maxX; x += 4) {
+				__m128 px = _mm_add_ps(_mm_set1_ps((float)x), laneOffsets);
+				__m128 inside = _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(vA[0], px), rowE[0]), zero);
+				inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(vA[1], px), rowE[1]), zero));
+				inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(vA[2], px), rowE[2]), zero));
+				if (_mm_movemask_ps(inside) == 0)
+					continue;
+
+				__m128 z = _mm_add_ps(_mm_mul_ps(vdzdx, px), rowZ);
+				__m128 current = _mm_loadu_ps(row + x);
+				__m128 nearest = _mm_min_ps(current, z);
+				_mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, current)));
+			}
+#else
+			for (int x = xStart; x <= maxX; ++x) {
+				float px = x + 0.5f;
+				bool inside = true;
+				for (unsigned int i = 0; i < 3; ++i)
+					inside = inside && (A[i] * px + B[i] * py + C[i] >= 0.0f);
+				if (inside)
+					row[x] = std::min(row[x], dzdx * px + dzdy * py + z0);
+			}
+#endif
+		}
+	}
+}
+
+//Center sampling also marks pixels the occluder only partially covers. Taking the farthest depth of every 3x3
+//neighbourhood erodes the occluders by one pixel, so a pixel only stays occluded where the occluder covers its
+//neighbours as well. Unlike testing coverage per triangle, this keeps the pixels along edges shared by two triangles
+void OcclusionCuller::erodeRows(unsigned int rowBegin, unsigned int rowEnd) {
+	for (unsigned int y = rowBegin; y < rowEnd; ++y) {
+		const float* rows[3] = {
+			&rasterBuffer[(y > 0 ? y - 1 : y) * width],
+			&rasterBuffer[y * width],
+			&rasterBuffer[(y + 1 < height ? y + 1 : y) * width]
+		};
+		float* output = &depthBuffer[y * width];
+
+		unsigned int x = 0;
+#ifdef OCCLUSION_CULLER_SSE
+		//interior pixels four at a time, the borders fall through to the scalar loop below
+		output[0] = std::max(std::max(rows[0][0], rows[0][1]), std::max(std::max(rows[1][0], rows[1][1]), std::max(rows[2][0], rows[2][1])));
+		for (x = 1; x + 4 < width; x += 4) {
+			__m128 farthest = _mm_setzero_ps();
+			for (unsigned int r = 0; r < 3; ++r) {
+				farthest = _mm_max_ps(farthest, _mm_loadu_ps(rows[r] + x - 1));
+				farthest = _mm_max_ps(farthest, _mm_loadu_ps(rows[r] + x));
+				farthest = _mm_max_ps(farthest, _mm_loadu_ps(rows[r] + x + 1));
+			}
+			_mm_storeu_ps(output + x, farthest);
+		}
+#endif
+		for (; x < width; ++x) {
+			unsigned int left = x > 0 ? x - 1 : x;
+			unsigned int right = x + 1 < width ? x + 1 : x;
+			float farthest = 0.0f;
+			for (unsigned int r = 0; r < 3; ++r)
+				farthest = std::max(farthest, std::max(rows[r][left], std::max(rows[r][x], rows[r][right])));
+			output[x] = farthest;
+		}
+	}
+}
+
+//projects the box and compares its nearest depth against every pixel its screen rectangle touches.
+//Boxes crossing the near plane are always visible
+bool OcclusionCuller::isVisible(const AABB& worldBounds) const {
+	glm::vec2 screenMin(FLT_MAX), screenMax(-FLT_MAX);
+	float nearestDepth = FLT_MAX;
+	for (unsigned int i = 0; i < 8; ++i) {
+		glm::vec3 corner(i & 1 ? worldBounds.max.x : worldBounds.min.x, i & 2 ? worldBounds.max.y : worldBounds.min.y,
+			i & 4 ? worldBounds.max.z : worldBounds.min.z);
+		glm::vec4 clip = viewProjection * glm::vec4(corner, 1.0f);
+		if (clip.w < NEAR_W)
+			return true;
+		glm::vec3 ndc = glm::vec3(clip) / clip.w;
+		glm::vec2 screen((ndc.x * 0.5f + 0.5f) * width, (ndc.y * 0.5f + 0.5f) * height);
+		screenMin = glm::min(screenMin, screen);
+		screenMax = glm::max(screenMax, screen);
+		nearestDepth = std::min(nearestDepth, ndc.z * 0.5f + 0.5f);
+	}
+
+	//entirely off screen or beyond the far plane
+	if (screenMax.x < 0.0f || screenMax.y < 0.0f || screenMin.x >= width || screenMin.y >= height || nearestDepth > 1.0f)
+		return false;
+
+	int minX = std::max(0, (int)std::floor(screenMin.x));
+	int maxX = std::min((int)width - 1, (int)std::floor(screenMax.x));
+	int minY = std::max(0, (int)std::floor(screenMin.y));
+	int maxY = std::min((int)height - 1, (int)std::floor(screenMax.y));
+
+	for (int y = minY; y <= maxY; ++y) {
+		const float* row = &depthBuffer[y * width];
+		int x = minX;
+#ifdef OCCLUSION_CULLER_SSE
+		const __m128 depth = _mm_set1_ps(nearestDepth);
+		for (; x + 3 <= maxX; x += 4) {
+			if (_mm_movemask_ps(_mm_cmpge_ps(_mm_loadu_ps(row + x), depth)) != 0)
+				return true;
+		}
+#endif
+		for (; x <= maxX; ++x) {
+			if (row[x] >= nearestDepth)
+				return true;
+		}
+	}
+	return false;
+}
+
+unsigned int OcclusionCuller::cullObjects(const std::vector<AABB>& worldBounds, std::vector<unsigned int>& objects) const {
+	unsigned int numVisible = 0;
+	for (unsigned int i = 0; i < objects.size(); ++i) {
+		if (isVisible(worldBounds[objects[i]]))
+			objects[numVisible++] = objects[i];
+	}
+	unsigned int numCulled = objects.size() - numVisible;
+	objects.resize(numVisible);
+	return numCulled;
+}
+
+unsigned int OcclusionCuller::getWidth() const {
+	return width;
+}
+
+unsigned int OcclusionCuller::getHeight() const {
+	return height;
+}
+
+unsigned int OcclusionCuller::getNumOccluderTriangles() const {
+	return triangles.size();
+}
+
+const std::vector<float>& OcclusionCuller::getDepthBuffer() const {
+	return depthBuffer;
+}
+
+
+void benchmarkOcclusionCulling() {
+	const unsigned int NUM_OBJECTS = 100000;
+	const unsigned int NUM_RUNS = 50;
+
+	glm::mat4 projection = glm::perspective(glm::radians(60.0f), 2.0f, 0.1f, 500.0f);
+	glm::mat4 view = glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	glm::mat4 viewProjection = projection * view;
+
+	//a row of walls with gaps between them, 20 units in front of the camera
+	std::vector<glm::mat4> occluders;
+	for (int i = -3; i <= 3; ++i) {
+		glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3(i * 10.0f, 0.0f, -20.0f));
+		occluders.push_back(glm::scale(model, glm::vec3(8.0f, 20.0f, 1.0f)));
+	}
+
+	//asteroid-like field of small boxes, most of them behind the walls
+	std::mt19937 generator(7);
+	std::uniform_real_distribution<float> randomX(-150.0f, 150.0f), randomY(-60.0f, 60.0f), randomZ(-300.0f, -5.0f);
+	std::vector<AABB> objectBounds(NUM_OBJECTS);
+	for (unsigned int i = 0; i < NUM_OBJECTS; ++i) {
+		glm::vec3 center(randomX(generator), randomY(generator), randomZ(generator));
+		objectBounds[i] = AABB(center - glm::vec3(0.5f), center + glm::vec3(0.5f));
+	}
+
+	//objects that survive frustum culling are the ones the occlusion test would be run on
+	Frustum frustum(viewProjection);
+	std::vector<unsigned int> inFrustum;
+	for (unsigned int i = 0; i < NUM_OBJECTS; ++i) {
+		if (frustum.intersects(objectBounds[i]))
+			inFrustum.push_back(i);
+	}
+
+	std::cout << "Occlusion culling benchmark: " << NUM_OBJECTS << " objects, " << inFrustum.size() << " in the frustum, "
+		<< occluders.size() * 12 << " occluder triangles" << std::endl;
+
+	unsigned int threadCounts[] = { 1, std::max(1u, std::thread::hardware_concurrency()) };
+	for (unsigned int threads : threadCounts) {
+		OcclusionCuller culler(256, 128, threads);
+		double rasterTime = 0.0, testTime = 0.0; //milliseconds
+		unsigned int numCulled = 0;
+		for (unsigned int run = 0; run < NUM_RUNS; ++run) {
+			auto start = std::chrono::high_resolution_clock::now();
+			culler.beginFrame(viewProjection);
+			for (unsigned int i = 0; i < occluders.size(); ++i)
+				culler.addOccluderBox(occluders[i]);
+			culler.rasterizeOccluders();
+			auto rasterized = std::chrono::high_resolution_clock::now();
+
+			std::vector<unsigned int> visible = inFrustum;
+			numCulled = culler.cullObjects(objectBounds, visible);
+			auto end = std::chrono::high_resolution_clock::now();
+
+			rasterTime += std::chrono::duration<double, std::milli>(rasterized - start).count();
+			testTime += std::chrono::duration<double, std::milli>(end - rasterized).count();
+		}
+
+		std::cout << "    " << threads << " thread(s): rasterize " << rasterTime / NUM_RUNS << " ms, test "
+			<< testTime / NUM_RUNS << " ms, culled " << numCulled << " of " << inFrustum.size() << " ("
+			<< (inFrustum.empty() ? 0.0f : 100.0f * numCulled / inFrustum.size()) << "%)" << std::endl;
+	}
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <vector>
+#include <glm/glm.hpp>
+#include "Bounds.h"
+
+class JobSystem;
+
+//Software occlusion culling on the CPU. Designated occluder meshes are rasterized into a small depth buffer and
+//object bounding boxes are tested against it before they are submitted to the GPU. The buffer is kept conservative
+//by writing the farthest depth a triangle reaches inside each pixel and then eroding the occluders by one pixel, so
+//partially covered pixels along silhouettes never hide anything.
+//Nothing in here touches OpenGL, so the culler can run (and be benchmarked) without a GPU.
+class OcclusionCuller
+{
+public:
+	//width is rounded up to a multiple of 4 (one SSE register of pixels); numThreads = 0 uses every hardware thread
+	OcclusionCuller(unsigned int width = 256, unsigned int height = 128, unsigned int numThreads = 0);
+
+	void beginFrame(const glm::mat4& viewProjection); //clears the occluders and the depth buffer
+	void addOccluder(const std::vector<glm::vec3>& positions, const std::vector<unsigned int>& indices, const glm::mat4& model);
+	void addOccluderBox(const glm::mat4& model); //unit cube centered on the origin, like the tutorials' cube VAO
+	void rasterizeOccluders(); //splits the depth buffer in horizontal bands, one per thread
+	void rasterizeOccluders(JobSystem& jobSystem); //same bands, run as jobs instead of threads started for this call
+
+	bool isVisible(const AABB& worldBounds) const;
+	unsigned int cullObjects(const std::vector<AABB>& worldBounds, std::vector<unsigned int>& objects) const; //removes hidden objects, returns how many
+
+	unsigned int getWidth() const;
+	unsigned int getHeight() const;
+	unsigned int getNumOccluderTriangles() const;
+	const std::vector<float>& getDepthBuffer() const; //row-major, 0 = near plane, 1 = far plane
+
+private:
+	struct ScreenTriangle {
+		glm::vec3 vertices[3]; //x, y in pixels, z in [0, 1]
+	};
+
+	unsigned int width, height;
+	unsigned int numThreads;
+	glm::mat4 viewProjection;
+	std::vector<ScreenTriangle> triangles;
+	std::vector<float> rasterBuffer; //occluders as rasterized
+	std::vector<float> depthBuffer; //eroded copy used by the visibility tests
+
+	void runInBands(void (OcclusionCuller::*function)(unsigned int, unsigned int));
+	void runInBands(void (OcclusionCuller::*function)(unsigned int, unsigned int), JobSystem& jobSystem);
+	void rasterizeRows(unsigned int rowBegin, unsigned int rowEnd);
+	void erodeRows(unsigned int rowBegin, unsigned int rowEnd);
+};
+
+//headless benchmark: walls of occluders in front of a field of randomly placed boxes, rasterized with one thread and
+//with all hardware threads. Prints the culled ratio and the CPU cost of rasterizing and testing
+void benchmarkOcclusionCulling();
@@ -0,0 +1,96 @@
+#include "ProcessMemory.h"
+#include <chrono>
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#include <malloc.h>
+#else
+#include <sys/resource.h>
+#include <unistd.h>
+#include <cstdio>
+#ifdef __APPLE__
+#include <mach/mach.h>
+#endif
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+#endif
+
+std::size_t getResidentBytes() {
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+		return counters.WorkingSetSize;
+	return 0;
+#elif defined(__APPLE__)
+	mach_task_basic_info_data_t info;
+	mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+	if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO, (task_info_t)&info, &count) != KERN_SUCCESS)
+		return 0;
+	return info.resident_size;
+#else
+	//total and resident pages
+	FILE* file = std::fopen("/proc/self/statm", "r");
+	if (!file)
+		return 0;
+	unsigned long size = 0, resident = 0;
+	int numRead = std::fscanf(file, "%lu %lu", &size, &resident);
+	std::fclose(file);
+	return numRead == 2 ? (std::size_t)resident * (std::size_t)sysconf(_SC_PAGESIZE) : 0;
+#endif
+}
+
+std::size_t getPeakResidentBytes() {
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+		return counters.PeakWorkingSetSize;
+	return 0;
+#else
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0)
+		return 0;
+#ifdef __APPLE__
+	return usage.ru_maxrss; //bytes
+#else
+	return (std::size_t)usage.ru_maxrss * 1024; //kilobytes
+#endif
+#endif
+}
+
+
+ResidentMemoryMeter::ResidentMemoryMeter() : peak(0), running(true) {
+#ifdef _WIN32
+	_heapmin();
+#elif defined(__GLIBC__)
+	malloc_trim(0);
+#endif
+	baseline = getResidentBytes();
+	peak = baseline;
+	sampler = std::thread([this]() {
+		while (running.load(std::memory_order_relaxed)) {
+			sample();
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+	});
+}
+
+ResidentMemoryMeter::~ResidentMemoryMeter() {
+	stop();
+}
+
+std::size_t ResidentMemoryMeter::stop() {
+	if (sampler.joinable()) {
+		running = false;
+		sampler.join();
+		sample();
+	}
+	return peak > baseline ? peak - baseline : 0;
+}
+
+void ResidentMemoryMeter::sample() {
+	std::size_t resident = getResidentBytes();
+	if (resident > peak.load(std::memory_order_relaxed))
+		peak.store(resident, std::memory_order_relaxed);
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <atomic>
+#include <thread>
+
+//resident memory (working set on Windows) of the process in bytes, 0 where it can't be queried
+std::size_t getResidentBytes();
+//high-water mark of the process's resident memory (peak working set on Windows) in bytes, 0 where it can't be queried
+std::size_t getPeakResidentBytes();
+
+//Measures how far the process's resident memory rises above where it was when the meter was started, to compare the
+//phases of one run: the process-wide peak never comes down, so it only tells about the largest phase so far. A thread
+//samples the resident memory every millisecond until stop(). Freed heap memory is given back to the system first where
+//the C runtime allows it, so a phase doesn't reuse what an earlier one freed without it showing up
+class ResidentMemoryMeter
+{
+public:
+	ResidentMemoryMeter(); //starts measuring
+	~ResidentMemoryMeter();
+	ResidentMemoryMeter(const ResidentMemoryMeter&) = delete;
+	ResidentMemoryMeter& operator=(const ResidentMemoryMeter&) = delete;
+
+	std::size_t stop(); //the largest rise in bytes, calls after the first return the same
+
+private:
+	std::size_t baseline;
+	std::atomic<std::size_t> peak;
+	std::atomic<bool> running;
+	std::thread sampler;
+
+	void sample();
+};
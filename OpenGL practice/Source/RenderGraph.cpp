@@ -0,0 +1,351 @@
+#include "RenderGraph.h"
+#include <iostream>
+#include <algorithm>
+
+RenderGraph::PassBuilder::PassBuilder(RenderGraph& graphVal, unsigned int passVal) : graph(graphVal), pass(passVal) {
+}
+
+RenderGraph::Resource RenderGraph::PassBuilder::create(const std::string& name, const RenderTargetDesc& desc) {
+	ResourceEntry resource = { name, desc, false, 0, -1, -1 };
+	graph.resources.push_back(resource);
+	return graph.resources.size() - 1;
+}
+
+void RenderGraph::PassBuilder::read(Resource resource) {
+	graph.passes[pass].reads.push_back(resource);
+}
+
+void RenderGraph::PassBuilder::write(Resource resource) {
+	graph.passes[pass].writes.push_back(resource);
+}
+
+void RenderGraph::PassBuilder::writeExternally(Resource resource) {
+	graph.passes[pass].externalWrites.push_back(resource);
+}
+
+void RenderGraph::PassBuilder::writeBackbuffer() {
+	graph.passes[pass].backbuffer = true;
+}
+
+void RenderGraph::PassBuilder::keep() {
+	graph.passes[pass].keep = true;
+}
+
+RenderGraph::RenderGraph(RenderTargetPool& poolVal) : pool(poolVal), compiled(false), numPasses(0), numCulledPasses(0), numTransientTargets(0), numTargetTextures(0),
+	transientMemory(0), aliasedMemory(0) {
+}
+
+RenderGraph::Resource RenderGraph::importTexture(const std::string& name, unsigned int texture, const RenderTargetDesc& desc) {
+	ResourceEntry resource = { name, desc, true, texture, -1, -1 };
+	resources.push_back(resource);
+	return resources.size() - 1;
+}
+
+void RenderGraph::addPass(const std::string& name, const std::function<void(PassBuilder&)>& setup, const ExecuteFunction& execute) {
+	PassEntry pass;
+	pass.name = name;
+	pass.execute = execute;
+	pass.backbuffer = false;
+	pass.keep = false;
+	pass.culled = false;
+	passes.push_back(pass);
+
+	PassBuilder builder(*this, passes.size() - 1);
+	setup(builder);
+	compiled = false;
+}
+
+void RenderGraph::compile() {
+	cullPasses();
+	orderPasses();
+	assignTextures();
+	compiled = true;
+}
+
+//walks the passes backwards: a pass is needed if it has effects outside of the graph or writes something that a
+//needed pass declared after it reads, and the resources it reads become needed in turn
+void RenderGraph::cullPasses() {
+	std::vector<unsigned char> needed(resources.size(), 0);
+	numCulledPasses = 0;
+	for (int i = (int)passes.size() - 1; i >= 0; --i) {
+		PassEntry& pass = passes[i];
+		bool used = pass.keep || pass.backbuffer;
+		for (unsigned int j = 0; j < pass.writes.size() && !used; ++j)
+			used = needed[pass.writes[j]] != 0;
+		for (unsigned int j = 0; j < pass.externalWrites.size() && !used; ++j)
+			used = needed[pass.externalWrites[j]] != 0;
+
+		pass.culled = !used;
+		if (pass.culled) {
+			++numCulledPasses;
+			continue;
+		}
+		for (unsigned int j = 0; j < pass.reads.size(); ++j)
+			needed[pass.reads[j]] = 1;
+	}
+	numPasses = passes.size();
+}
+
+//topological sort of the surviving passes. The dependencies come from the declaration order: a pass depends on the
+//last earlier pass that wrote what it reads or writes, and on the earlier passes that read what it overwrites. Among
+//the passes that are ready, the one that ends the most target lifetimes (minus the ones it starts) goes first, which
+//keeps fewer targets alive at once and gives the aliasing more to share
+void RenderGraph::orderPasses() {
+	std::vector<unsigned int> kept;
+	for (unsigned int i = 0; i < passes.size(); ++i) {
+		if (!passes[i].culled)
+			kept.push_back(i);
+	}
+
+	//resources used by each kept pass, without duplicates
+	std::vector<std::vector<Resource> > uses(kept.size());
+	std::vector<unsigned int> remainingUses(resources.size(), 0);
+	for (unsigned int i = 0; i < kept.size(); ++i) {
+		const PassEntry& pass = passes[kept[i]];
+		uses[i] = pass.reads;
+		uses[i].insert(uses[i].end(), pass.writes.begin(), pass.writes.end());
+		uses[i].insert(uses[i].end(), pass.externalWrites.begin(), pass.externalWrites.end());
+		std::sort(uses[i].begin(), uses[i].end());
+		uses[i].erase(std::unique(uses[i].begin(), uses[i].end()), uses[i].end());
+		for (unsigned int j = 0; j < uses[i].size(); ++j)
+			++remainingUses[uses[i][j]];
+	}
+
+	//dependency edges between kept passes (indices into kept)
+	std::vector<std::vector<unsigned int> > successors(kept.size());
+	std::vector<unsigned int> numPredecessors(kept.size(), 0);
+	std::vector<int> lastWriter(resources.size(), -1);
+	std::vector<std::vector<unsigned int> > readersSinceWrite(resources.size());
+	int lastBackbufferPass = -1;
+	for (unsigned int i = 0; i < kept.size(); ++i) {
+		const PassEntry& pass = passes[kept[i]];
+		std::vector<unsigned int> predecessors;
+		for (unsigned int j = 0; j < pass.reads.size(); ++j) {
+			Resource resource = pass.reads[j];
+			if (lastWriter[resource] >= 0)
+				predecessors.push_back(lastWriter[resource]);
+		}
+		std::vector<Resource> passWrites = pass.writes;
+		passWrites.insert(passWrites.end(), pass.externalWrites.begin(), pass.externalWrites.end());
+		for (unsigned int j = 0; j < passWrites.size(); ++j) {
+			Resource resource = passWrites[j];
+			if (lastWriter[resource] >= 0)
+				predecessors.push_back(lastWriter[resource]);
+			predecessors.insert(predecessors.end(), readersSinceWrite[resource].begin(), readersSinceWrite[resource].end());
+		}
+		if (pass.backbuffer) {
+			if (lastBackbufferPass >= 0)
+				predecessors.push_back(lastBackbufferPass);
+			lastBackbufferPass = i;
+		}
+
+		//update the hazard tracking after the predecessors are known, so a pass never depends on itself
+		for (unsigned int j = 0; j < pass.reads.size(); ++j)
+			readersSinceWrite[pass.reads[j]].push_back(i);
+		for (unsigned int j = 0; j < passWrites.size(); ++j) {
+			lastWriter[passWrites[j]] = i;
+			readersSinceWrite[passWrites[j]].clear();
+		}
+
+		std::sort(predecessors.begin(), predecessors.end());
+		predecessors.erase(std::unique(predecessors.begin(), predecessors.end()), predecessors.end());
+		for (unsigned int j = 0; j < predecessors.size(); ++j) {
+			if (predecessors[j] == i)
+				continue;
+			successors[predecessors[j]].push_back(i);
+			++numPredecessors[i];
+		}
+	}
+
+	std::vector<unsigned int> ready;
+	for (unsigned int i = 0; i < kept.size(); ++i) {
+		if (numPredecessors[i] == 0)
+			ready.push_back(i);
+	}
+	std::vector<unsigned char> started(resources.size(), 0);
+	executionOrder.clear();
+	while (!ready.empty()) {
+		unsigned int best = 0;
+		int bestScore = 0;
+		for (unsigned int i = 0; i < ready.size(); ++i) {
+			int score = 0;
+			const std::vector<Resource>& passUses = uses[ready[i]];
+			for (unsigned int j = 0; j < passUses.size(); ++j) {
+				if (resources[passUses[j]].imported)
+					continue;
+				if (remainingUses[passUses[j]] == 1)
+					++score;
+				if (!started[passUses[j]])
+					--score;
+			}
+			//ties go to the pass declared first, the order the scene was written in
+			if (i == 0 || score > bestScore || (score == bestScore && ready[i] < ready[best])) {
+				best = i;
+				bestScore = score;
+			}
+		}
+
+		unsigned int next = ready[best];
+		ready.erase(ready.begin() + best);
+		executionOrder.push_back(kept[next]);
+		for (unsigned int j = 0; j < uses[next].size(); ++j) {
+			--remainingUses[uses[next][j]];
+			started[uses[next][j]] = 1;
+		}
+		for (unsigned int j = 0; j < successors[next].size(); ++j) {
+			if (--numPredecessors[successors[next][j]] == 0)
+				ready.push_back(successors[next][j]);
+		}
+	}
+}
+
+//hands every transient target a texture for the span of passes between its first and last use. A texture is free
+//again after the last pass of the target holding it, so targets with disjoint lifetimes share it; the pool is only
+//asked for a texture when none of the ones already acquired this frame is free
+void RenderGraph::assignTextures() {
+	for (unsigned int i = 0; i < resources.size(); ++i) {
+		resources[i].firstUse = -1;
+		resources[i].lastUse = -1;
+	}
+	std::vector<std::vector<Resource> > firstUses(executionOrder.size());
+	for (unsigned int position = 0; position < executionOrder.size(); ++position) {
+		const PassEntry& pass = passes[executionOrder[position]];
+		const std::vector<Resource>* lists[3] = { &pass.reads, &pass.writes, &pass.externalWrites };
+		for (unsigned int l = 0; l < 3; ++l) {
+			for (unsigned int j = 0; j < lists[l]->size(); ++j) {
+				ResourceEntry& resource = resources[(*lists[l])[j]];
+				if (resource.firstUse < 0) {
+					resource.firstUse = position;
+					firstUses[position].push_back((*lists[l])[j]);
+				}
+				resource.lastUse = position;
+			}
+		}
+	}
+
+	releaseTargetTextures(); //compiled again without executing
+	numTransientTargets = 0;
+	transientMemory = 0;
+	for (unsigned int position = 0; position < firstUses.size(); ++position) {
+		for (unsigned int j = 0; j < firstUses[position].size(); ++j) {
+			ResourceEntry& resource = resources[firstUses[position][j]];
+			if (resource.imported)
+				continue;
+			++numTransientTargets;
+			transientMemory += RenderTargetPool::getMemory(resource.desc);
+
+			unsigned int index = targetTextures.size();
+			for (unsigned int k = 0; k < targetTextures.size(); ++k) {
+				if (targetTextures[k].busyUntil < (int)position && targetTextures[k].desc == resource.desc) {
+					index = k;
+					break;
+				}
+			}
+
+			if (index == targetTextures.size()) {
+				TargetTexture texture = { pool.acquire(resource.desc), resource.desc, -1 };
+				targetTextures.push_back(texture);
+			}
+			else if (targetTextures[index].desc.filter != resource.desc.filter && resource.desc.samples == 0) {
+				glBindTexture(GL_TEXTURE_2D, targetTextures[index].texture);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, resource.desc.filter);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, resource.desc.filter);
+				glBindTexture(GL_TEXTURE_2D, 0);
+				targetTextures[index].desc.filter = resource.desc.filter;
+			}
+			targetTextures[index].busyUntil = resource.lastUse;
+			resource.texture = targetTextures[index].texture;
+		}
+	}
+
+	numTargetTextures = targetTextures.size();
+	aliasedMemory = 0;
+	for (unsigned int i = 0; i < targetTextures.size(); ++i)
+		aliasedMemory += RenderTargetPool::getMemory(targetTextures[i].desc);
+}
+
+void RenderGraph::execute() {
+	if (!compiled)
+		compile();
+
+	for (unsigned int i = 0; i < executionOrder.size(); ++i) {
+		PassEntry& pass = passes[executionOrder[i]];
+		if (pass.backbuffer) {
+			glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		}
+		else if (!pass.writes.empty()) {
+			glBindFramebuffer(GL_FRAMEBUFFER, getFramebuffer(pass.writes));
+			const RenderTargetDesc& desc = resources[pass.writes[0]].desc;
+			glViewport(0, 0, desc.width, desc.height);
+		}
+		pass.execute(*this);
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	releaseTargetTextures();
+	passes.clear();
+	resources.clear();
+	executionOrder.clear();
+	compiled = false;
+}
+
+void RenderGraph::releaseTargetTextures() {
+	for (unsigned int i = 0; i < targetTextures.size(); ++i)
+		pool.release(targetTextures[i].texture);
+	targetTextures.clear();
+}
+
+unsigned int RenderGraph::getTexture(Resource resource) const {
+	return resources[resource].texture;
+}
+
+const RenderTargetDesc& RenderGraph::getDesc(Resource resource) const {
+	return resources[resource].desc;
+}
+
+unsigned int RenderGraph::getFramebuffer(const std::vector<Resource>& attachments) const {
+	std::vector<unsigned int> textures;
+	std::vector<RenderTargetDesc> descs;
+	for (unsigned int i = 0; i < attachments.size(); ++i) {
+		textures.push_back(resources[attachments[i]].texture);
+		descs.push_back(resources[attachments[i]].desc);
+	}
+	return pool.getFramebuffer(textures, descs);
+}
+
+unsigned int RenderGraph::getNumPasses() const {
+	return numPasses;
+}
+
+unsigned int RenderGraph::getNumCulledPasses() const {
+	return numCulledPasses;
+}
+
+unsigned int RenderGraph::getNumTransientTargets() const {
+	return numTransientTargets;
+}
+
+unsigned int RenderGraph::getNumTargetTextures() const {
+	return numTargetTextures;
+}
+
+std::size_t RenderGraph::getTransientMemory() const {
+	return transientMemory;
+}
+
+std::size_t RenderGraph::getAliasedMemory() const {
+	return aliasedMemory;
+}
+
+void RenderGraph::reportMemory(const std::string& label) {
+	std::pair<std::size_t, std::size_t>& peak = peakMemory[label];
+	if (transientMemory <= peak.first && aliasedMemory <= peak.second)
+		return;
+
+	peak.first = std::max(peak.first, transientMemory);
+	peak.second = std::max(peak.second, aliasedMemory);
+	std::cout << "Render graph (" << label << "): " << numPasses - numCulledPasses << " of " << numPasses << " passes run, "
+		<< numTransientTargets << " transient targets in " << numTargetTextures << " textures, peak render target memory "
+		<< peak.first / (1024.0 * 1024.0) << " MB with one texture per target, " << peak.second / (1024.0 * 1024.0) << " MB aliased"
+		<< std::endl;
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <glad/glad.h>
+#include "RenderTargetPool.h"
+#include <functional>
+#include <string>
+#include <vector>
+#include <map>
+
+//Frame graph for the offscreen passes of a frame. Every frame the passes are declared again along with the render
+//targets they create, read and write. compile() culls the passes whose results nothing uses and orders the remaining
+//ones. It then hands each transient target a texture acquired from a RenderTargetPool, and targets with the same
+//desc whose lifetimes don't overlap share a texture. execute() binds every pass's framebuffer, runs the passes and
+//gives the textures back to the pool, which outlives the frame, so the next frame is handed the same textures.
+class RenderGraph
+{
+public:
+	typedef unsigned int Resource;
+	typedef std::function<void(const RenderGraph&)> ExecuteFunction;
+
+	//declares what a pass creates, reads and writes, handed to the setup function of addPass()
+	class PassBuilder
+	{
+	public:
+		Resource create(const std::string& name, const RenderTargetDesc& desc); //transient target, contents undefined until written
+		void read(Resource resource);
+		void write(Resource resource); //attached to the pass's framebuffer: depth formats as the depth attachment, the others as color attachments in call order
+		void writeExternally(Resource resource); //written by the pass through its own means (own framebuffer, image stores), not attached
+		void writeBackbuffer(); //renders to the default framebuffer, such a pass is never culled
+		void keep(); //the pass has effects outside of the graph and is never culled
+
+	private:
+		friend class RenderGraph;
+		PassBuilder(RenderGraph& graphVal, unsigned int passVal);
+		RenderGraph& graph;
+		unsigned int pass;
+	};
+
+	RenderGraph(RenderTargetPool& poolVal);
+
+	Resource importTexture(const std::string& name, unsigned int texture, const RenderTargetDesc& desc); //persistent texture owned by the caller
+	void addPass(const std::string& name, const std::function<void(PassBuilder&)>& setup, const ExecuteFunction& execute);
+	void compile();
+	void execute(); //runs the compiled passes, then releases their textures and clears them for the next frame
+
+	unsigned int getTexture(Resource resource) const;
+	const RenderTargetDesc& getDesc(Resource resource) const;
+	unsigned int getFramebuffer(const std::vector<Resource>& attachments) const; //cached framebuffer with these targets attached
+
+	//statistics of the last compile
+	unsigned int getNumPasses() const;
+	unsigned int getNumCulledPasses() const;
+	unsigned int getNumTransientTargets() const;
+	unsigned int getNumTargetTextures() const; //pooled textures the transient targets were assigned to
+	std::size_t getTransientMemory() const; //bytes the transient targets would take with one texture each
+	std::size_t getAliasedMemory() const; //bytes of the pooled textures they actually use
+
+	//prints the transient target memory with and without aliasing whenever it reaches a new peak for this label
+	void reportMemory(const std::string& label);
+
+private:
+	struct ResourceEntry {
+		std::string name;
+		RenderTargetDesc desc;
+		bool imported;
+		unsigned int texture; //imported texture, or the pooled one assigned by compile()
+		int firstUse, lastUse; //positions in the execution order
+	};
+
+	struct PassEntry {
+		std::string name;
+		ExecuteFunction execute;
+		std::vector<Resource> reads;
+		std::vector<Resource> writes; //attachments
+		std::vector<Resource> externalWrites;
+		bool backbuffer;
+		bool keep;
+		bool culled;
+	};
+
+	struct TargetTexture {
+		unsigned int texture; //acquired from the pool, released by execute()
+		RenderTargetDesc desc;
+		int busyUntil; //last pass of the execution order that uses it
+	};
+
+	RenderTargetPool& pool;
+	std::vector<ResourceEntry> resources;
+	std::vector<PassEntry> passes;
+	std::vector<unsigned int> executionOrder; //indices of the passes that survived culling
+	std::vector<TargetTexture> targetTextures;
+	std::map<std::string, std::pair<std::size_t, std::size_t> > peakMemory; //label -> peak (transient, aliased) bytes
+	bool compiled;
+
+	//statistics of the last compile, kept after execute() clears the passes
+	unsigned int numPasses, numCulledPasses, numTransientTargets, numTargetTextures;
+	std::size_t transientMemory, aliasedMemory;
+
+	void cullPasses();
+	void orderPasses();
+	void assignTextures();
+	void releaseTargetTextures();
+};
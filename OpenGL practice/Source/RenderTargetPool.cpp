@@ -0,0 +1,231 @@
+#include "RenderTargetPool.h"
+#include <iostream>
+#include <algorithm>
+
+RenderTargetPool::RenderTargetPool() : frame(0) {
+}
+
+unsigned int RenderTargetPool::acquire(const RenderTargetDesc& desc) {
+	unsigned int index = textures.size();
+	for (unsigned int i = 0; i < textures.size(); ++i) {
+		if (!textures[i].inUse && textures[i].desc == desc) {
+			index = i;
+			break;
+		}
+	}
+
+	if (index == textures.size()) {
+		PooledTexture texture;
+		texture.desc = desc;
+		glGenTextures(1, &texture.texture);
+		if (desc.samples > 0) {
+			glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, texture.texture);
+			glTexStorage2DMultisample(GL_TEXTURE_2D_MULTISAMPLE, desc.samples, desc.internalFormat, desc.width, desc.height, GL_TRUE);
+			glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, 0);
+		}
+		else {
+			glBindTexture(GL_TEXTURE_2D, texture.texture);
+			glTexStorage2D(GL_TEXTURE_2D, 1, desc.internalFormat, desc.width, desc.height);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+			glBindTexture(GL_TEXTURE_2D, 0);
+		}
+		textures.push_back(texture);
+	}
+
+	PooledTexture& texture = textures[index];
+	if (desc.samples == 0) {
+		glBindTexture(GL_TEXTURE_2D, texture.texture);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, desc.filter);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, desc.filter);
+		glBindTexture(GL_TEXTURE_2D, 0);
+	}
+	texture.desc.filter = desc.filter;
+	texture.inUse = true;
+	texture.lastUsedFrame = frame;
+	return texture.texture;
+}
+
+void RenderTargetPool::release(unsigned int texture) {
+	int index = findTexture(texture);
+	if (index < 0) {
+		std::cout << "ERROR::RENDER_TARGET_POOL:: Released texture " << texture << " is not pooled!" << std::endl;
+		return;
+	}
+	textures[index].inUse = false;
+	textures[index].lastUsedFrame = frame;
+}
+
+bool RenderTargetPool::reacquire(unsigned int& texture, const RenderTargetDesc& desc) {
+	int index = findTexture(texture);
+	if (index >= 0 && textures[index].desc == desc) {
+		textures[index].lastUsedFrame = frame;
+		return false;
+	}
+
+	if (index >= 0)
+		release(texture);
+	texture = acquire(desc);
+	return true;
+}
+
+//a free texture is superseded when its format was requested at another size this frame and its own size wasn't:
+//the window (or the internal resolution) changed and the old size is not coming back soon
+void RenderTargetPool::endFrame() {
+	for (unsigned int i = 0; i < textures.size();) {
+		const PooledTexture& texture = textures[i];
+		bool remove = false;
+		if (!texture.inUse && texture.lastUsedFrame != frame) {
+			remove = frame - texture.lastUsedFrame > MAX_IDLE_FRAMES;
+			for (unsigned int j = 0; j < textures.size() && !remove; ++j) {
+				const PooledTexture& other = textures[j];
+				remove = other.lastUsedFrame == frame && other.desc.internalFormat == texture.desc.internalFormat
+					&& other.desc.samples == texture.desc.samples
+					&& (other.desc.width != texture.desc.width || other.desc.height != texture.desc.height);
+			}
+		}
+
+		if (remove)
+			deleteTexture(i);
+		else
+			++i;
+	}
+	++frame;
+}
+
+void RenderTargetPool::deleteTexture(unsigned int index) {
+	//framebuffers are cached by the textures attached to them
+	unsigned int texture = textures[index].texture;
+	for (std::map<std::vector<unsigned int>, unsigned int>::iterator it = framebuffers.begin(); it != framebuffers.end();) {
+		if (std::find(it->first.begin(), it->first.end(), texture) != it->first.end()) {
+			glDeleteFramebuffers(1, &it->second);
+			it = framebuffers.erase(it);
+		}
+		else {
+			++it;
+		}
+	}
+	glDeleteTextures(1, &texture);
+	textures.erase(textures.begin() + index);
+}
+
+void RenderTargetPool::releaseTextures() {
+	for (std::map<std::vector<unsigned int>, unsigned int>::iterator it = framebuffers.begin(); it != framebuffers.end(); ++it)
+		glDeleteFramebuffers(1, &it->second);
+	framebuffers.clear();
+	for (unsigned int i = 0; i < textures.size(); ++i)
+		glDeleteTextures(1, &textures[i].texture);
+	textures.clear();
+}
+
+unsigned int RenderTargetPool::getFramebuffer(const std::vector<unsigned int>& attachments) const {
+	std::vector<RenderTargetDesc> descs;
+	for (unsigned int i = 0; i < attachments.size(); ++i)
+		descs.push_back(getDesc(attachments[i]));
+	return getFramebuffer(attachments, descs);
+}
+
+unsigned int RenderTargetPool::getFramebuffer(const std::vector<unsigned int>& attachments, const std::vector<RenderTargetDesc>& descs) const {
+	std::vector<unsigned int> key;
+	std::vector<unsigned int> colorSamples;
+	unsigned int depthTexture = 0;
+	unsigned int depthSamples = 0;
+	GLenum depthAttachment = GL_DEPTH_ATTACHMENT;
+	for (unsigned int i = 0; i < attachments.size(); ++i) {
+		if (isDepthFormat(descs[i].internalFormat)) {
+			depthTexture = attachments[i];
+			depthSamples = descs[i].samples;
+			if (descs[i].internalFormat == GL_DEPTH24_STENCIL8 || descs[i].internalFormat == GL_DEPTH32F_STENCIL8)
+				depthAttachment = GL_DEPTH_STENCIL_ATTACHMENT;
+		}
+		else {
+			key.push_back(attachments[i]);
+			colorSamples.push_back(descs[i].samples);
+		}
+	}
+	unsigned int numColorAttachments = key.size();
+	key.push_back(depthTexture);
+
+	std::map<std::vector<unsigned int>, unsigned int>::const_iterator found = framebuffers.find(key);
+	if (found != framebuffers.end())
+		return found->second;
+
+	unsigned int framebuffer;
+	glGenFramebuffers(1, &framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	std::vector<GLenum> drawBuffers;
+	for (unsigned int i = 0; i < numColorAttachments; ++i) {
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, colorSamples[i] > 0 ? GL_TEXTURE_2D_MULTISAMPLE : GL_TEXTURE_2D, key[i], 0);
+		drawBuffers.push_back(GL_COLOR_ATTACHMENT0 + i);
+	}
+	if (drawBuffers.empty())
+		glDrawBuffer(GL_NONE);
+	else
+		glDrawBuffers(drawBuffers.size(), drawBuffers.data());
+	if (depthTexture != 0)
+		glFramebufferTexture2D(GL_FRAMEBUFFER, depthAttachment, depthSamples > 0 ? GL_TEXTURE_2D_MULTISAMPLE : GL_TEXTURE_2D, depthTexture, 0);
+
+	//check if the framebuffer is complete
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		std::cout << "ERROR::RENDER_TARGET_POOL:: Framebuffer of " << descs[0].width << "x" << descs[0].height << " targets is not complete!" << std::endl;
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	framebuffers[key] = framebuffer;
+	return framebuffer;
+}
+
+const RenderTargetDesc& RenderTargetPool::getDesc(unsigned int texture) const {
+	static const RenderTargetDesc unknown;
+	int index = findTexture(texture);
+	return index >= 0 ? textures[index].desc : unknown;
+}
+
+unsigned int RenderTargetPool::getNumTextures() const {
+	return textures.size();
+}
+
+std::size_t RenderTargetPool::getMemory() const {
+	std::size_t bytes = 0;
+	for (unsigned int i = 0; i < textures.size(); ++i)
+		bytes += getMemory(textures[i].desc);
+	return bytes;
+}
+
+std::size_t RenderTargetPool::getMemory(const RenderTargetDesc& desc) {
+	return (std::size_t)desc.width * desc.height * std::max(desc.samples, 1u) * getBytesPerPixel(desc.internalFormat);
+}
+
+//sizes as the formats are commonly stored, three-channel formats are padded to four
+std::size_t RenderTargetPool::getBytesPerPixel(GLenum internalFormat) {
+	switch (internalFormat) {
+	case GL_R8:
+		return 1;
+	case GL_R16F:
+	case GL_RG8:
+	case GL_DEPTH_COMPONENT16:
+		return 2;
+	case GL_RGBA16F:
+	case GL_RGB16F:
+	case GL_RG32F:
+	case GL_DEPTH32F_STENCIL8:
+		return 8;
+	case GL_RGBA32F:
+	case GL_RGB32F:
+		return 16;
+	default: //GL_R32F, GL_RG16, GL_RG16F, GL_RGBA8, GL_RGB8, GL_SRGB8_ALPHA8, GL_R11F_G11F_B10F, GL_RGB10_A2, 24/32-bit depth
+		return 4;
+	}
+}
+
+bool RenderTargetPool::isDepthFormat(GLenum internalFormat) {
+	return internalFormat == GL_DEPTH_COMPONENT16 || internalFormat == GL_DEPTH_COMPONENT24 || internalFormat == GL_DEPTH_COMPONENT32F
+		|| internalFormat == GL_DEPTH24_STENCIL8 || internalFormat == GL_DEPTH32F_STENCIL8;
+}
+
+int RenderTargetPool::findTexture(unsigned int texture) const {
+	for (unsigned int i = 0; i < textures.size(); ++i) {
+		if (textures[i].texture == texture)
+			return i;
+	}
+	return -1;
+}
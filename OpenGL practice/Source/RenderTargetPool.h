@@ -0,0 +1,73 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <string>
+#include <vector>
+#include <map>
+
+//size, format and sample count of a render target. Two targets can share a pooled texture when these match
+struct RenderTargetDesc {
+	unsigned int width;
+	unsigned int height;
+	GLenum internalFormat; //sized format, textures are allocated with glTexStorage2D(Multisample)
+	GLint filter; //sampling filter, set whenever a texture is handed out so it doesn't prevent sharing
+	unsigned int samples; //0 for a GL_TEXTURE_2D, otherwise a GL_TEXTURE_2D_MULTISAMPLE with this many samples (no filter)
+
+	RenderTargetDesc(unsigned int widthVal = 0, unsigned int heightVal = 0, GLenum internalFormatVal = GL_RGBA8, GLint filterVal = GL_LINEAR,
+		unsigned int samplesVal = 0)
+		: width(widthVal), height(heightVal), internalFormat(internalFormatVal), filter(filterVal), samples(samplesVal) {}
+
+	bool operator==(const RenderTargetDesc& other) const {
+		return width == other.width && height == other.height && internalFormat == other.internalFormat && samples == other.samples;
+	}
+	bool operator!=(const RenderTargetDesc& other) const {
+		return !(*this == other);
+	}
+};
+
+//Pool of render target textures keyed by (size, format, samples). acquire() hands out a free texture matching the desc
+//and only allocates when there is none, release() gives it back. Nothing is reallocated when the window is resized:
+//the next request for the new size allocates lazily, and at the end of the frame the free textures of a format that
+//was requested at another size this frame are deleted, as are the ones no frame has asked for in a while.
+//Persistent targets (history buffers and the like) go through reacquire(), which swaps them only when their desc changed.
+class RenderTargetPool
+{
+public:
+	RenderTargetPool();
+
+	unsigned int acquire(const RenderTargetDesc& desc); //free texture matching desc, created if there is none
+	void release(unsigned int texture); //free for the next acquire(), deleted once it has been idle for a while
+	bool reacquire(unsigned int& texture, const RenderTargetDesc& desc); //returns true when texture was swapped and its contents lost
+	void endFrame(); //deletes the superseded and idle free textures, call once at the end of every frame
+	void releaseTextures(); //deletes every texture and cached framebuffer, the context must still be current
+
+	//cached framebuffer with these textures attached: depth formats as the depth attachment, the others as color
+	//attachments in order. The descs of textures the pool doesn't own are passed in descs
+	unsigned int getFramebuffer(const std::vector<unsigned int>& textures) const;
+	unsigned int getFramebuffer(const std::vector<unsigned int>& textures, const std::vector<RenderTargetDesc>& descs) const;
+
+	const RenderTargetDesc& getDesc(unsigned int texture) const;
+	unsigned int getNumTextures() const;
+	std::size_t getMemory() const; //bytes of every pooled texture, including free ones
+
+	static std::size_t getMemory(const RenderTargetDesc& desc);
+	static std::size_t getBytesPerPixel(GLenum internalFormat);
+	static bool isDepthFormat(GLenum internalFormat);
+
+private:
+	static const unsigned int MAX_IDLE_FRAMES = 60; //free textures unused for this long are deleted
+
+	struct PooledTexture {
+		unsigned int texture;
+		RenderTargetDesc desc;
+		bool inUse;
+		unsigned int lastUsedFrame;
+	};
+
+	std::vector<PooledTexture> textures;
+	mutable std::map<std::vector<unsigned int>, unsigned int> framebuffers; //attached textures (depth last, 0 if none) -> framebuffer
+	unsigned int frame;
+
+	int findTexture(unsigned int texture) const;
+	void deleteTexture(unsigned int index);
+};
@@ -0,0 +1,305 @@
+#include "SceneGraph.h"
+#include "JobSystem.h"
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <iostream>
+#include <algorithm>
+#include <random>
+#include <chrono>
+#include <cmath>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define SCENE_GRAPH_SSE
+#include <xmmintrin.h>
+#endif
+
+#ifdef SCENE_GRAPH_SSE
+//result = a * b for column-major 4x4 matrices: every column of the result is a linear combination of the columns of a
+//weighted by the matching column of b. The pointers must not alias.
+static inline void multiplyMatrixSSE(const float* a, const float* b, float* result) {
+	const __m128 a0 = _mm_loadu_ps(a);
+	const __m128 a1 = _mm_loadu_ps(a + 4);
+	const __m128 a2 = _mm_loadu_ps(a + 8);
+	const __m128 a3 = _mm_loadu_ps(a + 12);
+
+	for (unsigned int j = 0; j < 4; ++j) {
+		const float* bColumn = b + 4 * j;
+		__m128 column = _mm_mul_ps(a0, _mm_set1_ps(bColumn[0]));
+		column = _mm_add_ps(column, _mm_mul_ps(a1, _mm_set1_ps(bColumn[1])));
+		column = _mm_add_ps(column, _mm_mul_ps(a2, _mm_set1_ps(bColumn[2])));
+		column = _mm_add_ps(column, _mm_mul_ps(a3, _mm_set1_ps(bColumn[3])));
+		_mm_storeu_ps(result + 4 * j, column);
+	}
+}
+#endif
+
+SceneGraph::SceneGraph() : maxDepth(0), firstDirty(0), useSIMD(true) {
+}
+
+unsigned int SceneGraph::addNode(int parent, const glm::mat4& localTransform, const std::string& name) {
+	unsigned int node = parents.size();
+	if (parent != NO_PARENT && (parent < 0 || (unsigned int)parent >= node)) {
+		std::cout << "ERROR::SCENE_GRAPH:: Parent " << parent << " of node \"" << name
+			<< "\" does not exist yet, adding it as a root node" << std::endl;
+		parent = NO_PARENT;
+	}
+
+	parents.push_back(parent);
+	localTransforms.push_back(localTransform);
+	worldTransforms.push_back(localTransform);
+	dirtyFlags.push_back(1);
+	names.push_back(name);
+	depths.push_back(parent == NO_PARENT ? 0 : depths[parent] + 1);
+	maxDepth = std::max(maxDepth, depths.back());
+	firstDirty = std::min<std::size_t>(firstDirty, node);
+	return node;
+}
+
+void SceneGraph::setLocalTransform(unsigned int node, const glm::mat4& localTransform) {
+	localTransforms[node] = localTransform;
+	dirtyFlags[node] = 1;
+	firstDirty = std::min<std::size_t>(firstDirty, node);
+}
+
+const glm::mat4& SceneGraph::getLocalTransform(unsigned int node) const {
+	return localTransforms[node];
+}
+
+const glm::mat4& SceneGraph::getWorldTransform(unsigned int node) const {
+	return worldTransforms[node];
+}
+
+int SceneGraph::getParent(unsigned int node) const {
+	return parents[node];
+}
+
+const std::string& SceneGraph::getName(unsigned int node) const {
+	return names[node];
+}
+
+//returns the index of the first node with the given name or NO_PARENT if there is none
+int SceneGraph::findNode(const std::string& name) const {
+	for (unsigned int i = 0; i < names.size(); ++i) {
+		if (names[i] == name)
+			return i;
+	}
+	return NO_PARENT;
+}
+
+std::size_t SceneGraph::size() const {
+	return parents.size();
+}
+
+void SceneGraph::reserve(std::size_t numNodes) {
+	parents.reserve(numNodes);
+	localTransforms.reserve(numNodes);
+	worldTransforms.reserve(numNodes);
+	dirtyFlags.reserve(numNodes);
+	names.reserve(numNodes);
+	depths.reserve(numNodes);
+}
+
+void SceneGraph::clear() {
+	parents.clear();
+	localTransforms.clear();
+	worldTransforms.clear();
+	dirtyFlags.clear();
+	names.clear();
+	depths.clear();
+	dirtyNodes.clear();
+	maxDepth = 0;
+	firstDirty = 0;
+}
+
+//recomputes the world matrices of the dirty nodes and all of their descendants.
+//The gathered list stays in parent-before-child order, which lets the matrix products run as one tight batch over the
+//contiguous arrays.
+unsigned int SceneGraph::updateWorldTransforms() {
+	if (firstDirty >= parents.size())
+		return 0;
+
+	gatherDirtyNodes();
+	computeWorldTransforms(dirtyNodes.data(), dirtyNodes.size());
+	clearDirtyFlags();
+	return dirtyNodes.size();
+}
+
+//the dirty nodes are counting-sorted by depth, then every level is split across the job system once the level
+//above it is complete. Levels smaller than grainSize are computed on the calling thread
+unsigned int SceneGraph::updateWorldTransforms(JobSystem& jobSystem, unsigned int grainSize) {
+	if (firstDirty >= parents.size())
+		return 0;
+
+	gatherDirtyNodes();
+	levelOffsets.assign(maxDepth + 2, 0);
+	for (unsigned int i = 0; i < dirtyNodes.size(); ++i)
+		++levelOffsets[depths[dirtyNodes[i]] + 1];
+	for (unsigned int level = 1; level < levelOffsets.size(); ++level)
+		levelOffsets[level] += levelOffsets[level - 1];
+	levelNodes.resize(dirtyNodes.size());
+	for (unsigned int i = 0; i < dirtyNodes.size(); ++i)
+		levelNodes[levelOffsets[depths[dirtyNodes[i]]]++] = dirtyNodes[i];
+	//the insertion moved every offset to the start of the next level
+	for (unsigned int level = maxDepth + 1; level > 0; --level)
+		levelOffsets[level] = levelOffsets[level - 1];
+	levelOffsets[0] = 0;
+
+	for (unsigned int level = 0; level <= maxDepth; ++level) {
+		const unsigned int* nodes = levelNodes.data() + levelOffsets[level];
+		const unsigned int count = levelOffsets[level + 1] - levelOffsets[level];
+		if (count <= grainSize) {
+			computeWorldTransforms(nodes, count);
+			continue;
+		}
+		JobCounter levelDone;
+		jobSystem.parallelFor(count, grainSize, [this, nodes](unsigned int begin, unsigned int end) {
+			computeWorldTransforms(nodes + begin, end - begin);
+		}, &levelDone);
+		jobSystem.wait(levelDone);
+	}
+
+	clearDirtyFlags();
+	return dirtyNodes.size();
+}
+
+void SceneGraph::updateAllWorldTransforms() {
+	const std::size_t numNodes = parents.size();
+	dirtyNodes.resize(numNodes);
+	for (unsigned int i = 0; i < numNodes; ++i)
+		dirtyNodes[i] = i;
+
+	computeWorldTransforms(dirtyNodes.data(), numNodes);
+
+	std::fill(dirtyFlags.begin(), dirtyFlags.end(), 0);
+	firstDirty = numNodes;
+}
+
+void SceneGraph::setSIMDEnabled(bool enabled) {
+	useSIMD = enabled;
+}
+
+bool SceneGraph::isSIMDEnabled() const {
+	return useSIMD;
+}
+
+//the dirty flags are propagated in the same forward pass that gathers the nodes: a parent always precedes its
+//children, so by the time a node is visited its parent's flag is final
+void SceneGraph::gatherDirtyNodes() {
+	const std::size_t numNodes = parents.size();
+	dirtyNodes.clear();
+	for (std::size_t i = firstDirty; i < numNodes; ++i) {
+		const int parent = parents[i];
+		if (parent != NO_PARENT && dirtyFlags[parent])
+			dirtyFlags[i] = 1;
+		if (dirtyFlags[i])
+			dirtyNodes.push_back(i);
+	}
+}
+
+void SceneGraph::clearDirtyFlags() {
+	for (unsigned int i = 0; i < dirtyNodes.size(); ++i)
+		dirtyFlags[dirtyNodes[i]] = 0;
+	firstDirty = parents.size();
+}
+
+//world = parentWorld * local for the given nodes, which must be in parent-before-child order
+void SceneGraph::computeWorldTransforms(const unsigned int* nodes, std::size_t count) {
+	const int* parentData = parents.data();
+	const glm::mat4* localData = localTransforms.data();
+	glm::mat4* worldData = worldTransforms.data();
+
+#ifdef SCENE_GRAPH_SSE
+	if (useSIMD) {
+		for (std::size_t i = 0; i < count; ++i) {
+			const unsigned int node = nodes[i];
+			const int parent = parentData[node];
+			if (parent == NO_PARENT)
+				worldData[node] = localData[node];
+			else
+				multiplyMatrixSSE(glm::value_ptr(worldData[parent]), glm::value_ptr(localData[node]), glm::value_ptr(worldData[node]));
+		}
+		return;
+	}
+#endif
+
+	for (std::size_t i = 0; i < count; ++i) {
+		const unsigned int node = nodes[i];
+		const int parent = parentData[node];
+		worldData[node] = parent == NO_PARENT ? localData[node] : worldData[parent] * localData[node];
+	}
+}
+
+
+void benchmarkSceneGraph(unsigned int numNodes, float changedFraction, unsigned int numFrames) {
+	if (numNodes == 0 || numFrames == 0)
+		return;
+
+	//build a random tree: every node is attached to a random earlier node
+	std::mt19937 generator(1234);
+	std::uniform_real_distribution<float> randomFloat(-1.0f, 1.0f);
+	SceneGraph sceneGraph;
+	sceneGraph.reserve(numNodes);
+	for (unsigned int i = 0; i < numNodes; ++i) {
+		glm::mat4 local = glm::translate(glm::mat4(1.0f), glm::vec3(randomFloat(generator), randomFloat(generator), randomFloat(generator)));
+		local = glm::rotate(local, randomFloat(generator) * glm::radians(180.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+		sceneGraph.addNode(i == 0 ? SceneGraph::NO_PARENT : (int)(generator() % i), local);
+	}
+	sceneGraph.updateAllWorldTransforms();
+
+	const unsigned int numChanged = std::max(1u, (unsigned int)(numNodes * changedFraction));
+	const char* modeNames[] = { "dirty update (SIMD)", "dirty update (scalar)", "full recompute (SIMD)" };
+	std::vector<glm::mat4> simdResult, scalarResult;
+
+	std::cout << "Scene graph benchmark: " << numNodes << " nodes, " << numChanged << " changed per frame, "
+		<< numFrames << " frames" << std::endl;
+#ifndef SCENE_GRAPH_SSE
+	std::cout << "    (SSE not available in this build, the SIMD modes use the scalar path)" << std::endl;
+#endif
+
+	for (unsigned int mode = 0; mode < 3; ++mode) {
+		//every mode starts from the same hierarchy and applies the same sequence of changes
+		SceneGraph frameGraph = sceneGraph;
+		frameGraph.setSIMDEnabled(mode != 1);
+		std::mt19937 frameGenerator(5678);
+
+		double totalTime = 0.0; //milliseconds
+		unsigned long long totalRecomputed = 0;
+		for (unsigned int frame = 0; frame < numFrames; ++frame) {
+			for (unsigned int i = 0; i < numChanged; ++i) {
+				unsigned int node = frameGenerator() % numNodes;
+				frameGraph.setLocalTransform(node, glm::rotate(frameGraph.getLocalTransform(node), 0.01f, glm::vec3(0.0f, 1.0f, 0.0f)));
+			}
+
+			auto start = std::chrono::high_resolution_clock::now();
+			if (mode == 2) {
+				frameGraph.updateAllWorldTransforms();
+				totalRecomputed += numNodes;
+			}
+			else {
+				totalRecomputed += frameGraph.updateWorldTransforms();
+			}
+			auto end = std::chrono::high_resolution_clock::now();
+			totalTime += std::chrono::duration<double, std::milli>(end - start).count();
+		}
+
+		std::cout << "    " << modeNames[mode] << ": " << totalTime / numFrames << " ms/frame, "
+			<< totalRecomputed / numFrames << " world matrices recomputed/frame" << std::endl;
+
+		std::vector<glm::mat4>& result = mode == 0 ? simdResult : scalarResult;
+		if (mode < 2) {
+			result.resize(numNodes);
+			for (unsigned int i = 0; i < numNodes; ++i)
+				result[i] = frameGraph.getWorldTransform(i);
+		}
+	}
+
+	//sanity check: both update paths must produce the same world matrices
+	float maxDifference = 0.0f;
+	for (unsigned int i = 0; i < numNodes; ++i) {
+		for (unsigned int column = 0; column < 4; ++column) {
+			for (unsigned int row = 0; row < 4; ++row)
+				maxDifference = std::max(maxDifference, std::abs(simdResult[i][column][row] - scalarResult[i][column][row]));
+		}
+	}
+	std::cout << "    max difference between SIMD and scalar world matrices: " << maxDifference << std::endl;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <glm/glm.hpp>
+
+class JobSystem;
+
+//Transform hierarchy stored as a structure of arrays. Nodes are kept in parent-before-child order (a node can only be
+//added after its parent), so world transforms can be resolved with a single forward pass over the arrays.
+//Changing a local transform only flags the node as dirty; updateWorldTransforms() then recomputes the flagged nodes
+//and their descendants and leaves every other world matrix untouched. Nodes of the same depth never depend on each
+//other, so the job system overload recomputes the dirty nodes one depth level at a time, every level in parallel.
+class SceneGraph
+{
+public:
+	static const int NO_PARENT = -1;
+
+	SceneGraph();
+	unsigned int addNode(int parent, const glm::mat4& localTransform = glm::mat4(1.0f), const std::string& name = "");
+	void setLocalTransform(unsigned int node, const glm::mat4& localTransform);
+	const glm::mat4& getLocalTransform(unsigned int node) const;
+	const glm::mat4& getWorldTransform(unsigned int node) const;
+	int getParent(unsigned int node) const;
+	const std::string& getName(unsigned int node) const;
+	int findNode(const std::string& name) const;
+	std::size_t size() const;
+	void reserve(std::size_t numNodes);
+	void clear();
+
+	unsigned int updateWorldTransforms(); //returns the number of world matrices that were recomputed
+	unsigned int updateWorldTransforms(JobSystem& jobSystem, unsigned int grainSize = 256);
+	void updateAllWorldTransforms(); //recomputes every node regardless of its dirty flag (reference path)
+	void setSIMDEnabled(bool enabled);
+	bool isSIMDEnabled() const;
+
+private:
+	//per-node data, indexed by node id
+	std::vector<int> parents;
+	std::vector<glm::mat4> localTransforms;
+	std::vector<glm::mat4> worldTransforms;
+	std::vector<unsigned char> dirtyFlags;
+	std::vector<std::string> names;
+	std::vector<unsigned int> depths; //0 for root nodes
+
+	std::vector<unsigned int> dirtyNodes; //scratch list of nodes to recompute, reused every update
+	std::vector<unsigned int> levelNodes; //dirty nodes sorted by depth for the parallel update
+	std::vector<unsigned int> levelOffsets; //start of every depth level in levelNodes
+	unsigned int maxDepth;
+	std::size_t firstDirty; //no node before this index is dirty
+	bool useSIMD;
+
+	void gatherDirtyNodes();
+	void clearDirtyFlags();
+	void computeWorldTransforms(const unsigned int* nodes, std::size_t count);
+};
+
+//builds a random hierarchy of numNodes nodes, changes changedFraction of the local transforms every frame and
+//prints the average cost of the dirty update (SIMD and scalar) against a full recompute
+void benchmarkSceneGraph(unsigned int numNodes = 100000, float changedFraction = 0.01f, unsigned int numFrames = 200);
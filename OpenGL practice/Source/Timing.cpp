@@ -0,0 +1,31 @@
+#include "Timing.h"
+#include <glad/glad.h>
+#include <iostream>
+
+void beginGPUTimer(GPUTimer& timer) {
+	if (timer.queries[0] == 0)
+		glGenQueries(2, timer.queries);
+	glBeginQuery(GL_TIME_ELAPSED, timer.queries[timer.frame % 2]);
+}
+
+void endGPUTimer(GPUTimer& timer, const char* label, unsigned int reportInterval) {
+	glEndQuery(GL_TIME_ELAPSED);
+
+	//last frame's query has had a whole frame to complete
+	if (timer.frame > 0) {
+		GLuint64 elapsedTime;
+		glGetQueryObjectui64v(timer.queries[(timer.frame + 1) % 2], GL_QUERY_RESULT, &elapsedTime);
+		timer.accumulatedTime += elapsedTime / 1000000.0;
+		if (++timer.timedFrames == reportInterval) {
+			std::cout << label << ": " << timer.accumulatedTime / timer.timedFrames << " ms" << std::endl;
+			timer.accumulatedTime = 0.0;
+			timer.timedFrames = 0;
+		}
+	}
+	++timer.frame;
+}
+
+void resetGPUTimer(GPUTimer& timer) {
+	timer.accumulatedTime = 0.0;
+	timer.timedFrames = 0;
+}
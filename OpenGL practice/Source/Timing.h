@@ -0,0 +1,25 @@
+#pragma once
+
+#include <chrono>
+
+//CPU time since start, for load statistics and the benchmarks
+inline double elapsedMilliseconds(std::chrono::high_resolution_clock::time_point start) {
+	return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+//double-buffered GL_TIME_ELAPSED queries: each result is read back a frame late so that reading it doesn't stall
+struct GPUTimer {
+	unsigned int queries[2] = { 0, 0 };
+	unsigned int frame = 0;
+	double accumulatedTime = 0.0; //milliseconds
+	unsigned int timedFrames = 0;
+};
+
+//starts timing the GPU work issued until the matching endGPUTimer() call. GL_TIME_ELAPSED queries don't nest, so the
+//timed passes must not overlap
+void beginGPUTimer(GPUTimer& timer);
+//stops the timer, accumulates last frame's result and prints it averaged over reportInterval frames after label
+void endGPUTimer(GPUTimer& timer, const char* label, unsigned int reportInterval = 300);
+//drops the accumulated time, used when the timed technique is switched so that two techniques are never averaged
+//together
+void resetGPUTimer(GPUTimer& timer);
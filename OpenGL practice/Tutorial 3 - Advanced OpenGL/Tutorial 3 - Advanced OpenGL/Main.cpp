@@ -9,6 +9,8 @@
 #include <vector>
 #include <map>
 #include <algorithm>
+#include <string>
+#include <cstdlib>
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 #include "Shader.h"
@@ -24,22 +26,40 @@ const unsigned int FRAMEBUFFER_HEIGHT = 600;
 float deltaTime = 0.0f;
 //camera
 Camera newCamera(glm::vec3(0.0f, 0.0f, 3.0f));
+bool OIT_ENABLED = false; //weighted blended order-independent transparency option
+bool GRASS_FIELD_ENABLED = false; //grass field option
+const unsigned int NUM_GRASS_INSTANCES = 10000;
+
+//double-buffered GL_TIME_ELAPSED queries: each result is read back a frame late so that reading it doesn't stall
+struct GPUTimer {
+    unsigned int queries[2] = { 0, 0 };
+    unsigned int frame = 0;
+    double accumulatedTime = 0.0; //milliseconds
+    unsigned int timedFrames = 0;
+};
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void mouse_callback(GLFWwindow* window, double xPos, double yPos);
 void scroll_callback(GLFWwindow* window, double xOffset, double yOffset);
+void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods);
 
 unsigned int textureFromFile(const char* textureFile);
 void processInput(GLFWwindow* window, Shader& shader, Camera& camera);
 void drawTwoContainers(GLuint cubeVAO, const Shader& shader, float scale);
 void createFBO(unsigned int& framebuffer, unsigned int& texColorBuffer);
 void createMSAA_FBO();
+void createOIT_FBO(unsigned int& oitFBO, unsigned int& accumulationTexture, unsigned int& revealageTexture);
+unsigned int createInstancedQuadVAO(unsigned int quadVBO, unsigned int quadEBO, unsigned int& instanceVBO,
+    const std::vector<glm::vec3>& offsets);
+void beginGPUTimer(GPUTimer& timer);
+void endGPUTimer(GPUTimer& timer, const std::string& label, unsigned int reportInterval = 300);
+void resetGPUTimer(GPUTimer& timer);
 
 int main(int argc, char* argv[]) {
     //initialize glfw and set context options
     glfwInit();
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4); //4.0 for per-draw-buffer blend functions (glBlendFunci)
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 0);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 
     //Create window and its associated context
@@ -62,6 +82,7 @@ int main(int argc, char* argv[]) {
     glfwSetFramebufferSizeCallback(window, framebuffer_size_callback); //sets the frambuffer resize callbaclk for the specified window
     glfwSetCursorPosCallback(window, mouse_callback); //registers the mouse_callback function for mouse events
     glfwSetScrollCallback(window, scroll_callback); // registers the scroll_callack function for mouse scroll events
+    glfwSetKeyCallback(window, key_callback);
 
     //glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
 
@@ -78,6 +99,9 @@ int main(int argc, char* argv[]) {
     Shader shader = Shader("depthTesting.vert", "depthTesting.frag");
     Shader shaderSingleColor = Shader("depthTesting.vert", "shaderSingleColor.frag");
     Shader screenShader = Shader("screenShader.vert", "KernelEffectsShader.frag");
+    Shader transparentSortedShader = Shader("transparentInstanced.vert", "transparentSorted.frag");
+    Shader oitShader = Shader("transparentInstanced.vert", "weightedBlendedOIT.frag");
+    Shader oitCompositeShader = Shader("screenShader.vert", "weightedBlendedOITComposite.frag");
     //--------------------------------------------------------------
 
     float cubeVertices[] = {
@@ -168,6 +192,12 @@ int main(int argc, char* argv[]) {
     vegetation.push_back(glm::vec3(0.0f, 0.0f, 0.7f));
     vegetation.push_back(glm::vec3(-0.3f, 0.0f, -2.3f));
     vegetation.push_back(glm::vec3(0.5f, 0.0f, -0.6f));
+
+    //grass field scattered over the floor
+    std::vector<glm::vec3> grassField;
+    srand(1);
+    for (unsigned int i = 0; i < NUM_GRASS_INSTANCES; ++i)
+        grassField.push_back(glm::vec3(-5.0f + 10.0f * rand() / RAND_MAX, 0.0f, -5.0f + 10.0f * rand() / RAND_MAX));
     //--------------------------------------------------------
 
     //create fbo
@@ -255,6 +285,20 @@ int main(int argc, char* argv[]) {
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0); //unbinds ebo
     //--------------------------------------------------------
 
+    //instanced vegetation VAOs: the grass quad plus one position per instance
+    unsigned int windowInstanceVBO, grassInstanceVBO;
+    unsigned int windowInstanceVAO = createInstancedQuadVAO(vegetationVBO, vegetationEBO, windowInstanceVBO, vegetation);
+    unsigned int grassInstanceVAO = createInstancedQuadVAO(vegetationVBO, vegetationEBO, grassInstanceVBO, grassField);
+    //--------------------------------------------------------
+
+    //create weighted blended OIT framebuffer
+    unsigned int oitFBO, accumulationTexture, revealageTexture;
+    createOIT_FBO(oitFBO, accumulationTexture, revealageTexture);
+    GPUTimer transparencyTimer;
+    bool timedOIT = OIT_ENABLED, timedGrassField = GRASS_FIELD_ENABLED;
+    double cpuTransparencyTime = 0.0;
+    //--------------------------------------------------------
+
     //load textures
     unsigned int cubeTexture = textureFromFile("../../Textures/container.jpg"); //textureFromFile("../../Textures/iron_texture.jpg");
     unsigned int floorTexture = textureFromFile("../../Textures/marble.jpg");
@@ -312,22 +356,108 @@ int main(int argc, char* argv[]) {
         //glStencilMask(0xFF); //enable writing to stencil buffer
         //glStencilFunc(GL_ALWAYS, 1, 0xFF); //reset back to all fragment passing the shader
 
-        //draw windows using contents in vegetation VAO
-        shader.activateShader();
+        //draw transparent objects: the windows and, optionally, the grass field
         glDisable(GL_CULL_FACE);
         glEnable(GL_DEPTH_TEST);
         glDisable(GL_STENCIL_TEST);
-        glBindTexture(GL_TEXTURE_2D, windowTexture);
-        glBindVertexArray(vegetationVAO);
-        std::sort(vegetation.begin(), vegetation.end(), [](const glm::vec3& element1, const glm::vec3& element2)->bool {
-            return glm::length2(newCamera.getEye() - element1) > glm::length2(newCamera.getEye() - element2);
-            });
-        for (unsigned int i = 0; i < vegetation.size(); ++i) {
-            glm::mat4 model = glm::mat4(1.0f);
-            model = glm::translate(model, vegetation[i]);
-            shader.setUniformMatrix4("model", model);
-            glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+        glm::mat4 projection = glm::perspective(glm::radians(newCamera.getFOV()), (float)WINDOW_WIDTH / WINDOW_HEIGHT, 0.1f, 100.0f);
+        glm::mat4 view = newCamera.getViewMatrix();
+
+        //the technique or the instance count was switched: restart the timing
+        if (timedOIT != OIT_ENABLED || timedGrassField != GRASS_FIELD_ENABLED) {
+            timedOIT = OIT_ENABLED;
+            timedGrassField = GRASS_FIELD_ENABLED;
+            resetGPUTimer(transparencyTimer);
+            cpuTransparencyTime = 0.0;
+        }
+        beginGPUTimer(transparencyTimer);
+        double cpuStartTime = glfwGetTime();
+
+        if (OIT_ENABLED) {
+            //copy the opaque depth so that transparent fragments hidden by opaque geometry are still rejected
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, oitFBO);
+            glBlitFramebuffer(0, 0, FRAMEBUFFER_WIDTH, FRAMEBUFFER_HEIGHT, 0, 0, FRAMEBUFFER_WIDTH, FRAMEBUFFER_HEIGHT, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+            glBindFramebuffer(GL_FRAMEBUFFER, oitFBO);
+
+            float clearAccumulation[] = { 0.0f, 0.0f, 0.0f, 0.0f };
+            float clearRevealage[] = { 1.0f, 1.0f, 1.0f, 1.0f };
+            glClearBufferfv(GL_COLOR, 0, clearAccumulation);
+            glClearBufferfv(GL_COLOR, 1, clearRevealage);
+
+            //unsorted: accumulation is additive and revealage multiplicative, neither depends on draw order
+            glDepthMask(GL_FALSE);
+            glBlendFunci(0, GL_ONE, GL_ONE);
+            glBlendFunci(1, GL_ZERO, GL_ONE_MINUS_SRC_COLOR);
+
+            oitShader.activateShader();
+            oitShader.setUniformMatrix4("projection", projection);
+            oitShader.setUniformMatrix4("view", view);
+            glBindTexture(GL_TEXTURE_2D, windowTexture);
+            glBindVertexArray(windowInstanceVAO);
+            glDrawElementsInstanced(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0, vegetation.size());
+            if (GRASS_FIELD_ENABLED) {
+                glBindTexture(GL_TEXTURE_2D, grassTexture);
+                glBindVertexArray(grassInstanceVAO);
+                glDrawElementsInstanced(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0, grassField.size());
+            }
+            glDepthMask(GL_TRUE);
+            glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+            //composite the weighted average over the opaque image
+            glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+            glDisable(GL_DEPTH_TEST);
+            oitCompositeShader.activateShader();
+            oitCompositeShader.setUniformInt("accumulationTexture", 0);
+            oitCompositeShader.setUniformInt("revealageTexture", 1);
+            glActiveTexture(GL_TEXTURE1);
+            glBindTexture(GL_TEXTURE_2D, revealageTexture);
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, accumulationTexture);
+            glBindVertexArray(screenQuadVAO);
+            glDrawArrays(GL_TRIANGLES, 0, 6);
+        }
+        else {
+            //grass field: sorted back to front on the CPU every frame and re-uploaded for a single instanced draw
+            if (GRASS_FIELD_ENABLED) {
+                std::sort(grassField.begin(), grassField.end(), [](const glm::vec3& element1, const glm::vec3& element2)->bool {
+                    return glm::length2(newCamera.getEye() - element1) > glm::length2(newCamera.getEye() - element2);
+                    });
+                glBindBuffer(GL_ARRAY_BUFFER, grassInstanceVBO);
+                glBufferSubData(GL_ARRAY_BUFFER, 0, grassField.size() * sizeof(glm::vec3), &grassField[0]);
+                glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+                transparentSortedShader.activateShader();
+                transparentSortedShader.setUniformMatrix4("projection", projection);
+                transparentSortedShader.setUniformMatrix4("view", view);
+                glBindTexture(GL_TEXTURE_2D, grassTexture);
+                glBindVertexArray(grassInstanceVAO);
+                glDrawElementsInstanced(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0, grassField.size());
+            }
+
+            //draw windows using contents in vegetation VAO
+            shader.activateShader();
+            glBindTexture(GL_TEXTURE_2D, windowTexture);
+            glBindVertexArray(vegetationVAO);
+            std::sort(vegetation.begin(), vegetation.end(), [](const glm::vec3& element1, const glm::vec3& element2)->bool {
+                return glm::length2(newCamera.getEye() - element1) > glm::length2(newCamera.getEye() - element2);
+                });
+            for (unsigned int i = 0; i < vegetation.size(); ++i) {
+                glm::mat4 model = glm::mat4(1.0f);
+                model = glm::translate(model, vegetation[i]);
+                shader.setUniformMatrix4("model", model);
+                glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+            }
         }
+
+        unsigned int numTransparentInstances = vegetation.size() + (GRASS_FIELD_ENABLED ? grassField.size() : 0);
+        cpuTransparencyTime += (glfwGetTime() - cpuStartTime) * 1000.0;
+        if (transparencyTimer.timedFrames == 299)
+            std::cout << "Transparent pass CPU time: " << cpuTransparencyTime / 300.0 << " ms" << std::endl;
+        endGPUTimer(transparencyTimer, std::string("Transparent pass (") + (OIT_ENABLED ? "weighted blended OIT" : "sorted blending")
+            + ", " + std::to_string(numTransparentInstances) + " instances)");
+        if (transparencyTimer.timedFrames == 0)
+            cpuTransparencyTime = 0.0;
         glEnable(GL_CULL_FACE);
         //--------------------------------------------------------------------
 
@@ -360,6 +490,10 @@ int main(int argc, char* argv[]) {
     glDeleteBuffers(1, &planeVBO);
     glDeleteBuffers(1, &vegetationVBO);
     glDeleteBuffers(1, &vegetationEBO);
+    glDeleteVertexArrays(1, &windowInstanceVAO);
+    glDeleteVertexArrays(1, &grassInstanceVAO);
+    glDeleteBuffers(1, &windowInstanceVBO);
+    glDeleteBuffers(1, &grassInstanceVBO);
     glDeleteBuffers(1, &screenQuadVBO);
 
     glfwTerminate();
@@ -610,4 +744,163 @@ void createMSAA_FBO() {
 
 }
 
+/* Creates the framebuffer for weighted blended order-independent transparency: an RGBA16F accumulation target
+*   (weighted premultiplied color and weighted alpha) and an R8 revealage target (product of 1 - alpha), plus a depth
+*   buffer that the opaque depth is copied into
+*   Parameters:
+*       oitFBO:                 framebuffer object
+*       accumulationTexture:    color attachment 0
+*       revealageTexture:       color attachment 1
+* */
+void createOIT_FBO(unsigned int& oitFBO, unsigned int& accumulationTexture, unsigned int& revealageTexture) {
+    //setup framebuffer
+    glGenFramebuffers(1, &oitFBO);
+    glBindFramebuffer(GL_FRAMEBUFFER, oitFBO);
+
+    //generate accumulation and revealage textures as color attachments
+    glGenTextures(1, &accumulationTexture);
+    glBindTexture(GL_TEXTURE_2D, accumulationTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, FRAMEBUFFER_WIDTH, FRAMEBUFFER_HEIGHT, 0, GL_RGBA, GL_HALF_FLOAT, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, accumulationTexture, 0);
+
+    glGenTextures(1, &revealageTexture);
+    glBindTexture(GL_TEXTURE_2D, revealageTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, FRAMEBUFFER_WIDTH, FRAMEBUFFER_HEIGHT, 0, GL_RED, GL_UNSIGNED_BYTE, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, revealageTexture, 0);
+    glBindTexture(GL_TEXTURE_2D, 0);//unnbind color buffer from target
+
+    unsigned int attachments[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+    glDrawBuffers(2, attachments);
+    //---------------------------------------
+
+    //create renderbuffer object with the same format as the opaque pass, so its depth can be blitted in
+    unsigned int rbo;
+    glGenRenderbuffers(1, &rbo);
+    glBindRenderbuffer(GL_RENDERBUFFER, rbo);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, FRAMEBUFFER_WIDTH, FRAMEBUFFER_HEIGHT);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);  //unbind rbo
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, rbo);
+    //--------------------------------------------------------
+
+    //check if the framebuffer is complete
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        std::cout << "ERROR::FRAMEBUFFER:: Framebuffer is not complete!" << std::endl;
+    //----------------------------------------------------------------------------------------
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0); //unbined framebuffer
+    //---------------------------------------------------------------------------------------------
+}
+
+/* Creates a VAO drawing the grass quad once per instance, each instance offset by one position of offsets
+*   Parameters:
+*       quadVBO:        vertex buffer of the grass quad
+*       quadEBO:        element buffer of the grass quad
+*       instanceVBO:    created buffer holding the instance positions
+*       offsets:        instance positions
+* */
+unsigned int createInstancedQuadVAO(unsigned int quadVBO, unsigned int quadEBO, unsigned int& instanceVBO,
+    const std::vector<glm::vec3>& offsets) {
+    unsigned int VAO;
+    glGenVertexArrays(1, &VAO);
+    glBindVertexArray(VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, quadEBO);
+
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
+
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
+
+    //instance positions, updated when the sorted path re-orders them
+    glGenBuffers(1, &instanceVBO);
+    glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+    glBufferData(GL_ARRAY_BUFFER, offsets.size() * sizeof(glm::vec3), &offsets[0], GL_DYNAMIC_DRAW);
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0);
+    glVertexAttribDivisor(2, 1); //tells OpenGL to update the attribute in location 2 every (1) instance
+
+    glBindVertexArray(0); //unbinds vao
+    glBindBuffer(GL_ARRAY_BUFFER, 0); //unbinds vbo
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0); //unbinds ebo
+    return VAO;
+}
+
+/* Starts timing the GPU work issued until the matching endGPUTimer() call
+*   Parameters:
+*       timer:  the timer to start
+* */
+void beginGPUTimer(GPUTimer& timer) {
+    if (timer.queries[0] == 0)
+        glGenQueries(2, timer.queries);
+    glBeginQuery(GL_TIME_ELAPSED, timer.queries[timer.frame % 2]);
+}
+
+/* Stops the timer, accumulates last frame's result and prints the average every reportInterval frames
+*   Parameters:
+*       timer:          the timer to stop
+*       label:          printed in front of the average
+*       reportInterval: number of frames averaged per report
+* */
+void endGPUTimer(GPUTimer& timer, const std::string& label, unsigned int reportInterval) {
+    glEndQuery(GL_TIME_ELAPSED);
+
+    //last frame's query has had a whole frame to complete
+    if (timer.frame > 0) {
+        GLuint64 elapsedTime;
+        glGetQueryObjectui64v(timer.queries[(timer.frame + 1) % 2], GL_QUERY_RESULT, &elapsedTime);
+        timer.accumulatedTime += elapsedTime / 1000000.0;
+        if (++timer.timedFrames == reportInterval) {
+            std::cout << label << ": " << timer.accumulatedTime / timer.timedFrames << " ms" << std::endl;
+            timer.accumulatedTime = 0.0;
+            timer.timedFrames = 0;
+        }
+    }
+    ++timer.frame;
+}
+
+/* Drops the accumulated time, used when the timed technique is switched so that two techniques are never averaged
+*   together
+*   Parameters:
+*       timer:  the timer to reset
+* */
+void resetGPUTimer(GPUTimer& timer) {
+    timer.accumulatedTime = 0.0;
+    timer.timedFrames = 0;
+}
+
+/*  Callback to process key events
+*   Parameters:
+*       window:	    The window that received the event.
+*       key:	    The keyboard key that was pressed or released.
+*       scancode:	The system - specific scancode of the key.
+*       action: 	GLFW_PRESS, GLFW_RELEASE or GLFW_REPEAT.Future releases may add more actions.
+*       mods:   	Bit field describing which modifier keys were held down.
+*/
+void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods) {
+    //weighted blended order-independent transparency option
+    if (key == GLFW_KEY_O && action == GLFW_PRESS) {
+        if (OIT_ENABLED) {
+            OIT_ENABLED = false;
+        }
+        else {
+            OIT_ENABLED = true;
+        }
+    }
+
+    //grass field option
+    if (key == GLFW_KEY_F && action == GLFW_PRESS) {
+        if (GRASS_FIELD_ENABLED) {
+            GRASS_FIELD_ENABLED = false;
+        }
+        else {
+            GRASS_FIELD_ENABLED = true;
+        }
+    }
+}
+
 
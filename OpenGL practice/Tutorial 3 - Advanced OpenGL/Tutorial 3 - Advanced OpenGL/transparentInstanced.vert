@@ -0,0 +1,15 @@
+#version 400 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec2 aTexCoord;
+layout (location = 2) in vec3 anOffset; //per-instance position
+
+out vec2 texCoord;
+
+uniform mat4 view;
+uniform mat4 projection;
+
+void main()
+{
+    gl_Position = projection * view * vec4(aPos + anOffset, 1.0);
+    texCoord = aTexCoord;
+}
@@ -0,0 +1,15 @@
+#version 400 core
+
+out vec4 FragColor;
+
+in vec2 texCoord;
+
+uniform sampler2D texture1;
+
+void main()
+{
+	vec4 texColor = texture(texture1, texCoord);
+	if(texColor.a < 0.01)
+		discard;
+	FragColor = texColor;
+}
@@ -0,0 +1,23 @@
+#version 400 core
+
+layout (location = 0) out vec4 accumulation; //sum of weighted premultiplied colors (rgb) and weighted alphas (a)
+layout (location = 1) out float revealage; //product of (1 - alpha), blended with (ZERO, ONE_MINUS_SRC_COLOR)
+
+in vec2 texCoord;
+
+uniform sampler2D texture1;
+
+void main()
+{
+	vec4 texColor = texture(texture1, texCoord);
+	if(texColor.a < 0.01)
+		discard;
+
+	//McGuire and Bavoil's depth weight: nearer and more opaque surfaces dominate the average, clamped to stay
+	//within 16-bit float range
+	float a = texColor.a;
+	float weight = clamp(pow(min(1.0, a * 10.0) + 0.01, 3.0) * 1e8 * pow(1.0 - gl_FragCoord.z * 0.9, 3.0), 1e-2, 3e3);
+
+	accumulation = vec4(texColor.rgb * a, a) * weight;
+	revealage = a;
+}
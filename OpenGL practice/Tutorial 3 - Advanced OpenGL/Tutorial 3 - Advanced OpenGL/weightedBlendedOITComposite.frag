@@ -0,0 +1,20 @@
+#version 400 core
+out vec4 FragColor;
+
+in vec2 texCoord;
+
+uniform sampler2D accumulationTexture;
+uniform sampler2D revealageTexture;
+
+void main()
+{
+	float revealage = texture(revealageTexture, texCoord).r;
+	if(revealage >= 1.0)
+		discard; //no transparent surface covers this pixel
+
+	vec4 accumulation = texture(accumulationTexture, texCoord);
+	vec3 averageColor = accumulation.rgb / max(accumulation.a, 1e-5);
+
+	//blended over the opaque image with (SRC_ALPHA, ONE_MINUS_SRC_ALPHA)
+	FragColor = vec4(averageColor, 1.0 - revealage);
+}
@@ -4,17 +4,29 @@
 #include <glm/gtx/norm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
+#include <glm/gtc/constants.hpp>
 
 #include <iostream>
 #include <vector>
 #include <map>
 #include <algorithm>
+#include <string>
+#include <cmath>
+#include <chrono>
+#include <memory>
+#include <thread>
 //#define STB_IMAGE_IMPLEMENTATION
 //#include "stb_image.h"
 #include "Shader.h"
 #include "Camera.h"
 #include "Light.h"
 #include "Model.h"
+#include "Bounds.h"
+#include "JobSystem.h"
+#include "CommandBuffer.h"
+#include "FrameArena.h"
+#include "GLResource.h"
+#include "Timing.h"
 
 //Window dimensions
 unsigned int WINDOW_WIDTH = 800;
@@ -29,6 +41,84 @@ float deltaTime = 0.0f;
 //camera
 Camera newCamera(glm::vec3(0.0f, 0.0f, 3.0f));
 bool GAMMA_ENABLED = false; //gamma option
+bool CASCADED_SHADOWS_ENABLED = false; //cascaded shadow maps option
+bool SHOW_CASCADES = false; //cascade visualisation option
+unsigned int CASCADE_RESOLUTION = 2048; //resolution of each cascade, cycled between 1024, 2048 and 4096
+bool MULTI_POINT_SHADOWS_ENABLED = false; //many shadowed point lights option
+unsigned int POINT_SHADOW_FACE_BUDGET = 12; //cube faces re-rendered per frame, cycled between 6, 12, 24 and 48
+unsigned int POINT_SHADOW_PATH = 0; //how the omnidirectional shadow cube is rendered, see PointShadowPath
+bool VERTEX_LAYER_SUPPORTED = false; //GL_ARB_shader_viewport_layer_array is available
+bool SCALED_SHADOW_SCENE = false; //adds a grid of small cubes to the omnidirectional shadow scene
+bool PARALLEL_RECORDING_ENABLED = false; //record the shadow cube faces and the main view into command buffers on worker threads
+unsigned int RECORDING_THREADS = 1; //threads recording command buffers, the GL thread included, cycled up to the hardware threads
+bool FRAME_ARENA_ENABLED = true; //the render loop's transient containers and strings come from frameArenas instead of the heap
+
+//per-thread arenas for data that only lives during a frame, reset at the end of every frame
+FrameArenas frameArenas;
+
+//cascaded shadow map settings
+const unsigned int NUM_CASCADES = 4; //must match NUM_CASCADES in the cascaded shadow shaders
+const float SHADOW_DISTANCE = 50.0f; //distance from the camera covered by the cascades
+const float CASCADE_SPLIT_LAMBDA = 0.75f; //blend between logarithmic (1.0) and uniform (0.0) split distances
+
+//multi-light point shadow settings
+const unsigned int MAX_SHADOWED_POINT_LIGHTS = 32; //must match MAX_SHADOWED_POINT_LIGHTS in multiPointShadowLighting.frag
+const unsigned int POINT_SHADOW_RESOLUTION = 256; //width and height of every cube face in the cube map arrays
+const unsigned int NUM_MOVING_CASTERS = 4;
+
+//omnidirectional shadow rendering paths
+enum PointShadowPath {
+    GEOMETRY_SHADER_PATH, //every triangle is amplified into all six faces by depthCubeMapShader.geom
+    VERTEX_LAYER_PATH, //casters culled per face, one instance per visible face, gl_Layer written by the vertex shader
+    SIX_PASS_PATH, //casters culled per face, one pass per face
+    NUM_POINT_SHADOW_PATHS
+};
+const char* POINT_SHADOW_PATH_NAMES[] = { "geometry shader", "vertex shader layer", "six culled passes" };
+
+//a shadow caster as seen by the point shadow scheduler, which culls its bounding sphere against each cube face
+struct ShadowCaster {
+    unsigned int VAO;
+    unsigned int vertexCount;
+    glm::mat4 model;
+    glm::vec3 center; //world-space bounding sphere
+    float radius;
+    bool isStatic; //static casters live in the cached depth and are only re-rendered when that cache is invalidated
+    bool moved; //model matrix changed this frame
+};
+
+//a point light owning one cube of the shadow cube map arrays
+struct ShadowedPointLight {
+    glm::vec3 position;
+    glm::vec3 color;
+    float farPlane; //range of the light
+    unsigned int layer; //cube index in the cube map arrays
+    glm::vec3 cachedPosition; //position the static caster depth was rendered from
+    bool staticValid[6] = { false, false, false, false, false, false }; //static caster depth of the face is cached
+    bool hadMovingCasters[6] = { false, false, false, false, false, false }; //face must be redrawn once they leave it
+    unsigned int lastUpdateFrame[6] = { 0, 0, 0, 0, 0, 0 };
+    float importance = 0.0f;
+};
+
+//uniform block data of one shadow cube face, matches ViewData in the packet shadow depth shaders
+struct ShadowFaceUniforms {
+    glm::mat4 lightSpaceMatrix;
+    glm::vec4 lightPosFarPlane; //xyz: light position, w: far plane
+};
+
+//uniform block data of one main view draw, matches DrawData in packetLighting.vert
+struct SceneDrawUniforms {
+    glm::mat4 model;
+    glm::mat4 normalMatrix;
+};
+
+//averages of the CPU side of a frame, printed every reportInterval frames
+struct CPUFrameTimer {
+    double recordTime = 0.0; //milliseconds from starting the recording jobs until they all finished
+    double replayTime = 0.0; //milliseconds spent uploading and executing the command buffers
+    double frameTime = 0.0; //milliseconds from the start of the frame until the buffers are swapped
+    std::size_t heapAllocations = 0; //operator new calls during the timed frames
+    unsigned int timedFrames = 0;
+};
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void mouse_callback(GLFWwindow* window, double xPos, double yPos);
@@ -42,6 +132,28 @@ void createFBO(unsigned int& framebuffer, unsigned int& texColorBuffer);
 void createDepthMapFBO(unsigned int& depthMapFBO, unsigned int& depthMap);
 void createDepthCubeMapFBO(unsigned int& depthCubeMapFBO, unsigned int& depthCubeMap);
 void createMSAA_FBO(unsigned int& multisampledFBO, unsigned int& msaa_texColorBuffer, unsigned int numSamples);
+void createCascadedShadowMapFBO(unsigned int& cascadedShadowMapFBO, unsigned int& cascadedShadowMap, unsigned int resolution);
+ArenaVector<float> computeCascadeSplits(float nearPlane, float farPlane, unsigned int numCascades, float lambda, FrameArena* arena);
+glm::mat4 computeCascadeMatrix(const glm::mat4& view, float fovY, float aspect, float splitNear, float splitFar,
+    const glm::vec3& lightDirection, unsigned int resolution, float& texelSize);
+void createPointShadowArrays(unsigned int& pointShadowFBO, unsigned int& shadowCubeMapArray,
+    unsigned int& staticShadowCubeMapArray, unsigned int numLights);
+ShadowCaster createShadowCaster(unsigned int VAO, unsigned int vertexCount, const glm::mat4& model,
+    const glm::vec3& localCenter, float localRadius, bool isStatic);
+glm::mat4 cubeFaceMatrix(const glm::vec3& lightPos, unsigned int face, float farPlane);
+bool sphereInCubeFace(const glm::vec3& lightPos, float farPlane, unsigned int face, const glm::vec3& center, float radius);
+unsigned int drawShadowCasters(const ArenaVector<ShadowCaster>& casters, const Shader& shader, const glm::vec3& lightPos,
+    float farPlane, unsigned int face, bool staticCasters);
+unsigned int updatePointShadows(std::vector<ShadowedPointLight>& lights, const ArenaVector<ShadowCaster>& casters,
+    Shader& shader, unsigned int pointShadowFBO, unsigned int shadowCubeMapArray, unsigned int staticShadowCubeMapArray,
+    const glm::vec3& cameraPos, const glm::vec3& cameraForward, unsigned int frame, unsigned int faceBudget);
+unsigned int drawShadowCastersLayered(const ArenaVector<ShadowCaster>& casters, const Shader& shader, const glm::vec3& lightPos,
+    float farPlane);
+void recordShadowFace(CommandBuffer& buffer, const ArenaVector<ShadowCaster>& casters, unsigned int program, const glm::vec3& lightPos,
+    float farPlane, unsigned int face);
+void recordSceneView(CommandBuffer& buffer, const ArenaVector<ShadowCaster>& objects, const ArenaVector<unsigned int>& textures,
+    unsigned int program, const Frustum& frustum);
+void endCPUFrameTimer(CPUFrameTimer& timer, const char* label, unsigned int reportInterval = 300);
 void GLAPIENTRY messageCallback(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length,
     const GLchar* message, const void* userParam);
 
@@ -101,6 +213,20 @@ int main(int argc, char* argv[]) {
     Shader lightSourceShader = Shader("Shaders/lightSourceShader.vert", "Shaders/lightSourceShader.frag");
     Shader basicDepthShader = Shader("Shaders/basicDepthShader.vert", "Shaders/basicDepthShader.frag");
     Shader depthCubeMapShader = Shader("Shaders/depthCubeMapShader.vert", "Shaders/depthCubeMapShader.frag", "Shaders/depthCubeMapShader.geom");
+    Shader cascadedDepthShader = Shader("Shaders/cascadedDepthShader.vert", "Shaders/cascadedDepthShader.frag", "Shaders/cascadedDepthShader.geom");
+    Shader cascadedShadowLightingShader = Shader("Shaders/cascadedShadowLighting.vert", "Shaders/cascadedShadowLighting.frag");
+    Shader pointShadowArrayDepthShader = Shader("Shaders/pointShadowArrayDepth.vert", "Shaders/pointShadowArrayDepth.frag");
+    Shader multiPointShadowLightingShader = Shader("Shaders/cascadedShadowLighting.vert", "Shaders/multiPointShadowLighting.frag");
+    Shader packetShadowDepthShader = Shader("Shaders/packetShadowDepth.vert", "Shaders/packetShadowDepth.frag");
+    Shader packetLightingShader = Shader("Shaders/packetLighting.vert", "Shaders/packetLighting.frag");
+
+    //writing gl_Layer from the vertex shader needs an extension, without it only the other two paths are available
+    VERTEX_LAYER_SUPPORTED = glfwExtensionSupported("GL_ARB_shader_viewport_layer_array");
+    Shader* depthCubeMapLayeredShader = NULL;
+    if (VERTEX_LAYER_SUPPORTED)
+        depthCubeMapLayeredShader = new Shader("Shaders/depthCubeMapLayered.vert", "Shaders/pointShadowArrayDepth.frag");
+    else
+        std::cout << "GL_ARB_shader_viewport_layer_array not supported, vertex shader layer path disabled" << std::endl;
     //----------------------------------------------------------------------------------------------------------
 
     glm::mat4 identityMatrix = glm::mat4(1.0f);
@@ -191,6 +317,31 @@ int main(int argc, char* argv[]) {
 
     DirLight dirLight = DirLight(glm::vec3(-0.2f, -1.0f, -0.3f), glm::vec3(0.05f, 0.05f, 0.05f));
     PointLight pointLight = PointLight(glm::vec3(-2.0f+2, 2.3f-1, -1.0f));// glm::vec3(-1.0f, 0.3f, -0.3f));
+
+    //grid of shadowed point lights over the floor, each owning one cube of the shadow cube map arrays
+    std::vector<ShadowedPointLight> shadowedPointLights;
+    for (unsigned int i = 0; i < 6; ++i) {
+        for (unsigned int j = 0; j < 4; ++j) {
+            ShadowedPointLight light;
+            light.position = glm::vec3(-4.0f + 1.6f * i, 1.0f, -3.0f + 2.0f * j);
+            light.color = lightColours[(i + j) % 4] * 2.0f;
+            light.farPlane = 3.0f;
+            light.layer = shadowedPointLights.size();
+            light.cachedPosition = light.position;
+            shadowedPointLights.push_back(light);
+        }
+    }
+
+    //uniform names of the shadowed point lights, built once so that the lighting pass doesn't build strings every frame
+    std::vector<std::string> pointLightUniformNames;
+    for (unsigned int i = 0; i < shadowedPointLights.size(); ++i) {
+        std::string name = "pointLights[" + std::to_string(i) + "]";
+        pointLightUniformNames.push_back(name + ".position");
+        pointLightUniformNames.push_back(name + ".color");
+        pointLightUniformNames.push_back(name + ".far_plane");
+        pointLightUniformNames.push_back(name + ".layer");
+    }
+    //-----------------------------------------------------------------------------------------
     //-----------------------------------------------------------------------------------------
 
     //setup MSAA_framebuffer
@@ -214,6 +365,21 @@ int main(int argc, char* argv[]) {
     createDepthCubeMapFBO(depthCubeMapFBO, depthCubeMap);
     //------------------------------------------------------------------------------------------------------------
 
+    //setup cascaded shadow map framebuffer
+    unsigned int cascadedShadowMapFBO, cascadedShadowMap;
+    unsigned int cascadeResolution = CASCADE_RESOLUTION; //resolution the depth texture array is currently allocated with
+    createCascadedShadowMapFBO(cascadedShadowMapFBO, cascadedShadowMap, cascadeResolution);
+    GPUTimer cascadeTimer;
+    //------------------------------------------------------------------------------------------------------------
+
+    //setup point shadow cube map arrays: final depth sampled by the lighting pass and cached static caster depth
+    unsigned int pointShadowFBO, shadowCubeMapArray, staticShadowCubeMapArray;
+    createPointShadowArrays(pointShadowFBO, shadowCubeMapArray, staticShadowCubeMapArray, shadowedPointLights.size());
+    GPUTimer pointShadowTimer;
+    unsigned int pointShadowFrame = 0, timedFaceBudget = POINT_SHADOW_FACE_BUDGET;
+    unsigned int facesRendered = 0, facesRenderedFrames = 0;
+    //------------------------------------------------------------------------------------------------------------
+
     //screen quad VAO
     unsigned int screenQuadVAO, screenQuadVBO;
     glGenVertexArrays(1, &screenQuadVAO);
@@ -288,6 +454,42 @@ int main(int argc, char* argv[]) {
     glEnableVertexAttribArray(0);
     //------------------------------------------------------------------------------------------------
 
+    //point shadow casters: the floor, the containers and the raised cube never move, the small cubes orbit them. The
+    //ArenaVectors that live for the whole program have no arena and allocate from the heap
+    ArenaVector<ShadowCaster> shadowCasters;
+    shadowCasters.push_back(createShadowCaster(planeVAO, 6, identityMatrix, glm::vec3(0.0f, -0.5f, 0.0f), 7.08f, true));
+    shadowCasters.push_back(createShadowCaster(cubeVAO, 36, glm::translate(identityMatrix, glm::vec3(-1.0f, 0.0f, -1.0f)), glm::vec3(0.0f), 0.87f, true));
+    shadowCasters.push_back(createShadowCaster(cubeVAO, 36, glm::translate(identityMatrix, glm::vec3(2.0f, 0.0f, 0.0f)), glm::vec3(0.0f), 0.87f, true));
+    shadowCasters.push_back(createShadowCaster(cubeVAO, 36, glm::translate(identityMatrix, glm::vec3(0.0f, 2.0f, 0.0f)), glm::vec3(0.0f), 0.87f, true));
+    unsigned int staticCasterCount = shadowCasters.size();
+    for (unsigned int i = 0; i < NUM_MOVING_CASTERS; ++i)
+        shadowCasters.push_back(createShadowCaster(cubeVAO, 36, identityMatrix, glm::vec3(0.0f), 0.87f, false));
+
+    //scaled-up scene for comparing the omnidirectional shadow paths: a 20x20 grid of small cubes covering the floor
+    ArenaVector<ShadowCaster> scaledSceneCasters;
+    for (unsigned int i = 0; i < 20; ++i) {
+        for (unsigned int j = 0; j < 20; ++j) {
+            glm::mat4 model = glm::translate(identityMatrix, glm::vec3(-4.75f + 0.5f * i, -0.4f, -4.75f + 0.5f * j));
+            model = glm::scale(model, glm::vec3(0.2f));
+            scaledSceneCasters.push_back(createShadowCaster(cubeVAO, 36, model, glm::vec3(0.0f), 0.87f, true));
+        }
+    }
+    GPUTimer omniShadowTimer;
+    unsigned int timedShadowPath = POINT_SHADOW_PATH;
+    bool timedScaledScene = SCALED_SHADOW_SCENE;
+    bool timedParallelRecording = PARALLEL_RECORDING_ENABLED;
+    bool timedFrameArena = FRAME_ARENA_ENABLED;
+
+    //command buffers of the six shadow cube faces and the main view, recorded by the jobs of recordingJobs
+    const unsigned int NUM_RECORDED_VIEWS = 7;
+    std::vector<CommandBuffer> viewCommandBuffers(NUM_RECORDED_VIEWS);
+    CommandBufferExecutor commandBufferExecutor;
+    unsigned int recordingThreads = RECORDING_THREADS;
+    std::unique_ptr<JobSystem> recordingJobs(new JobSystem(recordingThreads - 1));
+    std::vector<const CommandBuffer*> recordedBuffers;
+    CPUFrameTimer cpuFrameTimer;
+    //------------------------------------------------------------------------------------------------
+
     //-----------------------------------------------------------------------------------------------
     //setting up uniform block object 
     //-------------------------------------------------------------------------------------------
@@ -295,11 +497,24 @@ int main(int argc, char* argv[]) {
     unsigned int Shader_uniformBlockIndex = glGetUniformBlockIndex(shader.getProgramId(), "Matrices");
     unsigned int lightSourceShader_uniformBlockIndex = glGetUniformBlockIndex(lightSourceShader.getProgramId(), "Matrices");
     unsigned int lightingShader_uniformBlockIndex = glGetUniformBlockIndex(lightingShader.getProgramId(), "Matrices");
+    unsigned int cascadedShadowLightingShader_uniformBlockIndex = glGetUniformBlockIndex(cascadedShadowLightingShader.getProgramId(), "Matrices");
+    unsigned int multiPointShadowLightingShader_uniformBlockIndex = glGetUniformBlockIndex(multiPointShadowLightingShader.getProgramId(), "Matrices");
 
     //link each shader's uniform block indices to uniform binding point 0
     glUniformBlockBinding(shader.getProgramId(), Shader_uniformBlockIndex, 0); //bind uniform block to binding loc
     glUniformBlockBinding(lightSourceShader.getProgramId(), lightSourceShader_uniformBlockIndex, 0);
     glUniformBlockBinding(lightingShader.getProgramId(), lightingShader_uniformBlockIndex, 0);
+    glUniformBlockBinding(cascadedShadowLightingShader.getProgramId(), cascadedShadowLightingShader_uniformBlockIndex, 0);
+    glUniformBlockBinding(multiPointShadowLightingShader.getProgramId(), multiPointShadowLightingShader_uniformBlockIndex, 0);
+    glUniformBlockBinding(packetLightingShader.getProgramId(), glGetUniformBlockIndex(packetLightingShader.getProgramId(), "Matrices"), 0);
+
+    //the packet shaders read their per-view and per-draw blocks from the ranges the command buffer executor binds
+    glUniformBlockBinding(packetShadowDepthShader.getProgramId(), glGetUniformBlockIndex(packetShadowDepthShader.getProgramId(), "ViewData"),
+        CommandBufferExecutor::VIEW_UNIFORM_BINDING);
+    glUniformBlockBinding(packetShadowDepthShader.getProgramId(), glGetUniformBlockIndex(packetShadowDepthShader.getProgramId(), "DrawData"),
+        CommandBufferExecutor::DRAW_UNIFORM_BINDING);
+    glUniformBlockBinding(packetLightingShader.getProgramId(), glGetUniformBlockIndex(packetLightingShader.getProgramId(), "DrawData"),
+        CommandBufferExecutor::DRAW_UNIFORM_BINDING);
 
     //create ubo buffer
     unsigned int uboMatrices;
@@ -330,6 +545,61 @@ int main(int argc, char* argv[]) {
         lastFrame = currentFrame;
 
         processInput(window, shader, newCamera);
+        auto frameStart = std::chrono::high_resolution_clock::now();
+        std::size_t frameStartAllocations = getHeapAllocationCount();
+
+        //-------------------------------------------------------------------
+        //record command buffers (shadow cube faces and main view) on worker threads
+        //--------------------------------------------------------------------
+        //the thread count was cycled or a mode switched: recreate the job system and restart the timing
+        if (recordingThreads != RECORDING_THREADS || timedParallelRecording != PARALLEL_RECORDING_ENABLED
+            || timedFrameArena != FRAME_ARENA_ENABLED) {
+            if (recordingThreads != RECORDING_THREADS) {
+                recordingThreads = RECORDING_THREADS;
+                recordingJobs.reset(new JobSystem(recordingThreads - 1));
+            }
+            timedFrameArena = FRAME_ARENA_ENABLED;
+            frameArenas.setEnabled(FRAME_ARENA_ENABLED);
+            cpuFrameTimer = CPUFrameTimer();
+        }
+        FrameArena* frameArena = frameArenas.get(); //NULL when disabled: the containers below then use the heap
+
+        float near_plane = 0.1f, far_plane = 7.5f, aspect = (float) SHADOW_WIDTH / SHADOW_HEIGHT;
+
+        //casters of the omnidirectional shadow: the static part of the scene, plus the grid when scaled up
+        ArenaVector<ShadowCaster> omniCasters(shadowCasters.begin(), shadowCasters.begin() + staticCasterCount, frameArena);
+        if (SCALED_SHADOW_SCENE)
+            omniCasters.insert(omniCasters.end(), scaledSceneCasters.begin(), scaledSceneCasters.end());
+
+        //the main view shows the same objects with the floor texture on the floor and the container texture on the rest;
+        //only the single point light's lighting is recorded, the cascaded and multi-light modes are drawn as before
+        bool recordMainView = PARALLEL_RECORDING_ENABLED && !CASCADED_SHADOWS_ENABLED && !MULTI_POINT_SHADOWS_ENABLED;
+        ArenaVector<unsigned int> omniCasterTextures(omniCasters.size(), GAMMA_ENABLED ? cubeTextureGammaCorrected : cubeTexture,
+            frameArena);
+        omniCasterTextures[0] = GAMMA_ENABLED ? floorTextureGammaCorrected : floorTexture;
+        Frustum cameraFrustum(glm::perspective(glm::radians(45.0f), (float)WINDOW_WIDTH / WINDOW_HEIGHT, 0.1f, 1000.0f)
+            * newCamera.getViewMatrix());
+
+        //one job per view: the jobs only read the scene and write their own buffer, and the GL thread renders the
+        //cascades and the other lights' shadows while they run
+        JobCounter recordingDone;
+        auto recordStart = std::chrono::high_resolution_clock::now();
+        if (PARALLEL_RECORDING_ENABLED) {
+            for (unsigned int face = 0; face < 6; ++face) {
+                recordingJobs->run([&, face]() {
+                    recordShadowFace(viewCommandBuffers[face], omniCasters, packetShadowDepthShader.getProgramId(), pointLight.position,
+                        far_plane, face);
+                }, &recordingDone);
+            }
+            if (recordMainView) {
+                recordingJobs->run([&]() {
+                    recordSceneView(viewCommandBuffers[6], omniCasters, omniCasterTextures, packetLightingShader.getProgramId(),
+                        cameraFrustum);
+                }, &recordingDone);
+            }
+        }
+        //-------------------------------------------------------------------
+        //------------------------------------------------------------------------
 
         //---------------------------------------------------------
         //render to depth map (directional shadow mapping)
@@ -365,18 +635,121 @@ int main(int argc, char* argv[]) {
         //-------------------------------------------------------------------
         //------------------------------------------------------------------------
 
+        //-------------------------------------------------------------------
+        //render to cascaded depth map array (cascaded directional shadow mapping)
+        //--------------------------------------------------------------------
+        ArenaVector<glm::mat4> lightSpaceMatrices(frameArena);
+        ArenaVector<float> cascadeSplits(frameArena), cascadeTexelSizes(frameArena);
+        if (CASCADED_SHADOWS_ENABLED) {
+            //the resolution was cycled: reallocate the array and restart the timing
+            if (cascadeResolution != CASCADE_RESOLUTION) {
+                glDeleteFramebuffers(1, &cascadedShadowMapFBO);
+                glDeleteTextures(1, &cascadedShadowMap);
+                cascadeResolution = CASCADE_RESOLUTION;
+                createCascadedShadowMapFBO(cascadedShadowMapFBO, cascadedShadowMap, cascadeResolution);
+                resetGPUTimer(cascadeTimer);
+            }
+
+            //split the camera frustum (same projection as the lighting pass) and fit one light frustum per slice
+            float cameraNear = 0.1f, cameraFOV = glm::radians(45.0f), cameraAspect = (float)WINDOW_WIDTH / WINDOW_HEIGHT;
+            glm::mat4 cameraView = newCamera.getViewMatrix();
+            cascadeSplits = computeCascadeSplits(cameraNear, SHADOW_DISTANCE, NUM_CASCADES, CASCADE_SPLIT_LAMBDA, frameArena);
+            float splitNear = cameraNear;
+            lightSpaceMatrices.reserve(NUM_CASCADES);
+            cascadeTexelSizes.reserve(NUM_CASCADES);
+            for (unsigned int i = 0; i < NUM_CASCADES; ++i) {
+                float texelSize;
+                lightSpaceMatrices.push_back(computeCascadeMatrix(cameraView, cameraFOV, cameraAspect, splitNear, cascadeSplits[i],
+                    dirLight.direction, cascadeResolution, texelSize));
+                cascadeTexelSizes.push_back(texelSize);
+                splitNear = cascadeSplits[i];
+            }
+
+            beginGPUTimer(cascadeTimer);
+            glViewport(0, 0, cascadeResolution, cascadeResolution);
+            glBindFramebuffer(GL_FRAMEBUFFER, cascadedShadowMapFBO);
+            glClear(GL_DEPTH_BUFFER_BIT);
+
+            //one layered pass: the geometry shader replicates every triangle into each cascade's layer
+            cascadedDepthShader.activateShader();
+            glUniformMatrix4fv(glGetUniformLocation(cascadedDepthShader.getProgramId(), "lightSpaceMatrices"), NUM_CASCADES, GL_FALSE,
+                glm::value_ptr(lightSpaceMatrices[0]));
+
+            //render scene 
+            //draw floor
+            glBindVertexArray(planeVAO);
+            cascadedDepthShader.setUniformMatrix4("model", identityMatrix);
+            glDrawArrays(GL_TRIANGLES, 0, 6);
+            //draw containers
+            drawTwoContainers(cubeVAO, cascadedDepthShader, identityMatrix, identityMatrix, 1);
+            drawCube(cubeVAO, cascadedDepthShader, glm::vec3(0.0f, 2.0f, 0.0f), glm::vec3(1, 1, 1));
+
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            ArenaString label("Cascaded shadow pass (", frameArena);
+            label.append(std::to_string(NUM_CASCADES).c_str()).append(" x ").append(std::to_string(cascadeResolution).c_str()).append("^2)");
+            endGPUTimer(cascadeTimer, label.c_str());
+        }
+        //-------------------------------------------------------------------
+        //------------------------------------------------------------------------
+
+        //-------------------------------------------------------------------
+        //render to shadow cube map array (scheduled multi-light omnidirectional shadow mapping)
+        //--------------------------------------------------------------------
+        if (MULTI_POINT_SHADOWS_ENABLED) {
+            //moving casters orbit the containers
+            for (unsigned int i = 0; i < NUM_MOVING_CASTERS; ++i) {
+                float angle = currentFrame * 0.5f + i * glm::half_pi<float>();
+                glm::mat4 model = glm::translate(identityMatrix, glm::vec3(2.5f * std::cos(angle), 0.3f, 2.5f * std::sin(angle)));
+                model = glm::scale(model, glm::vec3(0.3f));
+                bool moved = model != shadowCasters[staticCasterCount + i].model;
+                shadowCasters[staticCasterCount + i] = createShadowCaster(cubeVAO, 36, model, glm::vec3(0.0f), 0.87f, false);
+                shadowCasters[staticCasterCount + i].moved = moved;
+            }
+
+            //the budget was cycled: restart the timing
+            if (timedFaceBudget != POINT_SHADOW_FACE_BUDGET) {
+                timedFaceBudget = POINT_SHADOW_FACE_BUDGET;
+                resetGPUTimer(pointShadowTimer);
+                facesRendered = facesRenderedFrames = 0;
+            }
+
+            beginGPUTimer(pointShadowTimer);
+            facesRendered += updatePointShadows(shadowedPointLights, shadowCasters, pointShadowArrayDepthShader, pointShadowFBO,
+                shadowCubeMapArray, staticShadowCubeMapArray, newCamera.getEye(), newCamera.getForward(), ++pointShadowFrame,
+                POINT_SHADOW_FACE_BUDGET);
+            ArenaString label("Point shadow updates (", frameArena);
+            label.append(std::to_string(shadowedPointLights.size()).c_str()).append(" lights, budget ")
+                .append(std::to_string(POINT_SHADOW_FACE_BUDGET).c_str()).append(" faces)");
+            endGPUTimer(pointShadowTimer, label.c_str());
+            if (++facesRenderedFrames == 300) {
+                std::cout << "Point shadow faces rendered per frame: " << facesRendered / 300.0 << std::endl;
+                facesRendered = facesRenderedFrames = 0;
+            }
+        }
+        //-------------------------------------------------------------------
+        //------------------------------------------------------------------------
+
         //-------------------------------------------------------------------
         //render to depth map(omnidirectional shadow mapping)
         //--------------------------------------------------------------------
+        //the path or the scene was switched: restart the timing
+        if (timedShadowPath != POINT_SHADOW_PATH || timedScaledScene != SCALED_SHADOW_SCENE
+            || timedParallelRecording != PARALLEL_RECORDING_ENABLED) {
+            timedShadowPath = POINT_SHADOW_PATH;
+            timedScaledScene = SCALED_SHADOW_SCENE;
+            timedParallelRecording = PARALLEL_RECORDING_ENABLED;
+            resetGPUTimer(omniShadowTimer);
+        }
+        beginGPUTimer(omniShadowTimer);
+
         glViewport(0, 0, SHADOW_WIDTH, SHADOW_HEIGHT);
         glBindFramebuffer(GL_FRAMEBUFFER, depthCubeMapFBO);
         glClear(GL_DEPTH_BUFFER_BIT);
 
-        depthCubeMapShader.activateShader();
-        float near_plane = 0.1f, far_plane = 7.5f, aspect = (float) SHADOW_WIDTH / SHADOW_HEIGHT;
         glm::mat4 shadowProjection = glm::perspective(glm::radians(90.0f), aspect, near_plane, far_plane);
 
-        std::vector<glm::mat4> shadowTransforms;
+        ArenaVector<glm::mat4> shadowTransforms(frameArena);
+        shadowTransforms.reserve(6);
         shadowTransforms.push_back(shadowProjection *
             glm::lookAt(pointLight.position, pointLight.position + glm::vec3(1.0, 0.0, 0.0), glm::vec3(0.0, -1.0, 0.0)));
         shadowTransforms.push_back(shadowProjection *
@@ -394,20 +767,75 @@ int main(int argc, char* argv[]) {
             glm::vec3(0.0f, 0.0f, 0.0f),
             glm::vec3(0.0f, 1.0f, 0.0f));
 
-        depthCubeMapShader.setUniformVec3("lightPos", pointLight.position);
-        depthCubeMapShader.setUniformFloat("far_plane", far_plane);
-        depthCubeMapShader.setUniformArrayOfMatrix4("shadowMatrices", shadowTransforms);
-
-        //render scene 
-        //draw floor
-        glBindVertexArray(planeVAO);
-        depthCubeMapShader.setUniformMatrix4("model", identityMatrix);
-        glDrawArrays(GL_TRIANGLES, 0, 6);
-        //draw containers
-        drawTwoContainers(cubeVAO, depthCubeMapShader, identityMatrix, identityMatrix, 1);
-        drawCube(cubeVAO, depthCubeMapShader, glm::vec3(0.0f, 2.0f, 0.0f), glm::vec3(1, 1, 1));
+        //replay the recorded faces: all buffers of the frame are uploaded in one go, then each face is attached and executed
+        double replayTime = 0.0; //milliseconds
+        if (PARALLEL_RECORDING_ENABLED) {
+            recordingJobs->wait(recordingDone);
+            cpuFrameTimer.recordTime += elapsedMilliseconds(recordStart);
+
+            auto replayStart = std::chrono::high_resolution_clock::now();
+            recordedBuffers.clear();
+            for (unsigned int i = 0; i < (recordMainView ? NUM_RECORDED_VIEWS : 6); ++i)
+                recordedBuffers.push_back(&viewCommandBuffers[i]);
+            commandBufferExecutor.upload(recordedBuffers);
+            for (unsigned int face = 0; face < 6; ++face) {
+                glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, depthCubeMap, 0);
+                commandBufferExecutor.execute(viewCommandBuffers[face]);
+            }
+            glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depthCubeMap, 0); //restore the layered attachment
+            replayTime += elapsedMilliseconds(replayStart);
+        }
+        else if (POINT_SHADOW_PATH == VERTEX_LAYER_PATH && VERTEX_LAYER_SUPPORTED) {
+            //one instanced draw per caster, covering only the faces it touches
+            depthCubeMapLayeredShader->activateShader();
+            depthCubeMapLayeredShader->setUniformVec3("lightPos", pointLight.position);
+            depthCubeMapLayeredShader->setUniformFloat("far_plane", far_plane);
+            glUniformMatrix4fv(glGetUniformLocation(depthCubeMapLayeredShader->getProgramId(), "shadowMatrices"), 6, GL_FALSE,
+                glm::value_ptr(shadowTransforms[0]));
+            drawShadowCastersLayered(omniCasters, *depthCubeMapLayeredShader, pointLight.position, far_plane);
+        }
+        else if (POINT_SHADOW_PATH == SIX_PASS_PATH) {
+            //one pass per face, each drawing only the casters inside that face
+            pointShadowArrayDepthShader.activateShader();
+            pointShadowArrayDepthShader.setUniformVec3("lightPos", pointLight.position);
+            pointShadowArrayDepthShader.setUniformFloat("far_plane", far_plane);
+            for (unsigned int face = 0; face < 6; ++face) {
+                glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, depthCubeMap, 0);
+                pointShadowArrayDepthShader.setUniformMatrix4("lightSpaceMatrix", shadowTransforms[face]);
+                drawShadowCasters(omniCasters, pointShadowArrayDepthShader, pointLight.position, far_plane, face, true);
+            }
+            glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depthCubeMap, 0); //restore the layered attachment
+        }
+        else {
+            depthCubeMapShader.activateShader();
+            depthCubeMapShader.setUniformVec3("lightPos", pointLight.position);
+            depthCubeMapShader.setUniformFloat("far_plane", far_plane);
+            glUniformMatrix4fv(glGetUniformLocation(depthCubeMapShader.getProgramId(), "shadowMatrices"), 6, GL_FALSE,
+                glm::value_ptr(shadowTransforms[0]));
+
+            //render scene 
+            //draw floor
+            glBindVertexArray(planeVAO);
+            depthCubeMapShader.setUniformMatrix4("model", identityMatrix);
+            glDrawArrays(GL_TRIANGLES, 0, 6);
+            //draw containers
+            drawTwoContainers(cubeVAO, depthCubeMapShader, identityMatrix, identityMatrix, 1);
+            drawCube(cubeVAO, depthCubeMapShader, glm::vec3(0.0f, 2.0f, 0.0f), glm::vec3(1, 1, 1));
+            //draw the grid, the geometry shader sends every triangle to all six faces
+            if (SCALED_SHADOW_SCENE) {
+                for (unsigned int i = 0; i < scaledSceneCasters.size(); ++i) {
+                    depthCubeMapShader.setUniformMatrix4("model", scaledSceneCasters[i].model);
+                    glBindVertexArray(scaledSceneCasters[i].VAO);
+                    glDrawArrays(GL_TRIANGLES, 0, scaledSceneCasters[i].vertexCount);
+                }
+            }
+        }
 
         glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        ArenaString omniShadowLabel("Omnidirectional shadow pass (", frameArena);
+        omniShadowLabel.append(PARALLEL_RECORDING_ENABLED ? "command buffers" : POINT_SHADOW_PATH_NAMES[POINT_SHADOW_PATH]).append(", ")
+            .append(std::to_string(omniCasters.size()).c_str()).append(" casters)");
+        endGPUTimer(omniShadowTimer, omniShadowLabel.c_str());
         //-------------------------------------------------------------------
         //------------------------------------------------------------------------
 
@@ -446,66 +874,159 @@ int main(int argc, char* argv[]) {
         glBindBuffer(GL_UNIFORM_BUFFER, 0);
         //------------------------------------------------------------------------------------
         
-        //activate shader and pass uniforms to it
-        lightingShader.activateShader();
-        lightingShader.setUniformVec3("cameraPos", newCamera.getEye());
-        lightingShader.setUniformInt("gamma", GAMMA_ENABLED);
-
-        //lightingShader.setUniformMatrix4("lightSpaceMatrix", lightSpaceMatrix);
-
-
-        lightingShader.setUniformFloat("near", near_plane);
-        lightingShader.setUniformFloat("far", far_plane);
-
-        //bind depth map to shadow map texture in the shader
-        lightingShader.setUniformInt("shadowMap", 1); 
-        lightingShader.setUniformInt("shadowCubeMap", 1);
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, depthMap);
-        glBindTexture(GL_TEXTURE_CUBE_MAP, depthCubeMap);
-
-        //send point light values to shader
-        lightingShader.setUniformVec3("point_light.position", pointLight.position);
-        lightingShader.setUniformVec3("point_light.ambient", pointLight.ambient);
-        lightingShader.setUniformVec3("point_light.diffuse", pointLight.diffuse);
-        lightingShader.setUniformVec3("point_light.specular", pointLight.specular);
-        lightingShader.setUniformFloat("point_light.constant", pointLight.constant);
-        lightingShader.setUniformFloat("point_light.linear", pointLight.linear);
-        lightingShader.setUniformFloat("point_light.quadratic", pointLight.quadratic);
-        //----------------------------------------------------------------------------------
-
-        //draws floor
-        glStencilMask(0x00); //disable writing to the stencil buffer, prevents floor from affecting the rendering of the cube border
-        glBindVertexArray(planeVAO);
-        glm::mat4 rotationMatrix = glm::rotate(identityMatrix, glm::radians(0.0f), glm::vec3(1.0f, 0.3f, 0.5f));
-        lightingShader.setUniformMatrix4("rotationMatrix", rotationMatrix);
-        lightingShader.setUniformMatrix4("model", identityMatrix);
-
-        //sets material properties
-        lightingShader.setUniformInt("material.diffuseMap", 0);
-        lightingShader.setUniformInt("material.specularMap", 0); //use the floor texture as a specular map
-        lightingShader.setUniformInt("material.emissionMap", 2);
-        lightingShader.setUniformFloat("material.shininess", 64.0f);
-        //-----------------------------------------------------------------------
-
-        glActiveTexture(GL_TEXTURE0); //sets texture unit as the current active texture unit
-        glBindTexture(GL_TEXTURE_2D, GAMMA_ENABLED ? floorTextureGammaCorrected : floorTexture);//binds texture objects to the current active texture unit in texture target
-        glDrawArrays(GL_TRIANGLES, 0, 6);
-        //--------------------------------------------------
-
-        //draw cubes
-        glBindTexture(GL_TEXTURE_2D, GAMMA_ENABLED ? cubeTextureGammaCorrected : cubeTexture); //binds texture objects to the current active texture unit in texture target
-        //glBindTexture(GL_TEXTURE_2D, depthMap);
-        drawTwoContainers(cubeVAO, lightingShader, projection, view, 1);
-        drawCube(cubeVAO, lightingShader, glm::vec3(0.0f, 2.0f, 0.0f), glm::vec3(1, 1, 1));
+        //replay the recorded main view: the per-object state is in the packets, only the per-frame uniforms are set here
+        if (recordMainView) {
+            auto replayStart = std::chrono::high_resolution_clock::now();
+            packetLightingShader.activateShader();
+            packetLightingShader.setUniformVec3("cameraPos", newCamera.getEye());
+            packetLightingShader.setUniformInt("gamma", GAMMA_ENABLED);
+            packetLightingShader.setUniformFloat("far_plane", far_plane);
+            packetLightingShader.setUniformInt("shadowCubeMap", 1);
+            glActiveTexture(GL_TEXTURE1);
+            glBindTexture(GL_TEXTURE_CUBE_MAP, depthCubeMap);
+            packetLightingShader.setUniformVec3("point_light.position", pointLight.position);
+            packetLightingShader.setUniformVec3("point_light.ambient", pointLight.ambient);
+            packetLightingShader.setUniformVec3("point_light.diffuse", pointLight.diffuse);
+            packetLightingShader.setUniformVec3("point_light.specular", pointLight.specular);
+            packetLightingShader.setUniformFloat("point_light.constant", pointLight.constant);
+            packetLightingShader.setUniformFloat("point_light.linear", pointLight.linear);
+            packetLightingShader.setUniformFloat("point_light.quadratic", pointLight.quadratic);
+            packetLightingShader.setUniformInt("material.diffuseMap", 0);
+            packetLightingShader.setUniformInt("material.specularMap", 0);
+            packetLightingShader.setUniformFloat("material.shininess", 64.0f);
+
+            glStencilMask(0x00);
+            commandBufferExecutor.execute(viewCommandBuffers[6]);
+            replayTime += elapsedMilliseconds(replayStart);
+        }
+        else {
+            //activate shader and pass uniforms to it
+            Shader& sceneShader = CASCADED_SHADOWS_ENABLED ? cascadedShadowLightingShader :
+                (MULTI_POINT_SHADOWS_ENABLED ? multiPointShadowLightingShader : lightingShader);
+            sceneShader.activateShader();
+            sceneShader.setUniformVec3("cameraPos", newCamera.getEye());
+            sceneShader.setUniformInt("gamma", GAMMA_ENABLED);
+
+            //send directional light and cascade data to shader
+            if (CASCADED_SHADOWS_ENABLED) {
+                sceneShader.setUniformVec3("dir_light.direction", dirLight.direction);
+                sceneShader.setUniformVec3("dir_light.ambient", dirLight.ambient);
+                sceneShader.setUniformVec3("dir_light.diffuse", dirLight.diffuse);
+                sceneShader.setUniformVec3("dir_light.specular", dirLight.specular);
+                glUniformMatrix4fv(glGetUniformLocation(sceneShader.getProgramId(), "lightSpaceMatrices"), NUM_CASCADES, GL_FALSE,
+                    glm::value_ptr(lightSpaceMatrices[0]));
+                glUniform1fv(glGetUniformLocation(sceneShader.getProgramId(), "cascadeSplits"), NUM_CASCADES, cascadeSplits.data());
+                glUniform1fv(glGetUniformLocation(sceneShader.getProgramId(), "cascadeTexelSizes"), NUM_CASCADES, cascadeTexelSizes.data());
+                sceneShader.setUniformInt("showCascades", SHOW_CASCADES);
+                sceneShader.setUniformInt("cascadedShadowMap", 3);
+                glActiveTexture(GL_TEXTURE3);
+                glBindTexture(GL_TEXTURE_2D_ARRAY, cascadedShadowMap);
+            }
+            //send shadowed point lights to shader
+            else if (MULTI_POINT_SHADOWS_ENABLED) {
+                sceneShader.setUniformVec3("ambient", glm::vec3(0.05f));
+                sceneShader.setUniformInt("numPointLights", shadowedPointLights.size());
+                for (unsigned int i = 0; i < shadowedPointLights.size(); ++i) {
+                    sceneShader.setUniformVec3(pointLightUniformNames[4 * i], shadowedPointLights[i].position);
+                    sceneShader.setUniformVec3(pointLightUniformNames[4 * i + 1], shadowedPointLights[i].color);
+                    sceneShader.setUniformFloat(pointLightUniformNames[4 * i + 2], shadowedPointLights[i].farPlane);
+                    sceneShader.setUniformInt(pointLightUniformNames[4 * i + 3], shadowedPointLights[i].layer);
+                }
+                sceneShader.setUniformInt("shadowCubeMapArray", 4);
+                glActiveTexture(GL_TEXTURE4);
+                glBindTexture(GL_TEXTURE_CUBE_MAP_ARRAY, shadowCubeMapArray);
+            }
+
+            //lightingShader.setUniformMatrix4("lightSpaceMatrix", lightSpaceMatrix);
+
+
+            sceneShader.setUniformFloat("near", near_plane);
+            sceneShader.setUniformFloat("far", far_plane);
+
+            //bind depth map to shadow map texture in the shader
+            sceneShader.setUniformInt("shadowMap", 1); 
+            sceneShader.setUniformInt("shadowCubeMap", 1);
+            glActiveTexture(GL_TEXTURE1);
+            glBindTexture(GL_TEXTURE_2D, depthMap);
+            glBindTexture(GL_TEXTURE_CUBE_MAP, depthCubeMap);
+
+            //send point light values to shader
+            sceneShader.setUniformVec3("point_light.position", pointLight.position);
+            sceneShader.setUniformVec3("point_light.ambient", pointLight.ambient);
+            sceneShader.setUniformVec3("point_light.diffuse", pointLight.diffuse);
+            sceneShader.setUniformVec3("point_light.specular", pointLight.specular);
+            sceneShader.setUniformFloat("point_light.constant", pointLight.constant);
+            sceneShader.setUniformFloat("point_light.linear", pointLight.linear);
+            sceneShader.setUniformFloat("point_light.quadratic", pointLight.quadratic);
+            //----------------------------------------------------------------------------------
+
+            //draws floor
+            glStencilMask(0x00); //disable writing to the stencil buffer, prevents floor from affecting the rendering of the cube border
+            glBindVertexArray(planeVAO);
+            glm::mat4 rotationMatrix = glm::rotate(identityMatrix, glm::radians(0.0f), glm::vec3(1.0f, 0.3f, 0.5f));
+            sceneShader.setUniformMatrix4("rotationMatrix", rotationMatrix);
+            sceneShader.setUniformMatrix4("model", identityMatrix);
+
+            //sets material properties
+            sceneShader.setUniformInt("material.diffuseMap", 0);
+            sceneShader.setUniformInt("material.specularMap", 0); //use the floor texture as a specular map
+            sceneShader.setUniformInt("material.emissionMap", 2);
+            sceneShader.setUniformFloat("material.shininess", 64.0f);
+            //-----------------------------------------------------------------------
+
+            glActiveTexture(GL_TEXTURE0); //sets texture unit as the current active texture unit
+            glBindTexture(GL_TEXTURE_2D, GAMMA_ENABLED ? floorTextureGammaCorrected : floorTexture);//binds texture objects to the current active texture unit in texture target
+            glDrawArrays(GL_TRIANGLES, 0, 6);
+            //--------------------------------------------------
+
+            //draw cubes
+            glBindTexture(GL_TEXTURE_2D, GAMMA_ENABLED ? cubeTextureGammaCorrected : cubeTexture); //binds texture objects to the current active texture unit in texture target
+            //glBindTexture(GL_TEXTURE_2D, depthMap);
+            drawTwoContainers(cubeVAO, sceneShader, projection, view, 1);
+            drawCube(cubeVAO, sceneShader, glm::vec3(0.0f, 2.0f, 0.0f), glm::vec3(1, 1, 1));
+            if (SCALED_SHADOW_SCENE) {
+                for (unsigned int i = 0; i < scaledSceneCasters.size(); ++i) {
+                    sceneShader.setUniformMatrix4("model", scaledSceneCasters[i].model);
+                    glBindVertexArray(scaledSceneCasters[i].VAO);
+                    glDrawArrays(GL_TRIANGLES, 0, scaledSceneCasters[i].vertexCount);
+                }
+            }
+            if (MULTI_POINT_SHADOWS_ENABLED) {
+                for (unsigned int i = staticCasterCount; i < shadowCasters.size(); ++i) {
+                    sceneShader.setUniformMatrix4("model", shadowCasters[i].model);
+                    glBindVertexArray(shadowCasters[i].VAO);
+                    glDrawArrays(GL_TRIANGLES, 0, shadowCasters[i].vertexCount);
+                }
+            }
+        }
         //-----------------------------------------------------------------------------------
 
         //Draw Point light
         lightSourceShader.activateShader();
         drawCube(lightObjectVAO, lightSourceShader, pointLight.position, glm::vec3(0.2, 0.2, 0.2));
         lightSourceShader.setUniformVec3("lightColor", pointLight.diffuse);
+        if (MULTI_POINT_SHADOWS_ENABLED) {
+            for (unsigned int i = 0; i < shadowedPointLights.size(); ++i) {
+                lightSourceShader.setUniformVec3("lightColor", shadowedPointLights[i].color);
+                drawCube(lightObjectVAO, lightSourceShader, shadowedPointLights[i].position, glm::vec3(0.1, 0.1, 0.1));
+            }
+        }
         //------------------------------------------------------------------------------------------------
 
+        //the recording jobs reference this frame's locals, they must be done before the iteration ends
+        recordingJobs->wait(recordingDone);
+        cpuFrameTimer.replayTime += replayTime;
+        cpuFrameTimer.frameTime += elapsedMilliseconds(frameStart);
+        ArenaString cpuFrameLabel(PARALLEL_RECORDING_ENABLED ? "command buffers, " : "immediate", frameArena);
+        if (PARALLEL_RECORDING_ENABLED)
+            cpuFrameLabel.append(std::to_string(recordingThreads).c_str()).append(" recording thread(s)");
+        cpuFrameLabel.append(FRAME_ARENA_ENABLED ? ", frame arenas" : ", heap");
+        cpuFrameTimer.heapAllocations += getHeapAllocationCount() - frameStartAllocations;
+        endCPUFrameTimer(cpuFrameTimer, cpuFrameLabel.c_str());
+
+        //everything the jobs and the GL thread allocated from the arenas this frame is released a frame from now
+        frameArenas.endFrame();
+
         //glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
         glfwSwapBuffers(window);
         glfwPollEvents(); //poll IO events(keys pressed/released, mouse moved etc.)
@@ -518,6 +1039,9 @@ int main(int argc, char* argv[]) {
     glDeleteBuffers(1, &cubeVBO);
     glDeleteBuffers(1, &planeVBO);
     glDeleteBuffers(1, &screenQuadVBO);
+    commandBufferExecutor.release();
+    delete depthCubeMapLayeredShader;
+    shutdownGLResources();
 
     glfwTerminate();
     //-----------------------------------------------
@@ -630,6 +1154,101 @@ void key_callback(GLFWwindow* window, int key, int scancode, int action, int mod
             GAMMA_ENABLED = true;
         }
     }
+
+    //cascaded shadow maps option
+    if (key == GLFW_KEY_V && action == GLFW_PRESS) {
+        if (CASCADED_SHADOWS_ENABLED) {
+            CASCADED_SHADOWS_ENABLED = false;
+        }
+        else {
+            CASCADED_SHADOWS_ENABLED = true;
+        }
+    }
+
+    //cascade visualisation option
+    if (key == GLFW_KEY_X && action == GLFW_PRESS) {
+        if (SHOW_CASCADES) {
+            SHOW_CASCADES = false;
+        }
+        else {
+            SHOW_CASCADES = true;
+        }
+    }
+
+    //many shadowed point lights option
+    if (key == GLFW_KEY_L && action == GLFW_PRESS) {
+        if (MULTI_POINT_SHADOWS_ENABLED) {
+            MULTI_POINT_SHADOWS_ENABLED = false;
+        }
+        else {
+            MULTI_POINT_SHADOWS_ENABLED = true;
+        }
+    }
+
+    //cycle omnidirectional shadow path, skipping the vertex shader layer path when it isn't supported
+    if (key == GLFW_KEY_J && action == GLFW_PRESS) {
+        POINT_SHADOW_PATH = (POINT_SHADOW_PATH + 1) % NUM_POINT_SHADOW_PATHS;
+        if (POINT_SHADOW_PATH == VERTEX_LAYER_PATH && !VERTEX_LAYER_SUPPORTED)
+            POINT_SHADOW_PATH = SIX_PASS_PATH;
+        std::cout << "Omnidirectional shadow path: " << POINT_SHADOW_PATH_NAMES[POINT_SHADOW_PATH] << std::endl;
+    }
+
+    //scaled-up shadow scene option
+    if (key == GLFW_KEY_H && action == GLFW_PRESS) {
+        if (SCALED_SHADOW_SCENE) {
+            SCALED_SHADOW_SCENE = false;
+        }
+        else {
+            SCALED_SHADOW_SCENE = true;
+        }
+    }
+
+    //cycle point shadow face budget: 6 -> 12 -> 24 -> 48 -> 6
+    if (key == GLFW_KEY_U && action == GLFW_PRESS) {
+        POINT_SHADOW_FACE_BUDGET = POINT_SHADOW_FACE_BUDGET >= 48 ? 6 : POINT_SHADOW_FACE_BUDGET * 2;
+        std::cout << "Point shadow face budget: " << POINT_SHADOW_FACE_BUDGET << std::endl;
+    }
+
+    //cycle cascade resolution: 1024 -> 2048 -> 4096 -> 1024
+    if (key == GLFW_KEY_R && action == GLFW_PRESS) {
+        CASCADE_RESOLUTION = CASCADE_RESOLUTION >= 4096 ? 1024 : CASCADE_RESOLUTION * 2;
+        std::cout << "Cascade resolution: " << CASCADE_RESOLUTION << std::endl;
+    }
+
+    //parallel command buffer recording option
+    if (key == GLFW_KEY_K && action == GLFW_PRESS) {
+        if (PARALLEL_RECORDING_ENABLED) {
+            PARALLEL_RECORDING_ENABLED = false;
+        }
+        else {
+            PARALLEL_RECORDING_ENABLED = true;
+        }
+    }
+
+    //cycle command buffer recording threads: 1 -> 2 -> ... -> hardware threads -> 1
+    if (key == GLFW_KEY_N && action == GLFW_PRESS) {
+        unsigned int maxThreads = std::max(1u, std::thread::hardware_concurrency());
+        RECORDING_THREADS = RECORDING_THREADS >= maxThreads ? 1 : RECORDING_THREADS + 1;
+        std::cout << "Command buffer recording threads: " << RECORDING_THREADS << std::endl;
+    }
+
+    //command buffer recording benchmark, runs without rendering
+    if (key == GLFW_KEY_B && action == GLFW_PRESS)
+        benchmarkCommandRecording();
+
+    //frame arena option, the CPU frame timer reports the heap allocations per frame of both
+    if (key == GLFW_KEY_M && action == GLFW_PRESS) {
+        if (FRAME_ARENA_ENABLED) {
+            FRAME_ARENA_ENABLED = false;
+        }
+        else {
+            FRAME_ARENA_ENABLED = true;
+        }
+    }
+
+    //frame arena benchmark, runs without rendering
+    if (key == GLFW_KEY_I && action == GLFW_PRESS)
+        benchmarkFrameArena();
 }
 
 void drawTwoContainers(GLuint cubeVAO, const Shader& shader, const glm::mat4& projection, const glm::mat4& view, float scale) {
@@ -794,6 +1413,479 @@ void createDepthCubeMapFBO(unsigned int& depthCubeMapFBO, unsigned int& depthCub
     //---------------------------------------------------------------------------------------------
 }
 
+/* Creates a depth-only framebuffer whose depth attachment is a NUM_CASCADES-layer depth texture array, so that all
+*   cascades can be rendered in one layered pass. The array is set up for hardware depth comparison
+*   (sampler2DArrayShadow) with bilinear filtering.
+*   Parameters:
+*       cascadedShadowMapFBO:   framebuffer object
+*       cascadedShadowMap:      depth texture array, one layer per cascade
+*       resolution:             width and height of each layer
+* */
+void createCascadedShadowMapFBO(unsigned int& cascadedShadowMapFBO, unsigned int& cascadedShadowMap, unsigned int resolution) {
+    //setup framebuffer
+    glGenFramebuffers(1, &cascadedShadowMapFBO);
+    glBindFramebuffer(GL_FRAMEBUFFER, cascadedShadowMapFBO);
+
+    //generate depth texture array
+    glGenTextures(1, &cascadedShadowMap);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, cascadedShadowMap);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT32F, resolution, resolution, NUM_CASCADES, 0,
+        GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+    float borderColor[] = { 1.0f, 1.0f, 1.0f, 1.0f };
+    glTexParameterfv(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BORDER_COLOR, borderColor);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);//unbind texture array from target
+    //---------------------------------------
+
+    //attach every layer at once, the geometry shader selects the layer with gl_Layer
+    glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, cascadedShadowMap, 0);
+
+    //To explicitly tell OpenGL, we are not rendering any color data and it is complete without color buffer
+    glDrawBuffer(GL_NONE);
+    glReadBuffer(GL_NONE);
+    //------------------------------------------------------------------------------------------------
+
+    //check if the framebuffer is complete
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        std::cout << "ERROR::FRAMEBUFFER:: Framebuffer is not complete!" << std::endl;
+    //----------------------------------------------------------------------------------------
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0); //unbined framebuffer
+    //---------------------------------------------------------------------------------------------
+}
+
+/* Computes the far distance of each cascade with the practical split scheme: a blend between logarithmic splits
+*   (even resolution in perspective) and uniform splits (avoids tiny near cascades)
+*   Parameters:
+*       nearPlane:      camera near plane
+*       farPlane:       distance covered by the last cascade
+*       numCascades:    number of cascades
+*       lambda:         1.0 for purely logarithmic splits, 0.0 for purely uniform splits
+*       arena:          frame arena the splits are allocated from, NULL for the heap
+* */
+ArenaVector<float> computeCascadeSplits(float nearPlane, float farPlane, unsigned int numCascades, float lambda, FrameArena* arena) {
+    ArenaVector<float> splits(arena);
+    splits.reserve(numCascades);
+    for (unsigned int i = 1; i <= numCascades; ++i) {
+        float fraction = (float) i / numCascades;
+        float logSplit = nearPlane * std::pow(farPlane / nearPlane, fraction);
+        float uniformSplit = nearPlane + (farPlane - nearPlane) * fraction;
+        splits.push_back(lambda * logSplit + (1.0f - lambda) * uniformSplit);
+    }
+    return splits;
+}
+
+/* Fits an orthographic light projection around one slice of the camera frustum. The slice is enclosed in a bounding
+*   sphere so that the projection's size doesn't change as the camera rotates, and the projection is snapped to
+*   whole shadow map texels so that the shadow edges don't shimmer as the camera moves.
+*   Parameters:
+*       view:           camera view matrix
+*       fovY:           camera vertical field of view, in radians
+*       aspect:         camera aspect ratio
+*       splitNear:      near distance of the slice
+*       splitFar:       far distance of the slice
+*       lightDirection: direction the directional light shines in
+*       resolution:     shadow map resolution of the cascade
+*       texelSize:      set to the world-space size of one shadow map texel
+* */
+glm::mat4 computeCascadeMatrix(const glm::mat4& view, float fovY, float aspect, float splitNear, float splitFar,
+    const glm::vec3& lightDirection, unsigned int resolution, float& texelSize) {
+    //world-space corners of the slice: unproject the NDC cube through the slice's own projection
+    glm::mat4 inverseViewProjection = glm::inverse(glm::perspective(fovY, aspect, splitNear, splitFar) * view);
+    glm::vec3 corners[8];
+    for (unsigned int i = 0; i < 8; ++i) {
+        glm::vec4 corner = inverseViewProjection * glm::vec4((i & 4) ? 1.0f : -1.0f, (i & 2) ? 1.0f : -1.0f, (i & 1) ? 1.0f : -1.0f, 1.0f);
+        corners[i] = glm::vec3(corner) / corner.w;
+    }
+
+    //bounding sphere of the slice
+    glm::vec3 center(0.0f);
+    for (unsigned int i = 0; i < 8; ++i)
+        center += corners[i];
+    center /= 8.0f;
+    float radius = 0.0f;
+    for (unsigned int i = 0; i < 8; ++i)
+        radius = std::max(radius, glm::length(corners[i] - center));
+    radius = std::ceil(radius * 16.0f) / 16.0f; //quantize so that floating point noise doesn't change the texel size
+    texelSize = 2.0f * radius / resolution;
+
+    //casters outside the slice but between it and the light must still land in the depth range
+    const float casterMargin = 20.0f;
+    glm::vec3 lightDir = glm::normalize(lightDirection);
+    glm::vec3 lightUp = std::abs(lightDir.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+    glm::mat4 lightView = glm::lookAt(center - lightDir * (radius + casterMargin), center, lightUp);
+    glm::mat4 lightProjection = glm::ortho(-radius, radius, -radius, radius, 0.0f, 2.0f * radius + casterMargin);
+
+    //snap: move the projection by the sub-texel offset of the world origin, so the texel grid stays fixed in world space
+    glm::mat4 lightSpaceMatrix = lightProjection * lightView;
+    glm::vec4 origin = lightSpaceMatrix * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+    origin *= resolution / 2.0f;
+    glm::vec4 roundedOrigin = glm::round(origin);
+    glm::vec4 roundOffset = (roundedOrigin - origin) * (2.0f / resolution);
+    lightProjection[3][0] += roundOffset.x;
+    lightProjection[3][1] += roundOffset.y;
+
+    return lightProjection * lightView;
+}
+
+/* Creates the two point shadow cube map arrays, one cube per light, and a depth-only framebuffer that renders into a
+*   single face of either. shadowCubeMapArray holds the final depth sampled by the lighting pass (set up for hardware
+*   comparison with samplerCubeArrayShadow); staticShadowCubeMapArray caches the depth of static casters only, so that
+*   a face with moving casters is rebuilt by copying the cached face and drawing just the moving casters on top.
+*   Parameters:
+*       pointShadowFBO:             framebuffer object
+*       shadowCubeMapArray:         final depth, sampled by the lighting pass
+*       staticShadowCubeMapArray:   cached static caster depth
+*       numLights:                  number of cubes in each array
+* */
+void createPointShadowArrays(unsigned int& pointShadowFBO, unsigned int& shadowCubeMapArray,
+    unsigned int& staticShadowCubeMapArray, unsigned int numLights) {
+    //generate cube map arrays, 16-bit depth is enough for distances normalized to each light's range
+    unsigned int* arrays[] = { &shadowCubeMapArray, &staticShadowCubeMapArray };
+    for (unsigned int i = 0; i < 2; ++i) {
+        glGenTextures(1, arrays[i]);
+        glBindTexture(GL_TEXTURE_CUBE_MAP_ARRAY, *arrays[i]);
+        glTexImage3D(GL_TEXTURE_CUBE_MAP_ARRAY, 0, GL_DEPTH_COMPONENT16, POINT_SHADOW_RESOLUTION, POINT_SHADOW_RESOLUTION,
+            numLights * 6, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    }
+    glBindTexture(GL_TEXTURE_CUBE_MAP_ARRAY, shadowCubeMapArray);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+    glBindTexture(GL_TEXTURE_CUBE_MAP_ARRAY, 0);//unbind cube map array from target
+    //---------------------------------------
+
+    //setup framebuffer, the face being rendered is attached with glFramebufferTextureLayer before each draw
+    glGenFramebuffers(1, &pointShadowFBO);
+    glBindFramebuffer(GL_FRAMEBUFFER, pointShadowFBO);
+    glDrawBuffer(GL_NONE);
+    glReadBuffer(GL_NONE);
+    glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, shadowCubeMapArray, 0, 0);
+
+    //check if the framebuffer is complete
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        std::cout << "ERROR::FRAMEBUFFER:: Framebuffer is not complete!" << std::endl;
+    //----------------------------------------------------------------------------------------
+
+    //faces are filled in over several frames: until then they must read as unshadowed rather than as garbage
+    glViewport(0, 0, POINT_SHADOW_RESOLUTION, POINT_SHADOW_RESOLUTION);
+    for (unsigned int layerFace = 0; layerFace < numLights * 6; ++layerFace) {
+        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, shadowCubeMapArray, 0, layerFace);
+        glClear(GL_DEPTH_BUFFER_BIT);
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0); //unbined framebuffer
+    //---------------------------------------------------------------------------------------------
+
+    std::cout << "Point shadow cube map arrays: " << numLights << " lights, "
+        << 2.0 * numLights * 6 * POINT_SHADOW_RESOLUTION * POINT_SHADOW_RESOLUTION * 2 / (1024.0 * 1024.0) << " MB" << std::endl;
+}
+
+/* Creates a shadow caster with its world-space bounding sphere
+*   Parameters:
+*       VAO:            vertex array object of the caster's geometry
+*       vertexCount:    number of vertices drawn with glDrawArrays
+*       model:          model matrix
+*       localCenter:    bounding sphere center in model space
+*       localRadius:    bounding sphere radius in model space
+*       isStatic:       the caster never moves
+* */
+ShadowCaster createShadowCaster(unsigned int VAO, unsigned int vertexCount, const glm::mat4& model,
+    const glm::vec3& localCenter, float localRadius, bool isStatic) {
+    ShadowCaster caster;
+    caster.VAO = VAO;
+    caster.vertexCount = vertexCount;
+    caster.model = model;
+    caster.center = glm::vec3(model * glm::vec4(localCenter, 1.0f));
+    float maxScale = std::max(glm::length(glm::vec3(model[0])), std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+    caster.radius = localRadius * maxScale;
+    caster.isStatic = isStatic;
+    caster.moved = false;
+    return caster;
+}
+
+/* Returns the projection * view matrix of one face of a point light's shadow cube, faces ordered as
+*   GL_TEXTURE_CUBE_MAP_POSITIVE_X + face
+*   Parameters:
+*       lightPos:   light position
+*       face:       cube face, 0 to 5
+*       farPlane:   range of the light
+* */
+glm::mat4 cubeFaceMatrix(const glm::vec3& lightPos, unsigned int face, float farPlane) {
+    static const glm::vec3 directions[6] = { glm::vec3(1.0, 0.0, 0.0), glm::vec3(-1.0, 0.0, 0.0), glm::vec3(0.0, 1.0, 0.0),
+        glm::vec3(0.0, -1.0, 0.0), glm::vec3(0.0, 0.0, 1.0), glm::vec3(0.0, 0.0, -1.0) };
+    static const glm::vec3 ups[6] = { glm::vec3(0.0, -1.0, 0.0), glm::vec3(0.0, -1.0, 0.0), glm::vec3(0.0, 0.0, 1.0),
+        glm::vec3(0.0, 0.0, -1.0), glm::vec3(0.0, -1.0, 0.0), glm::vec3(0.0, -1.0, 0.0) };
+
+    glm::mat4 shadowProjection = glm::perspective(glm::radians(90.0f), 1.0f, 0.1f, farPlane);
+    return shadowProjection * glm::lookAt(lightPos, lightPos + directions[face], ups[face]);
+}
+
+/* Tests a bounding sphere against the 90 degree frustum of one cube face. The face looking down axis a holds the points
+*   p with dot(p, a) >= |dot(p, b)| for both other axes b, i.e. four planes through the light with normals a +- b.
+*   Parameters:
+*       lightPos:   light position
+*       farPlane:   range of the light
+*       face:       cube face, 0 to 5
+*       center:     sphere center
+*       radius:     sphere radius
+* */
+bool sphereInCubeFace(const glm::vec3& lightPos, float farPlane, unsigned int face, const glm::vec3& center, float radius) {
+    glm::vec3 p = center - lightPos;
+    if (glm::length(p) > farPlane + radius)
+        return false;
+
+    unsigned int axis = face / 2;
+    float sign = face % 2 == 0 ? 1.0f : -1.0f;
+    for (unsigned int other = 0; other < 3; ++other) {
+        if (other == axis)
+            continue;
+        //normals (a + b) / sqrt(2) and (a - b) / sqrt(2)
+        float along = sign * p[axis], across = p[other];
+        if ((along + across) * 0.70710678f < -radius || (along - across) * 0.70710678f < -radius)
+            return false;
+    }
+    return true;
+}
+
+/* Draws the static or the moving casters that touch one cube face of a light
+*   Parameters:
+*       casters:        all shadow casters
+*       shader:         active depth shader
+*       lightPos:       light position
+*       farPlane:       range of the light
+*       face:           cube face, 0 to 5
+*       staticCasters:  draw the static casters if true, the moving ones otherwise
+* */
+unsigned int drawShadowCasters(const ArenaVector<ShadowCaster>& casters, const Shader& shader, const glm::vec3& lightPos,
+    float farPlane, unsigned int face, bool staticCasters) {
+    unsigned int drawn = 0;
+    for (unsigned int i = 0; i < casters.size(); ++i) {
+        if (casters[i].isStatic != staticCasters || !sphereInCubeFace(lightPos, farPlane, face, casters[i].center, casters[i].radius))
+            continue;
+        shader.setUniformMatrix4("model", casters[i].model);
+        glBindVertexArray(casters[i].VAO);
+        glDrawArrays(GL_TRIANGLES, 0, casters[i].vertexCount);
+        ++drawn;
+    }
+    return drawn;
+}
+
+/* Draws casters into a layered cube map target with one instance per cube face the caster touches. The faces are
+*   passed in the faces uniform array and the vertex shader writes gl_Layer, so casters are culled per face without a
+*   geometry shader.
+*   Parameters:
+*       casters:    shadow casters
+*       shader:     active depthCubeMapLayered shader
+*       lightPos:   light position
+*       farPlane:   range of the light
+* */
+unsigned int drawShadowCastersLayered(const ArenaVector<ShadowCaster>& casters, const Shader& shader, const glm::vec3& lightPos,
+    float farPlane) {
+    static const char* faceUniforms[6] = { "faces[0]", "faces[1]", "faces[2]", "faces[3]", "faces[4]", "faces[5]" };
+    unsigned int instances = 0;
+    for (unsigned int i = 0; i < casters.size(); ++i) {
+        unsigned int numFaces = 0;
+        for (unsigned int face = 0; face < 6; ++face) {
+            if (sphereInCubeFace(lightPos, farPlane, face, casters[i].center, casters[i].radius))
+                shader.setUniformInt(faceUniforms[numFaces++], face);
+        }
+        if (numFaces == 0)
+            continue;
+
+        shader.setUniformMatrix4("model", casters[i].model);
+        glBindVertexArray(casters[i].VAO);
+        glDrawArraysInstanced(GL_TRIANGLES, 0, casters[i].vertexCount, numFaces);
+        instances += numFaces;
+    }
+    return instances;
+}
+
+/* Re-renders the point shadow faces that are out of date, at most faceBudget of them per frame. A face is out of date
+*   when its cached static depth is invalid (first use, the light moved or a static caster moved through it), when a
+*   moving caster is inside it, or when it held moving casters at its last update. Candidate faces are ranked by the
+*   importance of their light (brightness and closeness to the camera) times the number of frames since their last
+*   update, so dim or distant lights still get refreshed, just less often.
+*   Parameters:
+*       lights:                     shadowed point lights
+*       casters:                    all shadow casters
+*       shader:                     point shadow depth shader
+*       pointShadowFBO:             framebuffer object
+*       shadowCubeMapArray:         final depth, sampled by the lighting pass
+*       staticShadowCubeMapArray:   cached static caster depth
+*       cameraPos:                  camera position
+*       cameraForward:              camera view direction
+*       frame:                      current frame number, starting from 1
+*       faceBudget:                 maximum number of faces rendered this frame
+* */
+unsigned int updatePointShadows(std::vector<ShadowedPointLight>& lights, const ArenaVector<ShadowCaster>& casters,
+    Shader& shader, unsigned int pointShadowFBO, unsigned int shadowCubeMapArray, unsigned int staticShadowCubeMapArray,
+    const glm::vec3& cameraPos, const glm::vec3& cameraForward, unsigned int frame, unsigned int faceBudget) {
+    struct FaceUpdate {
+        unsigned int light;
+        unsigned int face;
+        float priority;
+    };
+    ArenaVector<FaceUpdate> candidates(frameArenas.get());
+    candidates.reserve(6 * lights.size());
+
+    for (unsigned int i = 0; i < lights.size(); ++i) {
+        ShadowedPointLight& light = lights[i];
+
+        //a moved light invalidates all of its cached faces
+        if (light.position != light.cachedPosition) {
+            for (unsigned int face = 0; face < 6; ++face)
+                light.staticValid[face] = false;
+            light.cachedPosition = light.position;
+        }
+
+        //brightness over squared distance, lights whose whole range lies behind the camera count for a tenth
+        glm::vec3 toLight = light.position - cameraPos;
+        float distance = std::max(glm::length(toLight), light.farPlane);
+        light.importance = glm::dot(light.color, glm::vec3(0.2126f, 0.7152f, 0.0722f)) * (light.farPlane * light.farPlane) / (distance * distance);
+        if (glm::dot(toLight, cameraForward) < -light.farPlane)
+            light.importance *= 0.1f;
+
+        for (unsigned int face = 0; face < 6; ++face) {
+            bool hasMovingCasters = false;
+            for (unsigned int c = 0; c < casters.size(); ++c) {
+                if (!casters[c].moved || !sphereInCubeFace(light.position, light.farPlane, face, casters[c].center, casters[c].radius))
+                    continue;
+                if (casters[c].isStatic)
+                    light.staticValid[face] = false;
+                else
+                    hasMovingCasters = true;
+            }
+
+            if (!light.staticValid[face] || hasMovingCasters || light.hadMovingCasters[face]) {
+                FaceUpdate update = { i, face, light.importance * (frame - light.lastUpdateFrame[face]) };
+                candidates.push_back(update);
+            }
+        }
+    }
+
+    //highest priority first, only the budget gets rendered
+    std::sort(candidates.begin(), candidates.end(), [](const FaceUpdate& a, const FaceUpdate& b) {
+        return a.priority > b.priority;
+    });
+    if (candidates.size() > faceBudget)
+        candidates.resize(faceBudget);
+
+    glViewport(0, 0, POINT_SHADOW_RESOLUTION, POINT_SHADOW_RESOLUTION);
+    glBindFramebuffer(GL_FRAMEBUFFER, pointShadowFBO);
+    shader.activateShader();
+    for (unsigned int i = 0; i < candidates.size(); ++i) {
+        ShadowedPointLight& light = lights[candidates[i].light];
+        unsigned int face = candidates[i].face;
+        unsigned int layerFace = light.layer * 6 + face;
+        shader.setUniformMatrix4("lightSpaceMatrix", cubeFaceMatrix(light.position, face, light.farPlane));
+        shader.setUniformVec3("lightPos", light.position);
+        shader.setUniformFloat("far_plane", light.farPlane);
+
+        //rebuild the cached static depth of the face
+        if (!light.staticValid[face]) {
+            glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, staticShadowCubeMapArray, 0, layerFace);
+            glClear(GL_DEPTH_BUFFER_BIT);
+            drawShadowCasters(casters, shader, light.position, light.farPlane, face, true);
+            light.staticValid[face] = true;
+        }
+
+        //start from the cached static depth and add the moving casters on top
+        glCopyImageSubData(staticShadowCubeMapArray, GL_TEXTURE_CUBE_MAP_ARRAY, 0, 0, 0, layerFace,
+            shadowCubeMapArray, GL_TEXTURE_CUBE_MAP_ARRAY, 0, 0, 0, layerFace, POINT_SHADOW_RESOLUTION, POINT_SHADOW_RESOLUTION, 1);
+        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, shadowCubeMapArray, 0, layerFace);
+        light.hadMovingCasters[face] = drawShadowCasters(casters, shader, light.position, light.farPlane, face, false) > 0;
+        light.lastUpdateFrame[face] = frame;
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    return candidates.size();
+}
+
+/* Records the casters that touch one face of the point light's shadow cube into a command buffer. Makes no GL calls, so
+*   it runs on a worker thread; the face matrix, light position and range go into the buffer's view block.
+*   Parameters:
+*       buffer:     command buffer of the face, reset first
+*       casters:    shadow casters
+*       program:    packet shadow depth shader program
+*       lightPos:   light position
+*       farPlane:   range of the light
+*       face:       cube face, 0 to 5
+* */
+void recordShadowFace(CommandBuffer& buffer, const ArenaVector<ShadowCaster>& casters, unsigned int program, const glm::vec3& lightPos,
+    float farPlane, unsigned int face) {
+    buffer.reset();
+    ShadowFaceUniforms faceUniforms = { cubeFaceMatrix(lightPos, face, farPlane), glm::vec4(lightPos, farPlane) };
+    buffer.setViewUniforms(faceUniforms);
+
+    for (unsigned int i = 0; i < casters.size(); ++i) {
+        if (!sphereInCubeFace(lightPos, farPlane, face, casters[i].center, casters[i].radius))
+            continue;
+        DrawPacket packet;
+        packet.program = program;
+        packet.vertexArray = casters[i].VAO;
+        packet.uniformOffset = buffer.pushUniforms(casters[i].model);
+        packet.uniformSize = sizeof(glm::mat4);
+        packet.count = casters[i].vertexCount;
+        packet.sortKey = CommandBuffer::makeSortKey(program, 0, packet.vertexArray);
+        buffer.draw(packet);
+    }
+    buffer.sortPackets();
+}
+
+/* Records the objects inside the camera frustum into a command buffer for the packet lighting shader, computing every
+*   object's normal matrix on the recording thread instead of in the vertex shader.
+*   Parameters:
+*       buffer:     command buffer of the view, reset first
+*       objects:    objects of the scene, the bounding spheres are used for culling
+*       textures:   diffuse (and specular) texture of every object
+*       program:    packet lighting shader program
+*       frustum:    camera frustum
+* */
+void recordSceneView(CommandBuffer& buffer, const ArenaVector<ShadowCaster>& objects, const ArenaVector<unsigned int>& textures,
+    unsigned int program, const Frustum& frustum) {
+    buffer.reset();
+    for (unsigned int i = 0; i < objects.size(); ++i) {
+        if (!frustum.intersectsSphere(objects[i].center, objects[i].radius))
+            continue;
+        SceneDrawUniforms drawUniforms = { objects[i].model, glm::transpose(glm::inverse(objects[i].model)) };
+        DrawPacket packet;
+        packet.program = program;
+        packet.vertexArray = objects[i].VAO;
+        packet.textures[0] = textures[i];
+        packet.uniformOffset = buffer.pushUniforms(drawUniforms);
+        packet.uniformSize = sizeof(SceneDrawUniforms);
+        packet.count = objects[i].vertexCount;
+        packet.sortKey = CommandBuffer::makeSortKey(program, textures[i], packet.vertexArray);
+        buffer.draw(packet);
+    }
+    buffer.sortPackets();
+}
+
+/* Counts the timed frame and prints the averages of the CPU frame timer every reportInterval frames
+*   Parameters:
+*       timer:          the timer, its times already accumulated for this frame
+*       label:          printed in front of the averages
+*       reportInterval: number of frames averaged per report
+* */
+void endCPUFrameTimer(CPUFrameTimer& timer, const char* label, unsigned int reportInterval) {
+    if (++timer.timedFrames < reportInterval)
+        return;
+    std::cout << "CPU frame time (" << label << "): " << timer.frameTime / timer.timedFrames << " ms, recording "
+        << timer.recordTime / timer.timedFrames << " ms, replay " << timer.replayTime / timer.timedFrames << " ms, "
+        << (double)timer.heapAllocations / timer.timedFrames << " heap allocations per frame" << std::endl;
+    timer = CPUFrameTimer();
+}
+
 void createMSAA_FBO(unsigned int& multisampledFBO, unsigned int& msaa_texColorBuffer, unsigned int numSamples) {
     //setup MSAA framebuffer
     glGenFramebuffers(1, &multisampledFBO);
@@ -0,0 +1,6 @@
+#version 430 core
+
+void main()
+{
+    //depth only
+}
@@ -0,0 +1,97 @@
+#version 430 core
+#define NUM_CASCADES 4 //must match NUM_CASCADES in Main.cpp
+out vec4 FragColor;
+
+struct Material{
+    sampler2D diffuseMap;
+    sampler2D specularMap;
+    float shininess;
+};
+
+struct DirLight{
+    vec3 direction;
+
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+
+in VS_OUT {
+    vec3 fragPos;
+    vec3 normal;
+    vec2 texCoord;
+    float viewDepth;
+} fs_in;
+
+uniform Material material;
+uniform DirLight dir_light;
+uniform vec3 cameraPos;
+uniform bool gamma;
+
+uniform sampler2DArrayShadow cascadedShadowMap; //hardware depth comparison, bilinear-filtered
+uniform mat4 lightSpaceMatrices[NUM_CASCADES];
+uniform float cascadeSplits[NUM_CASCADES]; //far distance of each cascade along the view direction
+uniform float cascadeTexelSizes[NUM_CASCADES]; //world-space size of one shadow map texel in each cascade
+uniform bool showCascades;
+
+const vec3 cascadeColors[4] = vec3[](vec3(1.0, 0.3, 0.3), vec3(0.3, 1.0, 0.3), vec3(0.3, 0.3, 1.0), vec3(1.0, 1.0, 0.3));
+
+int selectCascade(float viewDepth)
+{
+    for(int i = 0; i < NUM_CASCADES - 1; ++i)
+    {
+        if(viewDepth < cascadeSplits[i])
+            return i;
+    }
+    return NUM_CASCADES - 1;
+}
+
+float shadowCalculation(vec3 normal, vec3 lightDir, int cascade)
+{
+    //offset along the normal by about one texel of this cascade: the bias follows the texel footprint, which grows
+    //with each cascade, instead of being a single constant tuned for one of them
+    float normalOffset = cascadeTexelSizes[cascade] * (1.0 - max(dot(normal, lightDir), 0.0) + 0.5);
+    vec4 lightSpacePos = lightSpaceMatrices[cascade] * vec4(fs_in.fragPos + normal * normalOffset, 1.0);
+    vec3 projCoords = lightSpacePos.xyz / lightSpacePos.w * 0.5 + 0.5;
+
+    //beyond the far plane of the cascade: treat as lit
+    if(projCoords.z > 1.0)
+        return 0.0;
+
+    //3x3 PCF, each tap is itself a 2x2 bilinear comparison
+    float shadow = 0.0;
+    vec2 texelSize = 1.0 / vec2(textureSize(cascadedShadowMap, 0).xy);
+    for(int x = -1; x <= 1; ++x)
+    {
+        for(int y = -1; y <= 1; ++y)
+        {
+            vec2 offset = vec2(x, y) * texelSize;
+            shadow += 1.0 - texture(cascadedShadowMap, vec4(projCoords.xy + offset, cascade, projCoords.z));
+        }
+    }
+    return shadow / 9.0;
+}
+
+void main()
+{
+    vec3 color = texture(material.diffuseMap, fs_in.texCoord).rgb;
+    vec3 normal = normalize(fs_in.normal);
+    vec3 lightDir = normalize(-dir_light.direction);
+    vec3 viewDir = normalize(cameraPos - fs_in.fragPos);
+    vec3 halfwayDir = normalize(lightDir + viewDir);
+
+    vec3 ambient = dir_light.ambient * color;
+    vec3 diffuse = max(dot(normal, lightDir), 0.0) * dir_light.diffuse * color;
+    vec3 specular = pow(max(dot(normal, halfwayDir), 0.0), material.shininess) * dir_light.specular
+        * texture(material.specularMap, fs_in.texCoord).r;
+
+    int cascade = selectCascade(fs_in.viewDepth);
+    float shadow = shadowCalculation(normal, lightDir, cascade);
+    vec3 result = ambient + (1.0 - shadow) * (diffuse + specular);
+    if(showCascades)
+        result *= cascadeColors[cascade];
+
+    if(gamma)
+        result = pow(result, vec3(1.0 / 2.2));
+    FragColor = vec4(result, 1.0);
+}
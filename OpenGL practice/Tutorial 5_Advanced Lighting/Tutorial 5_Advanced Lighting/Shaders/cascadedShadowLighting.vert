@@ -0,0 +1,30 @@
+#version 430 core
+layout (location = 0) in vec3 aPosition;
+layout (location = 1) in vec2 aTexCoord;
+layout (location = 2) in vec3 aNormal;
+
+layout (std140) uniform Matrices
+{
+    mat4 projection;
+    mat4 view;
+};
+
+out VS_OUT {
+    vec3 fragPos; //world space
+    vec3 normal; //world space
+    vec2 texCoord;
+    float viewDepth; //positive distance along the camera's view direction, used to pick the cascade
+} vs_out;
+
+uniform mat4 model;
+
+void main()
+{
+    vec4 worldPos = model * vec4(aPosition, 1.0);
+    vec4 viewPos = view * worldPos;
+    vs_out.fragPos = worldPos.xyz;
+    vs_out.normal = mat3(transpose(inverse(model))) * aNormal;
+    vs_out.texCoord = aTexCoord;
+    vs_out.viewDepth = -viewPos.z;
+    gl_Position = projection * viewPos;
+}
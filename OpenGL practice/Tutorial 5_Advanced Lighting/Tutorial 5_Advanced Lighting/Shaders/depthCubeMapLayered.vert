@@ -0,0 +1,18 @@
+#version 430 core
+#extension GL_ARB_shader_viewport_layer_array : require
+layout (location = 0) in vec3 aPosition;
+
+uniform mat4 model;
+uniform mat4 shadowMatrices[6];
+uniform int faces[6]; //cube faces the caster touches, instance i renders into faces[i]
+
+out vec3 fragPos;
+
+void main()
+{
+    int face = faces[gl_InstanceID];
+    vec4 worldPos = model * vec4(aPosition, 1.0);
+    fragPos = worldPos.xyz;
+    gl_Layer = face; //selects the cube face from the vertex shader, no geometry shader needed
+    gl_Position = shadowMatrices[face] * worldPos;
+}
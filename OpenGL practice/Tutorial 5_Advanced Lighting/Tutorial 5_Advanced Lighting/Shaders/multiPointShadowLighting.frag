@@ -0,0 +1,73 @@
+#version 430 core
+#define MAX_SHADOWED_POINT_LIGHTS 32 //must match MAX_SHADOWED_POINT_LIGHTS in Main.cpp
+out vec4 FragColor;
+
+struct Material{
+    sampler2D diffuseMap;
+    sampler2D specularMap;
+    float shininess;
+};
+
+struct ShadowedPointLight{
+    vec3 position;
+    vec3 color;
+    float far_plane; //range of the light, also the far plane its shadow faces were rendered with
+    int layer; //cube index in the shadow cube map array
+};
+
+in VS_OUT {
+    vec3 fragPos;
+    vec3 normal;
+    vec2 texCoord;
+    float viewDepth;
+} fs_in;
+
+uniform Material material;
+uniform ShadowedPointLight pointLights[MAX_SHADOWED_POINT_LIGHTS];
+uniform int numPointLights;
+uniform vec3 ambient;
+uniform vec3 cameraPos;
+uniform bool gamma;
+
+uniform samplerCubeArrayShadow shadowCubeMapArray; //hardware depth comparison, bilinear-filtered
+
+float shadowCalculation(ShadowedPointLight light, vec3 normal)
+{
+    vec3 fragToLight = fs_in.fragPos - light.position;
+    float currentDepth = length(fragToLight) / light.far_plane;
+    float bias = 0.02 * (1.0 - max(dot(normal, -normalize(fragToLight)), 0.0)) + 0.005;
+    return 1.0 - texture(shadowCubeMapArray, vec4(fragToLight, light.layer), currentDepth - bias);
+}
+
+void main()
+{
+    vec3 color = texture(material.diffuseMap, fs_in.texCoord).rgb;
+    float specularStrength = texture(material.specularMap, fs_in.texCoord).r;
+    vec3 normal = normalize(fs_in.normal);
+    vec3 viewDir = normalize(cameraPos - fs_in.fragPos);
+
+    vec3 result = ambient * color;
+    for(int i = 0; i < numPointLights; ++i)
+    {
+        vec3 toLight = pointLights[i].position - fs_in.fragPos;
+        float distance = length(toLight);
+        if(distance > pointLights[i].far_plane)
+            continue;
+
+        //inverse-square falloff windowed to reach zero at the light's range
+        float window = clamp(1.0 - pow(distance / pointLights[i].far_plane, 4.0), 0.0, 1.0);
+        float attenuation = window * window / (distance * distance + 1.0);
+
+        vec3 lightDir = toLight / distance;
+        vec3 halfwayDir = normalize(lightDir + viewDir);
+        vec3 diffuse = max(dot(normal, lightDir), 0.0) * color;
+        vec3 specular = pow(max(dot(normal, halfwayDir), 0.0), material.shininess) * vec3(specularStrength);
+
+        float shadow = shadowCalculation(pointLights[i], normal);
+        result += (1.0 - shadow) * attenuation * pointLights[i].color * (diffuse + specular);
+    }
+
+    if(gamma)
+        result = pow(result, vec3(1.0 / 2.2));
+    FragColor = vec4(result, 1.0);
+}
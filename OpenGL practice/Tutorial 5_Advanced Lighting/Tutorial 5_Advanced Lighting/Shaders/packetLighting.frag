@@ -0,0 +1,67 @@
+#version 430 core
+out vec4 FragColor;
+
+struct Material{
+    sampler2D diffuseMap;
+    sampler2D specularMap;
+    float shininess;
+};
+
+struct PointLight{
+    vec3 position;
+
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+
+    float constant;
+    float linear;
+    float quadratic;
+};
+
+in VS_OUT {
+    vec3 fragPos;
+    vec3 normal;
+    vec2 texCoord;
+} fs_in;
+
+uniform Material material;
+uniform PointLight point_light;
+uniform vec3 cameraPos;
+uniform bool gamma;
+
+uniform samplerCube shadowCubeMap; //linear distance to the light divided by far_plane
+uniform float far_plane;
+
+float shadowCalculation(vec3 normal, vec3 lightDir)
+{
+    vec3 lightToFrag = fs_in.fragPos - point_light.position;
+    float currentDepth = length(lightToFrag);
+    float closestDepth = texture(shadowCubeMap, lightToFrag).r * far_plane;
+    float bias = max(0.05 * (1.0 - dot(normal, lightDir)), 0.005);
+    return currentDepth - bias > closestDepth ? 1.0 : 0.0;
+}
+
+void main()
+{
+    vec3 color = texture(material.diffuseMap, fs_in.texCoord).rgb;
+    vec3 normal = normalize(fs_in.normal);
+    vec3 lightDir = normalize(point_light.position - fs_in.fragPos);
+    vec3 viewDir = normalize(cameraPos - fs_in.fragPos);
+    vec3 halfwayDir = normalize(lightDir + viewDir);
+
+    float distance = length(point_light.position - fs_in.fragPos);
+    float attenuation = 1.0 / (point_light.constant + point_light.linear * distance + point_light.quadratic * distance * distance);
+
+    vec3 ambient = point_light.ambient * color;
+    vec3 diffuse = max(dot(normal, lightDir), 0.0) * point_light.diffuse * color;
+    vec3 specular = pow(max(dot(normal, halfwayDir), 0.0), material.shininess) * point_light.specular
+        * texture(material.specularMap, fs_in.texCoord).r;
+
+    float shadow = shadowCalculation(normal, lightDir);
+    vec3 result = attenuation * (ambient + (1.0 - shadow) * (diffuse + specular));
+
+    if(gamma)
+        result = pow(result, vec3(1.0 / 2.2));
+    FragColor = vec4(result, 1.0);
+}
@@ -0,0 +1,32 @@
+#version 430 core
+layout (location = 0) in vec3 aPosition;
+layout (location = 1) in vec2 aTexCoord;
+layout (location = 2) in vec3 aNormal;
+
+layout (std140) uniform Matrices
+{
+    mat4 projection;
+    mat4 view;
+};
+
+//one block per packet: the normal matrix is computed while recording instead of per vertex
+layout (std140) uniform DrawData
+{
+    mat4 model;
+    mat4 normalMatrix;
+};
+
+out VS_OUT {
+    vec3 fragPos; //world space
+    vec3 normal; //world space
+    vec2 texCoord;
+} vs_out;
+
+void main()
+{
+    vec4 worldPos = model * vec4(aPosition, 1.0);
+    vs_out.fragPos = worldPos.xyz;
+    vs_out.normal = mat3(normalMatrix) * aNormal;
+    vs_out.texCoord = aTexCoord;
+    gl_Position = projection * view * worldPos;
+}
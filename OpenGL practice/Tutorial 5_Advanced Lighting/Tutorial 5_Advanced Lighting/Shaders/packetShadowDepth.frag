@@ -0,0 +1,14 @@
+#version 430 core
+in vec3 fragPos;
+
+layout (std140) uniform ViewData
+{
+    mat4 lightSpaceMatrix;
+    vec4 lightPosFarPlane;
+};
+
+void main()
+{
+    //same linear distance as pointShadowArrayDepth.frag, so the lighting shaders read either cube the same way
+    gl_FragDepth = length(fragPos - lightPosFarPlane.xyz) / lightPosFarPlane.w;
+}
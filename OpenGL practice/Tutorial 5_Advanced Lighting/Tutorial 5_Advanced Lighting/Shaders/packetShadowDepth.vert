@@ -0,0 +1,24 @@
+#version 430 core
+layout (location = 0) in vec3 aPosition;
+
+//one block per cube face, bound once before the face's packets are replayed
+layout (std140) uniform ViewData
+{
+    mat4 lightSpaceMatrix; //projection * view of the cube face
+    vec4 lightPosFarPlane; //xyz: light position, w: far plane
+};
+
+//one block per packet, bound with glBindBufferRange at the packet's offset
+layout (std140) uniform DrawData
+{
+    mat4 model;
+};
+
+out vec3 fragPos;
+
+void main()
+{
+    vec4 worldPos = model * vec4(aPosition, 1.0);
+    fragPos = worldPos.xyz;
+    gl_Position = lightSpaceMatrix * worldPos;
+}
@@ -0,0 +1,11 @@
+#version 430 core
+in vec3 fragPos;
+
+uniform vec3 lightPos;
+uniform float far_plane;
+
+void main()
+{
+    //store the linear distance to the light mapped to [0, 1], so every face of the cube compares the same quantity
+    gl_FragDepth = length(fragPos - lightPos) / far_plane;
+}
@@ -0,0 +1,14 @@
+#version 430 core
+layout (location = 0) in vec3 aPosition;
+
+uniform mat4 model;
+uniform mat4 lightSpaceMatrix; //projection * view of the single cube face being rendered
+
+out vec3 fragPos;
+
+void main()
+{
+    vec4 worldPos = model * vec4(aPosition, 1.0);
+    fragPos = worldPos.xyz;
+    gl_Position = lightSpaceMatrix * worldPos;
+}
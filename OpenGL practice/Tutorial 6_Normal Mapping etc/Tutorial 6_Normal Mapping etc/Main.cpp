@@ -11,18 +11,31 @@
 #include <algorithm>
 #include <ctime>
 #include <random>
+#include <chrono>
+#include <filesystem>
 //#define STB_IMAGE_IMPLEMENTATION
 //#include "stb_image.h"
 #include "Shader.h"
 #include "Camera.h"
 #include "Light.h"
 #include "Model.h"
+#include "BVH.h"
+#include "OcclusionCuller.h"
+#include "RenderGraph.h"
+#include "DynamicResolution.h"
+#include "JobSystem.h"
+#include "Animation.h"
+#include "GLResource.h"
+#include "AssetLoader.h"
+#include "CellStreamer.h"
+#include "Timing.h"
 
 //Window dimensions
 unsigned int WINDOW_WIDTH = 800;
 unsigned int WINDOW_HEIGHT = 600;
-const unsigned int FRAMEBUFFER_WIDTH = 800;
-const unsigned int FRAMEBUFFER_HEIGHT = 600;
+//internal render resolution of the offscreen passes: the window size, scaled down by the dynamic resolution
+unsigned int FRAMEBUFFER_WIDTH = 800;
+unsigned int FRAMEBUFFER_HEIGHT = 600;
 const unsigned int SHADOW_WIDTH = 1024;
 const unsigned int SHADOW_HEIGHT = 1024;
 
@@ -35,6 +48,100 @@ bool NORMAL_MAPPING = false; //normal mapping option
 bool PARALLAX_MAPPING = false; //parallax mapping option
 bool BLOOM_ENABLED = false; //bloom option
 bool AO_ENABLED = false; //ambient occlusion option
+bool TEMPORAL_AO_ENABLED = false; //temporal ambient occlusion option
+bool COMPACT_GBUFFER = false; //compact G-buffer option
+bool MIP_BLOOM_ENABLED = false; //mip-chain bloom option
+bool BVH_CULLING_ENABLED = true; //frustum culling through the scene's bounding volume hierarchy
+bool OCCLUSION_CULLING_ENABLED = false; //CPU occlusion culling option
+bool HIZ_ENABLED = false; //hierarchical-Z pyramid option, also enables GPU occlusion culling in the SSAO scene
+bool HIZ_AO_ENABLED = false; //SSAO reads sample depths from the hierarchical-Z pyramid
+bool DYNAMIC_RESOLUTION_ENABLED = false; //dynamic resolution scaling option
+bool GPU_SKINNING_ENABLED = true; //skin the animated crowd in the vertex shader instead of on the CPU
+
+//render targets shared by every offscreen pass, and the graph the scenes declare their passes on
+RenderTargetPool renderTargetPool;
+RenderGraph renderGraph(renderTargetPool);
+//internal resolution picked from the measured GPU frame time
+DynamicResolution dynamicResolution;
+//worker threads for the per-frame CPU stages, every GL call stays on the main thread
+JobSystem jobSystem;
+//GL objects the scenes create on the fly, referred to by handle
+GLResourceRegistry glResources;
+//models and textures loaded in the background, their GL uploads get this many milliseconds of every frame
+AssetLoader assetLoader;
+double ASSET_UPLOAD_BUDGET = 2.0;
+
+//GL_TIMESTAMP queries at the start and end of every frame, in a ring so that a result is read a few frames late
+//without stalling. Unlike GL_TIME_ELAPSED they can be issued while the passes' GPUTimers are running
+struct GPUFrameTimer {
+    static const unsigned int LATENCY = 3;
+    unsigned int queries[LATENCY][2] = {};
+    unsigned int frame = 0;
+};
+
+//frame times while every model in Models/ loads at once, with the GL uploads on the render thread and on the asset
+//loader's upload thread. An unmeasured pass loads everything once first, so both measured passes find the files in the
+//OS cache and the allocators warm, and the two swap places on every run
+struct StreamingBenchmark {
+    unsigned int phase = 0; //0 when not running, 1 warming up, 2 and 3 measured
+    bool uploadThreadFirst = false; //whether phase 2 uploads on the upload thread, flipped every run
+    bool uploadThread = false; //of the current phase
+    std::vector<std::string> files;
+    std::vector<Task<Model>> loads;
+    std::vector<float> frameTimes; //milliseconds
+    double startTime = 0.0;
+    bool uploadThreadWasEnabled = false;
+};
+StreamingBenchmark streamingBenchmark;
+
+//frame times and cell residency while the camera flies straight across the streamed city
+struct FlyThroughBenchmark {
+    bool running = false;
+    float time = 0.0f; //seconds into the flight
+    std::vector<float> frameTimes; //milliseconds
+    unsigned int framesWithMissingCells = 0;
+    unsigned int maxMissingCells = 0;
+    std::size_t peakMemoryBytes = 0, peakGPUBytes = 0;
+    StreamingStats startStats; //of the streamer when the flight started
+};
+FlyThroughBenchmark flyThroughBenchmark;
+
+//GL objects of a generated sphere, owned by glResources
+struct SphereMesh {
+    GLHandle<GL_RESOURCE_VERTEX_ARRAY> vertexArray;
+    GLHandle<GL_RESOURCE_BUFFER> vertexBuffer, indexBuffer;
+    unsigned int indicesSize = 0;
+};
+
+//what level 0 of a hierarchical-Z pyramid is built from
+enum HiZSource { HIZ_VIEW_POSITIONS, HIZ_WORLD_POSITIONS, HIZ_DEPTH_BUFFER };
+
+//hierarchical-Z pyramid: linear view-space depth of the scene with a full mip chain, the nearest (red) and farthest
+//(green) depth of every 2^n x 2^n block of pixels in level n. Built after the geometry pass, it can be sampled by any
+//later pass of the frame and by the next frame, which is what the GPU occlusion culling pass uses
+struct HiZPyramid {
+    unsigned int texture = 0;
+    unsigned int framebuffer = 0; //levels are attached one at a time while building
+    std::vector<glm::ivec2> levelSizes;
+    glm::mat4 view = glm::mat4(1.0f), projection = glm::mat4(1.0f); //camera the pyramid was last built from
+    bool valid = false;
+};
+
+//same layout as the command read by glDrawArraysIndirect
+struct DrawArraysIndirectCommand {
+    unsigned int count;
+    unsigned int instanceCount;
+    unsigned int first;
+    unsigned int baseInstance;
+};
+
+//GPU occlusion culling against a hierarchical-Z pyramid: one point per object carrying its bounds, and one indirect
+//draw command per object whose instance count the culling pass zeroes when the object is hidden
+struct HiZCullingPass {
+    unsigned int boundsVAO = 0, boundsVBO = 0;
+    unsigned int commandBuffer = 0;
+    std::vector<DrawArraysIndirectCommand> commands;
+};
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void mouse_callback(GLFWwindow* window, double xPos, double yPos);
@@ -44,12 +151,34 @@ void key_callback(GLFWwindow* window, int key, int scancode, int action, int mod
 void processInput(GLFWwindow* window, Camera& camera);
 void drawTwoContainers(GLuint cubeVAO, const Shader& shader, const glm::mat4& projection, const glm::mat4& view, float scale);
 void drawCube(GLuint cubeVAO, const Shader& shader, const glm::vec3 translationVec = glm::vec3(0.0f), glm::vec3 scale = glm::vec3(1.0f), glm::mat4 rotationMatrix = glm::mat4(1.0));
-void createFBO(unsigned int& framebuffer, unsigned int* colorBuffer, unsigned int numColorBuffers, GLint colorBuffer_internalFormat, bool hasDepthbuffer = true);
-void createFBO(unsigned int& framebuffer, unsigned int* colorBuffer, unsigned int numColorBuffers, GLint* colorBuffer_internalFormat, bool hasDepthBuffer = true);
-void createFBO(unsigned int& framebuffer, unsigned int& texColorBuffer, GLint colorBuffer_internalFormat, bool hasDepthbuffer = true);
-void createDepthMapFBO(unsigned int& depthMapFBO, unsigned int& depthMap);
+void drawCube(GLuint cubeVAO, const Shader& shader, const glm::mat4& model);
+glm::mat4 createModelMatrix(const glm::vec3 translationVec = glm::vec3(0.0f), glm::vec3 scale = glm::vec3(1.0f), glm::mat4 rotationMatrix = glm::mat4(1.0));
+void createFBO(unsigned int& framebuffer, unsigned int* colorBuffer, unsigned int numColorBuffers, GLint colorBuffer_internalFormat, unsigned int width,
+    unsigned int height, bool hasDepthbuffer = true);
+void createFBO(unsigned int& framebuffer, unsigned int* colorBuffer, unsigned int numColorBuffers, GLint* colorBuffer_internalFormat, unsigned int width,
+    unsigned int height, bool hasDepthBuffer = true);
+void createFBO(unsigned int& framebuffer, unsigned int& texColorBuffer, GLint colorBuffer_internalFormat, unsigned int width, unsigned int height,
+    bool hasDepthbuffer = true);
+void createDepthMapFBO(unsigned int& depthMapFBO, unsigned int& depthMap, unsigned int width = SHADOW_WIDTH, unsigned int height = SHADOW_HEIGHT);
 void createDepthCubeMapFBO(unsigned int& depthCubeMapFBO, unsigned int& depthCubeMap);
-void createMSAA_FBO(unsigned int& multisampledFBO, unsigned int& msaa_texColorBuffer, unsigned int numSamples);
+void createMSAA_FBO(unsigned int& multisampledFBO, unsigned int& msaa_texColorBuffer, unsigned int numSamples, unsigned int width, unsigned int height);
+void updateRenderResolution(float gpuFrameTime);
+void addUpscalePass(RenderGraph& graph, RenderGraph::Resource sceneColor, unsigned int screenQuadVAO);
+void printGBufferBandwidth();
+void createHiZPyramid(HiZPyramid& pyramid, unsigned int width, unsigned int height);
+void buildHiZPyramid(HiZPyramid& pyramid, const Shader& copyShader, const Shader& downsampleShader, HiZSource source, unsigned int sourceTexture,
+    unsigned int normalTexture, const glm::mat4& view, const glm::mat4& projection, float farPlane, unsigned int screenQuadVAO);
+void createHiZCullingPass(HiZCullingPass& pass, unsigned int numObjects, unsigned int vertexCount);
+void cullWithHiZ(HiZCullingPass& pass, const HiZPyramid& pyramid, const Shader& cullingShader, const std::vector<AABB>& objectBounds,
+    const std::vector<unsigned char>& objectVisible);
+unsigned int readHiZCulledObjects(HiZCullingPass& pass, const std::vector<unsigned char>& objectVisible);
+void drawCube(GLuint cubeVAO, const Shader& shader, const glm::mat4& model, unsigned int indirectCommand);
+void beginGPUFrameTimer(GPUFrameTimer& timer);
+float endGPUFrameTimer(GPUFrameTimer& timer);
+void startStreamingBenchmark(StreamingBenchmark& benchmark, const char* directory);
+void startStreamingBenchmarkPhase(StreamingBenchmark& benchmark, unsigned int phase);
+void updateStreamingBenchmark(StreamingBenchmark& benchmark, float frameTime);
+void printFrameTimeStats(std::vector<float> frameTimes);
 void GLAPIENTRY messageCallback(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length,
     const GLchar* message, const void* userParam);
 void setObjectTangentsandBitangents(std::vector<glm::vec3>& tangentsAndBitangents, const float* objData,
@@ -59,10 +188,12 @@ void renderTunnelScene(unsigned int cubeVAO, unsigned int lightObjectVAO, unsign
 void renderSceneWithBloomEffect(unsigned int cubeVAO, unsigned int lightObjectVAO, unsigned int screenQuadVAO, unsigned int uboMatrices);
 void renderSceneWithDeferredShading(unsigned int cubeVAO, unsigned int lightObjectVAO, unsigned int screenQuadVAO, unsigned int uboMatrices);
 void renderSceneWithSSAO(unsigned int cubeVAO, unsigned int lightObjectVAO, unsigned int screenQuadVAO, unsigned int uboMatrices);
-void createSphere(unsigned int xSegments, unsigned int ySegments, unsigned int& sphereVAO, unsigned int& indicesSize);
+void createSphere(unsigned int xSegments, unsigned int ySegments, SphereMesh& sphere);
 void drawSphere(unsigned int xSegs = 64, unsigned int ySegs = 64);
 void PBR_directLighting(unsigned int uboMatrices);
 void renderEquirectangularMap_withPBR(unsigned int cubeVAO, unsigned int uboMatrices);
+void renderAnimatedCrowd(unsigned int uboMatrices);
+void renderStreamedCity(unsigned int uboMatrices);
 
 int main(int argc, char* argv[]) {
     const unsigned int NUM_SAMPLES = 4;
@@ -103,6 +234,8 @@ int main(int argc, char* argv[]) {
     //---------------------------------------------------------------------
     glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
     glDebugMessageCallback(messageCallback, "Learn OpenGL application");
+    //buffer and texture uploads of the asset loader go to a second context on their own thread
+    assetLoader.startUploadThread(window);
     glEnable(GL_DEPTH_TEST);
     glDepthFunc(GL_LESS);
     //glEnable(GL_BLEND);
@@ -310,6 +443,8 @@ int main(int argc, char* argv[]) {
     //----------------------------------------------------------------------------------------------------------
     //----------------------------------------------------------------------------------------------------------
 
+    GPUFrameTimer frameTimer;
+
     //main render loop
     while (!glfwWindowShouldClose(window))
     {
@@ -319,6 +454,7 @@ int main(int argc, char* argv[]) {
         lastFrame = currentFrame;
 
         processInput(window, newCamera);
+        beginGPUFrameTimer(frameTimer);
         //renderRandomScene(cubeVAO, planeVAO, lightObjectVAO, uboMatrices);
         //renderTunnelScene(cubeVAO, lightObjectVAO, screenQuadVAO, uboMatrices);
         //renderSceneWithBloomEffect(cubeVAO, lightObjectVAO, screenQuadVAO, uboMatrices);
@@ -326,6 +462,15 @@ int main(int argc, char* argv[]) {
         //renderSceneWithSSAO(cubeVAO, lightObjectVAO, screenQuadVAO, uboMatrices);
         //PBR_directLighting(uboMatrices);
         renderEquirectangularMap_withPBR(cubeVAO, uboMatrices);
+        //renderAnimatedCrowd(uboMatrices);
+        //renderStreamedCity(uboMatrices);
+
+        assetLoader.update(ASSET_UPLOAD_BUDGET);
+        updateStreamingBenchmark(streamingBenchmark, deltaTime * 1000.0f);
+
+        //internal resolution of the next frame, from the GPU time of a frame a few frames back
+        updateRenderResolution(endGPUFrameTimer(frameTimer));
+        renderTargetPool.endFrame();
 
         //glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
         glfwSwapBuffers(window);
@@ -341,6 +486,10 @@ int main(int argc, char* argv[]) {
     glDeleteBuffers(1, &planeVBO);
     glDeleteBuffers(1, &planeTB_VBO);
     glDeleteBuffers(1, &screenQuadVBO);
+    renderTargetPool.releaseTextures();
+    assetLoader.shutdown(); //loads still running are dropped with the scenes that started them
+    glResources.clear(false); //the scenes keep theirs until the end
+    shutdownGLResources();
 
     glfwTerminate();
     //-----------------------------------------------
@@ -348,12 +497,14 @@ int main(int argc, char* argv[]) {
     return 0;
 }
 
-// you should destroy vertex array and vertex buffer objects
-void createSphere(unsigned int xSegments, unsigned int ySegments, unsigned int& sphereVAO, unsigned int& indicesSize) {
-    unsigned int sphereVBO, sphereEBO;
-    glGenVertexArrays(1, &sphereVAO);
-    glGenBuffers(1, &sphereVBO);
-    glGenBuffers(1, &sphereEBO);
+//(re)creates the sphere's GL objects in glResources, deleting the ones it had before
+void createSphere(unsigned int xSegments, unsigned int ySegments, SphereMesh& sphere) {
+    glResources.remove(sphere.vertexArray);
+    glResources.remove(sphere.vertexBuffer);
+    glResources.remove(sphere.indexBuffer);
+    sphere.vertexArray = glResources.add(GLVertexArray::create(), "sphere");
+    sphere.vertexBuffer = glResources.add(GLBuffer::create(), "sphere vertices");
+    sphere.indexBuffer = glResources.add(GLBuffer::create(), "sphere indices");
 
     std::vector<float> vertexData;
     std::vector<unsigned int> indices;
@@ -410,12 +561,12 @@ void createSphere(unsigned int xSegments, unsigned int ySegments, unsigned int&
             indices.push_back((y + 1) * (xSegments + 1) + x);
         }
     }
-    indicesSize = indices.size();
+    sphere.indicesSize = indices.size();
 
-    glBindVertexArray(sphereVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, sphereVBO);
+    glBindVertexArray(glResources.get(sphere.vertexArray));
+    glBindBuffer(GL_ARRAY_BUFFER, glResources.get(sphere.vertexBuffer));
     glBufferData(GL_ARRAY_BUFFER, vertexData.size() * sizeof(float), vertexData.data(), GL_STATIC_DRAW);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, sphereEBO);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, glResources.get(sphere.indexBuffer));
     glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
     unsigned int stride = 8 * sizeof(float);
 
@@ -436,15 +587,14 @@ void drawSphere(unsigned int xSegs, unsigned int ySegs) {
     static bool initialized = false;
     static unsigned int xSegments = xSegs;
     static unsigned int ySegments = ySegs;
-    static unsigned int sphereVAO = 0;
-    static unsigned int indicesSize = 0;
+    static SphereMesh sphere;
     if (!initialized || xSegments != xSegs || ySegments != ySegs) {
-        createSphere(xSegments = xSegs, ySegments = ySegs, sphereVAO, indicesSize);
+        createSphere(xSegments = xSegs, ySegments = ySegs, sphere);
         initialized = true;
     }
 
-    glBindVertexArray(sphereVAO);
-    glDrawElements(GL_TRIANGLE_STRIP, indicesSize, GL_UNSIGNED_INT, 0);
+    glBindVertexArray(glResources.get(sphere.vertexArray));
+    glDrawElements(GL_TRIANGLE_STRIP, sphere.indicesSize, GL_UNSIGNED_INT, 0);
 }
 /* This function processes input events
 *   Parameters:
@@ -488,6 +638,7 @@ void processInput(GLFWwindow* window, Camera& camera)
 void framebuffer_size_callback(GLFWwindow* window, int width, int height)
 {
     //glViewport(0, 0, width, height);
+    //the render targets follow on the next frame, through updateRenderResolution()
     WINDOW_WIDTH = width;
     WINDOW_HEIGHT = height;
 }
@@ -590,6 +741,147 @@ void key_callback(GLFWwindow* window, int key, int scancode, int action, int mod
             AO_ENABLED = true;
         }
     }
+
+    //temporal ambient occlusion option
+    if (key == GLFW_KEY_T && action == GLFW_PRESS) {
+        if (TEMPORAL_AO_ENABLED) {
+            TEMPORAL_AO_ENABLED = false;
+        }
+        else {
+            TEMPORAL_AO_ENABLED = true;
+        }
+    }
+
+    //compact G-buffer option
+    if (key == GLFW_KEY_K && action == GLFW_PRESS) {
+        if (COMPACT_GBUFFER) {
+            COMPACT_GBUFFER = false;
+        }
+        else {
+            COMPACT_GBUFFER = true;
+        }
+    }
+
+    //mip-chain bloom option
+    if (key == GLFW_KEY_M && action == GLFW_PRESS) {
+        if (MIP_BLOOM_ENABLED) {
+            MIP_BLOOM_ENABLED = false;
+        }
+        else {
+            MIP_BLOOM_ENABLED = true;
+        }
+    }
+
+    //scene graph benchmark: 100k nodes with 1% of the local transforms changing every frame
+    if (key == GLFW_KEY_H && action == GLFW_PRESS) {
+        benchmarkSceneGraph(100000, 0.01f);
+    }
+
+    //BVH culling option
+    if (key == GLFW_KEY_V && action == GLFW_PRESS) {
+        if (BVH_CULLING_ENABLED) {
+            BVH_CULLING_ENABLED = false;
+        }
+        else {
+            BVH_CULLING_ENABLED = true;
+        }
+    }
+
+    //BVH build/refit/query benchmark at 10k, 100k and 1M objects
+    if (key == GLFW_KEY_J && action == GLFW_PRESS) {
+        benchmarkBVH();
+    }
+
+    //CPU occlusion culling option
+    if (key == GLFW_KEY_Y && action == GLFW_PRESS) {
+        if (OCCLUSION_CULLING_ENABLED) {
+            OCCLUSION_CULLING_ENABLED = false;
+        }
+        else {
+            OCCLUSION_CULLING_ENABLED = true;
+        }
+    }
+
+    //headless occlusion culling benchmark
+    if (key == GLFW_KEY_I && action == GLFW_PRESS) {
+        benchmarkOcclusionCulling();
+    }
+
+    //per-frame CPU stages on 1 to N threads of the job system
+    if (key == GLFW_KEY_L && action == GLFW_PRESS) {
+        benchmarkJobSystem();
+    }
+
+    //hierarchical-Z pyramid and GPU occlusion culling option
+    if (key == GLFW_KEY_Z && action == GLFW_PRESS) {
+        if (HIZ_ENABLED) {
+            HIZ_ENABLED = false;
+        }
+        else {
+            HIZ_ENABLED = true;
+        }
+    }
+
+    //hierarchical-Z SSAO sampling option
+    if (key == GLFW_KEY_X && action == GLFW_PRESS) {
+        if (HIZ_AO_ENABLED) {
+            HIZ_AO_ENABLED = false;
+        }
+        else {
+            HIZ_AO_ENABLED = true;
+        }
+    }
+
+    //dynamic resolution scaling option
+    if (key == GLFW_KEY_R && action == GLFW_PRESS) {
+        if (DYNAMIC_RESOLUTION_ENABLED) {
+            DYNAMIC_RESOLUTION_ENABLED = false;
+        }
+        else {
+            DYNAMIC_RESOLUTION_ENABLED = true;
+        }
+    }
+
+    //GPU or CPU skinning of the animated crowd
+    if (key == GLFW_KEY_E && action == GLFW_PRESS) {
+        if (GPU_SKINNING_ENABLED) {
+            GPU_SKINNING_ENABLED = false;
+        }
+        else {
+            GPU_SKINNING_ENABLED = true;
+        }
+    }
+
+    //headless skinning benchmark: pose sampling and CPU skinning of 1000 characters
+    if (key == GLFW_KEY_F && action == GLFW_PRESS) {
+        benchmarkSkinning();
+    }
+
+    //headless mesh conversion benchmark: the backpack's meshes converted into one buffer vs a vector per mesh
+    if (key == GLFW_KEY_Q && action == GLFW_PRESS) {
+        benchmarkMeshConversion("../../Models/backpack/backpack.obj");
+    }
+
+    //frame-time hitches while every model loads at once, uploading on the render thread and on the upload thread
+    if (key == GLFW_KEY_U && action == GLFW_PRESS) {
+        startStreamingBenchmark(streamingBenchmark, "../../Models");
+    }
+
+    //flight across the streamed city: frame-time hitches and how much of it was resident on the way
+    if (key == GLFW_KEY_1 && action == GLFW_PRESS) {
+        flyThroughBenchmark = FlyThroughBenchmark();
+        flyThroughBenchmark.running = true;
+    }
+
+    //headless glTF loading benchmark: the native loader against assimp on the same file
+    if (key == GLFW_KEY_2 && action == GLFW_PRESS) {
+        benchmarkGLTFLoading("../../Models/Sponza/glTF/Sponza.gltf");
+    }
+
+    //headless OBJ parsing benchmark: the backpack parsed on one thread, on every thread and by assimp
+    if (key == GLFW_KEY_3 && action == GLFW_PRESS) {
+        benchmarkOBJParsing("../../Models/backpack/backpack.obj");
+    }
 }
 float lerp(float a, float b, float f) {
     return a * (1 - f) + b * f;
@@ -600,8 +892,10 @@ void renderSceneWithSSAO(unsigned int cubeVAO, unsigned int lightObjectVAO, unsi
     //------------------------------------------------------------------------------------------------------------------------------------
     //---------------------------------------------------------INITIALIZATION-------------------------------------------------------------
     //------------------------------------------------------------------------------------------------------------------------------------
-    //load model into object
-    static Model modelObject = Model("../../Models/backpack/backpack.obj");
+    //load model into object in the background, nothing but its draw ranges and bounds stays on the CPU. A cube stands
+    //in for it until it is ready
+    static Task<Model> modelObject = assetLoader.loadModel("../../Models/backpack/backpack.obj", false, RESIDENCY_GPU_ONLY);
+    static bool modelLoaded = false;
 
     //initialize light parameters
     //--------------------------------------------------------------------------------------------------------
@@ -616,10 +910,17 @@ void renderSceneWithSSAO(unsigned int cubeVAO, unsigned int lightObjectVAO, unsi
     //initialize shaders
     //--------------------------------------------------------------------------------------------------------
     static Shader SSAOGeometryPassShader = Shader("Shaders/SSAOGeometryPass.vert", "Shaders/SSAOGeometryPass.frag");
+    static Shader compactGeometryPassShader = Shader("Shaders/compactGeometryPass.vert", "Shaders/compactGeometryPass.frag");
     static Shader SSAOShader = Shader("Shaders/SSAO.vert", "Shaders/SSAO.frag");
     static Shader SSAOBlurShader = Shader("Shaders/SSAO.vert", "Shaders/SSAOBlur.frag");
+    static Shader SSAOTemporalShader = Shader("Shaders/SSAO.vert", "Shaders/SSAOTemporal.frag");
+    static Shader SSAOTemporalResolveShader = Shader("Shaders/SSAO.vert", "Shaders/SSAOTemporalResolve.frag");
     static Shader SSAOLightingPassShader= Shader("Shaders/deferredMultipleLightingPass.vert", "Shaders/SSAOLightingPass.frag");
+    static Shader compactLightingPassShader = Shader("Shaders/deferredMultipleLightingPass.vert", "Shaders/compactLightingPass.frag");
     static Shader ScreenShader = Shader("Shaders/screenShader.vert", "Shaders/screenShader.frag");
+    static Shader hiZCopyShader = Shader("Shaders/bloomMip.vert", "Shaders/hiZCopy.frag");
+    static Shader hiZDownsampleShader = Shader("Shaders/bloomMip.vert", "Shaders/hiZDownsample.frag");
+    static Shader hiZCullingShader = Shader("Shaders/hiZCulling.vert", "Shaders/hiZCulling.frag");
     //--------------------------------------------------------------------------------------------------------
 
     //load textures
@@ -632,31 +933,96 @@ void renderSceneWithSSAO(unsigned int cubeVAO, unsigned int lightObjectVAO, unsi
     static unsigned int cubeTexture_depth = textureFromFile("../../Textures/toy_box_disp.png", false);
     //--------------------------------------------------------------------------------------------------------
 
-    static unsigned int gBuffer, gPosition, gNormal, gAlbedoSpec;
-    static unsigned int ssaoFBO, ssaoColorBuffer, noiseTexture;
-    static unsigned int ssaoBlurFBO, ssaoColorBufferBlur;
+    static unsigned int noiseTexture;
     static std::vector<glm::vec3> ssaoKernel;
     static float kernelRadius = 0.5;
     static int noiseRadius = 4;
-    static glm::vec2 noiseScale(FRAMEBUFFER_WIDTH / noiseRadius, FRAMEBUFFER_HEIGHT / noiseRadius);
+
+    //temporal SSAO: each frame evaluates an interleaved subset of the kernel and accumulates the result in a history
+    //buffer (ao in the red channel, linear view-space depth in the green channel) reprojected from the previous frame
+    static unsigned int historyBuffers[2]; //acquired from the render target pool at the internal resolution
+    static unsigned int temporalSamples = 16; //samples per pixel per frame, must divide the kernel size
+    static float historyBlend = 0.1f; //weight of the current frame when history is accepted
+    static float depthRejectThreshold = 0.05f; //relative depth difference at which history is discarded
+    static unsigned int frameIndex = 0;
+    static bool historyValid = false;
+    static glm::mat4 prevView(1.0f), prevProjection(1.0f);
+
+    //scene objects are nodes of a scene graph: their world matrices are only recomputed when a transform changes
+    static SceneGraph sceneGraph;
+    static unsigned int modelNode, floorNode;
+    static std::vector<unsigned int> cubeNodes;
+    static std::vector<unsigned int> objectNodes; //scene graph node of every object below
+
+    //bounding volume hierarchy over the scene objects: object 0 is the model, 1 the floor and 2.. the cubes
+    static BVH sceneBVH;
+    static std::vector<AABB> objectBounds;
+    static AABB modelBounds, cubeBounds(glm::vec3(-0.5f), glm::vec3(0.5f));
+    static std::vector<unsigned int> visibleObjects;
+    static std::vector<unsigned char> objectVisible;
+
+    //CPU occlusion culling: the floor and the three large cubes are rasterized as occluders
+    static OcclusionCuller occlusionCuller(256, 128);
+    static std::vector<unsigned int> occluderNodes;
+    static unsigned int occlusionTestedObjects = 0, occlusionCulledObjects = 0, occlusionFrames = 0;
+    static double occlusionCullingTime = 0.0; //milliseconds
+    static GPUTimer geometryPassTimer;
+
+    //hierarchical-Z pyramid, rebuilt after every geometry pass. The GPU occlusion culling pass tests the floor and the
+    //cubes against the previous frame's pyramid (the model is drawn by its meshes, not through an indirect command, so
+    //it is only culled on the CPU) and the SSAO pass can sample it at larger radii
+    static HiZPyramid hiZPyramid;
+    static HiZCullingPass hiZCullingPass;
+    static unsigned int hiZFrames = 0;
+    static GPUTimer hiZBuildTimer, hiZCullingTimer, ssaoTimer;
+
+    //light binning: the radius and view-space position of every light and whether its volume reaches into the view.
+    //The lighting pass only uploads the lights in view
+    static const unsigned int MAX_LIGHTS = 32; //size of lights[] in the lighting pass shaders
+    static std::vector<float> lightRadii;
+    static std::vector<glm::vec3> lightViewPositions;
+    static std::vector<unsigned char> lightInView;
     if (!initialized) {
-        //setup G-buffer
+        //setup scene graph
         //---------------------------------------------------------------------------------------------------------
-        unsigned int colorBuffers[3];
-        GLint internalFormat[3] = { GL_RGBA16F, GL_RGBA16F, GL_RGBA };
-        createFBO(gBuffer, colorBuffers, 3, internalFormat);
-        gPosition = colorBuffers[0];
-        gNormal = colorBuffers[1];
-        gAlbedoSpec = colorBuffers[2];
+        unsigned int rootNode = sceneGraph.addNode(SceneGraph::NO_PARENT, identityMatrix, "root");
+        modelNode = sceneGraph.addNode(rootNode, identityMatrix, "backpack");
+        floorNode = sceneGraph.addNode(rootNode, createModelMatrix(glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(12.5f, 0.5f, 12.5f)), "floor");
+        glm::vec3 axis = glm::normalize(glm::vec3(1.0f, 0.0f, 1.0f));
+        cubeNodes.push_back(sceneGraph.addNode(rootNode, createModelMatrix(glm::vec3(0.0f, 1.5f, 0.0f), glm::vec3(0.5f))));
+        cubeNodes.push_back(sceneGraph.addNode(rootNode, createModelMatrix(glm::vec3(2.0f, 0.0f, 1.0f), glm::vec3(0.5f))));
+        cubeNodes.push_back(sceneGraph.addNode(rootNode, createModelMatrix(glm::vec3(-1.0f, -1.0f, 2.0f), glm::vec3(1.0f), glm::rotate(identityMatrix, glm::radians(60.0f), axis))));
+        cubeNodes.push_back(sceneGraph.addNode(rootNode, createModelMatrix(glm::vec3(0.0f, 2.7f, 4.0f), glm::vec3(1.25f), glm::rotate(identityMatrix, glm::radians(23.0f), axis))));
+        cubeNodes.push_back(sceneGraph.addNode(rootNode, createModelMatrix(glm::vec3(-2.0f, 1.0f, -3.0f), glm::vec3(1.0f), glm::rotate(identityMatrix, glm::radians(124.0f), axis))));
+        cubeNodes.push_back(sceneGraph.addNode(rootNode, createModelMatrix(glm::vec3(-3.0f, 0.0f, 0.0f), glm::vec3(0.5f))));
+        sceneGraph.updateWorldTransforms();
+        occluderNodes = { floorNode, cubeNodes[2], cubeNodes[3], cubeNodes[4] };
+        objectNodes = { modelNode, floorNode };
+        objectNodes.insert(objectNodes.end(), cubeNodes.begin(), cubeNodes.end());
         //---------------------------------------------------------------------------------------------------------
         //---------------------------------------------------------------------------------------------------------
 
-        //setup SSAO framebuffer
+        //build the scene BVH from the world-space object bounds
         //---------------------------------------------------------------------------------------------------------
-        createFBO(ssaoFBO, ssaoColorBuffer, GL_RED, false);
+        modelBounds = cubeBounds; //of the placeholder until the model is loaded
+        for (unsigned int i = 0; i < objectNodes.size(); ++i)
+            objectBounds.push_back((i == 0 ? modelBounds : cubeBounds).transformed(sceneGraph.getWorldTransform(objectNodes[i])));
+        sceneBVH.build(objectBounds);
+        objectVisible.resize(objectBounds.size());
+        lightRadii.resize(pointLights.size());
+        lightViewPositions.resize(pointLights.size());
+        lightInView.resize(pointLights.size());
         //---------------------------------------------------------------------------------------------------------
         //---------------------------------------------------------------------------------------------------------
 
+        //the G-buffer, SSAO and blur targets are declared every frame on the render graph
+        printGBufferBandwidth();
+
+        //setup GPU occlusion culling, the hierarchical-Z pyramid is (re)created every frame the resolution changes
+        //---------------------------------------------------------------------------------------------------------
+        createHiZCullingPass(hiZCullingPass, objectBounds.size(), 36);
+        //---------------------------------------------------------------------------------------------------------
+        //---------------------------------------------------------------------------------------------------------
 
         //setup kernel
         //---------------------------------------------------------------------------------------------------------
@@ -701,12 +1067,6 @@ void renderSceneWithSSAO(unsigned int cubeVAO, unsigned int lightObjectVAO, unsi
         //---------------------------------------------------------------------------------------------------------
         //---------------------------------------------------------------------------------------------------------
         
-        //setup ssao blur fbo
-        //--------------------------------------------------------------------------------------------------------
-        createFBO(ssaoBlurFBO, ssaoColorBufferBlur, GL_RED, false);
-        //--------------------------------------------------------------------------------------------------------
-        //--------------------------------------------------------------------------------------------------------
-
         //bind ubo and shaders to a binding location
         //--------------------------------------------------------------------------------------------------------
         //bind uniform buffer object to binding point(loc) 0
@@ -714,9 +1074,11 @@ void renderSceneWithSSAO(unsigned int cubeVAO, unsigned int lightObjectVAO, unsi
 
         //get relevant block indices
         unsigned int SSAOGeometryPassShader_uniformBlockIndex = glGetUniformBlockIndex(SSAOGeometryPassShader.getProgramId(), "Matrices");
+        unsigned int compactGeometryPassShader_uniformBlockIndex = glGetUniformBlockIndex(compactGeometryPassShader.getProgramId(), "Matrices");
         
         //link each shader's uniform block indices to uniform binding point(loc) 0
         glUniformBlockBinding(SSAOGeometryPassShader.getProgramId(), SSAOGeometryPassShader_uniformBlockIndex, 0);
+        glUniformBlockBinding(compactGeometryPassShader.getProgramId(), compactGeometryPassShader_uniformBlockIndex, 0);
         //--------------------------------------------------------------------------------------------------------
 
         initialized = true;
@@ -725,183 +1087,503 @@ void renderSceneWithSSAO(unsigned int cubeVAO, unsigned int lightObjectVAO, unsi
     //------------------------------------------------------------------------------------------------------------------------------------
     //------------------------------------------------------------------------------------------------------------------------------------
 
-    //First pass: Geometry Pass
+    //glm::mat4 projection = glm::perspective(glm::radians(newCamera.getFOV()), (float)WINDOW_WIDTH / WINDOW_HEIGHT, 0.1f, 100.0f);
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float)WINDOW_WIDTH / WINDOW_HEIGHT, 0.1f, 1000.0f);
+    glm::mat4 view = newCamera.getViewMatrix();
+    glm::vec2 noiseScale((float)FRAMEBUFFER_WIDTH / noiseRadius, (float)FRAMEBUFFER_HEIGHT / noiseRadius);
+
+    //persistent textures the passes read or write across frames. The temporal ssao history buffers (ping-ponged every
+    //frame) carry data from one frame to the next, so they are imported into the render graph instead of being
+    //transient targets. Both follow the internal resolution and lose their contents when it changes
+    createHiZPyramid(hiZPyramid, FRAMEBUFFER_WIDTH, FRAMEBUFFER_HEIGHT);
+    for (unsigned int i = 0; i < 2; ++i) {
+        if (renderTargetPool.reacquire(historyBuffers[i], RenderTargetDesc(FRAMEBUFFER_WIDTH, FRAMEBUFFER_HEIGHT, GL_RG16F)))
+            historyValid = false;
+    }
+    RenderGraph::Resource hiZTarget = renderGraph.importTexture("Hi-Z pyramid", hiZPyramid.texture, RenderTargetDesc(FRAMEBUFFER_WIDTH, FRAMEBUFFER_HEIGHT, GL_RG32F));
+    RenderGraph::Resource historyTargets[2];
+    for (unsigned int i = 0; i < 2; ++i)
+        historyTargets[i] = renderGraph.importTexture("SSAO history", historyBuffers[i], RenderTargetDesc(FRAMEBUFFER_WIDTH, FRAMEBUFFER_HEIGHT, GL_RG16F));
+    bool hiZBuilt = false, historyWritten = false;
+
+    //the model is swapped in for its placeholder, with its own bounds, on the first frame it is ready
+    if (!modelLoaded && modelObject.isReady()) {
+        modelLoaded = true;
+        modelBounds = modelObject.get().computeBounds();
+        objectBounds[0] = modelBounds.transformed(sceneGraph.getWorldTransform(modelNode));
+        sceneBVH.build(objectBounds);
+        const ModelLoadStats& loadStats = modelObject.get().getLoadStats();
+        std::cout << "Model loaded: " << loadStats.numVertices << " vertices, " << loadStats.numIndices << " indices, import "
+            << loadStats.importTime << " ms, mesh conversion " << loadStats.conversionTime << " ms, texture uploads " << loadStats.textureTime
+            << " ms, peak resident " << loadStats.peakResidentBytes / (1024 * 1024) << " MB" << std::endl;
+        ModelMemoryUsage memoryUsage = modelObject.get().getMemoryUsage();
+        std::cout << "Model memory: CPU " << memoryUsage.getCPUBytes() / 1024 << " KB (meshes " << memoryUsage.meshBytes / 1024
+            << " KB, positions " << memoryUsage.positionBytes / 1024 << " KB, skinning " << memoryUsage.skinningBytes / 1024
+            << " KB, animation " << memoryUsage.animationBytes / 1024 << " KB), GPU " << memoryUsage.getGPUBytes() / 1024
+            << " KB (vertices " << memoryUsage.vertexBufferBytes / 1024 << " KB, indices " << memoryUsage.indexBufferBytes / 1024
+            << " KB, bones " << memoryUsage.boneBufferBytes / 1024 << " KB, textures " << memoryUsage.textureBytes / 1024 << " KB)"
+            << std::endl;
+    }
+
+    //CPU stages of the frame: the transform update, the culling that depends on it and the light binning run as jobs
+    //while this thread declares and compiles the passes. The passes only wait for their results
     //---------------------------------------------------------------------------------------------------------------
-    glBindFramebuffer(GL_FRAMEBUFFER, gBuffer);
-    glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
-    glViewport(0, 0, FRAMEBUFFER_WIDTH, FRAMEBUFFER_HEIGHT);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    JobCounter transformsDone, cullingDone, lightsDone;
+    jobSystem.run([&]() {
+        //refit the BVH only when a transform changed since the last frame, rebuild it once refitting has degraded it
+        if (sceneGraph.updateWorldTransforms(jobSystem) > 0) {
+            JobCounter boundsDone;
+            jobSystem.parallelFor(objectBounds.size(), 64, [&](unsigned int begin, unsigned int end) {
+                for (unsigned int i = begin; i < end; ++i)
+                    objectBounds[i] = (i == 0 ? modelBounds : cubeBounds).transformed(sceneGraph.getWorldTransform(objectNodes[i]));
+            }, &boundsDone);
+            jobSystem.wait(boundsDone);
+            sceneBVH.refit(objectBounds);
+            if (sceneBVH.shouldRebuild())
+                sceneBVH.build(objectBounds);
+        }
+    }, &transformsDone);
 
-    //inserting projection and view matrices into ubo
-    //--------------------------------------------------------------------------------------------------------
-    glBindBuffer(GL_UNIFORM_BUFFER, uboMatrices);
+    jobSystem.run([&]() {
+        //frustum culling through the BVH, then occlusion culling of the objects that survived it
+        visibleObjects.clear();
+        if (BVH_CULLING_ENABLED) {
+            sceneBVH.queryFrustum(Frustum(projection * view), visibleObjects, jobSystem);
+        }
+        else {
+            for (unsigned int i = 0; i < objectBounds.size(); ++i)
+                visibleObjects.push_back(i);
+        }
 
-    //glm::mat4 projection = glm::perspective(glm::radians(newCamera.getFOV()), (float)WINDOW_WIDTH / WINDOW_HEIGHT, 0.1f, 100.0f);
-    glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float)WINDOW_WIDTH / WINDOW_HEIGHT, 0.1f, 1000.0f);
-    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(glm::mat4), glm::value_ptr(projection));
+        if (OCCLUSION_CULLING_ENABLED) {
+            auto cullingStart = std::chrono::high_resolution_clock::now();
+            occlusionCuller.beginFrame(projection * view);
+            for (unsigned int i = 0; i < occluderNodes.size(); ++i)
+                occlusionCuller.addOccluderBox(sceneGraph.getWorldTransform(occluderNodes[i]));
+            occlusionCuller.rasterizeOccluders(jobSystem);
+            occlusionTestedObjects += visibleObjects.size();
+            occlusionCulledObjects += occlusionCuller.cullObjects(objectBounds, visibleObjects);
+            occlusionCullingTime += elapsedMilliseconds(cullingStart);
+
+            if (++occlusionFrames == 300) {
+                std::cout << "Occlusion culling: " << occlusionCulledObjects << " of " << occlusionTestedObjects << " tested objects culled ("
+                    << (occlusionTestedObjects > 0 ? 100.0f * occlusionCulledObjects / occlusionTestedObjects : 0.0f) << "%), "
+                    << occlusionCullingTime / occlusionFrames << " ms CPU per frame" << std::endl;
+                occlusionTestedObjects = occlusionCulledObjects = occlusionFrames = 0;
+                occlusionCullingTime = 0.0;
+            }
+        }
 
-    glm::mat4 view = newCamera.getViewMatrix();
-    glBufferSubData(GL_UNIFORM_BUFFER, sizeof(glm::mat4), sizeof(glm::mat4), glm::value_ptr(view));
+        std::fill(objectVisible.begin(), objectVisible.end(), 0);
+        for (unsigned int i = 0; i < visibleObjects.size(); ++i)
+            objectVisible[visibleObjects[i]] = 1;
+    }, &cullingDone, &transformsDone);
+
+    //the lights aren't part of the scene graph, so their binning doesn't wait for the transforms
+    Frustum viewFrustum(projection * view);
+    jobSystem.parallelFor(pointLights.size(), 16, [&](unsigned int begin, unsigned int end) {
+        for (unsigned int i = begin; i < end; ++i) {
+            float constant = pointLights[i].constant;
+            float linear = pointLights[i].linear;
+            float quadratic = pointLights[i].quadratic;
+            float lightMax = std::fmaxf(std::fmaxf(pointLights[i].diffuse.r, pointLights[i].diffuse.g), pointLights[i].diffuse.b);
+            lightRadii[i] = (-linear + std::sqrtf(linear * linear - 4.0 * quadratic * (constant - (256.0 / 5.0) * lightMax)))
+                / (2 * quadratic);
+            lightViewPositions[i] = glm::vec3(view * glm::vec4(pointLights[i].position, 1.0));
+            lightInView[i] = viewFrustum.intersectsSphere(pointLights[i].position, lightRadii[i]) ? 1 : 0;
+        }
+    }, &lightsDone);
+    //---------------------------------------------------------------------------------------------------------------
+    //---------------------------------------------------------------------------------------------------------------
 
-    glBindBuffer(GL_UNIFORM_BUFFER, 0);
-    //--------------------------------------------------------------------------------------------------------
-    //--------------------------------------------------------------------------------------------------------
+    //First pass: Geometry Pass
+    //---------------------------------------------------------------------------------------------------------------
+    //positions are read from gPosition in the standard layout and reconstructed from gDepth in the compact one
+    RenderGraph::Resource gPosition = 0, gNormal, gAlbedoSpec, gDepth, gPositionSource;
+    renderGraph.addPass("SSAO geometry", [&](RenderGraph::PassBuilder& builder) {
+        if (COMPACT_GBUFFER) {
+            //the normals are decoded with exact texel fetches, interpolating encoded normals across the octahedron seams is wrong
+            gNormal = builder.create("G-buffer normal", RenderTargetDesc(FRAMEBUFFER_WIDTH, FRAMEBUFFER_HEIGHT, GL_RG16, GL_NEAREST));
+        }
+        else {
+            gPosition = builder.create("G-buffer position", RenderTargetDesc(FRAMEBUFFER_WIDTH, FRAMEBUFFER_HEIGHT, GL_RGBA16F));
+            gNormal = builder.create("G-buffer normal", RenderTargetDesc(FRAMEBUFFER_WIDTH, FRAMEBUFFER_HEIGHT, GL_RGBA16F));
+            builder.write(gPosition);
+        }
+        gAlbedoSpec = builder.create("G-buffer albedo + specular", RenderTargetDesc(FRAMEBUFFER_WIDTH, FRAMEBUFFER_HEIGHT, GL_RGBA8));
+        gDepth = builder.create("G-buffer depth", RenderTargetDesc(FRAMEBUFFER_WIDTH, FRAMEBUFFER_HEIGHT, GL_DEPTH24_STENCIL8, GL_NEAREST));
+        gPositionSource = COMPACT_GBUFFER ? gDepth : gPosition;
+        builder.write(gNormal);
+        builder.write(gAlbedoSpec);
+        builder.write(gDepth);
+        //the culling pass tests against the pyramid of the previous frame, before this frame's Hi-Z pass rebuilds it
+        if (HIZ_ENABLED)
+            builder.read(hiZTarget);
+    }, [&](const RenderGraph& graph) {
+        glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+        //inserting projection and view matrices into ubo
+        //--------------------------------------------------------------------------------------------------------
+        glBindBuffer(GL_UNIFORM_BUFFER, uboMatrices);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(glm::mat4), glm::value_ptr(projection));
+        glBufferSubData(GL_UNIFORM_BUFFER, sizeof(glm::mat4), sizeof(glm::mat4), glm::value_ptr(view));
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        //--------------------------------------------------------------------------------------------------------
+        //--------------------------------------------------------------------------------------------------------
 
-    for (unsigned int i = 0; i < pointLights.size(); ++i) {
-        //Draw point lights
+        for (unsigned int i = 0; i < pointLights.size(); ++i) {
+            //Draw point lights
+            //---------------------------------------------------------------------------------------------------------------
+           // lightSourceDeferredGeometryPassShader.activateShader();
+           // lightSourceDeferredGeometryPassShader.setUniformVec3("lightColor", pointLights[i].diffuse);
+          //  drawCube(lightObjectVAO, lightSourceDeferredGeometryPassShader, pointLights[i].position, glm::vec3(0.2, 0.2, 0.2));
+            //---------------------------------------------------------------------------------------------------------------
+        }
+
+        //activate shader and pass uniforms to it
         //---------------------------------------------------------------------------------------------------------------
-       // lightSourceDeferredGeometryPassShader.activateShader();
-       // lightSourceDeferredGeometryPassShader.setUniformVec3("lightColor", pointLights[i].diffuse);
-      //  drawCube(lightObjectVAO, lightSourceDeferredGeometryPassShader, pointLights[i].position, glm::vec3(0.2, 0.2, 0.2));
+        Shader& geometryPassShader = COMPACT_GBUFFER ? compactGeometryPassShader : SSAOGeometryPassShader;
+        geometryPassShader.activateShader();
+        geometryPassShader.setUniformVec3("cameraPos", newCamera.getEye());
+        geometryPassShader.setUniformInt("gamma", GAMMA_ENABLED);
+        geometryPassShader.setUniformInt("normal_mapping", NORMAL_MAPPING);
+        geometryPassShader.setUniformInt("parallax_mapping", PARALLAX_MAPPING);
+        geometryPassShader.setUniformFloat("height_scale", 0.2);
+
+        //sets material properties
+        geometryPassShader.setUniformInt("material.diffuseMap", 0);
+        geometryPassShader.setUniformInt("material.specularMap", 0); //use the floor texture as a specular map
+        geometryPassShader.setUniformInt("material.emissionMap", 2);
+        geometryPassShader.setUniformFloat("material.shininess", 64.0f);
+        geometryPassShader.setUniformInt("material.heightMap", 1);
+        geometryPassShader.setUniformInt("depthMap", 3);
         //---------------------------------------------------------------------------------------------------------------
-    }
 
-    //activate shader and pass uniforms to it
-    //---------------------------------------------------------------------------------------------------------------
-    SSAOGeometryPassShader.activateShader();
-    SSAOGeometryPassShader.setUniformVec3("cameraPos", newCamera.getEye());
-    SSAOGeometryPassShader.setUniformInt("gamma", GAMMA_ENABLED);
-    SSAOGeometryPassShader.setUniformInt("normal_mapping", NORMAL_MAPPING);
-    SSAOGeometryPassShader.setUniformInt("parallax_mapping", PARALLAX_MAPPING);
-    SSAOGeometryPassShader.setUniformFloat("height_scale", 0.2);
+        //draw scene
+        //---------------------------------------------------------------------------------------------------------------
+        jobSystem.wait(cullingDone);
+
+        //GPU occlusion culling of what is left against the previous frame's depth
+        if (HIZ_ENABLED) {
+            beginGPUTimer(hiZCullingTimer);
+            cullWithHiZ(hiZCullingPass, hiZPyramid, hiZCullingShader, objectBounds, objectVisible);
+            std::string cullingLabel = "Hi-Z occlusion culling pass, " + std::to_string(objectBounds.size()) + " objects";
+            endGPUTimer(hiZCullingTimer, cullingLabel.c_str());
+
+            if (++hiZFrames == 300) {
+                std::cout << "Hi-Z occlusion culling: " << readHiZCulledObjects(hiZCullingPass, objectVisible) << " of " << visibleObjects.size()
+                    << " objects kept by the CPU culled this frame" << std::endl;
+                hiZFrames = 0;
+            }
+            geometryPassShader.activateShader();
+        }
 
-    //sets material properties
-    SSAOGeometryPassShader.setUniformInt("material.diffuseMap", 0);
-    SSAOGeometryPassShader.setUniformInt("material.specularMap", 0); //use the floor texture as a specular map
-    SSAOGeometryPassShader.setUniformInt("material.emissionMap", 2);
-    SSAOGeometryPassShader.setUniformFloat("material.shininess", 64.0f);
-    SSAOGeometryPassShader.setUniformInt("material.heightMap", 1);
-    SSAOGeometryPassShader.setUniformInt("depthMap", 3);
-    //---------------------------------------------------------------------------------------------------------------
+        //compare this with occlusion culling on and off for the net frame-time win
+        static bool lastOcclusionCulling = OCCLUSION_CULLING_ENABLED;
+        static bool lastHiZCulling = HIZ_ENABLED;
+        if (lastOcclusionCulling != OCCLUSION_CULLING_ENABLED || lastHiZCulling != HIZ_ENABLED) {
+            resetGPUTimer(geometryPassTimer);
+            lastOcclusionCulling = OCCLUSION_CULLING_ENABLED;
+            lastHiZCulling = HIZ_ENABLED;
+        }
+        beginGPUTimer(geometryPassTimer);
+
+        if (objectVisible[0]) {
+            if (modelLoaded)
+                modelObject.get().draw(geometryPassShader, sceneGraph.getWorldTransform(modelNode));
+            else {
+                glActiveTexture(GL_TEXTURE0);
+                glBindTexture(GL_TEXTURE_2D, GAMMA_ENABLED ? cubeTextureGammaCorrected : cubeTexture);
+                drawCube(cubeVAO, geometryPassShader, sceneGraph.getWorldTransform(modelNode));
+            }
+        }
+        //draw cube as floor
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, GAMMA_ENABLED ? floorTextureGammaCorrected : floorTexture);
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, cubeTexture_normal);
+        glActiveTexture(GL_TEXTURE3);
+        glBindTexture(GL_TEXTURE_2D, cubeTexture_depth);
+        if (objectVisible[1]) {
+            if (HIZ_ENABLED)
+                drawCube(cubeVAO, geometryPassShader, sceneGraph.getWorldTransform(floorNode), 1);
+            else
+                drawCube(cubeVAO, geometryPassShader, sceneGraph.getWorldTransform(floorNode));
+        }
 
-    //draw scene
+        //draw other cubes
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, GAMMA_ENABLED ? cubeTextureGammaCorrected : cubeTexture);
+        for (unsigned int i = 0; i < cubeNodes.size(); ++i) {
+            if (!objectVisible[2 + i])
+                continue;
+            if (HIZ_ENABLED)
+                drawCube(cubeVAO, geometryPassShader, sceneGraph.getWorldTransform(cubeNodes[i]), 2 + i);
+            else
+                drawCube(cubeVAO, geometryPassShader, sceneGraph.getWorldTransform(cubeNodes[i]));
+        }
+        std::string geometryLabel = std::string("Geometry pass draws, occlusion culling ") + (OCCLUSION_CULLING_ENABLED ? "on" : "off")
+            + ", Hi-Z culling " + (HIZ_ENABLED ? "on" : "off");
+        endGPUTimer(geometryPassTimer, geometryLabel.c_str());
+        //---------------------------------------------------------------------------------------------------------------
+    });
     //---------------------------------------------------------------------------------------------------------------
-    modelObject.draw(SSAOGeometryPassShader);
-    //draw cube as floor
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, GAMMA_ENABLED ? floorTextureGammaCorrected : floorTexture);
-    glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D, cubeTexture_normal);
-    glActiveTexture(GL_TEXTURE3);
-    glBindTexture(GL_TEXTURE_2D, cubeTexture_depth);
-    drawCube(cubeVAO, SSAOGeometryPassShader, glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(12.5f, 0.5f, 12.5f));
-
-    //draw other cubes
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, GAMMA_ENABLED ? cubeTextureGammaCorrected : cubeTexture);
-    drawCube(cubeVAO, SSAOGeometryPassShader, glm::vec3(0.0f, 1.5f, 0.0f), glm::vec3(0.5f));
-    drawCube(cubeVAO, SSAOGeometryPassShader, glm::vec3(2.0f, 0.0f, 1.0f), glm::vec3(0.5f));
-    glm::mat4 rotationMatrix = glm::rotate(identityMatrix, glm::radians(60.0f), glm::normalize(glm::vec3(1.0f, 0.0f, 1.0f)));
-    drawCube(cubeVAO, SSAOGeometryPassShader, glm::vec3(-1.0f, -1.0f, 2.0f), glm::vec3(1.0f), rotationMatrix);
-    rotationMatrix = glm::rotate(identityMatrix, glm::radians(23.0f), glm::normalize(glm::vec3(1.0f, 0.0f, 1.0f)));
-    drawCube(cubeVAO, SSAOGeometryPassShader, glm::vec3(0.0f, 2.7f, 4.0f), glm::vec3(1.25f), rotationMatrix);
-    rotationMatrix = glm::rotate(identityMatrix, glm::radians(124.0f), glm::normalize(glm::vec3(1.0f, 0.0f, 1.0f)));
-    drawCube(cubeVAO, SSAOGeometryPassShader, glm::vec3(-2.0f, 1.0f, -3.0f), glm::vec3(1.0f), rotationMatrix);
-    drawCube(cubeVAO, SSAOGeometryPassShader, glm::vec3(-3.0f, 0.0f, 0.0f), glm::vec3(0.5f));
     //---------------------------------------------------------------------------------------------------------------
 
+    //Hi-Z pass: build the depth pyramid from the G-buffer that was just written. The next frame's culling pass needs
+    //it, so it is kept while Hi-Z culling is on; otherwise it only runs when the SSAO pass samples it
+    //---------------------------------------------------------------------------------------------------------------
+    if (HIZ_ENABLED || HIZ_AO_ENABLED) {
+        renderGraph.addPass("Hi-Z build", [&](RenderGraph::PassBuilder& builder) {
+            builder.read(gPositionSource);
+            if (!COMPACT_GBUFFER)
+                builder.read(gNormal);
+            builder.writeExternally(hiZTarget);
+            if (HIZ_ENABLED)
+                builder.keep();
+        }, [&](const RenderGraph& graph) {
+            beginGPUTimer(hiZBuildTimer);
+            if (COMPACT_GBUFFER)
+                buildHiZPyramid(hiZPyramid, hiZCopyShader, hiZDownsampleShader, HIZ_DEPTH_BUFFER, graph.getTexture(gDepth), 0, view, projection, 1000.0f, screenQuadVAO);
+            else
+                buildHiZPyramid(hiZPyramid, hiZCopyShader, hiZDownsampleShader, HIZ_VIEW_POSITIONS, graph.getTexture(gPosition), graph.getTexture(gNormal), view, projection, 1000.0f, screenQuadVAO);
+            std::string hiZLabel = "Hi-Z pyramid build " + std::to_string(FRAMEBUFFER_WIDTH) + "x" + std::to_string(FRAMEBUFFER_HEIGHT) + ", "
+                + std::to_string(hiZPyramid.levelSizes.size()) + " levels";
+            endGPUTimer(hiZBuildTimer, hiZLabel.c_str());
+            hiZBuilt = true;
+        });
+    }
     //---------------------------------------------------------------------------------------------------------------
     //---------------------------------------------------------------------------------------------------------------
 
     //SSAO pass: calculate ambient occlusion for each fragment
     //---------------------------------------------------------------------------------------------------------------
-    glBindFramebuffer(GL_FRAMEBUFFER, ssaoFBO);
-    glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
-    glViewport(0, 0, FRAMEBUFFER_WIDTH, FRAMEBUFFER_HEIGHT);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-    SSAOShader.activateShader();
-    SSAOShader.setUniformMatrix4("projection", projection);
-    SSAOShader.setUniformMatrix4("view", view);
-
-    //set uniform sampler textures in shader
-    SSAOShader.setUniformInt("gPosition", 0);
-    SSAOShader.setUniformInt("gNormal", 1);
-    SSAOShader.setUniformInt("noiseTexture", 2);
+    RenderGraph::Resource ssaoTarget;
+    renderGraph.addPass("SSAO", [&](RenderGraph::PassBuilder& builder) {
+        ssaoTarget = builder.create("SSAO", RenderTargetDesc(FRAMEBUFFER_WIDTH, FRAMEBUFFER_HEIGHT, GL_R8));
+        builder.read(gPositionSource);
+        builder.read(gNormal);
+        if (HIZ_AO_ENABLED)
+            builder.read(hiZTarget);
+        builder.write(ssaoTarget);
+    }, [&](const RenderGraph& graph) {
+        glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT);
+
+        //compare this with Hi-Z sampling on and off, the difference grows with the kernel radius
+        static bool lastHiZAO = HIZ_AO_ENABLED;
+        if (lastHiZAO != HIZ_AO_ENABLED) {
+            resetGPUTimer(ssaoTimer);
+            lastHiZAO = HIZ_AO_ENABLED;
+        }
+        beginGPUTimer(ssaoTimer);
+
+        //only the temporal shader reads the compact G-buffer and the Hi-Z pyramid, outside of temporal mode it is run over
+        //the full kernel
+        Shader& aoShader = (TEMPORAL_AO_ENABLED || COMPACT_GBUFFER || HIZ_AO_ENABLED) ? SSAOTemporalShader : SSAOShader;
+        aoShader.activateShader();
+        aoShader.setUniformMatrix4("projection", projection);
+        aoShader.setUniformMatrix4("view", view);
+
+        //set uniform sampler textures in shader
+        aoShader.setUniformInt("gPosition", 0);
+        aoShader.setUniformInt("gNormal", 1);
+        aoShader.setUniformInt("noiseTexture", 2);
+        aoShader.setUniformInt("gDepth", 3);
+
+        //set remaining uniforms
+        aoShader.setUniformFloat("kernelRadius", kernelRadius);
+        aoShader.setUniformVec2("noiseScale", noiseScale);
+        aoShader.setUniformArrayOfVec3("ssaoKernel", ssaoKernel);
+        aoShader.setUniformInt("compactGBuffer", COMPACT_GBUFFER);
+        aoShader.setUniformMatrix4("inverseProjection", glm::inverse(projection));
+        aoShader.setUniformInt("useHiZ", HIZ_AO_ENABLED);
+        aoShader.setUniformInt("hiZ", 4);
+        aoShader.setUniformInt("hiZLevels", hiZPyramid.levelSizes.size());
+        if (TEMPORAL_AO_ENABLED) {
+            //rotate through interleaved subsets of the kernel (sample k = i * stride + offset), so that every frame covers
+            //the whole hemisphere at near and far distances and numFrames consecutive frames cover the full kernel
+            unsigned int sampleStride = ssaoKernel.size() / temporalSamples;
+            aoShader.setUniformInt("numSamples", temporalSamples);
+            aoShader.setUniformInt("sampleStride", sampleStride);
+            aoShader.setUniformInt("sampleOffset", frameIndex % sampleStride);
+
+            //shift the noise tile every frame so that the rotation pattern also varies over time
+            glm::vec2 noiseOffset((frameIndex * 7) % noiseRadius, (frameIndex * 3) % noiseRadius);
+            aoShader.setUniformVec2("noiseOffset", noiseOffset / (float) noiseRadius);
+        }
+        else if (COMPACT_GBUFFER || HIZ_AO_ENABLED) {
+            aoShader.setUniformInt("numSamples", ssaoKernel.size());
+            aoShader.setUniformInt("sampleStride", 1);
+            aoShader.setUniformInt("sampleOffset", 0);
+            aoShader.setUniformVec2("noiseOffset", glm::vec2(0.0f));
+        }
 
-    //set remaining uniforms
-    SSAOShader.setUniformFloat("kernelRadius", kernelRadius);
-    SSAOShader.setUniformVec2("noiseScale", noiseScale);
-    SSAOShader.setUniformArrayOfVec3("ssaoKernel", ssaoKernel);
+        //draw screen quad
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, COMPACT_GBUFFER ? 0 : graph.getTexture(gPosition));
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, graph.getTexture(gNormal));
+        glActiveTexture(GL_TEXTURE2);
+        glBindTexture(GL_TEXTURE_2D, noiseTexture);
+        glActiveTexture(GL_TEXTURE3);
+        glBindTexture(GL_TEXTURE_2D, COMPACT_GBUFFER ? graph.getTexture(gDepth) : 0);
+        glActiveTexture(GL_TEXTURE4);
+        glBindTexture(GL_TEXTURE_2D, hiZPyramid.texture);
+        glBindVertexArray(screenQuadVAO);
+        glDrawArrays(GL_TRIANGLES, 0, 6);
+        endGPUTimer(ssaoTimer, HIZ_AO_ENABLED ? "SSAO pass, Hi-Z sampling on" : "SSAO pass, Hi-Z sampling off");
+    });
+    //---------------------------------------------------------------------------------------------------------------
+    //---------------------------------------------------------------------------------------------------------------
 
-    //draw screen quad
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, gPosition);
-    glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D, gNormal);
-    glActiveTexture(GL_TEXTURE2);
-    glBindTexture(GL_TEXTURE_2D, noiseTexture);
-    glBindVertexArray(screenQuadVAO);
-    glDrawArrays(GL_TRIANGLES, 0, 6);
+    //Temporal resolve pass: blend the current ao with the reprojected history, rejecting history on depth mismatch
+    //---------------------------------------------------------------------------------------------------------------
+    RenderGraph::Resource aoResult = ssaoTarget;
+    if (TEMPORAL_AO_ENABLED) {
+        unsigned int current = frameIndex % 2;
+        aoResult = historyTargets[current];
+        renderGraph.addPass("SSAO temporal resolve", [&](RenderGraph::PassBuilder& builder) {
+            builder.read(ssaoTarget);
+            builder.read(historyTargets[!current]);
+            builder.read(gPositionSource);
+            builder.write(historyTargets[current]);
+        }, [&, current](const RenderGraph& graph) {
+            glClear(GL_COLOR_BUFFER_BIT);
+
+            SSAOTemporalResolveShader.activateShader();
+            SSAOTemporalResolveShader.setUniformMatrix4("inverseView", glm::inverse(view));
+            SSAOTemporalResolveShader.setUniformMatrix4("prevView", prevView);
+            SSAOTemporalResolveShader.setUniformMatrix4("prevProjection", prevProjection);
+            SSAOTemporalResolveShader.setUniformFloat("historyBlend", historyBlend);
+            SSAOTemporalResolveShader.setUniformFloat("depthRejectThreshold", depthRejectThreshold);
+            SSAOTemporalResolveShader.setUniformInt("historyValid", historyValid);
+            SSAOTemporalResolveShader.setUniformInt("ssaoInput", 0);
+            SSAOTemporalResolveShader.setUniformInt("history", 1);
+            SSAOTemporalResolveShader.setUniformInt("gPosition", 2);
+            SSAOTemporalResolveShader.setUniformInt("gDepth", 3);
+            SSAOTemporalResolveShader.setUniformInt("compactGBuffer", COMPACT_GBUFFER);
+            SSAOTemporalResolveShader.setUniformMatrix4("inverseProjection", glm::inverse(projection));
+
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, graph.getTexture(ssaoTarget));
+            glActiveTexture(GL_TEXTURE1);
+            glBindTexture(GL_TEXTURE_2D, graph.getTexture(historyTargets[!current]));
+            glActiveTexture(GL_TEXTURE2);
+            glBindTexture(GL_TEXTURE_2D, COMPACT_GBUFFER ? 0 : graph.getTexture(gPosition));
+            glActiveTexture(GL_TEXTURE3);
+            glBindTexture(GL_TEXTURE_2D, COMPACT_GBUFFER ? graph.getTexture(gDepth) : 0);
+            glBindVertexArray(screenQuadVAO);
+            glDrawArrays(GL_TRIANGLES, 0, 6);
+
+            historyWritten = true;
+        });
+    }
     //---------------------------------------------------------------------------------------------------------------
     //---------------------------------------------------------------------------------------------------------------
 
     //SSAO blur pass
     //---------------------------------------------------------------------------------------------------------------
-    glBindFramebuffer(GL_FRAMEBUFFER, ssaoBlurFBO); 
-    glViewport(0, 0, WINDOW_WIDTH, WINDOW_HEIGHT);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-    SSAOBlurShader.activateShader();
-
-    //draw screen quad
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, ssaoColorBuffer);
-    glBindVertexArray(screenQuadVAO);
-    glDrawArrays(GL_TRIANGLES, 0, 6);
-
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    RenderGraph::Resource ssaoBlurTarget;
+    renderGraph.addPass("SSAO blur", [&](RenderGraph::PassBuilder& builder) {
+        ssaoBlurTarget = builder.create("SSAO blur", RenderTargetDesc(FRAMEBUFFER_WIDTH, FRAMEBUFFER_HEIGHT, GL_R8));
+        builder.read(aoResult);
+        builder.write(ssaoBlurTarget);
+    }, [&](const RenderGraph& graph) {
+        glClear(GL_COLOR_BUFFER_BIT);
+        SSAOBlurShader.activateShader();
+
+        //draw screen quad
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, graph.getTexture(aoResult));
+        glBindVertexArray(screenQuadVAO);
+        glDrawArrays(GL_TRIANGLES, 0, 6);
+    });
     //---------------------------------------------------------------------------------------------------------------
     //---------------------------------------------------------------------------------------------------------------
 
-    //Lighting pass: render to screen
+    //Lighting pass: render at the internal resolution, upscaled to the screen. Nothing reads the ao when it is off, so
+    //the SSAO passes above are culled
     //---------------------------------------------------------------------------------------------------------------
     //---------------------------------------------------------------------------------------------------------------
-    glViewport(0, 0, WINDOW_WIDTH, WINDOW_HEIGHT);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-    SSAOLightingPassShader.activateShader();
+    RenderGraph::Resource sceneColor;
+    renderGraph.addPass("SSAO lighting", [&](RenderGraph::PassBuilder& builder) {
+        builder.read(gPositionSource);
+        builder.read(gNormal);
+        builder.read(gAlbedoSpec);
+        if (AO_ENABLED)
+            builder.read(ssaoBlurTarget);
+        sceneColor = builder.create("Scene color", RenderTargetDesc(FRAMEBUFFER_WIDTH, FRAMEBUFFER_HEIGHT, GL_RGBA8));
+        builder.write(sceneColor);
+    }, [&](const RenderGraph& graph) {
+        glClear(GL_COLOR_BUFFER_BIT);
+        Shader& lightingPassShader = COMPACT_GBUFFER ? compactLightingPassShader : SSAOLightingPassShader;
+        lightingPassShader.activateShader();
+
+        //send the data of the binned lights
+        jobSystem.wait(lightsDone);
+        unsigned int numLights = 0;
+        for (unsigned int i = 0; i < pointLights.size() && numLights < MAX_LIGHTS; ++i) {
+            if (!lightInView[i])
+                continue;
+            std::string light = "lights[" + std::to_string(numLights) + "]";
+            lightingPassShader.setUniformFloat(light + ".radius", lightRadii[i]);
+            lightingPassShader.setUniformFloat(light + ".constant", pointLights[i].constant);
+            lightingPassShader.setUniformFloat(light + ".linear", pointLights[i].linear);
+            lightingPassShader.setUniformFloat(light + ".quadratic", pointLights[i].quadratic);
+            lightingPassShader.setUniformVec3("lightPos[" + std::to_string(numLights) + "]", lightViewPositions[i]);
+            lightingPassShader.setUniformVec3(light + ".ambient", pointLights[i].ambient);
+            lightingPassShader.setUniformVec3(light + ".diffuse", pointLights[i].diffuse);
+            lightingPassShader.setUniformVec3(light + ".specular", pointLights[i].specular);
+            ++numLights;
+        }
 
-    //send light data
-    for (unsigned int i = 0; i < pointLights.size(); ++i) {
-        float constant = pointLights[i].constant;
-        float linear = pointLights[i].linear;
-        float quadratic = pointLights[i].quadratic;
-        float lightMax = std::fmaxf(std::fmaxf(pointLights[i].diffuse.r, pointLights[i].diffuse.g), pointLights[i].diffuse.b);
-        float radius = (-linear + std::sqrtf(linear * linear - 4.0 * quadratic * (constant - (256.0 / 5.0) * lightMax)))
-            / (2 * quadratic);
-        SSAOLightingPassShader.setUniformFloat("lights[" + std::to_string(i) + "].radius", radius);
-        SSAOLightingPassShader.setUniformFloat("lights[" + std::to_string(i) + "].constant", pointLights[i].constant);
-        SSAOLightingPassShader.setUniformFloat("lights[" + std::to_string(i) + "].linear", pointLights[i].linear);
-        SSAOLightingPassShader.setUniformFloat("lights[" + std::to_string(i) + "].quadratic", pointLights[i].quadratic);
-        SSAOLightingPassShader.setUniformVec3("lightPos[" + std::to_string(i) + "]", 
-            glm::vec3(view * glm::vec4(pointLights[i].position, 1.0)));
-        SSAOLightingPassShader.setUniformVec3("lights[" + std::to_string(i) + "].ambient", pointLights[i].ambient);
-        SSAOLightingPassShader.setUniformVec3("lights[" + std::to_string(i) + "].diffuse", pointLights[i].diffuse);
-        SSAOLightingPassShader.setUniformVec3("lights[" + std::to_string(i) + "].specular", pointLights[i].specular);
-    }
-
-    //send remaining uniforms
-    SSAOLightingPassShader.setUniformVec3("cameraPos", newCamera.getEye());
-    SSAOLightingPassShader.setUniformFloat("shininess", 64.0f);
-    SSAOLightingPassShader.setUniformInt("gamma", GAMMA_ENABLED);
-    SSAOLightingPassShader.setUniformInt("ao", AO_ENABLED);
-    SSAOLightingPassShader.setUniformInt("numLights", pointLights.size());
-    SSAOLightingPassShader.setUniformInt("gPosition", 0);
-    SSAOLightingPassShader.setUniformInt("gNormal", 1); //use the floor texture as a specular map
-    SSAOLightingPassShader.setUniformInt("gAlbedoSpec", 2); 
-    SSAOLightingPassShader.setUniformInt("ssao", 3);
-    //draw screen quad
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, gPosition);
-    glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D, gNormal);
-    glActiveTexture(GL_TEXTURE2);
-    glBindTexture(GL_TEXTURE_2D, gAlbedoSpec);
-    glActiveTexture(GL_TEXTURE3);
-    glBindTexture(GL_TEXTURE_2D, ssaoColorBufferBlur);
-    glBindVertexArray(screenQuadVAO);
-    glDrawArrays(GL_TRIANGLES, 0, 6);
+        //send remaining uniforms
+        lightingPassShader.setUniformVec3("cameraPos", newCamera.getEye());
+        lightingPassShader.setUniformFloat("shininess", 64.0f);
+        lightingPassShader.setUniformInt("gamma", GAMMA_ENABLED);
+        lightingPassShader.setUniformInt("ao", AO_ENABLED);
+        lightingPassShader.setUniformInt("numLights", numLights);
+        lightingPassShader.setUniformInt("gPosition", 0);
+        lightingPassShader.setUniformInt("gNormal", 1); //use the floor texture as a specular map
+        lightingPassShader.setUniformInt("gAlbedoSpec", 2); 
+        lightingPassShader.setUniformInt("ssao", 3);
+        lightingPassShader.setUniformInt("gDepth", 4);
+        lightingPassShader.setUniformMatrix4("inverseProjection", glm::inverse(projection));
+        //draw screen quad
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, COMPACT_GBUFFER ? 0 : graph.getTexture(gPosition));
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, graph.getTexture(gNormal));
+        glActiveTexture(GL_TEXTURE2);
+        glBindTexture(GL_TEXTURE_2D, graph.getTexture(gAlbedoSpec));
+        glActiveTexture(GL_TEXTURE3);
+        glBindTexture(GL_TEXTURE_2D, AO_ENABLED ? graph.getTexture(ssaoBlurTarget) : 0);
+        glActiveTexture(GL_TEXTURE4);
+        glBindTexture(GL_TEXTURE_2D, COMPACT_GBUFFER ? graph.getTexture(gDepth) : 0);
+        glBindVertexArray(screenQuadVAO);
+        glDrawArrays(GL_TRIANGLES, 0, 6);
+    });
     //---------------------------------------------------------------------------------------------------------------
     //---------------------------------------------------------------------------------------------------------------
+
+    addUpscalePass(renderGraph, sceneColor, screenQuadVAO);
+
+    renderGraph.compile();
+    renderGraph.reportMemory("SSAO");
+    renderGraph.execute();
+    //the jobs reference this frame's locals, and a culled pass would never have waited for them
+    jobSystem.wait(cullingDone);
+    jobSystem.wait(lightsDone);
+
+    //whatever was culled this frame is stale: nothing rebuilt the pyramid or wrote the history
+    if (!hiZBuilt)
+        hiZPyramid.valid = false;
+    historyValid = historyWritten;
+    prevView = view;
+    prevProjection = projection;
+    ++frameIndex;
 }
 
 void renderSceneWithDeferredShading(unsigned int cubeVAO, unsigned int lightObjectVAO, unsigned int screenQuadVAO, unsigned int uboMatrices) {
@@ -928,6 +1610,10 @@ void renderSceneWithDeferredShading(unsigned int cubeVAO, unsigned int lightObje
     static Shader screenShader = Shader("Shaders/screenShader.vert", "Shaders/screenShader.frag");
     static Shader lightSourceShader = Shader("Shaders/lightSourceShader.vert", "Shaders/lightSourceShader.frag");
     static Shader deferredMultipleLightingPassShader = Shader("Shaders/deferredMultipleLightingPass.vert", "Shaders/deferredMultipleLightingPass.frag");
+    static Shader compactGeometryPassShader = Shader("Shaders/compactGeometryPass.vert", "Shaders/compactGeometryPass.frag");
+    static Shader compactLightingPassShader = Shader("Shaders/deferredMultipleLightingPass.vert", "Shaders/compactLightingPass.frag");
+    static Shader hiZCopyShader = Shader("Shaders/bloomMip.vert", "Shaders/hiZCopy.frag");
+    static Shader hiZDownsampleShader = Shader("Shaders/bloomMip.vert", "Shaders/hiZDownsample.frag");
     //--------------------------------------------------------------------------------------------------------
 
     //load textures
@@ -940,7 +1626,13 @@ void renderSceneWithDeferredShading(unsigned int cubeVAO, unsigned int lightObje
     static unsigned int cubeTexture_depth = textureFromFile("../../Textures/toy_box_disp.png", false);
     //--------------------------------------------------------------------------------------------------------
 
-    static unsigned int gBuffer, gPosition, gNormal, gAlbedoSpec;
+    //gpu time of the geometry and lighting passes
+    static GPUTimer gBufferTimer;
+    static bool timedLayout = COMPACT_GBUFFER;
+
+    //hierarchical-Z pyramid of the geometry pass, built from world-space positions or from the compact layout's depth
+    static HiZPyramid hiZPyramid;
+    static GPUTimer hiZBuildTimer;
     if (!initialized) {
         //initialize light range to 7
         //---------------------------------------------------------------------------------------------------------
@@ -950,14 +1642,8 @@ void renderSceneWithDeferredShading(unsigned int cubeVAO, unsigned int lightObje
         }
         //---------------------------------------------------------------------------------------------------------
 
-        //setup G-buffer
-        //---------------------------------------------------------------------------------------------------------
-        unsigned int colorBuffers[3];
-        GLint internalFormat[3] = { GL_RGBA16F, GL_RGBA16F, GL_RGBA };
-        createFBO(gBuffer, colorBuffers, 3, internalFormat);
-        gPosition = colorBuffers[0];
-        gNormal = colorBuffers[1];
-        gAlbedoSpec = colorBuffers[2];
+        //the G-buffer itself is declared every frame on the render graph, only the layout in use takes memory
+        printGBufferBandwidth();
         //---------------------------------------------------------------------------------------------------------
         //---------------------------------------------------------------------------------------------------------
 
@@ -970,11 +1656,13 @@ void renderSceneWithDeferredShading(unsigned int cubeVAO, unsigned int lightObje
         unsigned int lightSourceDeferredGeometryPassShader_uniformBlockIndex = glGetUniformBlockIndex(lightSourceDeferredGeometryPassShader.getProgramId(), "Matrices");
         unsigned int deferredGeometryPassShader_uniformBlockIndex = glGetUniformBlockIndex(deferredGeometryPassShader.getProgramId(), "Matrices");
         unsigned int lightSourceShader_uniformBlockIndex = glGetUniformBlockIndex(lightSourceShader.getProgramId(), "Matrices");
+        unsigned int compactGeometryPassShader_uniformBlockIndex = glGetUniformBlockIndex(compactGeometryPassShader.getProgramId(), "Matrices");
 
         //link each shader's uniform block indices to uniform binding point(loc) 0
         glUniformBlockBinding(lightSourceDeferredGeometryPassShader.getProgramId(), lightSourceDeferredGeometryPassShader_uniformBlockIndex, 0);
         glUniformBlockBinding(deferredGeometryPassShader.getProgramId(), deferredGeometryPassShader_uniformBlockIndex, 0);
         glUniformBlockBinding(lightSourceShader.getProgramId(), lightSourceShader_uniformBlockIndex, 0);
+        glUniformBlockBinding(compactGeometryPassShader.getProgramId(), compactGeometryPassShader_uniformBlockIndex, 0);
         //--------------------------------------------------------------------------------------------------------
 
         initialized = true;
@@ -983,150 +1671,225 @@ void renderSceneWithDeferredShading(unsigned int cubeVAO, unsigned int lightObje
     //------------------------------------------------------------------------------------------------------------------------------------
     //------------------------------------------------------------------------------------------------------------------------------------
 
-    //First pass: Geometry Pass
-    //---------------------------------------------------------------------------------------------------------------
-    glBindFramebuffer(GL_FRAMEBUFFER, gBuffer);
-    glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
-    glViewport(0, 0, FRAMEBUFFER_WIDTH, FRAMEBUFFER_HEIGHT);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-    //inserting projection and view matrices into ubo
-    //--------------------------------------------------------------------------------------------------------
-    glBindBuffer(GL_UNIFORM_BUFFER, uboMatrices);
+    //the layout switched: restart the averaging so that both layouts are never mixed in one figure
+    if (timedLayout != COMPACT_GBUFFER) {
+        resetGPUTimer(gBufferTimer);
+        resetGPUTimer(hiZBuildTimer);
+        timedLayout = COMPACT_GBUFFER;
+    }
 
     //glm::mat4 projection = glm::perspective(glm::radians(newCamera.getFOV()), (float)WINDOW_WIDTH / WINDOW_HEIGHT, 0.1f, 100.0f);
     glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float)WINDOW_WIDTH / WINDOW_HEIGHT, 0.1f, 1000.0f);
-    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(glm::mat4), glm::value_ptr(projection));
-
     glm::mat4 view = newCamera.getViewMatrix();
-    glBufferSubData(GL_UNIFORM_BUFFER, sizeof(glm::mat4), sizeof(glm::mat4), glm::value_ptr(view));
 
-    glBindBuffer(GL_UNIFORM_BUFFER, 0);
-    //--------------------------------------------------------------------------------------------------------
-    //--------------------------------------------------------------------------------------------------------
+    //First pass: Geometry Pass
+    //---------------------------------------------------------------------------------------------------------------
+    //the compact layout drops the position target, reconstructs positions from depth and octahedral-encodes the
+    //view-space normal into GL_RG16, so the color targets take 8 bytes per pixel instead of 20
+    RenderGraph::Resource gPosition = 0, gNormal, gAlbedoSpec, gDepth;
+    std::vector<RenderGraph::Resource> gBufferTargets;
+    createHiZPyramid(hiZPyramid, FRAMEBUFFER_WIDTH, FRAMEBUFFER_HEIGHT);
+    RenderGraph::Resource hiZTarget = renderGraph.importTexture("Hi-Z pyramid", hiZPyramid.texture, RenderTargetDesc(FRAMEBUFFER_WIDTH, FRAMEBUFFER_HEIGHT, GL_RG32F));
+    renderGraph.addPass("Deferred geometry", [&](RenderGraph::PassBuilder& builder) {
+        if (COMPACT_GBUFFER) {
+            //the normals are decoded with exact texel fetches, interpolating encoded normals across the octahedron seams is wrong
+            gNormal = builder.create("G-buffer normal", RenderTargetDesc(FRAMEBUFFER_WIDTH, FRAMEBUFFER_HEIGHT, GL_RG16, GL_NEAREST));
+            gAlbedoSpec = builder.create("G-buffer albedo + specular", RenderTargetDesc(FRAMEBUFFER_WIDTH, FRAMEBUFFER_HEIGHT, GL_RGBA8));
+            gBufferTargets = { gNormal, gAlbedoSpec };
+        }
+        else {
+            gPosition = builder.create("G-buffer position", RenderTargetDesc(FRAMEBUFFER_WIDTH, FRAMEBUFFER_HEIGHT, GL_RGBA16F));
+            gNormal = builder.create("G-buffer normal", RenderTargetDesc(FRAMEBUFFER_WIDTH, FRAMEBUFFER_HEIGHT, GL_RGBA16F));
+            gAlbedoSpec = builder.create("G-buffer albedo + specular", RenderTargetDesc(FRAMEBUFFER_WIDTH, FRAMEBUFFER_HEIGHT, GL_RGBA8));
+            gBufferTargets = { gPosition, gNormal, gAlbedoSpec };
+        }
+        //depth is sampled to reconstruct positions, and kept in the default framebuffer's format so it can be blitted
+        gDepth = builder.create("G-buffer depth", RenderTargetDesc(FRAMEBUFFER_WIDTH, FRAMEBUFFER_HEIGHT, GL_DEPTH24_STENCIL8, GL_NEAREST));
+        gBufferTargets.push_back(gDepth);
+        for (unsigned int i = 0; i < gBufferTargets.size(); ++i)
+            builder.write(gBufferTargets[i]);
+    }, [&](const RenderGraph& graph) {
+        beginGPUTimer(gBufferTimer);
+        glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+        //inserting projection and view matrices into ubo
+        //--------------------------------------------------------------------------------------------------------
+        glBindBuffer(GL_UNIFORM_BUFFER, uboMatrices);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(glm::mat4), glm::value_ptr(projection));
+        glBufferSubData(GL_UNIFORM_BUFFER, sizeof(glm::mat4), sizeof(glm::mat4), glm::value_ptr(view));
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        //--------------------------------------------------------------------------------------------------------
+        //--------------------------------------------------------------------------------------------------------
 
-    for (unsigned int i = 0; i < pointLights.size(); ++i) {
-        //Draw point lights
+        Shader& geometryPassShader = COMPACT_GBUFFER ? compactGeometryPassShader : deferredGeometryPassShader;
+        for (unsigned int i = 0; i < pointLights.size(); ++i) {
+            //Draw point lights
+            //---------------------------------------------------------------------------------------------------------------
+           // lightSourceDeferredGeometryPassShader.activateShader();
+           // lightSourceDeferredGeometryPassShader.setUniformVec3("lightColor", pointLights[i].diffuse);
+          //  drawCube(lightObjectVAO, lightSourceDeferredGeometryPassShader, pointLights[i].position, glm::vec3(0.2, 0.2, 0.2));
+            //---------------------------------------------------------------------------------------------------------------
+
+            //send pointLight uniform values for drawing objects
+            //---------------------------------------------------------------------------------------------------------------
+            geometryPassShader.activateShader();
+            geometryPassShader.setUniformVec3("lightPos[" + std::to_string(i) + "]", pointLights[i].position);
+            geometryPassShader.setUniformVec3("lights[" + std::to_string(i) + "].ambient", pointLights[i].ambient);
+            geometryPassShader.setUniformVec3("lights[" + std::to_string(i) + "].diffuse", pointLights[i].diffuse);
+            geometryPassShader.setUniformVec3("lights[" + std::to_string(i) + "].specular", pointLights[i].specular);
+            //---------------------------------------------------------------------------------------------------------------
+        }
+
+        //activate shader and pass uniforms to it
         //---------------------------------------------------------------------------------------------------------------
-       // lightSourceDeferredGeometryPassShader.activateShader();
-       // lightSourceDeferredGeometryPassShader.setUniformVec3("lightColor", pointLights[i].diffuse);
-      //  drawCube(lightObjectVAO, lightSourceDeferredGeometryPassShader, pointLights[i].position, glm::vec3(0.2, 0.2, 0.2));
+        geometryPassShader.activateShader();
+        geometryPassShader.setUniformVec3("cameraPos", newCamera.getEye());
+        geometryPassShader.setUniformInt("gamma", GAMMA_ENABLED);
+        geometryPassShader.setUniformInt("normal_mapping", NORMAL_MAPPING);
+        geometryPassShader.setUniformInt("parallax_mapping", PARALLAX_MAPPING);
+        geometryPassShader.setUniformFloat("height_scale", 0.2);
+        geometryPassShader.setUniformInt("numLights", pointLights.size());
+
+        //sets material properties
+        geometryPassShader.setUniformInt("material.diffuseMap", 0);
+        geometryPassShader.setUniformInt("material.specularMap", 0); //use the floor texture as a specular map
+        geometryPassShader.setUniformInt("material.emissionMap", 2);
+        geometryPassShader.setUniformFloat("material.shininess", 64.0f);
+        geometryPassShader.setUniformInt("material.heightMap", 1);
+        geometryPassShader.setUniformInt("depthMap", 3);
         //---------------------------------------------------------------------------------------------------------------
 
-        //send pointLight uniform values for drawing objects
-        //---------------------------------------------------------------------------------------------------------------
-        deferredGeometryPassShader.activateShader();
-        deferredGeometryPassShader.setUniformVec3("lightPos[" + std::to_string(i) + "]", pointLights[i].position);
-        deferredGeometryPassShader.setUniformVec3("lights[" + std::to_string(i) + "].ambient", pointLights[i].ambient);
-        deferredGeometryPassShader.setUniformVec3("lights[" + std::to_string(i) + "].diffuse", pointLights[i].diffuse);
-        deferredGeometryPassShader.setUniformVec3("lights[" + std::to_string(i) + "].specular", pointLights[i].specular);
+        //draw scene
         //---------------------------------------------------------------------------------------------------------------
-    }
+        //draw cube as floor
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, GAMMA_ENABLED ? floorTextureGammaCorrected : floorTexture);
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, cubeTexture_normal);
+        glActiveTexture(GL_TEXTURE3);
+        glBindTexture(GL_TEXTURE_2D, cubeTexture_depth);
+        drawCube(cubeVAO, geometryPassShader, glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(12.5f, 0.5f, 12.5f));
 
-    //activate shader and pass uniforms to it
+        //draw other cubes
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, GAMMA_ENABLED ? cubeTextureGammaCorrected : cubeTexture);
+        drawCube(cubeVAO, geometryPassShader, glm::vec3(0.0f, 1.5f, 0.0f), glm::vec3(0.5f));
+        drawCube(cubeVAO, geometryPassShader, glm::vec3(2.0f, 0.0f, 1.0f), glm::vec3(0.5f));
+        glm::mat4 rotationMatrix = glm::rotate(identityMatrix, glm::radians(60.0f), glm::normalize(glm::vec3(1.0f, 0.0f, 1.0f)));
+        drawCube(cubeVAO, geometryPassShader, glm::vec3(-1.0f, -1.0f, 2.0f), glm::vec3(1.0f), rotationMatrix);
+        rotationMatrix = glm::rotate(identityMatrix, glm::radians(23.0f), glm::normalize(glm::vec3(1.0f, 0.0f, 1.0f)));
+        drawCube(cubeVAO, geometryPassShader, glm::vec3(0.0f, 2.7f, 4.0f), glm::vec3(1.25f), rotationMatrix);
+        rotationMatrix = glm::rotate(identityMatrix, glm::radians(124.0f), glm::normalize(glm::vec3(1.0f, 0.0f, 1.0f)));
+        drawCube(cubeVAO, geometryPassShader, glm::vec3(-2.0f, 1.0f, -3.0f), glm::vec3(1.0f), rotationMatrix);
+        drawCube(cubeVAO, geometryPassShader, glm::vec3(-3.0f, 0.0f, 0.0f), glm::vec3(0.5f));
+        //---------------------------------------------------------------------------------------------------------------
+    });
     //---------------------------------------------------------------------------------------------------------------
-    deferredGeometryPassShader.activateShader();
-    deferredGeometryPassShader.setUniformVec3("cameraPos", newCamera.getEye());
-    deferredGeometryPassShader.setUniformInt("gamma", GAMMA_ENABLED);
-    deferredGeometryPassShader.setUniformInt("normal_mapping", NORMAL_MAPPING);
-    deferredGeometryPassShader.setUniformInt("parallax_mapping", PARALLAX_MAPPING);
-    deferredGeometryPassShader.setUniformFloat("height_scale", 0.2);
-    deferredGeometryPassShader.setUniformInt("numLights", pointLights.size());
-
-    //sets material properties
-    deferredGeometryPassShader.setUniformInt("material.diffuseMap", 0);
-    deferredGeometryPassShader.setUniformInt("material.specularMap", 0); //use the floor texture as a specular map
-    deferredGeometryPassShader.setUniformInt("material.emissionMap", 2);
-    deferredGeometryPassShader.setUniformFloat("material.shininess", 64.0f);
-    deferredGeometryPassShader.setUniformInt("material.heightMap", 1);
-    deferredGeometryPassShader.setUniformInt("depthMap", 3);
     //---------------------------------------------------------------------------------------------------------------
 
-    //draw scene
+    //Lighting pass: render at the internal resolution, upscaled to the screen. The Hi-Z build runs in the same pass,
+    //right after the G-buffer timer stops, so that its own timer never overlaps the G-buffer one
     //---------------------------------------------------------------------------------------------------------------
-    //draw cube as floor
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, GAMMA_ENABLED ? floorTextureGammaCorrected : floorTexture);
-    glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D, cubeTexture_normal);
-    glActiveTexture(GL_TEXTURE3);
-    glBindTexture(GL_TEXTURE_2D, cubeTexture_depth);
-    drawCube(cubeVAO, deferredGeometryPassShader, glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(12.5f, 0.5f, 12.5f));
+    RenderGraph::Resource sceneColor, sceneDepth;
+    renderGraph.addPass("Deferred lighting", [&](RenderGraph::PassBuilder& builder) {
+        for (unsigned int i = 0; i < gBufferTargets.size(); ++i)
+            builder.read(gBufferTargets[i]);
+        if (HIZ_ENABLED)
+            builder.writeExternally(hiZTarget);
+        sceneColor = builder.create("Scene color", RenderTargetDesc(FRAMEBUFFER_WIDTH, FRAMEBUFFER_HEIGHT, GL_RGBA8));
+        sceneDepth = builder.create("Scene depth", RenderTargetDesc(FRAMEBUFFER_WIDTH, FRAMEBUFFER_HEIGHT, GL_DEPTH24_STENCIL8, GL_NEAREST));
+        builder.write(sceneColor);
+        builder.write(sceneDepth);
+    }, [&](const RenderGraph& graph) {
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        Shader& lightingPassShader = COMPACT_GBUFFER ? compactLightingPassShader : deferredMultipleLightingPassShader;
+        lightingPassShader.activateShader();
+
+        //send light data
+        for (unsigned int i = 0; i < pointLights.size(); ++i) {
+            float constant = pointLights[i].constant;
+            float linear = pointLights[i].linear;
+            float quadratic = pointLights[i].quadratic;
+            float lightMax = std::fmaxf(std::fmaxf(pointLights[i].diffuse.r, pointLights[i].diffuse.g), pointLights[i].diffuse.b);
+            float radius = (-linear + std::sqrtf(linear * linear - 4.0 * quadratic * (constant - (256.0 / 5.0) * lightMax)))
+                / (2 * quadratic);
+            lightingPassShader.setUniformFloat("lights[" + std::to_string(i) + "].radius", radius);
+            lightingPassShader.setUniformFloat("lights[" + std::to_string(i) + "].constant", pointLights[i].constant);
+            lightingPassShader.setUniformFloat("lights[" + std::to_string(i) + "].linear", pointLights[i].linear);
+            lightingPassShader.setUniformFloat("lights[" + std::to_string(i) + "].quadratic", pointLights[i].quadratic);
+            //the compact layout is lit in view space since positions are reconstructed from view-space depth
+            glm::vec3 lightPos = COMPACT_GBUFFER ? glm::vec3(view * glm::vec4(pointLights[i].position, 1.0)) : pointLights[i].position;
+            lightingPassShader.setUniformVec3("lightPos[" + std::to_string(i) + "]", lightPos);
+            lightingPassShader.setUniformVec3("lights[" + std::to_string(i) + "].ambient", pointLights[i].ambient);
+            lightingPassShader.setUniformVec3("lights[" + std::to_string(i) + "].diffuse", pointLights[i].diffuse);
+            lightingPassShader.setUniformVec3("lights[" + std::to_string(i) + "].specular", pointLights[i].specular);
+        }
 
-    //draw other cubes
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, GAMMA_ENABLED ? cubeTextureGammaCorrected : cubeTexture);
-    drawCube(cubeVAO, deferredGeometryPassShader, glm::vec3(0.0f, 1.5f, 0.0f), glm::vec3(0.5f));
-    drawCube(cubeVAO, deferredGeometryPassShader, glm::vec3(2.0f, 0.0f, 1.0f), glm::vec3(0.5f));
-    glm::mat4 rotationMatrix = glm::rotate(identityMatrix, glm::radians(60.0f), glm::normalize(glm::vec3(1.0f, 0.0f, 1.0f)));
-    drawCube(cubeVAO, deferredGeometryPassShader, glm::vec3(-1.0f, -1.0f, 2.0f), glm::vec3(1.0f), rotationMatrix);
-    rotationMatrix = glm::rotate(identityMatrix, glm::radians(23.0f), glm::normalize(glm::vec3(1.0f, 0.0f, 1.0f)));
-    drawCube(cubeVAO, deferredGeometryPassShader, glm::vec3(0.0f, 2.7f, 4.0f), glm::vec3(1.25f), rotationMatrix);
-    rotationMatrix = glm::rotate(identityMatrix, glm::radians(124.0f), glm::normalize(glm::vec3(1.0f, 0.0f, 1.0f)));
-    drawCube(cubeVAO, deferredGeometryPassShader, glm::vec3(-2.0f, 1.0f, -3.0f), glm::vec3(1.0f), rotationMatrix);
-    drawCube(cubeVAO, deferredGeometryPassShader, glm::vec3(-3.0f, 0.0f, 0.0f), glm::vec3(0.5f));
-    //---------------------------------------------------------------------------------------------------------------
+        //send remaining uniforms
+        lightingPassShader.setUniformVec3("cameraPos", newCamera.getEye());
+        lightingPassShader.setUniformFloat("shininess", 64.0f);
+        lightingPassShader.setUniformInt("gamma", GAMMA_ENABLED);
+        lightingPassShader.setUniformInt("numLights", pointLights.size());
+        lightingPassShader.setUniformInt("gPosition", 0);
+        lightingPassShader.setUniformInt("gNormal", 1); //use the floor texture as a specular map
+        lightingPassShader.setUniformInt("gAlbedoSpec", 2);
+        lightingPassShader.setUniformInt("gDepth", 3);
+        lightingPassShader.setUniformInt("ao", false);
+        lightingPassShader.setUniformMatrix4("inverseProjection", glm::inverse(projection));
+        //draw screen quad
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, COMPACT_GBUFFER ? 0 : graph.getTexture(gPosition));
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, graph.getTexture(gNormal));
+        glActiveTexture(GL_TEXTURE2);
+        glBindTexture(GL_TEXTURE_2D, graph.getTexture(gAlbedoSpec));
+        glActiveTexture(GL_TEXTURE3);
+        glBindTexture(GL_TEXTURE_2D, graph.getTexture(gDepth));
+        glBindVertexArray(screenQuadVAO);
+        glDrawArrays(GL_TRIANGLES, 0, 6);
+        std::string gBufferLabel = std::string(COMPACT_GBUFFER ? "Compact" : "Standard") + " G-buffer " + std::to_string(FRAMEBUFFER_WIDTH)
+            + "x" + std::to_string(FRAMEBUFFER_HEIGHT) + ", geometry + lighting pass";
+        endGPUTimer(gBufferTimer, gBufferLabel.c_str());
 
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        //Hi-Z pass: build the depth pyramid from the G-buffer, after the G-buffer timer so that it has its own figure
+        //---------------------------------------------------------------------------------------------------------------
+        if (HIZ_ENABLED) {
+            beginGPUTimer(hiZBuildTimer);
+            if (COMPACT_GBUFFER)
+                buildHiZPyramid(hiZPyramid, hiZCopyShader, hiZDownsampleShader, HIZ_DEPTH_BUFFER, graph.getTexture(gDepth), 0, view, projection, 1000.0f, screenQuadVAO);
+            else
+                buildHiZPyramid(hiZPyramid, hiZCopyShader, hiZDownsampleShader, HIZ_WORLD_POSITIONS, graph.getTexture(gPosition), graph.getTexture(gNormal), view, projection, 1000.0f, screenQuadVAO);
+            std::string hiZLabel = std::string("Hi-Z pyramid build from the ") + (COMPACT_GBUFFER ? "depth buffer " : "world-space positions ")
+                + std::to_string(FRAMEBUFFER_WIDTH) + "x" + std::to_string(FRAMEBUFFER_HEIGHT) + ", " + std::to_string(hiZPyramid.levelSizes.size()) + " levels";
+            endGPUTimer(hiZBuildTimer, hiZLabel.c_str());
+        }
+        //---------------------------------------------------------------------------------------------------------------
+        //glDisable(GL_DEPTH_TEST);
+        //copy the G-buffer depth so the light cubes are hidden behind the lit geometry, the Hi-Z build bound its own framebuffer
+        unsigned int sceneFramebuffer = graph.getFramebuffer({ sceneColor, sceneDepth });
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, graph.getFramebuffer(gBufferTargets));
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, sceneFramebuffer);
+        glBlitFramebuffer(0, 0, FRAMEBUFFER_WIDTH, FRAMEBUFFER_HEIGHT, 0, 0, FRAMEBUFFER_WIDTH, FRAMEBUFFER_HEIGHT, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+        glBindFramebuffer(GL_FRAMEBUFFER, sceneFramebuffer);
+        glViewport(0, 0, FRAMEBUFFER_WIDTH, FRAMEBUFFER_HEIGHT);
+        for (unsigned int i = 0; i < pointLights.size(); ++i) {
+            //Draw point lights
+            //---------------------------------------------------------------------------------------------------------------
+            lightSourceShader.activateShader();
+            lightSourceShader.setUniformVec3("lightColor", pointLights[i].diffuse);
+            drawCube(lightObjectVAO, lightSourceShader, pointLights[i].position, glm::vec3(0.2, 0.2, 0.2));
+        }
+        //glEnable(GL_DEPTH_TEST);
+    });
     //---------------------------------------------------------------------------------------------------------------
     //---------------------------------------------------------------------------------------------------------------
 
-    //Lighting pass: render to screen
-    //---------------------------------------------------------------------------------------------------------------
-    glViewport(0, 0, WINDOW_WIDTH, WINDOW_HEIGHT);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-    deferredMultipleLightingPassShader.activateShader();
+    addUpscalePass(renderGraph, sceneColor, screenQuadVAO);
 
-    //send light data
-    for (unsigned int i = 0; i < pointLights.size(); ++i) {
-        float constant = pointLights[i].constant;
-        float linear = pointLights[i].linear;
-        float quadratic = pointLights[i].quadratic;
-        float lightMax = std::fmaxf(std::fmaxf(pointLights[i].diffuse.r, pointLights[i].diffuse.g), pointLights[i].diffuse.b);
-        float radius = (-linear + std::sqrtf(linear * linear - 4.0 * quadratic * (constant - (256.0 / 5.0) * lightMax)))
-            / (2 * quadratic);
-        deferredMultipleLightingPassShader.setUniformFloat("lights[" + std::to_string(i) + "].radius", radius);
-        deferredMultipleLightingPassShader.setUniformFloat("lights[" + std::to_string(i) + "].constant", pointLights[i].constant);
-        deferredMultipleLightingPassShader.setUniformFloat("lights[" + std::to_string(i) + "].linear", pointLights[i].linear);
-        deferredMultipleLightingPassShader.setUniformFloat("lights[" + std::to_string(i) + "].quadratic", pointLights[i].quadratic);
-        deferredMultipleLightingPassShader.setUniformVec3("lightPos[" + std::to_string(i) + "]", pointLights[i].position);
-        deferredMultipleLightingPassShader.setUniformVec3("lights[" + std::to_string(i) + "].ambient", pointLights[i].ambient);
-        deferredMultipleLightingPassShader.setUniformVec3("lights[" + std::to_string(i) + "].diffuse", pointLights[i].diffuse);
-        deferredMultipleLightingPassShader.setUniformVec3("lights[" + std::to_string(i) + "].specular", pointLights[i].specular);
-    }
-
-    //send remaining uniforms
-    deferredMultipleLightingPassShader.setUniformVec3("cameraPos", newCamera.getEye());
-    deferredMultipleLightingPassShader.setUniformFloat("shininess", 64.0f);
-    deferredMultipleLightingPassShader.setUniformInt("gamma", GAMMA_ENABLED);
-    deferredMultipleLightingPassShader.setUniformInt("numLights", pointLights.size());
-    deferredMultipleLightingPassShader.setUniformInt("gPosition", 0);
-    deferredMultipleLightingPassShader.setUniformInt("gNormal", 1); //use the floor texture as a specular map
-    deferredMultipleLightingPassShader.setUniformInt("gAlbedoSpec", 2);
-    //draw screen quad
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, gPosition);
-    glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D, gNormal);
-    glActiveTexture(GL_TEXTURE2);
-    glBindTexture(GL_TEXTURE_2D, gAlbedoSpec);
-    glBindVertexArray(screenQuadVAO);
-    glDrawArrays(GL_TRIANGLES, 0, 6);
-    //glDisable(GL_DEPTH_TEST);
-    glBindFramebuffer(GL_READ_FRAMEBUFFER, gBuffer);
-    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
-    glBlitFramebuffer(0, 0, WINDOW_WIDTH, WINDOW_HEIGHT, 0, 0, WINDOW_WIDTH, WINDOW_HEIGHT, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-    for (unsigned int i = 0; i < pointLights.size(); ++i) {
-        //Draw point lights
-        //---------------------------------------------------------------------------------------------------------------
-        lightSourceShader.activateShader();
-        lightSourceShader.setUniformVec3("lightColor", pointLights[i].diffuse);
-        drawCube(lightObjectVAO, lightSourceShader, pointLights[i].position, glm::vec3(0.2, 0.2, 0.2));
-    }
-    //glEnable(GL_DEPTH_TEST);
-    //---------------------------------------------------------------------------------------------------------------
-    //---------------------------------------------------------------------------------------------------------------
+    renderGraph.compile();
+    renderGraph.reportMemory("deferred shading");
+    renderGraph.execute();
 }
 
 void renderSceneWithBloomEffect(unsigned int cubeVAO, unsigned int lightObjectVAO, unsigned int screenQuadVAO, unsigned int uboMatrices) {
@@ -1152,6 +1915,8 @@ void renderSceneWithBloomEffect(unsigned int cubeVAO, unsigned int lightObjectVA
     static Shader lightSourceMRTShader = Shader("Shaders/lightSourceMRT.vert", "Shaders/lightSourceMRT.frag");
     static Shader blurShader = Shader("Shaders/blur.vert", "Shaders/blur.frag");
     static Shader bloomShader = Shader("Shaders/bloom.vert", "Shaders/bloom.frag");
+    static Shader bloomDownsampleShader = Shader("Shaders/bloomMip.vert", "Shaders/bloomDownsample.frag");
+    static Shader bloomUpsampleShader = Shader("Shaders/bloomMip.vert", "Shaders/bloomUpsample.frag");
     //--------------------------------------------------------------------------------------------------------
 
     //load textures
@@ -1164,19 +1929,16 @@ void renderSceneWithBloomEffect(unsigned int cubeVAO, unsigned int lightObjectVA
     static unsigned int cubeTexture_depth = textureFromFile("../../Textures/toy_box_disp.png", false);
     //--------------------------------------------------------------------------------------------------------
 
-    static unsigned int hdrFBO, hdr_colorBuffers[2];
-    static unsigned int pingpongFBO[2], pingpongBuffers[2];
+    //mip-chain bloom: the scene is progressively downsampled (13-tap filter) into a chain of half-sized buffers and
+    //then upsampled back (3x3 tent filter), each level being added on top of the next larger one
+    static unsigned int bloomMipCount = 6; //number of half-sized levels below the HDR buffer
+    static float bloomThreshold = 1.0f; //brightness above which a fragment blooms
+    static float bloomKnee = 0.5f; //width of the soft transition below the threshold
+    static float bloomFilterRadius = 0.005f; //upsample tent radius in texture coordinates
+    static GPUTimer blurTimer;
+    static bool timedMipBloom = MIP_BLOOM_ENABLED;
 
     if (!initialized) {
-        //set up floating point framebuffer to render scene to
-        createFBO(hdrFBO, hdr_colorBuffers, 2, GL_RGBA16F);
-        //---------------------------------------------------------------------------------------------------------
-
-        //creatae two basic framebuffers, each with only a color buffer texture
-        createFBO(pingpongFBO[0], pingpongBuffers[0], GL_RGBA16F, false);
-        createFBO(pingpongFBO[1], pingpongBuffers[1], GL_RGBA16F, false);
-        //--------------------------------------------------------------------------------------------------------
-
         //bind ubo and shaders to a binding location
         //--------------------------------------------------------------------------------------------------------
         //bind uniform buffer object to binding point(loc) 0
@@ -1197,130 +1959,235 @@ void renderSceneWithBloomEffect(unsigned int cubeVAO, unsigned int lightObjectVA
     //------------------------------------------------------------------------------------------------------------------------------------
     //------------------------------------------------------------------------------------------------------------------------------------
 
+    //the render targets are declared every frame on the render graph, which hands them pooled textures: the blur
+    //targets end up sharing the brightness buffer's texture once it has been read
+
     //First pass
     //---------------------------------------------------------------------------------------------------------------
-    glBindFramebuffer(GL_FRAMEBUFFER, hdrFBO);
-    glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
-    glViewport(0, 0, FRAMEBUFFER_WIDTH, FRAMEBUFFER_HEIGHT);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-    //inserting projection and view matrices into ubo
-    //--------------------------------------------------------------------------------------------------------
-    glBindBuffer(GL_UNIFORM_BUFFER, uboMatrices);
+    RenderGraph::Resource hdrColor, hdrBright, hdrDepth;
+    renderGraph.addPass("Bloom scene", [&](RenderGraph::PassBuilder& builder) {
+        hdrColor = builder.create("HDR color", RenderTargetDesc(FRAMEBUFFER_WIDTH, FRAMEBUFFER_HEIGHT, GL_RGBA16F));
+        hdrBright = builder.create("HDR brightness", RenderTargetDesc(FRAMEBUFFER_WIDTH, FRAMEBUFFER_HEIGHT, GL_RGBA16F));
+        hdrDepth = builder.create("HDR depth", RenderTargetDesc(FRAMEBUFFER_WIDTH, FRAMEBUFFER_HEIGHT, GL_DEPTH24_STENCIL8));
+        builder.write(hdrColor);
+        builder.write(hdrBright);
+        builder.write(hdrDepth);
+    }, [&](const RenderGraph& graph) {
+        glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+        //inserting projection and view matrices into ubo
+        //--------------------------------------------------------------------------------------------------------
+        glBindBuffer(GL_UNIFORM_BUFFER, uboMatrices);
 
-    //glm::mat4 projection = glm::perspective(glm::radians(newCamera.getFOV()), (float)WINDOW_WIDTH / WINDOW_HEIGHT, 0.1f, 100.0f);
-    glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float)WINDOW_WIDTH / WINDOW_HEIGHT, 0.1f, 1000.0f);
-    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(glm::mat4), glm::value_ptr(projection));
+        //glm::mat4 projection = glm::perspective(glm::radians(newCamera.getFOV()), (float)WINDOW_WIDTH / WINDOW_HEIGHT, 0.1f, 100.0f);
+        glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float)WINDOW_WIDTH / WINDOW_HEIGHT, 0.1f, 1000.0f);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(glm::mat4), glm::value_ptr(projection));
 
-    glm::mat4 view = newCamera.getViewMatrix();
-    glBufferSubData(GL_UNIFORM_BUFFER, sizeof(glm::mat4), sizeof(glm::mat4), glm::value_ptr(view));
+        glm::mat4 view = newCamera.getViewMatrix();
+        glBufferSubData(GL_UNIFORM_BUFFER, sizeof(glm::mat4), sizeof(glm::mat4), glm::value_ptr(view));
 
-    glBindBuffer(GL_UNIFORM_BUFFER, 0);
-    //--------------------------------------------------------------------------------------------------------
-    //--------------------------------------------------------------------------------------------------------
-    for (unsigned int i = 0; i < pointLights.size(); ++i) {
-        //Draw point lights
-        //---------------------------------------------------------------------------------------------------------------
-        lightSourceMRTShader.activateShader();
-        lightSourceMRTShader.setUniformVec3("lightColor", pointLights[i].diffuse);
-        drawCube(lightObjectVAO, lightSourceMRTShader, pointLights[i].position, glm::vec3(0.2, 0.2, 0.2));
-        //---------------------------------------------------------------------------------------------------------------
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        //--------------------------------------------------------------------------------------------------------
+        //--------------------------------------------------------------------------------------------------------
+        for (unsigned int i = 0; i < pointLights.size(); ++i) {
+            //Draw point lights
+            //---------------------------------------------------------------------------------------------------------------
+            lightSourceMRTShader.activateShader();
+            lightSourceMRTShader.setUniformVec3("lightColor", pointLights[i].diffuse);
+            drawCube(lightObjectVAO, lightSourceMRTShader, pointLights[i].position, glm::vec3(0.2, 0.2, 0.2));
+            //---------------------------------------------------------------------------------------------------------------
+
+            //send pointLight uniform values for drawing tunnel cube
+            //---------------------------------------------------------------------------------------------------------------
+            multipleLightsMRTShader.activateShader();
+            multipleLightsMRTShader.setUniformVec3("lightPos[" + std::to_string(i) + "]", pointLights[i].position);
+            multipleLightsMRTShader.setUniformVec3("lights[" + std::to_string(i) + "].ambient", pointLights[i].ambient);
+            multipleLightsMRTShader.setUniformVec3("lights[" + std::to_string(i) + "].diffuse", pointLights[i].diffuse);
+            multipleLightsMRTShader.setUniformVec3("lights[" + std::to_string(i) + "].specular", pointLights[i].specular);
+            //---------------------------------------------------------------------------------------------------------------
+        }
 
-        //send pointLight uniform values for drawing tunnel cube
+        //activate shader and pass uniforms to it
         //---------------------------------------------------------------------------------------------------------------
         multipleLightsMRTShader.activateShader();
-        multipleLightsMRTShader.setUniformVec3("lightPos[" + std::to_string(i) + "]", pointLights[i].position);
-        multipleLightsMRTShader.setUniformVec3("lights[" + std::to_string(i) + "].ambient", pointLights[i].ambient);
-        multipleLightsMRTShader.setUniformVec3("lights[" + std::to_string(i) + "].diffuse", pointLights[i].diffuse);
-        multipleLightsMRTShader.setUniformVec3("lights[" + std::to_string(i) + "].specular", pointLights[i].specular);
+        multipleLightsMRTShader.setUniformVec3("cameraPos", newCamera.getEye());
+        multipleLightsMRTShader.setUniformInt("gamma", GAMMA_ENABLED);
+        multipleLightsMRTShader.setUniformInt("normal_mapping", NORMAL_MAPPING);
+        multipleLightsMRTShader.setUniformInt("parallax_mapping", PARALLAX_MAPPING);
+        multipleLightsMRTShader.setUniformFloat("height_scale", 0.2);
+        multipleLightsMRTShader.setUniformInt("numLights", pointLights.size());
+
+        //sets material properties
+        multipleLightsMRTShader.setUniformInt("material.diffuseMap", 0);
+        multipleLightsMRTShader.setUniformInt("material.specularMap", 0); //use the floor texture as a specular map
+        multipleLightsMRTShader.setUniformInt("material.emissionMap", 2);
+        multipleLightsMRTShader.setUniformFloat("material.shininess", 64.0f);
+        multipleLightsMRTShader.setUniformInt("material.heightMap", 1);
+        multipleLightsMRTShader.setUniformInt("depthMap", 3);
         //---------------------------------------------------------------------------------------------------------------
-    }
-
-    //activate shader and pass uniforms to it
-    //---------------------------------------------------------------------------------------------------------------
-    multipleLightsMRTShader.activateShader();
-    multipleLightsMRTShader.setUniformVec3("cameraPos", newCamera.getEye());
-    multipleLightsMRTShader.setUniformInt("gamma", GAMMA_ENABLED);
-    multipleLightsMRTShader.setUniformInt("normal_mapping", NORMAL_MAPPING);
-    multipleLightsMRTShader.setUniformInt("parallax_mapping", PARALLAX_MAPPING);
-    multipleLightsMRTShader.setUniformFloat("height_scale", 0.2);
-    multipleLightsMRTShader.setUniformInt("numLights", pointLights.size());
-
-    //sets material properties
-    multipleLightsMRTShader.setUniformInt("material.diffuseMap", 0);
-    multipleLightsMRTShader.setUniformInt("material.specularMap", 0); //use the floor texture as a specular map
-    multipleLightsMRTShader.setUniformInt("material.emissionMap", 2);
-    multipleLightsMRTShader.setUniformFloat("material.shininess", 64.0f);
-    multipleLightsMRTShader.setUniformInt("material.heightMap", 1);
-    multipleLightsMRTShader.setUniformInt("depthMap", 3);
-    //---------------------------------------------------------------------------------------------------------------
 
-    //draw scene
-    //---------------------------------------------------------------------------------------------------------------
-    //draw cube as floor
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, GAMMA_ENABLED ? floorTextureGammaCorrected : floorTexture);
-    glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D, cubeTexture_normal);
-    glActiveTexture(GL_TEXTURE3);
-    glBindTexture(GL_TEXTURE_2D, cubeTexture_depth);
-    drawCube(cubeVAO, multipleLightsMRTShader, glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(12.5f, 0.5f, 12.5f));
-    
-    //draw other cubes
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, GAMMA_ENABLED ? cubeTextureGammaCorrected : cubeTexture);
-    drawCube(cubeVAO, multipleLightsMRTShader, glm::vec3(0.0f, 1.5f, 0.0f), glm::vec3(0.5f));
-    drawCube(cubeVAO, multipleLightsMRTShader, glm::vec3(2.0f, 0.0f, 1.0f), glm::vec3(0.5f));
-    glm::mat4 rotationMatrix = glm::rotate(identityMatrix, glm::radians(60.0f), glm::normalize(glm::vec3(1.0f, 0.0f, 1.0f)));
-    drawCube(cubeVAO, multipleLightsMRTShader, glm::vec3(-1.0f, -1.0f, 2.0f), glm::vec3(1.0f), rotationMatrix);
-    rotationMatrix = glm::rotate(identityMatrix, glm::radians(23.0f), glm::normalize(glm::vec3(1.0f, 0.0f, 1.0f)));
-    drawCube(cubeVAO, multipleLightsMRTShader, glm::vec3(0.0f, 2.7f, 4.0f), glm::vec3(1.25f), rotationMatrix);
-    rotationMatrix = glm::rotate(identityMatrix, glm::radians(124.0f), glm::normalize(glm::vec3(1.0f, 0.0f, 1.0f)));
-    drawCube(cubeVAO, multipleLightsMRTShader, glm::vec3(-2.0f, 1.0f, -3.0f), glm::vec3(1.0f), rotationMatrix);
-    drawCube(cubeVAO, multipleLightsMRTShader, glm::vec3(-3.0f, 0.0f, 0.0f), glm::vec3(0.5f));
-    //---------------------------------------------------------------------------------------------------------------
+        //draw scene
+        //---------------------------------------------------------------------------------------------------------------
+        //draw cube as floor
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, GAMMA_ENABLED ? floorTextureGammaCorrected : floorTexture);
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, cubeTexture_normal);
+        glActiveTexture(GL_TEXTURE3);
+        glBindTexture(GL_TEXTURE_2D, cubeTexture_depth);
+        drawCube(cubeVAO, multipleLightsMRTShader, glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(12.5f, 0.5f, 12.5f));
 
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        //draw other cubes
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, GAMMA_ENABLED ? cubeTextureGammaCorrected : cubeTexture);
+        drawCube(cubeVAO, multipleLightsMRTShader, glm::vec3(0.0f, 1.5f, 0.0f), glm::vec3(0.5f));
+        drawCube(cubeVAO, multipleLightsMRTShader, glm::vec3(2.0f, 0.0f, 1.0f), glm::vec3(0.5f));
+        glm::mat4 rotationMatrix = glm::rotate(identityMatrix, glm::radians(60.0f), glm::normalize(glm::vec3(1.0f, 0.0f, 1.0f)));
+        drawCube(cubeVAO, multipleLightsMRTShader, glm::vec3(-1.0f, -1.0f, 2.0f), glm::vec3(1.0f), rotationMatrix);
+        rotationMatrix = glm::rotate(identityMatrix, glm::radians(23.0f), glm::normalize(glm::vec3(1.0f, 0.0f, 1.0f)));
+        drawCube(cubeVAO, multipleLightsMRTShader, glm::vec3(0.0f, 2.7f, 4.0f), glm::vec3(1.25f), rotationMatrix);
+        rotationMatrix = glm::rotate(identityMatrix, glm::radians(124.0f), glm::normalize(glm::vec3(1.0f, 0.0f, 1.0f)));
+        drawCube(cubeVAO, multipleLightsMRTShader, glm::vec3(-2.0f, 1.0f, -3.0f), glm::vec3(1.0f), rotationMatrix);
+        drawCube(cubeVAO, multipleLightsMRTShader, glm::vec3(-3.0f, 0.0f, 0.0f), glm::vec3(0.5f));
+        //---------------------------------------------------------------------------------------------------------------
+    });
     //---------------------------------------------------------------------------------------------------------------
     //---------------------------------------------------------------------------------------------------------------
 
-    //second pass: blur bright fragments with two-pass Gaussian Blur
+    //second pass: blur bright fragments, either with the two-pass Gaussian blur or over the bloom mip chain. Nothing
+    //reads the result when bloom is off, so the graph culls these passes
     //---------------------------------------------------------------------------------------------------------------
-    blurShader.activateShader();
-    bool horizontal = true, first_iteration = true;
-    int amount = 10;
-    for (unsigned int i = 0; i < amount; ++i) {
-        glBindFramebuffer(GL_FRAMEBUFFER, pingpongFBO[horizontal]);
-        blurShader.setUniformInt("horizontal", horizontal);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, first_iteration ? hdr_colorBuffers[1] : pingpongBuffers[!horizontal]);
-        glBindVertexArray(screenQuadVAO);
-        glDrawArrays(GL_TRIANGLES, 0, 6);
-        horizontal = !horizontal;
-        if (first_iteration)
-            first_iteration = false;
+    if (timedMipBloom != MIP_BLOOM_ENABLED) {
+        resetGPUTimer(blurTimer);
+        timedMipBloom = MIP_BLOOM_ENABLED;
+    }
+    RenderGraph::Resource bloomResult;
+    if (MIP_BLOOM_ENABLED) {
+        //the chain stops early once a level would be smaller than 2x2
+        std::vector<glm::ivec2> mipSizes;
+        glm::ivec2 mipSize(FRAMEBUFFER_WIDTH, FRAMEBUFFER_HEIGHT);
+        for (unsigned int i = 0; i < bloomMipCount; ++i) {
+            mipSize /= 2;
+            if (mipSize.x < 2 || mipSize.y < 2)
+                break;
+            mipSizes.push_back(mipSize);
+        }
+        std::string timerLabel = "Mip-chain bloom (" + std::to_string(mipSizes.size()) + " levels)";
+
+        //downsample: the first level thresholds the HDR scene itself, each following one reads the level above
+        std::vector<RenderGraph::Resource> mips(mipSizes.size());
+        for (unsigned int i = 0; i < mips.size(); ++i) {
+            RenderGraph::Resource source = i == 0 ? hdrColor : mips[i - 1];
+            renderGraph.addPass("Bloom downsample", [&](RenderGraph::PassBuilder& builder) {
+                //R11F_G11F_B10F: HDR range at half the bandwidth of RGBA16F, bloom doesn't need alpha
+                mips[i] = builder.create("Bloom mip " + std::to_string(i), RenderTargetDesc(mipSizes[i].x, mipSizes[i].y, GL_R11F_G11F_B10F));
+                builder.read(source);
+                builder.write(mips[i]);
+            }, [=](const RenderGraph& graph) {
+                if (i == 0)
+                    beginGPUTimer(blurTimer);
+                const RenderTargetDesc& sourceDesc = graph.getDesc(source);
+                glBindVertexArray(screenQuadVAO);
+                bloomDownsampleShader.activateShader();
+                bloomDownsampleShader.setUniformInt("sourceTexture", 0);
+                bloomDownsampleShader.setUniformFloat("threshold", bloomThreshold);
+                bloomDownsampleShader.setUniformFloat("knee", bloomKnee);
+                bloomDownsampleShader.setUniformInt("prefilter", i == 0);
+                bloomDownsampleShader.setUniformVec2("sourceTexelSize", 1.0f / glm::vec2(sourceDesc.width, sourceDesc.height));
+                glActiveTexture(GL_TEXTURE0);
+                glBindTexture(GL_TEXTURE_2D, graph.getTexture(source));
+                glDrawArrays(GL_TRIANGLES, 0, 6);
+                if (mipSizes.size() == 1) //no upsample pass follows to stop the timer
+                    endGPUTimer(blurTimer, timerLabel.c_str());
+            });
+        }
+
+        //upsample: walk back up the chain, blending each smaller level additively into the next larger one
+        for (int i = (int) mips.size() - 1; i > 0; --i) {
+            RenderGraph::Resource source = mips[i], target = mips[i - 1];
+            renderGraph.addPass("Bloom upsample", [=](RenderGraph::PassBuilder& builder) {
+                builder.read(source);
+                builder.write(target);
+            }, [=](const RenderGraph& graph) {
+                glBindVertexArray(screenQuadVAO);
+                bloomUpsampleShader.activateShader();
+                bloomUpsampleShader.setUniformInt("sourceTexture", 0);
+                bloomUpsampleShader.setUniformFloat("filterRadius", bloomFilterRadius);
+                glEnable(GL_BLEND);
+                glBlendFunc(GL_ONE, GL_ONE);
+                glBlendEquation(GL_FUNC_ADD);
+                glActiveTexture(GL_TEXTURE0);
+                glBindTexture(GL_TEXTURE_2D, graph.getTexture(source));
+                glDrawArrays(GL_TRIANGLES, 0, 6);
+                glDisable(GL_BLEND);
+                if (i == 1)
+                    endGPUTimer(blurTimer, timerLabel.c_str());
+            });
+        }
+
+        bloomResult = mips[0];
+    }
+    else {
+        //every pass writes a new target, the graph alternates them between two textures like a ping-pong pair
+        int amount = 10;
+        bloomResult = hdrBright;
+        for (unsigned int i = 0; i < amount; ++i) {
+            RenderGraph::Resource source = bloomResult;
+            bool horizontal = i % 2 == 0;
+            renderGraph.addPass("Gaussian blur", [&](RenderGraph::PassBuilder& builder) {
+                bloomResult = builder.create("Blur", RenderTargetDesc(FRAMEBUFFER_WIDTH, FRAMEBUFFER_HEIGHT, GL_RGBA16F));
+                builder.read(source);
+                builder.write(bloomResult);
+            }, [=](const RenderGraph& graph) {
+                if (i == 0)
+                    beginGPUTimer(blurTimer);
+                blurShader.activateShader();
+                blurShader.setUniformInt("horizontal", horizontal);
+                glActiveTexture(GL_TEXTURE0);
+                glBindTexture(GL_TEXTURE_2D, graph.getTexture(source));
+                glBindVertexArray(screenQuadVAO);
+                glDrawArrays(GL_TRIANGLES, 0, 6);
+                if (i + 1 == amount)
+                    endGPUTimer(blurTimer, "Ping-pong Gaussian bloom (10 passes)");
+            });
+        }
     }
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
     //---------------------------------------------------------------------------------------------------------------
     //---------------------------------------------------------------------------------------------------------------
 
-    //third pass: blend scene's HDR texture and  blurred brightness texture together to achieve bloom effect
+    //third pass: blend scene's HDR texture and  blurred brightness texture together to achieve bloom effect, at the
+    //internal resolution before the upscale to the screen
     //---------------------------------------------------------------------------------------------------------------
-    glViewport(0, 0, WINDOW_WIDTH, WINDOW_HEIGHT);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-    bloomShader.activateShader();
-    bloomShader.setUniformFloat("exposure", 0.1);
-    bloomShader.setUniformInt("bloom", BLOOM_ENABLED);
-    bloomShader.setUniformInt("scene", 0);
-    bloomShader.setUniformInt("blur", 1);
-    glBindVertexArray(screenQuadVAO);
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, hdr_colorBuffers[0]);
-    glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D, pingpongBuffers[!horizontal]);
-    glDrawArrays(GL_TRIANGLES, 0, 6);
+    RenderGraph::Resource sceneColor;
+    renderGraph.addPass("Bloom composite", [&](RenderGraph::PassBuilder& builder) {
+        builder.read(hdrColor);
+        if (BLOOM_ENABLED)
+            builder.read(bloomResult);
+        sceneColor = builder.create("Scene color", RenderTargetDesc(FRAMEBUFFER_WIDTH, FRAMEBUFFER_HEIGHT, GL_RGBA8));
+        builder.write(sceneColor);
+    }, [&](const RenderGraph& graph) {
+        glClear(GL_COLOR_BUFFER_BIT);
+        bloomShader.activateShader();
+        bloomShader.setUniformFloat("exposure", 0.1);
+        bloomShader.setUniformInt("bloom", BLOOM_ENABLED);
+        bloomShader.setUniformInt("scene", 0);
+        bloomShader.setUniformInt("blur", 1);
+        glBindVertexArray(screenQuadVAO);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, graph.getTexture(hdrColor));
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, BLOOM_ENABLED ? graph.getTexture(bloomResult) : 0);
+        glDrawArrays(GL_TRIANGLES, 0, 6);
+    });
     //---------------------------------------------------------------------------------------------------------------
     //---------------------------------------------------------------------------------------------------------------
+
+    addUpscalePass(renderGraph, sceneColor, screenQuadVAO);
+
+    renderGraph.compile();
+    renderGraph.reportMemory("bloom");
+    renderGraph.execute();
 }
 
 void renderRandomScene(unsigned int cubeVAO, unsigned int planeVAO, unsigned int lightObjectVAO, unsigned int uboMatrices) {
@@ -1500,7 +2367,7 @@ void renderTunnelScene(unsigned int cubeVAO, unsigned int lightObjectVAO, unsign
     static unsigned int cubeTexture_depth = textureFromFile("../../Textures/toy_box_disp.png", false);
     //--------------------------------------------------------------------------------------------------------
 
-    static unsigned int hdrFBO, hdr_screenTexture;
+    static unsigned int hdr_screenTexture, hdr_depthTexture; //acquired from the render target pool at the internal resolution
 
     if (!initialized) {
         //bind ubo and shaders to a binding location
@@ -1517,19 +2384,18 @@ void renderTunnelScene(unsigned int cubeVAO, unsigned int lightObjectVAO, unsign
         glUniformBlockBinding(multipleLightsShader.getProgramId(), multipleLightsShader_uniformBlockIndex, 0);
         //--------------------------------------------------------------------------------------------------------
 
-        //setup hdr framebuffer
-        createFBO(hdrFBO, hdr_screenTexture, GL_RGBA16F);
-        //--------------------------------------------------------------------------------------------------------
-
         initialized = true;
     }
     //------------------------------------------------------------------------------------------------------------------------------------
     //------------------------------------------------------------------------------------------------------------------------------------
     //------------------------------------------------------------------------------------------------------------------------------------
 
-    //First pass
+    //First pass: the hdr targets follow the internal resolution, the tone mapping pass samples them straight to the
+    //screen, which doubles as a bilinear upscale
     //---------------------------------------------------------------------------------------------------------------
-    glBindFramebuffer(GL_FRAMEBUFFER, hdrFBO);
+    renderTargetPool.reacquire(hdr_screenTexture, RenderTargetDesc(FRAMEBUFFER_WIDTH, FRAMEBUFFER_HEIGHT, GL_RGBA16F));
+    renderTargetPool.reacquire(hdr_depthTexture, RenderTargetDesc(FRAMEBUFFER_WIDTH, FRAMEBUFFER_HEIGHT, GL_DEPTH24_STENCIL8, GL_NEAREST));
+    glBindFramebuffer(GL_FRAMEBUFFER, renderTargetPool.getFramebuffer({ hdr_screenTexture, hdr_depthTexture }));
     glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
     glViewport(0, 0, FRAMEBUFFER_WIDTH, FRAMEBUFFER_HEIGHT);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -1667,7 +2533,27 @@ void drawCube(GLuint cubeVAO, const Shader& shader, const glm::vec3 translationV
     glDrawArrays(GL_TRIANGLES, 0, 36);
 }
 
-void createFBO(unsigned int& framebuffer, unsigned int *colorBuffer, unsigned int numColorBuffers, GLint colorBuffer_internalFormat, bool hasDepthBuffer) {
+void drawCube(GLuint cubeVAO, const Shader& shader, const glm::mat4& model) {
+    glBindVertexArray(cubeVAO);
+    shader.setUniformMatrix4("model", model);
+    glDrawArrays(GL_TRIANGLES, 0, 36);
+}
+
+//draws the cube through command indirectCommand of the bound GL_DRAW_INDIRECT_BUFFER, which a GPU pass may have culled
+void drawCube(GLuint cubeVAO, const Shader& shader, const glm::mat4& model, unsigned int indirectCommand) {
+    glBindVertexArray(cubeVAO);
+    shader.setUniformMatrix4("model", model);
+    glDrawArraysIndirect(GL_TRIANGLES, (void*)(indirectCommand * sizeof(DrawArraysIndirectCommand)));
+}
+
+glm::mat4 createModelMatrix(const glm::vec3 translationVec, glm::vec3 scale, glm::mat4 rotationMatrix) {
+    glm::mat4 identityMatrix = glm::mat4(1.0);
+    return glm::translate(identityMatrix, translationVec) * rotationMatrix * glm::scale(identityMatrix, scale);
+}
+
+//framebuffers of a fixed size, targets that follow the internal resolution are acquired from renderTargetPool instead
+void createFBO(unsigned int& framebuffer, unsigned int *colorBuffer, unsigned int numColorBuffers, GLint colorBuffer_internalFormat, unsigned int width,
+    unsigned int height, bool hasDepthBuffer) {
     std::vector<unsigned int> attachments;
 
     //setup framebuffer
@@ -1678,7 +2564,7 @@ void createFBO(unsigned int& framebuffer, unsigned int *colorBuffer, unsigned in
     glGenTextures(numColorBuffers, colorBuffer);
     for (unsigned int i = 0; i < numColorBuffers; i++) {
         glBindTexture(GL_TEXTURE_2D, colorBuffer[i]);
-        glTexImage2D(GL_TEXTURE_2D, 0, colorBuffer_internalFormat, FRAMEBUFFER_WIDTH, FRAMEBUFFER_HEIGHT, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        glTexImage2D(GL_TEXTURE_2D, 0, colorBuffer_internalFormat, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
@@ -1701,7 +2587,7 @@ void createFBO(unsigned int& framebuffer, unsigned int *colorBuffer, unsigned in
         unsigned int rbo;
         glGenRenderbuffers(1, &rbo);
         glBindRenderbuffer(GL_RENDERBUFFER, rbo);
-        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, FRAMEBUFFER_WIDTH, FRAMEBUFFER_HEIGHT);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
         glBindRenderbuffer(GL_RENDERBUFFER, 0);  //unbind rbo
         //--------------------------------------------------------
 
@@ -1716,7 +2602,8 @@ void createFBO(unsigned int& framebuffer, unsigned int *colorBuffer, unsigned in
     glBindFramebuffer(GL_FRAMEBUFFER, 0); //unbined framebuffer
     //---------------------------------------------------------------------------------------------
 }
-void createFBO(unsigned int& framebuffer, unsigned int* colorBuffer, unsigned int numColorBuffers, GLint* colorBuffer_internalFormat, bool hasDepthBuffer) {
+void createFBO(unsigned int& framebuffer, unsigned int* colorBuffer, unsigned int numColorBuffers, GLint* colorBuffer_internalFormat, unsigned int width,
+    unsigned int height, bool hasDepthBuffer) {
     std::vector<unsigned int> attachments;
 
     //setup framebuffer
@@ -1727,7 +2614,7 @@ void createFBO(unsigned int& framebuffer, unsigned int* colorBuffer, unsigned in
     glGenTextures(numColorBuffers, colorBuffer);
     for (unsigned int i = 0; i < numColorBuffers; i++) {
         glBindTexture(GL_TEXTURE_2D, colorBuffer[i]);
-        glTexImage2D(GL_TEXTURE_2D, 0, colorBuffer_internalFormat[i], FRAMEBUFFER_WIDTH, FRAMEBUFFER_HEIGHT, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        glTexImage2D(GL_TEXTURE_2D, 0, colorBuffer_internalFormat[i], width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
@@ -1750,7 +2637,7 @@ void createFBO(unsigned int& framebuffer, unsigned int* colorBuffer, unsigned in
         unsigned int rbo;
         glGenRenderbuffers(1, &rbo);
         glBindRenderbuffer(GL_RENDERBUFFER, rbo);
-        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, FRAMEBUFFER_WIDTH, FRAMEBUFFER_HEIGHT);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
         glBindRenderbuffer(GL_RENDERBUFFER, 0);  //unbind rbo
         //--------------------------------------------------------
 
@@ -1766,11 +2653,418 @@ void createFBO(unsigned int& framebuffer, unsigned int* colorBuffer, unsigned in
     //---------------------------------------------------------------------------------------------
 }
 
-void createFBO(unsigned int& framebuffer, unsigned int& texColorBuffer, GLint colorBuffer_internalFormat, bool hasDepthbuffer) {
-    createFBO(framebuffer, &texColorBuffer, 1, colorBuffer_internalFormat, hasDepthbuffer);
+void createFBO(unsigned int& framebuffer, unsigned int& texColorBuffer, GLint colorBuffer_internalFormat, unsigned int width, unsigned int height,
+    bool hasDepthbuffer) {
+    createFBO(framebuffer, &texColorBuffer, 1, colorBuffer_internalFormat, width, height, hasDepthbuffer);
+}
+
+/* Prints the G-buffer traffic of the standard and compact layouts at 1080p and 4K. Each layout is written once by
+*   the geometry pass and read once by the lighting pass, texture caches and compression are not accounted for.
+* */
+void printGBufferBandwidth() {
+    const unsigned int standardBytesPerPixel = 8 + 8 + 4 + 4; //RGBA16F position + RGBA16F normal + RGBA8 albedoSpec + depth24stencil8
+    const unsigned int compactBytesPerPixel = 4 + 4 + 4; //RG16 normal + RGBA8 albedoSpec + depth24stencil8
+    const unsigned int resolutions[2][2] = { { 1920, 1080 }, { 3840, 2160 } };
+    for (unsigned int i = 0; i < 2; ++i) {
+        double pixels = (double) resolutions[i][0] * resolutions[i][1];
+        std::cout << "G-buffer bandwidth at " << resolutions[i][0] << "x" << resolutions[i][1] << ": standard "
+            << 2.0 * pixels * standardBytesPerPixel / (1024.0 * 1024.0) << " MB/frame (" << standardBytesPerPixel
+            << " B/pixel), compact " << 2.0 * pixels * compactBytesPerPixel / (1024.0 * 1024.0) << " MB/frame ("
+            << compactBytesPerPixel << " B/pixel)" << std::endl;
+    }
+}
+
+/* Creates a hierarchical-Z pyramid: an RG32F texture with a mip chain down to 1x1 and the framebuffer its levels
+*   are rendered through. Every level is half the size of the one below, rounded down. Called every frame: the
+*   pyramid is only recreated when the resolution changed, and is then invalid until it is built again
+*   Parameters:
+*       pyramid:    the pyramid to create
+*       width:      resolution of level 0, the same as the depth it is built from
+*       height:
+* */
+void createHiZPyramid(HiZPyramid& pyramid, unsigned int width, unsigned int height) {
+    if (!pyramid.levelSizes.empty() && pyramid.levelSizes[0] == glm::ivec2(width, height))
+        return;
+
+    if (pyramid.texture != 0) {
+        glDeleteTextures(1, &pyramid.texture);
+        pyramid.levelSizes.clear();
+        pyramid.valid = false;
+    }
+    glGenTextures(1, &pyramid.texture);
+    glBindTexture(GL_TEXTURE_2D, pyramid.texture);
+    glm::ivec2 levelSize(width, height);
+    while (true) {
+        glTexImage2D(GL_TEXTURE_2D, pyramid.levelSizes.size(), GL_RG32F, levelSize.x, levelSize.y, 0, GL_RG, GL_FLOAT, NULL);
+        pyramid.levelSizes.push_back(levelSize);
+        if (levelSize.x == 1 && levelSize.y == 1)
+            break;
+        levelSize = glm::max(levelSize / 2, glm::ivec2(1));
+    }
+    //depths are never interpolated: a blend of two depths is a depth that exists nowhere in the scene
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, pyramid.levelSizes.size() - 1);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    if (pyramid.framebuffer == 0)
+        glGenFramebuffers(1, &pyramid.framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, pyramid.framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, pyramid.texture, 0);
+
+    //check if the framebuffer is complete
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        std::cout << "ERROR::FRAMEBUFFER:: Hi-Z pyramid framebuffer is not complete!" << std::endl;
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0); //unbined framebuffer
+}
+
+/* Builds the pyramid from the geometry pass that was just rendered. Level 0 converts the source to linear view-space
+*   depth, every following level keeps the nearest and farthest depth of the texels it covers in the level below
+*   Parameters:
+*       pyramid:            the pyramid to build, also records the camera it was built from
+*       copyShader:         hiZCopy shader, writes level 0
+*       downsampleShader:   hiZDownsample shader, writes the other levels
+*       source:             what sourceTexture holds
+*       sourceTexture:      G-buffer positions or depth buffer
+*       normalTexture:      G-buffer normals, tells background pixels apart when the source holds positions
+*       view:               camera of the geometry pass
+*       projection:
+*       farPlane:           depth given to background pixels
+*       screenQuadVAO:      full screen quad
+* */
+void buildHiZPyramid(HiZPyramid& pyramid, const Shader& copyShader, const Shader& downsampleShader, HiZSource source, unsigned int sourceTexture,
+    unsigned int normalTexture, const glm::mat4& view, const glm::mat4& projection, float farPlane, unsigned int screenQuadVAO) {
+    glBindFramebuffer(GL_FRAMEBUFFER, pyramid.framebuffer);
+    glBindVertexArray(screenQuadVAO);
+
+    //level 0
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, pyramid.texture, 0);
+    glViewport(0, 0, pyramid.levelSizes[0].x, pyramid.levelSizes[0].y);
+    copyShader.activateShader();
+    copyShader.setUniformInt("sourceTexture", 0);
+    copyShader.setUniformInt("normalTexture", 1);
+    copyShader.setUniformInt("source", source);
+    copyShader.setUniformMatrix4("view", view);
+    copyShader.setUniformMatrix4("inverseProjection", glm::inverse(projection));
+    copyShader.setUniformFloat("farPlane", farPlane);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, sourceTexture);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, normalTexture);
+    glDrawArrays(GL_TRIANGLES, 0, 6);
+
+    //every other level reads the one below it. That level is made the only one visible to sampling, so reading and
+    //writing the same texture is never a feedback loop
+    downsampleShader.activateShader();
+    downsampleShader.setUniformInt("previousLevel", 0);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, pyramid.texture);
+    for (unsigned int level = 1; level < pyramid.levelSizes.size(); ++level) {
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level - 1);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, level - 1);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, pyramid.texture, level);
+        glViewport(0, 0, pyramid.levelSizes[level].x, pyramid.levelSizes[level].y);
+        glDrawArrays(GL_TRIANGLES, 0, 6);
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, pyramid.levelSizes.size() - 1);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    pyramid.view = view;
+    pyramid.projection = projection;
+    pyramid.valid = true;
+}
+
+/* Creates the buffers of the GPU occlusion culling pass
+*   Parameters:
+*       pass:           the pass to create
+*       numObjects:     number of objects tested every frame
+*       vertexCount:    vertices drawn by every object's indirect command
+* */
+void createHiZCullingPass(HiZCullingPass& pass, unsigned int numObjects, unsigned int vertexCount) {
+    DrawArraysIndirectCommand command = { vertexCount, 1, 0, 0 };
+    pass.commands.assign(numObjects, command);
+
+    glGenBuffers(1, &pass.commandBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, pass.commandBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, numObjects * sizeof(DrawArraysIndirectCommand), pass.commands.data(), GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    glGenVertexArrays(1, &pass.boundsVAO);
+    glGenBuffers(1, &pass.boundsVBO);
+    glBindVertexArray(pass.boundsVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, pass.boundsVBO);
+    glBufferData(GL_ARRAY_BUFFER, numObjects * sizeof(AABB), NULL, GL_DYNAMIC_DRAW);
+
+    //bounds min attribute
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(AABB), (void*)0);
+
+    //bounds max attribute
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(AABB), (void*)sizeof(glm::vec3));
+
+    glBindVertexArray(0); //unbinds vao
+    glBindBuffer(GL_ARRAY_BUFFER, 0); //unbinds vbo
+
+    GLint vertexStorageBlocks = 0;
+    glGetIntegerv(GL_MAX_VERTEX_SHADER_STORAGE_BLOCKS, &vertexStorageBlocks);
+    if (vertexStorageBlocks == 0)
+        std::cout << "ERROR::HIZ:: Storage buffers are not available in vertex shaders, GPU occlusion culling will not cull anything" << std::endl;
+}
+
+/* Resets every object's indirect command to the CPU's visibility, then zeroes the instance count of the objects hidden
+*   behind the pyramid. The pyramid is the previous frame's, and is tested with the camera it was built from: an object
+*   that comes into view from behind an occluder is drawn one frame late. Leaves the command buffer bound to
+*   GL_DRAW_INDIRECT_BUFFER for the draws
+*   Parameters:
+*       pass:           the culling pass
+*       pyramid:        depth the objects are tested against, nothing is culled until it has been built once
+*       cullingShader:  hiZCulling shader
+*       objectBounds:   world-space bounds of every object
+*       objectVisible:  CPU visibility (frustum and occlusion culling) of every object
+* */
+void cullWithHiZ(HiZCullingPass& pass, const HiZPyramid& pyramid, const Shader& cullingShader, const std::vector<AABB>& objectBounds,
+    const std::vector<unsigned char>& objectVisible) {
+    for (unsigned int i = 0; i < pass.commands.size(); ++i)
+        pass.commands[i].instanceCount = objectVisible[i];
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, pass.commandBuffer);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, pass.commands.size() * sizeof(DrawArraysIndirectCommand), pass.commands.data());
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    if (pyramid.valid) {
+        glBindBuffer(GL_ARRAY_BUFFER, pass.boundsVBO);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, pass.commands.size() * sizeof(AABB), objectBounds.data());
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        cullingShader.activateShader();
+        cullingShader.setUniformInt("hiZ", 0);
+        cullingShader.setUniformInt("numLevels", pyramid.levelSizes.size());
+        cullingShader.setUniformMatrix4("viewProjection", pyramid.projection * pyramid.view);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, pyramid.texture);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, pass.commandBuffer);
+
+        //one point per object, nothing is rasterized
+        glEnable(GL_RASTERIZER_DISCARD);
+        glBindVertexArray(pass.boundsVAO);
+        glDrawArrays(GL_POINTS, 0, pass.commands.size());
+        glDisable(GL_RASTERIZER_DISCARD);
+
+        //the indirect draws read what the vertex shader wrote
+        glMemoryBarrier(GL_COMMAND_BARRIER_BIT);
+    }
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, pass.commandBuffer);
+}
+
+/* Reads the commands back and counts the objects that the CPU kept but the GPU pass culled. Waits for the GPU, only
+*   meant for the periodic statistics
+*   Parameters:
+*       pass:           the culling pass
+*       objectVisible:  CPU visibility the commands were reset to
+* */
+unsigned int readHiZCulledObjects(HiZCullingPass& pass, const std::vector<unsigned char>& objectVisible) {
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, pass.commandBuffer);
+    glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, pass.commands.size() * sizeof(DrawArraysIndirectCommand), pass.commands.data());
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    unsigned int culledObjects = 0;
+    for (unsigned int i = 0; i < pass.commands.size(); ++i) {
+        if (objectVisible[i] && pass.commands[i].instanceCount == 0)
+            ++culledObjects;
+    }
+    return culledObjects;
+}
+
+/* Marks the start of the frame on the GPU timeline, called before the first command of the frame
+*   Parameters:
+*       timer:  the frame timer
+* */
+void beginGPUFrameTimer(GPUFrameTimer& timer) {
+    if (timer.queries[0][0] == 0)
+        glGenQueries(2 * GPUFrameTimer::LATENCY, &timer.queries[0][0]);
+    glQueryCounter(timer.queries[timer.frame % GPUFrameTimer::LATENCY][0], GL_TIMESTAMP);
+}
+
+/* Marks the end of the frame and returns the GPU time of the oldest frame in the ring, the one whose queries the next
+*   begin reuses. The span between the timestamps includes any time the GPU sat idle waiting for commands, so a CPU
+*   bound frame reads as a slow one
+*   Parameters:
+*       timer:  the frame timer
+*   Returns the frame time in milliseconds, or a negative value when the result is not available yet
+* */
+float endGPUFrameTimer(GPUFrameTimer& timer) {
+    glQueryCounter(timer.queries[timer.frame % GPUFrameTimer::LATENCY][1], GL_TIMESTAMP);
+    ++timer.frame;
+    if (timer.frame < GPUFrameTimer::LATENCY)
+        return -1.0f;
+
+    //skipped rather than waited for when the GPU is more than LATENCY frames behind
+    unsigned int* queries = timer.queries[timer.frame % GPUFrameTimer::LATENCY];
+    GLint available = 0;
+    glGetQueryObjectiv(queries[1], GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available)
+        return -1.0f;
+    GLuint64 startTime, endTime;
+    glGetQueryObjectui64v(queries[0], GL_QUERY_RESULT, &startTime);
+    glGetQueryObjectui64v(queries[1], GL_QUERY_RESULT, &endTime);
+    return (endTime - startTime) / 1000000.0f;
+}
+
+/* Prints the distribution of a benchmark's frame times: the median, 99th percentile and maximum, and the hitches, frames
+*   that took more than twice as long as the median one. Ends the line the caller started
+*   Parameters:
+*       frameTimes: frame times in milliseconds, at least one
+* */
+void printFrameTimeStats(std::vector<float> frameTimes) {
+    std::sort(frameTimes.begin(), frameTimes.end());
+    float median = frameTimes[frameTimes.size() / 2];
+    unsigned int hitches = 0;
+    for (unsigned int i = 0; i < frameTimes.size(); ++i) {
+        if (frameTimes[i] > 2.0f * median)
+            ++hitches;
+    }
+    std::cout << frameTimes.size() << " frames, frame time median " << median << " ms, 99th percentile " << frameTimes[frameTimes.size() * 99 / 100]
+        << " ms, max " << frameTimes.back() << " ms, " << hitches << " hitches over twice the median" << std::endl;
+}
+
+/* Starts loading every model found under directory at once through the asset loader, a warm-up pass with the GL
+*   uploads on the render thread. Once all are loaded they are loaded twice more, measured: with the uploads on the
+*   render thread and on the upload thread, if there is one, in the opposite order of the last run
+*   Parameters:
+*       benchmark:  the benchmark, left alone while it is running
+*       directory:  searched recursively for files assimp can import
+* */
+void startStreamingBenchmark(StreamingBenchmark& benchmark, const char* directory) {
+    if (benchmark.phase != 0)
+        return;
+    Assimp::Importer importer;
+    std::error_code error;
+    benchmark.files.clear();
+    for (std::filesystem::recursive_directory_iterator file(directory, error), end; !error && file != end; file.increment(error)) {
+        if (file->is_regular_file() && importer.IsExtensionSupported(file->path().extension().string()))
+            benchmark.files.push_back(file->path().generic_string());
+    }
+    if (benchmark.files.empty()) {
+        std::cout << "ERROR::STREAMING_BENCHMARK:: No model files in " << directory << std::endl;
+        return;
+    }
+    benchmark.uploadThreadWasEnabled = assetLoader.isUploadThreadEnabled();
+    benchmark.uploadThreadFirst = !benchmark.uploadThreadFirst;
+    startStreamingBenchmarkPhase(benchmark, 1);
+}
+
+/* Starts loading the benchmark's models: the warm-up (phase 1) with the uploads on the render thread, then the two
+*   measured phases, in the order the benchmark chose. A phase that needs the upload thread is skipped when there is
+*   none, and the benchmark ends after the last phase
+*   Parameters:
+*       benchmark:  the benchmark
+*       phase:      the phase to start
+* */
+void startStreamingBenchmarkPhase(StreamingBenchmark& benchmark, unsigned int phase) {
+    if (phase > 3) {
+        assetLoader.setUploadThreadEnabled(benchmark.uploadThreadWasEnabled);
+        benchmark.phase = 0;
+        return;
+    }
+    bool uploadThread = phase != 1 && (phase == 2) == benchmark.uploadThreadFirst;
+    assetLoader.setUploadThreadEnabled(uploadThread);
+    if (uploadThread && !assetLoader.isUploadThreadEnabled()) {
+        startStreamingBenchmarkPhase(benchmark, phase + 1);
+        return;
+    }
+    benchmark.phase = phase;
+    benchmark.uploadThread = uploadThread;
+    benchmark.frameTimes.clear();
+    benchmark.startTime = glfwGetTime();
+    for (unsigned int i = 0; i < benchmark.files.size(); ++i)
+        benchmark.loads.push_back(assetLoader.loadModel(benchmark.files[i], false, RESIDENCY_GPU_ONLY));
+}
+
+/* Records the frame time while a benchmark phase's models are loading. When they are all loaded it prints the load
+*   time and the frame time distribution of a measured phase and starts the next one
+*   Parameters:
+*       benchmark:  the benchmark
+*       frameTime:  CPU time of the last frame in milliseconds
+* */
+void updateStreamingBenchmark(StreamingBenchmark& benchmark, float frameTime) {
+    if (benchmark.phase == 0)
+        return;
+    benchmark.frameTimes.push_back(frameTime);
+    for (unsigned int i = 0; i < benchmark.loads.size(); ++i) {
+        if (!benchmark.loads[i].isReady())
+            return;
+    }
+    if (benchmark.phase == 1) {
+        benchmark.loads.clear();
+        startStreamingBenchmarkPhase(benchmark, 2);
+        return;
+    }
+
+    std::cout << "Streaming " << benchmark.files.size() << " models with the uploads on the " << (benchmark.uploadThread ? "upload" : "render")
+        << " thread: loaded in " << (glfwGetTime() - benchmark.startTime) * 1000.0 << " ms, ";
+    printFrameTimeStats(benchmark.frameTimes);
+    benchmark.loads.clear();
+    startStreamingBenchmarkPhase(benchmark, benchmark.phase + 1);
+}
+
+/* Sets the internal resolution (FRAMEBUFFER_WIDTH/HEIGHT) of the next frame: the window size, scaled down by the
+*   dynamic resolution controller while it is enabled. The resolution is printed whenever it changes, and with the
+*   smoothed frame time every few seconds while the controller runs
+*   Parameters:
+*       gpuFrameTime:   GPU time of a finished frame in milliseconds, negative when no result was ready this frame
+* */
+void updateRenderResolution(float gpuFrameTime) {
+    static unsigned int frame = 0;
+    if (DYNAMIC_RESOLUTION_ENABLED)
+        dynamicResolution.update(gpuFrameTime, WINDOW_WIDTH, WINDOW_HEIGHT);
+    else
+        dynamicResolution.reset(WINDOW_WIDTH, WINDOW_HEIGHT);
+
+    bool changed = dynamicResolution.getWidth() != FRAMEBUFFER_WIDTH || dynamicResolution.getHeight() != FRAMEBUFFER_HEIGHT;
+    FRAMEBUFFER_WIDTH = dynamicResolution.getWidth();
+    FRAMEBUFFER_HEIGHT = dynamicResolution.getHeight();
+    ++frame;
+    if (changed || (DYNAMIC_RESOLUTION_ENABLED && frame % 300 == 0)) {
+        std::cout << "Render resolution " << FRAMEBUFFER_WIDTH << "x" << FRAMEBUFFER_HEIGHT << " (" << dynamicResolution.getScale() * 100.0f
+            << "% of the " << WINDOW_WIDTH << "x" << WINDOW_HEIGHT << " window)";
+        if (DYNAMIC_RESOLUTION_ENABLED)
+            std::cout << ", GPU frame time " << dynamicResolution.getSmoothedFrameTime() << " ms for a budget of " << dynamicResolution.getBudget() << " ms";
+        std::cout << std::endl;
+    }
+}
+
+/* Declares the pass that draws the scene, rendered at the internal resolution, to the screen. Catmull-Rom filtering
+*   keeps the edges sharper than a bilinear stretch, at full resolution the pass is a plain copy
+*   Parameters:
+*       graph:          the graph the scene's passes are declared on
+*       sceneColor:     the final image of the scene
+*       screenQuadVAO:  full-screen quad
+* */
+void addUpscalePass(RenderGraph& graph, RenderGraph::Resource sceneColor, unsigned int screenQuadVAO) {
+    static Shader upscaleShader = Shader("Shaders/bloomMip.vert", "Shaders/upscale.frag");
+    graph.addPass("Upscale", [&](RenderGraph::PassBuilder& builder) {
+        builder.read(sceneColor);
+        builder.writeBackbuffer();
+    }, [=](const RenderGraph& graph) {
+        glViewport(0, 0, WINDOW_WIDTH, WINDOW_HEIGHT);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        const RenderTargetDesc& desc = graph.getDesc(sceneColor);
+        upscaleShader.activateShader();
+        upscaleShader.setUniformInt("sceneColor", 0);
+        upscaleShader.setUniformInt("bicubic", desc.width != WINDOW_WIDTH || desc.height != WINDOW_HEIGHT);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, graph.getTexture(sceneColor));
+        glBindVertexArray(screenQuadVAO);
+        glDrawArrays(GL_TRIANGLES, 0, 6);
+    });
 }
 
-void createDepthMapFBO(unsigned int& depthMapFBO, unsigned int& depthMap) {
+void createDepthMapFBO(unsigned int& depthMapFBO, unsigned int& depthMap, unsigned int width, unsigned int height) {
     //setup framebuffer
     glGenFramebuffers(1, &depthMapFBO);
     glBindFramebuffer(GL_FRAMEBUFFER, depthMapFBO);
@@ -1778,7 +3072,7 @@ void createDepthMapFBO(unsigned int& depthMapFBO, unsigned int& depthMap) {
     //generate texture as color attachement
     glGenTextures(1, &depthMap);
     glBindTexture(GL_TEXTURE_2D, depthMap);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT, SHADOW_WIDTH, SHADOW_HEIGHT, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT, width, height, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
@@ -1847,7 +3141,7 @@ void createDepthCubeMapFBO(unsigned int& depthCubeMapFBO, unsigned int& depthCub
     //---------------------------------------------------------------------------------------------
 }
 
-void createMSAA_FBO(unsigned int& multisampledFBO, unsigned int& msaa_texColorBuffer, unsigned int numSamples) {
+void createMSAA_FBO(unsigned int& multisampledFBO, unsigned int& msaa_texColorBuffer, unsigned int numSamples, unsigned int width, unsigned int height) {
     //setup MSAA framebuffer
     glGenFramebuffers(1, &multisampledFBO);
     glBindFramebuffer(GL_FRAMEBUFFER, multisampledFBO);
@@ -1855,7 +3149,7 @@ void createMSAA_FBO(unsigned int& multisampledFBO, unsigned int& msaa_texColorBu
     //generate multisampled texture as color attachement
     glGenTextures(1, &msaa_texColorBuffer);
     glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, msaa_texColorBuffer);
-    glTexImage2DMultisample(GL_TEXTURE_2D_MULTISAMPLE, numSamples, GL_RGB, FRAMEBUFFER_WIDTH, FRAMEBUFFER_HEIGHT, GL_TRUE);
+    glTexImage2DMultisample(GL_TEXTURE_2D_MULTISAMPLE, numSamples, GL_RGB, width, height, GL_TRUE);
     //NOT NEED TO SET TEX PARAMETERS FOR MAGNIFYING AND MINIMIZING TEXTURE BECAUSE OPENGL CHOOSES GL_NEAREST NO MATTER WHAT
     glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, 0);//unnbind color buffer from target
 
@@ -1866,7 +3160,7 @@ void createMSAA_FBO(unsigned int& multisampledFBO, unsigned int& msaa_texColorBu
     unsigned int msaa_rbo;
     glGenRenderbuffers(1, &msaa_rbo);
     glBindRenderbuffer(GL_RENDERBUFFER, msaa_rbo);
-    glRenderbufferStorageMultisample(GL_RENDERBUFFER, numSamples, GL_DEPTH24_STENCIL8, FRAMEBUFFER_WIDTH, FRAMEBUFFER_HEIGHT);
+    glRenderbufferStorageMultisample(GL_RENDERBUFFER, numSamples, GL_DEPTH24_STENCIL8, width, height);
     glBindRenderbuffer(GL_RENDERBUFFER, 0);  //unbind rbo
 
     //attach the renderbuffer object to the currently-bound object
@@ -2375,6 +3669,323 @@ void renderEquirectangularMap_withPBR(unsigned int cubeVAO, unsigned int uboMatr
     //---------------------------------------------------------------------------------------------------------------
 }
 
+/* Draws a crowd of animated characters, all playing the same clip from different start times. The poses are sampled on
+*  the job system every frame, then the characters are skinned either in the vertex shader from a buffer of bone
+*  matrices (GPU_SKINNING_ENABLED) or on the CPU with the SIMD path into one dynamic vertex buffer. The CPU time of the
+*  sampling, skinning and upload and the GPU time of the draw are printed every 300 frames, so both paths can be compared
+*  on the same crowd by toggling between them
+*   Parameters:
+*       uboMatrices:    uniform buffer holding the projection and view matrices
+* */
+void renderAnimatedCrowd(unsigned int uboMatrices) {
+    static bool initialized = false;
+    //------------------------------------------------------------------------------------------------------------------------------------
+    //---------------------------------------------------------INITIALIZATION-------------------------------------------------------------
+    //------------------------------------------------------------------------------------------------------------------------------------
+    static const unsigned int numCharacters = 1000;
+    static const unsigned int reportInterval = 300;
+    static Shader shader = Shader("Shaders/skinnedCrowd.vert", "Shaders/skinnedCrowd.frag");
+
+    static Skeleton skeleton;
+    static std::vector<AnimationClip> clips;
+    static SkinnedMeshData character;
+    static std::vector<unsigned int> indices;
+    static AnimationSampler* sampler = NULL;
+    static BoneMatrixBuffer boneBuffer;
+
+    //GPU skinning draws the bind pose with its bone influences, CPU skinning draws the skinned vertices of every
+    //character: all positions, then all normals
+    static unsigned int gpuVAO, gpuVBO, boneVBO, cpuVAO, cpuVBO, EBO;
+    static std::vector<glm::vec3> skinnedPositions, skinnedNormals;
+    static std::vector<GLsizei> drawCounts;
+    static std::vector<const void*> drawIndices;
+    static std::vector<GLint> drawBaseVertices;
+
+    static GPUTimer drawTimer;
+    static double cpuTime = 0.0; //milliseconds
+    static unsigned int cpuFrames = 0;
+    static bool gpuSkinning = GPU_SKINNING_ENABLED;
+
+    if (!initialized) {
+        createProceduralCharacter(skeleton, clips, character, indices);
+        const std::size_t numVertices = character.positions.size();
+
+        //characters on a grid, each starting at a random point of the clip
+        std::mt19937 generator(7);
+        std::uniform_real_distribution<float> randomTime(0.0f, clips[0].duration);
+        sampler = new AnimationSampler(skeleton, clips);
+        unsigned int gridSize = (unsigned int)std::ceil(std::sqrt((float)numCharacters));
+        for (unsigned int i = 0; i < numCharacters; ++i) {
+            glm::vec3 position(1.5f * ((int)(i % gridSize) - (int)gridSize / 2), -1.0f, -1.5f * (i / gridSize) - 3.0f);
+            sampler->addInstance(0, randomTime(generator), glm::translate(glm::mat4(1.0f), position));
+        }
+
+        //shared index buffer
+        glGenBuffers(1, &EBO);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+
+        //GPU skinning: bind pose positions and normals, and the bone influences in their own buffer
+        glGenVertexArrays(1, &gpuVAO);
+        glBindVertexArray(gpuVAO);
+        glGenBuffers(1, &gpuVBO);
+        glBindBuffer(GL_ARRAY_BUFFER, gpuVBO);
+        glBufferData(GL_ARRAY_BUFFER, 2 * numVertices * sizeof(glm::vec3), NULL, GL_STATIC_DRAW);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, numVertices * sizeof(glm::vec3), character.positions.data());
+        glBufferSubData(GL_ARRAY_BUFFER, numVertices * sizeof(glm::vec3), numVertices * sizeof(glm::vec3), character.normals.data());
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0);
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)(numVertices * sizeof(glm::vec3)));
+
+        glGenBuffers(1, &boneVBO);
+        glBindBuffer(GL_ARRAY_BUFFER, boneVBO);
+        glBufferData(GL_ARRAY_BUFFER, numVertices * sizeof(VertexBoneData), character.bones.data(), GL_STATIC_DRAW);
+        glEnableVertexAttribArray(7);
+        glVertexAttribIPointer(7, VertexBoneData::MAX_INFLUENCES, GL_INT, sizeof(VertexBoneData), (void*)offsetof(VertexBoneData, boneIds));
+        glEnableVertexAttribArray(8);
+        glVertexAttribPointer(8, VertexBoneData::MAX_INFLUENCES, GL_FLOAT, GL_FALSE, sizeof(VertexBoneData), (void*)offsetof(VertexBoneData, weights));
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+
+        //CPU skinning: storage for every character's skinned vertices, refilled each frame
+        skinnedPositions.resize(numCharacters * numVertices);
+        skinnedNormals.resize(numCharacters * numVertices);
+        glGenVertexArrays(1, &cpuVAO);
+        glBindVertexArray(cpuVAO);
+        glGenBuffers(1, &cpuVBO);
+        glBindBuffer(GL_ARRAY_BUFFER, cpuVBO);
+        glBufferData(GL_ARRAY_BUFFER, 2 * skinnedPositions.size() * sizeof(glm::vec3), NULL, GL_STREAM_DRAW);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0);
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)(skinnedPositions.size() * sizeof(glm::vec3)));
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        glBindVertexArray(0);
+
+        //one draw per character over the same indices, offset to the character's vertices
+        for (unsigned int i = 0; i < numCharacters; ++i) {
+            drawCounts.push_back(indices.size());
+            drawIndices.push_back((const void*)0);
+            drawBaseVertices.push_back(i * numVertices);
+        }
+
+        //bind ubo and shader to a binding location
+        glBindBufferRange(GL_UNIFORM_BUFFER, 0, uboMatrices, 0, 2 * sizeof(glm::mat4));
+        glUniformBlockBinding(shader.getProgramId(), glGetUniformBlockIndex(shader.getProgramId(), "Matrices"), 0);
+
+        shader.activateShader();
+        shader.setUniformInt("numBones", skeleton.getNumBones());
+        shader.setUniformVec3("lightDirection", glm::normalize(glm::vec3(0.3f, 1.0f, 0.5f)));
+        shader.setUniformVec3("color", 0.8f, 0.55f, 0.3f);
+
+        initialized = true;
+    }
+    //------------------------------------------------------------------------------------------------------------------------------------
+    //------------------------------------------------------------------------------------------------------------------------------------
+    //------------------------------------------------------------------------------------------------------------------------------------
+
+    //restart the averages when the path changes
+    if (gpuSkinning != GPU_SKINNING_ENABLED) {
+        gpuSkinning = GPU_SKINNING_ENABLED;
+        resetGPUTimer(drawTimer);
+        cpuTime = 0.0;
+        cpuFrames = 0;
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    //inserting projection and view matrices into ubo
+    //--------------------------------------------------------------------------------------------------------
+    glBindBuffer(GL_UNIFORM_BUFFER, uboMatrices);
+
+    glm::mat4 projection = glm::perspective(glm::radians(newCamera.getFOV()), (float)WINDOW_WIDTH / WINDOW_HEIGHT, 0.1f, 100.0f);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(glm::mat4), glm::value_ptr(projection));
+
+    glm::mat4 view = newCamera.getViewMatrix();
+    glBufferSubData(GL_UNIFORM_BUFFER, sizeof(glm::mat4), sizeof(glm::mat4), glm::value_ptr(view));
+
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    //--------------------------------------------------------------------------------------------------------
+
+    //sample the poses, then skin on the CPU or upload the bone matrices for the vertex shader
+    //--------------------------------------------------------------------------------------------------------
+    auto cpuStart = std::chrono::high_resolution_clock::now();
+    sampler->update(deltaTime, jobSystem);
+
+    if (GPU_SKINNING_ENABLED) {
+        boneBuffer.upload(sampler->getBoneMatrices());
+    }
+    else {
+        const std::size_t numVertices = character.positions.size();
+        JobCounter skinningDone;
+        jobSystem.parallelFor(numCharacters, 8, [&](unsigned int begin, unsigned int end) {
+            for (unsigned int i = begin; i < end; ++i)
+                skinVerticesSIMD(character, sampler->getBoneMatrices(i), &skinnedPositions[i * numVertices], &skinnedNormals[i * numVertices]);
+        }, &skinningDone);
+        jobSystem.wait(skinningDone);
+
+        //orphan the buffer so the draws of the last frame don't stall the upload
+        std::size_t size = skinnedPositions.size() * sizeof(glm::vec3);
+        glBindBuffer(GL_ARRAY_BUFFER, cpuVBO);
+        glBufferData(GL_ARRAY_BUFFER, 2 * size, NULL, GL_STREAM_DRAW);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, size, skinnedPositions.data());
+        glBufferSubData(GL_ARRAY_BUFFER, size, size, skinnedNormals.data());
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+    cpuTime += elapsedMilliseconds(cpuStart);
+    if (++cpuFrames == reportInterval) {
+        std::cout << (GPU_SKINNING_ENABLED ? "GPU" : "CPU") << " skinning, CPU time (sampling, skinning and upload): "
+            << cpuTime / cpuFrames << " ms" << std::endl;
+        cpuTime = 0.0;
+        cpuFrames = 0;
+    }
+    //--------------------------------------------------------------------------------------------------------
+
+    //draw the crowd
+    //--------------------------------------------------------------------------------------------------------
+    beginGPUTimer(drawTimer);
+    shader.activateShader();
+    shader.setUniformBool("gpuSkinning", GPU_SKINNING_ENABLED);
+    if (GPU_SKINNING_ENABLED) {
+        boneBuffer.bind();
+        glBindVertexArray(gpuVAO);
+        glDrawElementsInstanced(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0, numCharacters);
+    }
+    else {
+        glBindVertexArray(cpuVAO);
+        glMultiDrawElementsBaseVertex(GL_TRIANGLES, drawCounts.data(), GL_UNSIGNED_INT, drawIndices.data(), numCharacters,
+            drawBaseVertices.data());
+    }
+    glBindVertexArray(0);
+    endGPUTimer(drawTimer, GPU_SKINNING_ENABLED ? "GPU skinning, crowd draw" : "CPU skinning, crowd draw", reportInterval);
+    //--------------------------------------------------------------------------------------------------------
+}
+
+/* Draws a city far larger than memory, streamed cell by cell out of a memory-mapped pack file by a CellStreamer. The
+*  pack is generated on the first run, about 4 GB, which takes a while. The camera's velocity is taken from how far it
+*  moved since the last frame, so the cells it is heading for are paged in and uploaded before it gets there. The
+*  residency of both tiers is printed every 300 frames; pressing 1 flies the camera diagonally across the whole city
+*  and prints the frame-time hitches and residency of the flight
+*   Parameters:
+*       uboMatrices:    uniform buffer holding the projection and view matrices
+* */
+void renderStreamedCity(unsigned int uboMatrices) {
+    static bool initialized = false;
+    //------------------------------------------------------------------------------------------------------------------------------------
+    //---------------------------------------------------------INITIALIZATION-------------------------------------------------------------
+    //------------------------------------------------------------------------------------------------------------------------------------
+    static const char* packPath = "streamedCity.pack";
+    static const float drawDistance = 200.0f;
+    static const float flightSpeed = 120.0f; //units per second
+    static const unsigned int reportInterval = 300;
+    static Shader shader = Shader("Shaders/streamedCity.vert", "Shaders/streamedCity.frag");
+    static CellStreamer streamer(assetLoader);
+    static bool packOpen = false;
+    static glm::vec3 lastEye;
+    static unsigned int frames = 0;
+
+    if (!initialized) {
+        packOpen = streamer.open(packPath) || (generateStreamingPack(packPath) && streamer.open(packPath));
+        //the cells within the prefetch distance take about 600 MB of the default pack, within the draw distance about 160 MB
+        streamer.setBudget((std::size_t)1024 << 20, (std::size_t)512 << 20);
+        streamer.setDistances(drawDistance, 2.0f * drawDistance, 2.0f);
+        lastEye = newCamera.getEye();
+
+        //bind ubo and shader to a binding location
+        glBindBufferRange(GL_UNIFORM_BUFFER, 0, uboMatrices, 0, 2 * sizeof(glm::mat4));
+        glUniformBlockBinding(shader.getProgramId(), glGetUniformBlockIndex(shader.getProgramId(), "Matrices"), 0);
+
+        shader.activateShader();
+        shader.setUniformVec3("lightDirection", glm::normalize(glm::vec3(0.3f, 1.0f, 0.5f)));
+        shader.setUniformVec3("groundColor", 0.35f, 0.35f, 0.3f);
+        shader.setUniformVec3("roofColor", 0.85f, 0.8f, 0.7f);
+        shader.setUniformFloat("maxHeight", 10.0f);
+
+        initialized = true;
+    }
+    //------------------------------------------------------------------------------------------------------------------------------------
+    //------------------------------------------------------------------------------------------------------------------------------------
+    //------------------------------------------------------------------------------------------------------------------------------------
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glClearColor(0.55f, 0.7f, 0.85f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    if (!packOpen)
+        return;
+
+    //the flight goes from one corner of the city to the other at a fixed height, looking slightly down. The user's
+    //camera stays where it was
+    //--------------------------------------------------------------------------------------------------------
+    FlyThroughBenchmark& benchmark = flyThroughBenchmark;
+    AABB cityBounds = streamer.getBounds();
+    glm::vec3 flightDirection = glm::normalize(glm::vec3(cityBounds.extent().x, 0.0f, cityBounds.extent().z));
+    float flightLength = glm::length(glm::vec3(cityBounds.extent().x, 0.0f, cityBounds.extent().z));
+    glm::vec3 eye = newCamera.getEye();
+    glm::vec3 forward = newCamera.getForward();
+    glm::vec3 velocity = deltaTime > 0.0f ? (eye - lastEye) / deltaTime : glm::vec3(0.0f);
+    if (benchmark.running) {
+        if (benchmark.frameTimes.empty())
+            benchmark.startStats = streamer.getStats();
+        eye = glm::vec3(cityBounds.min.x, 30.0f, cityBounds.min.z) + flightDirection * flightSpeed * benchmark.time;
+        forward = glm::normalize(flightDirection - glm::vec3(0.0f, 0.2f, 0.0f));
+        velocity = flightDirection * flightSpeed;
+        benchmark.time += deltaTime;
+    }
+    lastEye = eye;
+    streamer.update(eye, velocity);
+    //--------------------------------------------------------------------------------------------------------
+
+    //inserting projection and view matrices into ubo
+    //--------------------------------------------------------------------------------------------------------
+    glBindBuffer(GL_UNIFORM_BUFFER, uboMatrices);
+
+    glm::mat4 projection = glm::perspective(glm::radians(newCamera.getFOV()), (float)WINDOW_WIDTH / WINDOW_HEIGHT, 0.1f, drawDistance);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(glm::mat4), glm::value_ptr(projection));
+
+    glm::mat4 view = glm::lookAt(eye, eye + forward, glm::vec3(0.0f, 1.0f, 0.0f));
+    glBufferSubData(GL_UNIFORM_BUFFER, sizeof(glm::mat4), sizeof(glm::mat4), glm::value_ptr(view));
+
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    //--------------------------------------------------------------------------------------------------------
+
+    shader.activateShader();
+    unsigned int numDrawn = streamer.draw(Frustum(projection * view));
+
+    const StreamingStats& stats = streamer.getStats();
+    if (++frames == reportInterval) {
+        std::cout << "Streamed city: " << numDrawn << " cells drawn, " << stats.numCellsInMemory << " in memory (" << (stats.memoryBytes >> 20)
+            << " MB), " << stats.numCellsOnGPU << " on the GPU (" << (stats.gpuBytes >> 20) << " MB), " << stats.numMissingCells
+            << " missing within the draw distance" << std::endl;
+        frames = 0;
+    }
+
+    //frame times and residency of the fly-through benchmark
+    //--------------------------------------------------------------------------------------------------------
+    if (!benchmark.running)
+        return;
+    benchmark.frameTimes.push_back(deltaTime * 1000.0f);
+    if (stats.numMissingCells > 0)
+        ++benchmark.framesWithMissingCells;
+    benchmark.maxMissingCells = std::max(benchmark.maxMissingCells, stats.numMissingCells);
+    benchmark.peakMemoryBytes = std::max(benchmark.peakMemoryBytes, stats.memoryBytes);
+    benchmark.peakGPUBytes = std::max(benchmark.peakGPUBytes, stats.gpuBytes);
+    if (benchmark.time * flightSpeed < flightLength)
+        return;
+
+    std::cout << "Fly-through of " << streamer.getNumCells() << " cells (" << (streamer.getPackSize() >> 20) << " MB pack) at "
+        << flightSpeed << " units/s: ";
+    printFrameTimeStats(benchmark.frameTimes);
+    std::cout << "    " << benchmark.framesWithMissingCells << " frames with cells missing within the draw distance, at most "
+        << benchmark.maxMissingCells << "; peak residency " << (benchmark.peakMemoryBytes >> 20) << " MB in memory, "
+        << (benchmark.peakGPUBytes >> 20) << " MB on the GPU; " << stats.numPageIns - benchmark.startStats.numPageIns << " page-ins, "
+        << stats.numUploads - benchmark.startStats.numUploads << " uploads, "
+        << stats.numMemoryEvictions - benchmark.startStats.numMemoryEvictions << " memory and "
+        << stats.numGPUEvictions - benchmark.startStats.numGPUEvictions << " GPU evictions" << std::endl;
+    benchmark.running = false;
+}
+
 /*  This function statistically approximate the relative surface area of microfacetas exactly aligned to the 
 *   halfway vector h.
 *
@@ -0,0 +1,99 @@
+#version 330 core
+out float FragColor;
+
+in vec2 texCoord;
+
+uniform sampler2D gPosition; //view-space positions
+uniform sampler2D gNormal; //view-space normals
+uniform sampler2D noiseTexture;
+
+//compact G-buffer: view-space positions are rebuilt from the depth buffer and normals are octahedral-encoded
+uniform bool compactGBuffer;
+uniform sampler2D gDepth;
+uniform mat4 inverseProjection;
+
+uniform vec3 ssaoKernel[64];
+uniform mat4 projection;
+uniform float kernelRadius;
+uniform vec2 noiseScale;
+uniform vec2 noiseOffset; //per-frame shift of the tiled noise texture
+
+//interleaved subset of the kernel evaluated this frame: sample k = i * sampleStride + sampleOffset
+uniform int numSamples;
+uniform int sampleStride;
+uniform int sampleOffset;
+
+//hierarchical-Z sampling: sample depths are read from the nearest-depth channel of the pyramid at a level that grows
+//with the sample's distance from the pixel, so the far samples of a wide kernel hit a few texels of a small level
+//instead of scattering over the full resolution buffer
+uniform bool useHiZ;
+uniform sampler2D hiZ;
+uniform int hiZLevels;
+
+const float bias = 0.025;
+const float hiZLevelOffset = 3.0; //samples closer than 2^hiZLevelOffset pixels read level 0
+
+vec3 viewPosition(vec2 uv)
+{
+    if(!compactGBuffer)
+        return texture(gPosition, uv).xyz;
+
+    float depth = texture(gDepth, uv).r;
+    vec4 viewPos = inverseProjection * vec4(vec3(uv, depth) * 2.0 - 1.0, 1.0);
+    return viewPos.xyz / viewPos.w;
+}
+
+vec3 viewNormal(vec2 uv)
+{
+    if(!compactGBuffer)
+        return normalize(texture(gNormal, uv).rgb);
+
+    vec2 encoded = texture(gNormal, uv).rg * 2.0 - 1.0;
+    vec3 n = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+    float t = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
+
+float sampleViewDepth(vec2 uv)
+{
+    if(!useHiZ)
+        return viewPosition(uv).z;
+
+    float pixelDistance = length((uv - texCoord) * vec2(textureSize(hiZ, 0)));
+    float level = clamp(floor(log2(max(pixelDistance, 1.0))) - hiZLevelOffset, 0.0, float(hiZLevels - 1));
+    return -textureLod(hiZ, uv, level).r;
+}
+
+void main()
+{
+    vec3 fragPos = viewPosition(texCoord);
+    vec3 normal = viewNormal(texCoord);
+    vec3 randomVec = normalize(texture(noiseTexture, texCoord * noiseScale + noiseOffset).xyz);
+
+    //create TBN change-of-basis matrix: from tangent-space to view-space (Gramm-Schmidt process)
+    vec3 tangent = normalize(randomVec - normal * dot(randomVec, normal));
+    vec3 bitangent = cross(normal, tangent);
+    mat3 TBN = mat3(tangent, bitangent, normal);
+
+    float occlusion = 0.0;
+    for(int i = 0; i < numSamples; ++i)
+    {
+        //get sample position in view-space
+        vec3 samplePos = TBN * ssaoKernel[i * sampleStride + sampleOffset];
+        samplePos = fragPos + samplePos * kernelRadius;
+
+        //project sample position to get its position on the screen
+        vec4 offset = projection * vec4(samplePos, 1.0);
+        offset.xyz /= offset.w; //perspective divide
+        offset.xyz = offset.xyz * 0.5 + 0.5; //transform to range 0.0 - 1.0
+
+        //get depth of the geometry at the sample's screen position and compare
+        float sampleDepth = sampleViewDepth(offset.xy);
+        float rangeCheck = smoothstep(0.0, 1.0, kernelRadius / abs(fragPos.z - sampleDepth));
+        occlusion += (sampleDepth >= samplePos.z + bias ? 1.0 : 0.0) * rangeCheck;
+    }
+
+    FragColor = 1.0 - (occlusion / numSamples);
+}
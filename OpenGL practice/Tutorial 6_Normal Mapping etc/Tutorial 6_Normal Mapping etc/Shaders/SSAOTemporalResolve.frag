@@ -0,0 +1,57 @@
+#version 330 core
+out vec2 FragColor; //r: accumulated ambient occlusion, g: linear view-space depth used for rejection next frame
+
+in vec2 texCoord;
+
+uniform sampler2D ssaoInput; //this frame's partial ambient occlusion
+uniform sampler2D history; //last frame's resolved output
+uniform sampler2D gPosition; //view-space positions
+
+//compact G-buffer: view-space positions are rebuilt from the depth buffer
+uniform bool compactGBuffer;
+uniform sampler2D gDepth;
+uniform mat4 inverseProjection;
+
+uniform mat4 inverseView;
+uniform mat4 prevView;
+uniform mat4 prevProjection;
+uniform float historyBlend; //weight of the current frame when the history is accepted
+uniform float depthRejectThreshold; //relative depth difference at which the history is discarded
+uniform bool historyValid;
+
+vec3 viewPosition(vec2 uv)
+{
+    if(!compactGBuffer)
+        return texture(gPosition, uv).xyz;
+
+    float depth = texture(gDepth, uv).r;
+    vec4 viewPos = inverseProjection * vec4(vec3(uv, depth) * 2.0 - 1.0, 1.0);
+    return viewPos.xyz / viewPos.w;
+}
+
+void main()
+{
+    vec3 fragPos = viewPosition(texCoord);
+    float currentAO = texture(ssaoInput, texCoord).r;
+    float depth = -fragPos.z;
+
+    //reproject the fragment into last frame's screen space using last frame's view-projection matrix
+    vec4 worldPos = inverseView * vec4(fragPos, 1.0);
+    vec4 prevViewPos = prevView * worldPos;
+    vec4 prevClip = prevProjection * prevViewPos;
+    vec2 prevUV = (prevClip.xy / prevClip.w) * 0.5 + 0.5;
+
+    if(historyValid && prevClip.w > 0.0 && all(greaterThanEqual(prevUV, vec2(0.0))) && all(lessThanEqual(prevUV, vec2(1.0))))
+    {
+        vec2 prevSample = texture(history, prevUV).rg;
+
+        //accept the history only if the surface found there is the one we reprojected (disocclusion check)
+        float expectedDepth = -prevViewPos.z;
+        if(abs(prevSample.g - expectedDepth) <= depthRejectThreshold * expectedDepth)
+        {
+            currentAO = mix(prevSample.r, currentAO, historyBlend);
+        }
+    }
+
+    FragColor = vec2(currentAO, depth);
+}
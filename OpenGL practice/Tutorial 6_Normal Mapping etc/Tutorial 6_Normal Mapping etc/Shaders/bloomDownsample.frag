@@ -0,0 +1,82 @@
+#version 330 core
+out vec3 FragColor;
+
+in vec2 texCoord;
+
+uniform sampler2D sourceTexture;
+uniform vec2 sourceTexelSize; //1.0 / resolution of the source mip
+uniform bool prefilter; //true for the first downsample, which reads the full resolution HDR scene
+uniform float threshold;
+uniform float knee; //width of the soft transition below the threshold
+
+//soft-knee bright pass: a quadratic ramp around the threshold instead of a hard cut, to avoid popping
+vec3 brightPass(vec3 color)
+{
+    float brightness = max(color.r, max(color.g, color.b));
+    float soft = clamp(brightness - threshold + knee, 0.0, 2.0 * knee);
+    soft = soft * soft / (4.0 * knee + 0.00001);
+    float contribution = max(soft, brightness - threshold) / max(brightness, 0.00001);
+    return color * contribution;
+}
+
+//weight that tames single very bright pixels (fireflies) before they get smeared across the whole chain
+float karisWeight(vec3 color)
+{
+    float luma = dot(color, vec3(0.2126, 0.7152, 0.0722));
+    return 1.0 / (1.0 + luma);
+}
+
+void main()
+{
+    //13-tap downsample: five overlapping 2x2 boxes (a centre one and four corner ones) sampled with bilinear taps
+    // a - b - c
+    // - j - k -
+    // d - e - f
+    // - l - m -
+    // g - h - i
+    vec2 t = sourceTexelSize;
+    vec3 a = texture(sourceTexture, texCoord + vec2(-2.0 * t.x,  2.0 * t.y)).rgb;
+    vec3 b = texture(sourceTexture, texCoord + vec2( 0.0,        2.0 * t.y)).rgb;
+    vec3 c = texture(sourceTexture, texCoord + vec2( 2.0 * t.x,  2.0 * t.y)).rgb;
+    vec3 d = texture(sourceTexture, texCoord + vec2(-2.0 * t.x,  0.0)).rgb;
+    vec3 e = texture(sourceTexture, texCoord).rgb;
+    vec3 f = texture(sourceTexture, texCoord + vec2( 2.0 * t.x,  0.0)).rgb;
+    vec3 g = texture(sourceTexture, texCoord + vec2(-2.0 * t.x, -2.0 * t.y)).rgb;
+    vec3 h = texture(sourceTexture, texCoord + vec2( 0.0,       -2.0 * t.y)).rgb;
+    vec3 i = texture(sourceTexture, texCoord + vec2( 2.0 * t.x, -2.0 * t.y)).rgb;
+    vec3 j = texture(sourceTexture, texCoord + vec2(-t.x,  t.y)).rgb;
+    vec3 k = texture(sourceTexture, texCoord + vec2( t.x,  t.y)).rgb;
+    vec3 l = texture(sourceTexture, texCoord + vec2(-t.x, -t.y)).rgb;
+    vec3 m = texture(sourceTexture, texCoord + vec2( t.x, -t.y)).rgb;
+
+    vec3 centre = (j + k + l + m) * 0.25;
+    vec3 topLeft = (a + b + d + e) * 0.25;
+    vec3 topRight = (b + c + e + f) * 0.25;
+    vec3 bottomLeft = (d + e + g + h) * 0.25;
+    vec3 bottomRight = (e + f + h + i) * 0.25;
+
+    vec3 result;
+    if(prefilter)
+    {
+        centre = brightPass(centre);
+        topLeft = brightPass(topLeft);
+        topRight = brightPass(topRight);
+        bottomLeft = brightPass(bottomLeft);
+        bottomRight = brightPass(bottomRight);
+
+        float centreWeight = karisWeight(centre) * 0.5;
+        float topLeftWeight = karisWeight(topLeft) * 0.125;
+        float topRightWeight = karisWeight(topRight) * 0.125;
+        float bottomLeftWeight = karisWeight(bottomLeft) * 0.125;
+        float bottomRightWeight = karisWeight(bottomRight) * 0.125;
+        result = (centre * centreWeight + topLeft * topLeftWeight + topRight * topRightWeight
+            + bottomLeft * bottomLeftWeight + bottomRight * bottomRightWeight)
+            / (centreWeight + topLeftWeight + topRightWeight + bottomLeftWeight + bottomRightWeight);
+    }
+    else
+    {
+        result = centre * 0.5 + (topLeft + topRight + bottomLeft + bottomRight) * 0.125;
+    }
+
+    FragColor = max(result, vec3(0.0001)); //keep the chain free of zeros/negatives that would turn into black spots
+}
@@ -0,0 +1,31 @@
+#version 330 core
+out vec3 FragColor;
+
+in vec2 texCoord;
+
+uniform sampler2D sourceTexture; //the smaller mip, added on top of the current one with additive blending
+uniform float filterRadius; //radius of the tent filter in texture coordinates
+
+void main()
+{
+    //3x3 tent filter
+    // 1 2 1
+    // 2 4 2  * 1/16
+    // 1 2 1
+    float x = filterRadius;
+    float y = filterRadius;
+    vec3 a = texture(sourceTexture, vec2(texCoord.x - x, texCoord.y + y)).rgb;
+    vec3 b = texture(sourceTexture, vec2(texCoord.x,     texCoord.y + y)).rgb;
+    vec3 c = texture(sourceTexture, vec2(texCoord.x + x, texCoord.y + y)).rgb;
+    vec3 d = texture(sourceTexture, vec2(texCoord.x - x, texCoord.y)).rgb;
+    vec3 e = texture(sourceTexture, vec2(texCoord.x,     texCoord.y)).rgb;
+    vec3 f = texture(sourceTexture, vec2(texCoord.x + x, texCoord.y)).rgb;
+    vec3 g = texture(sourceTexture, vec2(texCoord.x - x, texCoord.y - y)).rgb;
+    vec3 h = texture(sourceTexture, vec2(texCoord.x,     texCoord.y - y)).rgb;
+    vec3 i = texture(sourceTexture, vec2(texCoord.x + x, texCoord.y - y)).rgb;
+
+    vec3 result = e * 4.0;
+    result += (b + d + f + h) * 2.0;
+    result += (a + c + g + i);
+    FragColor = result * (1.0 / 16.0);
+}
@@ -0,0 +1,73 @@
+#version 330 core
+//compact G-buffer: no position target (reconstructed from depth), octahedral view-space normal in RG16, albedo + spec in RGBA8
+layout (location = 0) out vec2 gNormal;
+layout (location = 1) out vec4 gAlbedoSpec;
+
+struct Material{
+    sampler2D diffuseMap;
+    sampler2D specularMap;
+    sampler2D heightMap; //normal map
+    float shininess;
+};
+
+in VS_OUT {
+    vec3 viewPos;
+    vec2 texCoord;
+    mat3 TBN;
+} fs_in;
+
+uniform Material material;
+uniform sampler2D depthMap;
+uniform bool normal_mapping;
+uniform bool parallax_mapping;
+uniform float height_scale;
+
+//map a unit vector onto the octahedron and unfold it into the [-1, 1] square
+vec2 octahedralEncode(vec3 n)
+{
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    vec2 encoded = n.z >= 0.0 ? n.xy : (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    return encoded;
+}
+
+vec2 parallaxMapping(vec2 texCoord, vec3 viewDir)
+{
+    //steep parallax mapping: march along the view ray in tangent space until it dips below the depth map
+    const float minLayers = 8.0;
+    const float maxLayers = 32.0;
+    float numLayers = mix(maxLayers, minLayers, abs(dot(vec3(0.0, 0.0, 1.0), viewDir)));
+    float layerDepth = 1.0 / numLayers;
+    vec2 deltaTexCoord = viewDir.xy / viewDir.z * height_scale / numLayers;
+
+    float currentLayerDepth = 0.0;
+    vec2 currentTexCoord = texCoord;
+    float currentDepth = texture(depthMap, currentTexCoord).r;
+    while(currentLayerDepth < currentDepth)
+    {
+        currentTexCoord -= deltaTexCoord;
+        currentDepth = texture(depthMap, currentTexCoord).r;
+        currentLayerDepth += layerDepth;
+    }
+    return currentTexCoord;
+}
+
+void main()
+{
+    vec2 texCoord = fs_in.texCoord;
+    if(parallax_mapping)
+    {
+        vec3 tangentViewDir = normalize(transpose(fs_in.TBN) * -fs_in.viewPos);
+        texCoord = parallaxMapping(texCoord, tangentViewDir);
+    }
+
+    vec3 normal = fs_in.TBN[2];
+    if(normal_mapping)
+    {
+        normal = texture(material.heightMap, texCoord).rgb * 2.0 - 1.0;
+        normal = fs_in.TBN * normal;
+    }
+
+    gNormal = octahedralEncode(normalize(normal)) * 0.5 + 0.5; //GL_RG16 is unsigned normalized
+    gAlbedoSpec.rgb = texture(material.diffuseMap, texCoord).rgb;
+    gAlbedoSpec.a = texture(material.specularMap, texCoord).r;
+}
@@ -0,0 +1,35 @@
+#version 330 core
+layout (location = 0) in vec3 aPosition;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoord;
+layout (location = 3) in vec3 aTangent;
+layout (location = 4) in vec3 aBitangent;
+
+layout (std140) uniform Matrices
+{
+    mat4 projection;
+    mat4 view;
+};
+
+out VS_OUT {
+    vec3 viewPos; //view-space position, only used for parallax mapping (positions are not written to the G-buffer)
+    vec2 texCoord;
+    mat3 TBN; //tangent-space to view-space
+} vs_out;
+
+uniform mat4 model;
+
+void main()
+{
+    mat3 normalMatrix = mat3(transpose(inverse(view * model)));
+    vec3 T = normalize(normalMatrix * aTangent);
+    vec3 N = normalize(normalMatrix * aNormal);
+    T = normalize(T - dot(T, N) * N); //re-orthogonalize T with respect to N
+    vec3 B = cross(N, T);
+
+    vec4 viewPos = view * model * vec4(aPosition, 1.0);
+    vs_out.viewPos = viewPos.xyz;
+    vs_out.texCoord = aTexCoord;
+    vs_out.TBN = mat3(T, B, N);
+    gl_Position = projection * viewPos;
+}
@@ -0,0 +1,83 @@
+#version 330 core
+out vec4 FragColor;
+
+struct PointLight{
+    float radius;
+
+    //attenuation
+    float constant;
+    float linear;
+    float quadratic;
+
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+
+#define MAX_LIGHTS 32
+
+in vec2 texCoord;
+
+uniform sampler2D gDepth;
+uniform sampler2D gNormal; //octahedral-encoded view-space normals
+uniform sampler2D gAlbedoSpec;
+uniform sampler2D ssao;
+
+uniform PointLight lights[MAX_LIGHTS];
+uniform vec3 lightPos[MAX_LIGHTS]; //view-space light positions
+uniform int numLights;
+uniform mat4 inverseProjection;
+uniform float shininess;
+uniform bool gamma;
+uniform bool ao;
+
+vec3 octahedralDecode(vec2 encoded)
+{
+    vec3 n = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+    float t = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
+
+//rebuild the view-space position from the hardware depth and the inverse projection
+vec3 reconstructViewPos(vec2 uv)
+{
+    float depth = texture(gDepth, uv).r;
+    vec4 viewPos = inverseProjection * vec4(vec3(uv, depth) * 2.0 - 1.0, 1.0);
+    return viewPos.xyz / viewPos.w;
+}
+
+void main()
+{
+    vec3 fragPos = reconstructViewPos(texCoord);
+    vec3 normal = octahedralDecode(texture(gNormal, texCoord).rg * 2.0 - 1.0);
+    vec3 albedo = texture(gAlbedoSpec, texCoord).rgb;
+    float specularStrength = texture(gAlbedoSpec, texCoord).a;
+    float occlusion = ao ? texture(ssao, texCoord).r : 1.0;
+
+    vec3 viewDir = normalize(-fragPos); //the camera sits at the origin in view space
+    vec3 result = vec3(0.0);
+    for(int i = 0; i < numLights; ++i)
+    {
+        float distance = length(lightPos[i] - fragPos);
+        vec3 ambient = lights[i].ambient * albedo * occlusion;
+        if(distance > lights[i].radius)
+        {
+            result += ambient;
+            continue;
+        }
+
+        vec3 lightDir = normalize(lightPos[i] - fragPos);
+        vec3 halfwayDir = normalize(lightDir + viewDir);
+        vec3 diffuse = max(dot(normal, lightDir), 0.0) * lights[i].diffuse * albedo;
+        vec3 specular = pow(max(dot(normal, halfwayDir), 0.0), shininess) * lights[i].specular * specularStrength;
+
+        float attenuation = 1.0 / (lights[i].constant + lights[i].linear * distance + lights[i].quadratic * distance * distance);
+        result += ambient + (diffuse + specular) * attenuation;
+    }
+
+    if(gamma)
+        result = pow(result, vec3(1.0 / 2.2));
+    FragColor = vec4(result, 1.0);
+}
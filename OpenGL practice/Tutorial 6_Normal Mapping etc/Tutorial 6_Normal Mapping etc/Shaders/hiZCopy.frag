@@ -0,0 +1,42 @@
+#version 330 core
+out vec2 FragColor;
+
+//level 0 of the hierarchical-Z pyramid: linear view-space depth (distance along the view direction), nearest depth
+//in red and farthest depth in green, both equal at this level
+uniform sampler2D sourceTexture;
+uniform sampler2D normalTexture; //only read when the source holds positions
+uniform int source; //0: view-space positions, 1: world-space positions, 2: depth buffer
+uniform mat4 view;
+uniform mat4 inverseProjection;
+uniform float farPlane; //depth given to background pixels
+
+void main()
+{
+    ivec2 texel = ivec2(gl_FragCoord.xy);
+    float depth = farPlane;
+    if(source == 2)
+    {
+        float bufferDepth = texelFetch(sourceTexture, texel, 0).r;
+        if(bufferDepth < 1.0)
+        {
+            vec2 uv = (vec2(texel) + 0.5) / vec2(textureSize(sourceTexture, 0));
+            vec4 viewPos = inverseProjection * vec4(vec3(uv, bufferDepth) * 2.0 - 1.0, 1.0);
+            depth = -viewPos.z / viewPos.w;
+        }
+    }
+    else
+    {
+        //position buffers are cleared to a constant that could be a real position, background pixels are told
+        //apart by their normal instead, which is only unit length where geometry was drawn
+        vec3 normal = texelFetch(normalTexture, texel, 0).xyz;
+        if(dot(normal, normal) > 0.25)
+        {
+            vec3 position = texelFetch(sourceTexture, texel, 0).xyz;
+            if(source == 1)
+                position = (view * vec4(position, 1.0)).xyz;
+            depth = -position.z;
+        }
+    }
+
+    FragColor = vec2(depth);
+}
@@ -0,0 +1,6 @@
+#version 430 core
+
+//the culling pass runs with rasterizer discard, this stage only exists to complete the program
+void main()
+{
+}
@@ -0,0 +1,69 @@
+#version 430 core
+layout (location = 0) in vec3 aBoundsMin; //world-space bounds, one point per object
+layout (location = 1) in vec3 aBoundsMax;
+
+struct DrawArraysIndirectCommand
+{
+    uint count;
+    uint instanceCount;
+    uint first;
+    uint baseInstance;
+};
+
+//one draw command per object. The CPU has already zeroed the instance count of every object it culled, this pass
+//only zeroes the ones hidden behind the depth of the previous frame
+layout (std430, binding = 0) buffer DrawCommands
+{
+    DrawArraysIndirectCommand commands[];
+};
+
+uniform sampler2D hiZ; //linear depth pyramid: nearest depth in red, farthest depth in green
+uniform mat4 viewProjection; //camera the pyramid was built from
+uniform int numLevels;
+
+void main()
+{
+    if(commands[gl_VertexID].instanceCount == 0u)
+        return;
+
+    //screen rectangle and nearest depth of the box
+    vec2 rectMin = vec2(1.0e30);
+    vec2 rectMax = vec2(-1.0e30);
+    float nearestDepth = 1.0e30;
+    for(int i = 0; i < 8; ++i)
+    {
+        vec3 corner = vec3((i & 1) != 0 ? aBoundsMax.x : aBoundsMin.x, (i & 2) != 0 ? aBoundsMax.y : aBoundsMin.y,
+            (i & 4) != 0 ? aBoundsMax.z : aBoundsMin.z);
+        vec4 clipPos = viewProjection * vec4(corner, 1.0);
+
+        //the box reaches behind the camera, its projection is unbounded
+        if(clipPos.w <= 0.0)
+            return;
+
+        vec2 uv = clipPos.xy / clipPos.w * 0.5 + 0.5;
+        rectMin = min(rectMin, uv);
+        rectMax = max(rectMax, uv);
+        nearestDepth = min(nearestDepth, clipPos.w); //w is the linear view-space depth under a perspective projection
+    }
+
+    //off-screen objects are left to frustum culling
+    if(any(lessThan(rectMax, vec2(0.0))) || any(greaterThan(rectMin, vec2(1.0))))
+        return;
+
+    //pick the first level at which the rectangle spans at most 2x2 texels
+    ivec2 baseSize = textureSize(hiZ, 0);
+    ivec2 pixelMin = clamp(ivec2(clamp(rectMin, 0.0, 1.0) * vec2(baseSize)), ivec2(0), baseSize - 1);
+    ivec2 pixelMax = clamp(ivec2(clamp(rectMax, 0.0, 1.0) * vec2(baseSize)), ivec2(0), baseSize - 1);
+    int span = max(pixelMax.x - pixelMin.x, pixelMax.y - pixelMin.y);
+    int level = min(span <= 1 ? 0 : findMSB(span - 1) + 1, numLevels - 1);
+
+    ivec2 levelSize = textureSize(hiZ, level);
+    ivec2 texelMin = min(pixelMin >> level, levelSize - 1);
+    ivec2 texelMax = min(pixelMax >> level, levelSize - 1);
+    float farthestDepth = max(max(texelFetch(hiZ, texelMin, level).g, texelFetch(hiZ, ivec2(texelMax.x, texelMin.y), level).g),
+        max(texelFetch(hiZ, ivec2(texelMin.x, texelMax.y), level).g, texelFetch(hiZ, texelMax, level).g));
+
+    //everything drawn under the rectangle is nearer than the nearest point of the box
+    if(nearestDepth > farthestDepth)
+        commands[gl_VertexID].instanceCount = 0u;
+}
@@ -0,0 +1,34 @@
+#version 330 core
+out vec2 FragColor;
+
+//base and max level are both set to the level below the one being written, so level 0 here is that level
+uniform sampler2D previousLevel;
+
+void main()
+{
+    ivec2 sourceSize = textureSize(previousLevel, 0);
+    ivec2 levelSize = max(sourceSize / 2, ivec2(1));
+    ivec2 texel = ivec2(gl_FragCoord.xy);
+
+    //every texel covers 2x2 texels of the level below. Along an odd edge the last row/column also takes in the texels
+    //the halving rounded away, so that a texel at level n always covers pixels [texel << n, (texel + 1) << n) of level
+    //0, extended to the edge of the image for the last row and column
+    ivec2 first = texel * 2;
+    ivec2 last = min(first + 1, sourceSize - 1);
+    if(texel.x == levelSize.x - 1)
+        last.x = sourceSize.x - 1;
+    if(texel.y == levelSize.y - 1)
+        last.y = sourceSize.y - 1;
+
+    vec2 depthRange = vec2(1.0e30, 0.0);
+    for(int y = first.y; y <= last.y; ++y)
+    {
+        for(int x = first.x; x <= last.x; ++x)
+        {
+            vec2 depth = texelFetch(previousLevel, ivec2(x, y), 0).rg;
+            depthRange = vec2(min(depthRange.x, depth.x), max(depthRange.y, depth.y));
+        }
+    }
+
+    FragColor = depthRange;
+}
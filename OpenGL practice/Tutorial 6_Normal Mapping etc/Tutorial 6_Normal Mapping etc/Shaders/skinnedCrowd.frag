@@ -0,0 +1,13 @@
+#version 430 core
+out vec4 FragColor;
+
+in vec3 normal;
+
+uniform vec3 lightDirection; //towards the light
+uniform vec3 color;
+
+void main()
+{
+    float diffuse = max(dot(normalize(normal), lightDirection), 0.0);
+    FragColor = vec4(color * (0.2 + 0.8 * diffuse), 1.0);
+}
@@ -0,0 +1,37 @@
+#version 430 core
+layout (location = 0) in vec3 aPosition;
+layout (location = 1) in vec3 aNormal;
+layout (location = 7) in ivec4 aBoneIds;
+layout (location = 8) in vec4 aBoneWeights;
+
+layout (std140) uniform Matrices
+{
+    mat4 projection;
+    mat4 view;
+};
+
+//numBones matrices per instance, instance after instance. Each one already includes the instance's model transform
+layout (std430, binding = 3) buffer BoneMatrices
+{
+    mat4 boneMatrices[];
+};
+
+uniform bool gpuSkinning; //when false the vertices were skinned on the CPU and are already in world space
+uniform int numBones;
+
+out vec3 normal;
+
+void main()
+{
+    vec3 position = aPosition;
+    normal = aNormal;
+    if(gpuSkinning)
+    {
+        int firstBone = gl_InstanceID * numBones;
+        mat4 skin = aBoneWeights.x * boneMatrices[firstBone + aBoneIds.x] + aBoneWeights.y * boneMatrices[firstBone + aBoneIds.y]
+            + aBoneWeights.z * boneMatrices[firstBone + aBoneIds.z] + aBoneWeights.w * boneMatrices[firstBone + aBoneIds.w];
+        position = vec3(skin * vec4(aPosition, 1.0));
+        normal = mat3(skin) * aNormal; //the bones don't scale non-uniformly
+    }
+    gl_Position = projection * view * vec4(position, 1.0);
+}
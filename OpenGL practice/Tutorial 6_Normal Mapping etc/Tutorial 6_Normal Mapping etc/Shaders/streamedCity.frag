@@ -0,0 +1,17 @@
+#version 430 core
+out vec4 FragColor;
+
+in vec3 normal;
+in float height;
+
+uniform vec3 lightDirection; //towards the light
+uniform vec3 groundColor;
+uniform vec3 roofColor;
+uniform float maxHeight; //height at which roofColor is reached
+
+void main()
+{
+    float diffuse = max(dot(normalize(normal), lightDirection), 0.0);
+    vec3 color = mix(groundColor, roofColor, clamp(height / maxHeight, 0.0, 1.0));
+    FragColor = vec4(color * (0.2 + 0.8 * diffuse), 1.0);
+}
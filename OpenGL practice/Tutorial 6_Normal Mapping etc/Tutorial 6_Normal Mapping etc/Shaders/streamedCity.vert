@@ -0,0 +1,19 @@
+#version 430 core
+layout (location = 0) in vec3 aPosition;
+layout (location = 1) in vec3 aNormal;
+
+layout (std140) uniform Matrices
+{
+    mat4 projection;
+    mat4 view;
+};
+
+out vec3 normal;
+out float height;
+
+void main()
+{
+    normal = aNormal;
+    height = aPosition.y;
+    gl_Position = projection * view * vec4(aPosition, 1.0);
+}
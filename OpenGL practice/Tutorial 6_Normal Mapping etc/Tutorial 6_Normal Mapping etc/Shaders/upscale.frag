@@ -0,0 +1,52 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 texCoord;
+
+uniform sampler2D sceneColor; //the scene at the internal resolution, sampled with linear filtering
+uniform bool bicubic; //false when the scene is already at the window's resolution
+
+//Catmull-Rom filter over the 4x4 texels around the sample in 9 bilinear fetches: the two middle weights of each axis
+//have the same sign, so the middle texel pair is read with a single fetch placed between them by their weights
+vec4 sampleCatmullRom(vec2 uv)
+{
+    vec2 texSize = vec2(textureSize(sceneColor, 0));
+    vec2 samplePos = uv * texSize;
+    vec2 texPos1 = floor(samplePos - 0.5) + 0.5;
+    vec2 f = samplePos - texPos1;
+
+    vec2 w0 = f * (-0.5 + f * (1.0 - 0.5 * f));
+    vec2 w1 = 1.0 + f * f * (-2.5 + 1.5 * f);
+    vec2 w2 = f * (0.5 + f * (2.0 - 1.5 * f));
+    vec2 w3 = f * f * (-0.5 + 0.5 * f);
+
+    vec2 w12 = w1 + w2;
+    vec2 offset12 = w2 / w12;
+
+    vec2 texPos0 = (texPos1 - 1.0) / texSize;
+    vec2 texPos3 = (texPos1 + 2.0) / texSize;
+    vec2 texPos12 = (texPos1 + offset12) / texSize;
+
+    vec4 result = vec4(0.0);
+    result += texture(sceneColor, vec2(texPos0.x, texPos0.y)) * w0.x * w0.y;
+    result += texture(sceneColor, vec2(texPos12.x, texPos0.y)) * w12.x * w0.y;
+    result += texture(sceneColor, vec2(texPos3.x, texPos0.y)) * w3.x * w0.y;
+
+    result += texture(sceneColor, vec2(texPos0.x, texPos12.y)) * w0.x * w12.y;
+    result += texture(sceneColor, vec2(texPos12.x, texPos12.y)) * w12.x * w12.y;
+    result += texture(sceneColor, vec2(texPos3.x, texPos12.y)) * w3.x * w12.y;
+
+    result += texture(sceneColor, vec2(texPos0.x, texPos3.y)) * w0.x * w3.y;
+    result += texture(sceneColor, vec2(texPos12.x, texPos3.y)) * w12.x * w3.y;
+    result += texture(sceneColor, vec2(texPos3.x, texPos3.y)) * w3.x * w3.y;
+    return result;
+}
+
+void main()
+{
+    //the negative lobes overshoot around hard edges, the result is clamped back into the range of the image
+    if(bicubic)
+        FragColor = clamp(sampleCatmullRom(texCoord), 0.0, 1.0);
+    else
+        FragColor = texture(sceneColor, texCoord);
+}